@@ -119,7 +119,16 @@ namespace Shattang::MyLisp
         {
             indent();
             const auto &forNode = static_cast<const ForIterationNode &>(node);
-            out_ << "(FOR_ITERATION (for " << forNode.index_ << " ";
+            if (forNode.grain_ != nullptr)
+            {
+                out_ << "(FOR_ITERATION (pfor (" << forNode.index_ << " ";
+                print(*forNode.grain_);
+                out_ << ") ";
+            }
+            else
+            {
+                out_ << "(FOR_ITERATION (" << (forNode.isParallel_ ? "pfor " : "for ") << forNode.index_ << " ";
+            }
             print(*forNode.start_);
             out_ << " ";
             print(*forNode.end_);
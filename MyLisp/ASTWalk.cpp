@@ -0,0 +1,96 @@
+#include <Shattang/MyLisp/ASTWalk.h>
+
+namespace Shattang::MyLisp
+{
+    void forEachNode(const ASTNode &node, const std::function<void(const ASTNode &)> &fn)
+    {
+        fn(node);
+        auto each = [&fn](const std::vector<std::unique_ptr<ASTNode>> &nodes)
+        {
+            for (const auto &child : nodes)
+            {
+                forEachNode(*child, fn);
+            }
+        };
+
+        switch (node.getType())
+        {
+        case NodeType::VARIABLE_DECLARATION:
+            forEachNode(*static_cast<const VariableDeclarationNode &>(node).valueNode_, fn);
+            break;
+        case NodeType::FUNCTION_DECLARATION:
+            each(static_cast<const FunctionDeclarationNode &>(node).body_);
+            break;
+        case NodeType::FUNCTION_CALL:
+            each(static_cast<const FunctionCallNode &>(node).arguments_);
+            break;
+        case NodeType::VARIABLE_ASSIGNMENT:
+            forEachNode(*static_cast<const VariableAssignmentNode &>(node).valueNode_, fn);
+            break;
+        case NodeType::FOR_ITERATION:
+        {
+            const auto &forNode = static_cast<const ForIterationNode &>(node);
+            if (forNode.grain_ != nullptr)
+            {
+                forEachNode(*forNode.grain_, fn);
+            }
+            forEachNode(*forNode.start_, fn);
+            forEachNode(*forNode.end_, fn);
+            forEachNode(*forNode.step_, fn);
+            each(forNode.body_);
+            break;
+        }
+        case NodeType::WHILE_ITERATION:
+        {
+            const auto &whileNode = static_cast<const WhileIterationNode &>(node);
+            forEachNode(*whileNode.condition_, fn);
+            each(whileNode.body_);
+            break;
+        }
+        case NodeType::IF:
+        {
+            const auto &ifNode = static_cast<const IfNode &>(node);
+            forEachNode(*ifNode.condition_, fn);
+            forEachNode(*ifNode.thenBranch_, fn);
+            forEachNode(*ifNode.elseBranch_, fn);
+            break;
+        }
+        case NodeType::SCRIPT:
+            each(static_cast<const ScriptNode &>(node).statements_);
+            break;
+        default:
+            break;
+        }
+    }
+
+    void collectWrittenVariables(const ASTNode &node, std::unordered_set<std::string> &written)
+    {
+        forEachNode(node, [&written](const ASTNode &child)
+                    {
+            switch (child.getType())
+            {
+            case NodeType::VARIABLE_ASSIGNMENT:
+                written.insert(static_cast<const VariableAssignmentNode &>(child).variableName_);
+                break;
+            case NodeType::VARIABLE_DECLARATION:
+                written.insert(static_cast<const VariableDeclarationNode &>(child).variableName_);
+                break;
+            case NodeType::FOR_ITERATION:
+                written.insert(static_cast<const ForIterationNode &>(child).index_);
+                break;
+            case NodeType::FUNCTION_CALL:
+            {
+                const auto &call = static_cast<const FunctionCallNode &>(child);
+                if (call.functionName_ == "vector-push" && !call.arguments_.empty() &&
+                    call.arguments_[0]->getType() == NodeType::SYMBOL)
+                {
+                    written.insert(static_cast<const SymbolNode &>(*call.arguments_[0]).name_);
+                }
+                break;
+            }
+            default:
+                break;
+            } });
+    }
+
+} // namespace Shattang::MyLisp
@@ -0,0 +1,127 @@
+#include <Shattang/MyLisp/BoundsCheckElimination.h>
+#include <Shattang/MyLisp/ASTWalk.h>
+#include <Shattang/MyLisp/Builtins.h>
+
+#include <algorithm>
+#include <optional>
+
+namespace Shattang::MyLisp
+{
+    namespace
+    {
+        // Larger offsets are left checked, which keeps the entry check free of overflow
+        constexpr long MaxOffset = 1L << 20;
+
+        bool isSymbol(const ASTNode &node, const std::string &name)
+        {
+            return node.getType() == NodeType::SYMBOL && static_cast<const SymbolNode &>(node).name_ == name;
+        }
+
+        std::optional<long> smallInteger(const ASTNode &node)
+        {
+            if (node.getType() != NodeType::INTEGER)
+            {
+                return std::nullopt;
+            }
+            long value = static_cast<const IntegerNode &>(node).value_;
+            return value >= -MaxOffset && value <= MaxOffset ? std::optional<long>(value) : std::nullopt;
+        }
+
+        // c in i, (add i c), (add c i) or (subtract i c)
+        std::optional<long> indexOffset(const ASTNode &node, const std::string &index)
+        {
+            if (isSymbol(node, index))
+            {
+                return 0;
+            }
+            if (node.getType() != NodeType::FUNCTION_CALL)
+            {
+                return std::nullopt;
+            }
+            const auto &call = static_cast<const FunctionCallNode &>(node);
+            if (call.arguments_.size() != 2)
+            {
+                return std::nullopt;
+            }
+            const ASTNode &lhs = *call.arguments_[0];
+            const ASTNode &rhs = *call.arguments_[1];
+            if (call.functionName_ == "add")
+            {
+                return isSymbol(lhs, index) ? smallInteger(rhs) : isSymbol(rhs, index) ? smallInteger(lhs) : std::nullopt;
+            }
+            if (call.functionName_ == "subtract" && isSymbol(lhs, index))
+            {
+                std::optional<long> offset = smallInteger(rhs);
+                return offset ? std::optional<long>(-*offset) : std::nullopt;
+            }
+            return std::nullopt;
+        }
+    }
+
+    std::unique_ptr<BoundsCheckPlan> planBoundsChecks(const ForIterationNode &loop, const FunctionTypeInfo *function)
+    {
+        std::unordered_set<std::string> written;
+        bool callsFunctions = false;
+        for (const auto &statement : loop.body_)
+        {
+            collectWrittenVariables(*statement, written);
+            forEachNode(*statement, [&callsFunctions](const ASTNode &node)
+                        {
+                if (node.getType() == NodeType::FUNCTION_CALL &&
+                    findBuiltin(static_cast<const FunctionCallNode &>(node).functionName_) == nullptr)
+                {
+                    callsFunctions = true;
+                } });
+        }
+        if (written.count(loop.index_) != 0)
+        {
+            return nullptr;
+        }
+
+        auto plan = std::make_unique<BoundsCheckPlan>();
+        for (const auto &statement : loop.body_)
+        {
+            forEachNode(*statement, [&](const ASTNode &node)
+                        {
+                if (node.getType() != NodeType::FUNCTION_CALL)
+                {
+                    return;
+                }
+                const auto &call = static_cast<const FunctionCallNode &>(node);
+                if (call.functionName_ != "vector-ref" || call.arguments_.size() != 2 ||
+                    call.arguments_[0]->getType() != NodeType::SYMBOL)
+                {
+                    return;
+                }
+                const std::string &vector = static_cast<const SymbolNode &>(*call.arguments_[0]).name_;
+                // A called function could replace or grow a global vector, but not a local one.
+                // Parameters are excluded too, since generated C++ may pass them by reference.
+                bool isLocal = function != nullptr && function->locals_.count(vector) != 0 &&
+                               std::none_of(function->declaration_->parameters_.begin(),
+                                            function->declaration_->parameters_.end(),
+                                            [&vector](const Parameter &param)
+                                            { return param.name_ == vector; });
+                std::optional<long> offset = indexOffset(*call.arguments_[1], loop.index_);
+                if (written.count(vector) != 0 || (callsFunctions && !isLocal) || !offset)
+                {
+                    return;
+                }
+
+                auto it = std::find_if(plan->vectors_.begin(), plan->vectors_.end(),
+                                       [&vector](const IndexedVector &indexed)
+                                       { return indexed.vector_ == vector; });
+                if (it == plan->vectors_.end())
+                {
+                    plan->vectors_.push_back({vector, *offset, *offset});
+                }
+                else
+                {
+                    it->minOffset_ = std::min(it->minOffset_, *offset);
+                    it->maxOffset_ = std::max(it->maxOffset_, *offset);
+                }
+                plan->accesses_.insert(&node); });
+        }
+        return plan->accesses_.empty() ? nullptr : std::move(plan);
+    }
+
+} // namespace Shattang::MyLisp
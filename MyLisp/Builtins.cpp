@@ -0,0 +1,1097 @@
+#include <Shattang/MyLisp/Builtins.h>
+#include <Shattang/MyLisp/DoubleMatrix.h>
+#include <Shattang/MyLisp/Interpreter.h>
+#include <Shattang/MyLisp/Sequence.h>
+#include <Shattang/MyLisp/Sketches.h>
+#include <Shattang/MyLisp/Sorting.h>
+#include <Shattang/MyLisp/VectorExpression.h>
+
+#include <cmath>
+#include <optional>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace Shattang::MyLisp
+{
+    namespace
+    {
+        // Type rules report without the "Type error" prefix; TypeChecker adds context
+        [[noreturn]] void throwTypeError(const std::string &message)
+        {
+            throw std::runtime_error(message);
+        }
+
+        void expectArity(const std::string &name, const std::vector<ValueType> &args, std::size_t count)
+        {
+            if (args.size() != count)
+            {
+                throwTypeError("'" + name + "' expects " + std::to_string(count) + " argument(s), got " + std::to_string(args.size()));
+            }
+        }
+
+        void expectArgument(const std::string &name, const std::vector<ValueType> &args, std::size_t index, ValueType expected)
+        {
+            if (!isAssignable(args[index], expected))
+            {
+                throwTypeError("argument " + std::to_string(index + 1) + " of '" + name + "' must be " +
+                               ValueTypeToString(expected) + ", got " + ValueTypeToString(args[index]));
+            }
+        }
+
+        // Elements can be read from a DoubleVector or a Sequence alike
+        void expectElements(const std::string &name, const std::vector<ValueType> &args, std::size_t index)
+        {
+            if (args[index] != ValueType::DOUBLE_VECTOR && args[index] != ValueType::SEQUENCE)
+            {
+                throwTypeError("argument " + std::to_string(index + 1) + " of '" + name +
+                               "' must be DoubleVector or Sequence, got " + ValueTypeToString(args[index]));
+            }
+        }
+
+        void expectNumeric(const std::string &name, const std::vector<ValueType> &args)
+        {
+            for (std::size_t i = 0; i < args.size(); ++i)
+            {
+                if (!isNumericType(args[i]))
+                {
+                    throwTypeError("argument " + std::to_string(i + 1) + " of '" + name + "' must be Int or Float, got " +
+                                   ValueTypeToString(args[i]));
+                }
+            }
+        }
+
+        ValueType arithmeticRule(const std::string &name, const std::vector<ValueType> &args)
+        {
+            expectArity(name, args, 2);
+            expectNumeric(name, args);
+            return (args[0] == ValueType::FLOAT || args[1] == ValueType::FLOAT) ? ValueType::FLOAT : ValueType::INT;
+        }
+
+        ValueType moduloRule(const std::string &name, const std::vector<ValueType> &args)
+        {
+            expectArity(name, args, 2);
+            expectArgument(name, args, 0, ValueType::INT);
+            expectArgument(name, args, 1, ValueType::INT);
+            return ValueType::INT;
+        }
+
+        ValueType comparisonRule(const std::string &name, const std::vector<ValueType> &args)
+        {
+            expectArity(name, args, 2);
+            expectNumeric(name, args);
+            return ValueType::BOOLEAN;
+        }
+
+        ValueType equalityRule(const std::string &name, const std::vector<ValueType> &args)
+        {
+            expectArity(name, args, 2);
+            if (!(isNumericType(args[0]) && isNumericType(args[1])) && args[0] != args[1])
+            {
+                throwTypeError("cannot compare " + ValueTypeToString(args[0]) + " with " + ValueTypeToString(args[1]) +
+                               " in '" + name + "'");
+            }
+            return ValueType::BOOLEAN;
+        }
+
+        ValueType logicalRule(const std::string &name, const std::vector<ValueType> &args)
+        {
+            expectArity(name, args, 2);
+            expectArgument(name, args, 0, ValueType::BOOLEAN);
+            expectArgument(name, args, 1, ValueType::BOOLEAN);
+            return ValueType::BOOLEAN;
+        }
+
+        ValueType notRule(const std::string &name, const std::vector<ValueType> &args)
+        {
+            expectArity(name, args, 1);
+            expectArgument(name, args, 0, ValueType::BOOLEAN);
+            return ValueType::BOOLEAN;
+        }
+
+        ValueType sqrtRule(const std::string &name, const std::vector<ValueType> &args)
+        {
+            expectArity(name, args, 1);
+            expectNumeric(name, args);
+            return ValueType::FLOAT;
+        }
+
+        ValueType toIntRule(const std::string &name, const std::vector<ValueType> &args)
+        {
+            expectArity(name, args, 1);
+            expectNumeric(name, args);
+            return ValueType::INT;
+        }
+
+        ValueType printRule(const std::string &name, const std::vector<ValueType> &args)
+        {
+            for (std::size_t i = 0; i < args.size(); ++i)
+            {
+                if (args[i] == ValueType::VOID)
+                {
+                    throwTypeError("argument " + std::to_string(i + 1) + " of '" + name + "' has no value");
+                }
+            }
+            return ValueType::VOID;
+        }
+
+        ValueType stringAppendRule(const std::string &name, const std::vector<ValueType> &args)
+        {
+            if (args.empty())
+            {
+                throwTypeError("'" + name + "' expects at least 1 argument(s), got 0");
+            }
+            for (std::size_t i = 0; i < args.size(); ++i)
+            {
+                expectArgument(name, args, i, ValueType::STRING);
+            }
+            return ValueType::STRING;
+        }
+
+        ValueType stringLengthRule(const std::string &name, const std::vector<ValueType> &args)
+        {
+            expectArity(name, args, 1);
+            expectArgument(name, args, 0, ValueType::STRING);
+            return ValueType::INT;
+        }
+
+        ValueType toStringRule(const std::string &name, const std::vector<ValueType> &args)
+        {
+            expectArity(name, args, 1);
+            printRule(name, args);
+            return ValueType::STRING;
+        }
+
+        ValueType usingRule(const std::string &name, const std::vector<ValueType> &args)
+        {
+            expectArity(name, args, 1);
+            expectArgument(name, args, 0, ValueType::STRING);
+            return ValueType::VOID;
+        }
+
+        ValueType lengthRule(const std::string &name, const std::vector<ValueType> &args)
+        {
+            expectArity(name, args, 1);
+            expectElements(name, args, 0);
+            return ValueType::INT;
+        }
+
+        ValueType vectorRefRule(const std::string &name, const std::vector<ValueType> &args)
+        {
+            expectArity(name, args, 2);
+            expectArgument(name, args, 0, ValueType::DOUBLE_VECTOR);
+            expectArgument(name, args, 1, ValueType::INT);
+            return ValueType::FLOAT;
+        }
+
+        ValueType vectorPushRule(const std::string &name, const std::vector<ValueType> &args)
+        {
+            expectArity(name, args, 2);
+            expectArgument(name, args, 0, ValueType::DOUBLE_VECTOR);
+            expectArgument(name, args, 1, ValueType::FLOAT);
+            return ValueType::VOID;
+        }
+
+        ValueType makeDoubleVectorRule(const std::string &name, const std::vector<ValueType> &args)
+        {
+            expectArity(name, args, 0);
+            return ValueType::DOUBLE_VECTOR;
+        }
+
+        ValueType importDoubleVectorRule(const std::string &name, const std::vector<ValueType> &args)
+        {
+            expectArity(name, args, 1);
+            expectArgument(name, args, 0, ValueType::STRING);
+            return ValueType::DOUBLE_VECTOR;
+        }
+
+        ValueType vectorBinaryRule(const std::string &name, const std::vector<ValueType> &args)
+        {
+            expectArity(name, args, 2);
+            expectArgument(name, args, 0, ValueType::DOUBLE_VECTOR);
+            expectArgument(name, args, 1, ValueType::DOUBLE_VECTOR);
+            return ValueType::DOUBLE_VECTOR;
+        }
+
+        ValueType vectorScaleRule(const std::string &name, const std::vector<ValueType> &args)
+        {
+            expectArity(name, args, 2);
+            expectArgument(name, args, 0, ValueType::DOUBLE_VECTOR);
+            expectArgument(name, args, 1, ValueType::FLOAT);
+            return ValueType::DOUBLE_VECTOR;
+        }
+
+        ValueType vectorDotRule(const std::string &name, const std::vector<ValueType> &args)
+        {
+            expectArity(name, args, 2);
+            expectArgument(name, args, 0, ValueType::DOUBLE_VECTOR);
+            expectArgument(name, args, 1, ValueType::DOUBLE_VECTOR);
+            return ValueType::FLOAT;
+        }
+
+        ValueType vectorReductionRule(const std::string &name, const std::vector<ValueType> &args)
+        {
+            expectArity(name, args, 1);
+            expectElements(name, args, 0);
+            return ValueType::FLOAT;
+        }
+
+        // (make-double-matrix rows columns elements), with the elements in row-major order
+        ValueType makeDoubleMatrixRule(const std::string &name, const std::vector<ValueType> &args)
+        {
+            expectArity(name, args, 3);
+            expectArgument(name, args, 0, ValueType::INT);
+            expectArgument(name, args, 1, ValueType::INT);
+            expectElements(name, args, 2);
+            return ValueType::DOUBLE_MATRIX;
+        }
+
+        ValueType matrixRefRule(const std::string &name, const std::vector<ValueType> &args)
+        {
+            expectArity(name, args, 3);
+            expectArgument(name, args, 0, ValueType::DOUBLE_MATRIX);
+            expectArgument(name, args, 1, ValueType::INT);
+            expectArgument(name, args, 2, ValueType::INT);
+            return ValueType::FLOAT;
+        }
+
+        // matrix-rows, matrix-columns, matrix-elements and matrix-transpose
+        ValueType matrixQueryRule(const std::string &name, const std::vector<ValueType> &args)
+        {
+            expectArity(name, args, 1);
+            expectArgument(name, args, 0, ValueType::DOUBLE_MATRIX);
+            if (name == "matrix-elements")
+                return ValueType::DOUBLE_VECTOR;
+            if (name == "matrix-transpose")
+                return ValueType::DOUBLE_MATRIX;
+            return ValueType::INT;
+        }
+
+        ValueType matrixVectorMultiplyRule(const std::string &name, const std::vector<ValueType> &args)
+        {
+            expectArity(name, args, 2);
+            expectArgument(name, args, 0, ValueType::DOUBLE_MATRIX);
+            expectArgument(name, args, 1, ValueType::DOUBLE_VECTOR);
+            return ValueType::DOUBLE_VECTOR;
+        }
+
+        ValueType matrixMultiplyRule(const std::string &name, const std::vector<ValueType> &args)
+        {
+            expectArity(name, args, 2);
+            expectArgument(name, args, 0, ValueType::DOUBLE_MATRIX);
+            expectArgument(name, args, 1, ValueType::DOUBLE_MATRIX);
+            return ValueType::DOUBLE_MATRIX;
+        }
+
+        // (range start end) or (range start end step)
+        ValueType rangeRule(const std::string &name, const std::vector<ValueType> &args)
+        {
+            if (args.size() != 2 && args.size() != 3)
+            {
+                throwTypeError("'" + name + "' expects 2 or 3 argument(s), got " + std::to_string(args.size()));
+            }
+            for (std::size_t i = 0; i < args.size(); ++i)
+            {
+                expectArgument(name, args, i, ValueType::INT);
+            }
+            return ValueType::SEQUENCE;
+        }
+
+        ValueType takeRule(const std::string &name, const std::vector<ValueType> &args)
+        {
+            expectArity(name, args, 2);
+            expectArgument(name, args, 0, ValueType::INT);
+            expectElements(name, args, 1);
+            return ValueType::SEQUENCE;
+        }
+
+        ValueType collectRule(const std::string &name, const std::vector<ValueType> &args)
+        {
+            expectArity(name, args, 1);
+            expectElements(name, args, 0);
+            return ValueType::DOUBLE_VECTOR;
+        }
+
+        bool isSketchType(ValueType type)
+        {
+            return type == ValueType::QUANTILE_SKETCH || type == ValueType::DISTINCT_SKETCH;
+        }
+
+        void expectSketch(const std::string &name, const std::vector<ValueType> &args, std::size_t index)
+        {
+            if (!isSketchType(args[index]))
+            {
+                throwTypeError("argument " + std::to_string(index + 1) + " of '" + name +
+                               "' must be QuantileSketch or DistinctSketch, got " + ValueTypeToString(args[index]));
+            }
+        }
+
+        // (quantile-sketch elements) and (distinct-sketch elements)
+        ValueType sketchRule(const std::string &name, const std::vector<ValueType> &args)
+        {
+            expectArity(name, args, 1);
+            expectElements(name, args, 0);
+            return name == "quantile-sketch" ? ValueType::QUANTILE_SKETCH : ValueType::DISTINCT_SKETCH;
+        }
+
+        ValueType sketchUpdateRule(const std::string &name, const std::vector<ValueType> &args)
+        {
+            expectArity(name, args, 2);
+            expectSketch(name, args, 0);
+            expectElements(name, args, 1);
+            return args[0];
+        }
+
+        ValueType sketchMergeRule(const std::string &name, const std::vector<ValueType> &args)
+        {
+            expectArity(name, args, 2);
+            expectSketch(name, args, 0);
+            expectArgument(name, args, 1, args[0]);
+            return args[0];
+        }
+
+        // sketch-count and sketch-serialize
+        ValueType sketchQueryRule(const std::string &name, const std::vector<ValueType> &args)
+        {
+            expectArity(name, args, 1);
+            expectSketch(name, args, 0);
+            return name == "sketch-count" ? ValueType::INT : ValueType::STRING;
+        }
+
+        ValueType sketchQuantileRule(const std::string &name, const std::vector<ValueType> &args)
+        {
+            expectArity(name, args, 2);
+            expectArgument(name, args, 0, ValueType::QUANTILE_SKETCH);
+            expectArgument(name, args, 1, ValueType::FLOAT);
+            return ValueType::FLOAT;
+        }
+
+        ValueType sketchDistinctRule(const std::string &name, const std::vector<ValueType> &args)
+        {
+            expectArity(name, args, 1);
+            expectArgument(name, args, 0, ValueType::DISTINCT_SKETCH);
+            return ValueType::INT;
+        }
+
+        // parse-quantile-sketch and parse-distinct-sketch
+        ValueType parseSketchRule(const std::string &name, const std::vector<ValueType> &args)
+        {
+            expectArity(name, args, 1);
+            expectArgument(name, args, 0, ValueType::STRING);
+            return name == "parse-quantile-sketch" ? ValueType::QUANTILE_SKETCH : ValueType::DISTINCT_SKETCH;
+        }
+
+        // sort and argsort
+        ValueType sortRule(const std::string &name, const std::vector<ValueType> &args)
+        {
+            expectArity(name, args, 1);
+            expectElements(name, args, 0);
+            return ValueType::DOUBLE_VECTOR;
+        }
+
+        ValueType topKRule(const std::string &name, const std::vector<ValueType> &args)
+        {
+            expectArity(name, args, 2);
+            expectArgument(name, args, 0, ValueType::INT);
+            expectElements(name, args, 1);
+            return ValueType::DOUBLE_VECTOR;
+        }
+
+        // (histogram elements low high bins)
+        ValueType histogramRule(const std::string &name, const std::vector<ValueType> &args)
+        {
+            expectArity(name, args, 4);
+            expectElements(name, args, 0);
+            expectArgument(name, args, 1, ValueType::FLOAT);
+            expectArgument(name, args, 2, ValueType::FLOAT);
+            expectArgument(name, args, 3, ValueType::INT);
+            return ValueType::DOUBLE_VECTOR;
+        }
+
+        ValueType groupByKeyRule(const std::string &name, const std::vector<ValueType> &args)
+        {
+            expectArity(name, args, 2);
+            expectArgument(name, args, 0, ValueType::DOUBLE_VECTOR);
+            expectArgument(name, args, 1, ValueType::DOUBLE_VECTOR);
+            return ValueType::GROUPS;
+        }
+
+        // group-keys, group-counts, group-sums and group-means
+        ValueType groupQueryRule(const std::string &name, const std::vector<ValueType> &args)
+        {
+            expectArity(name, args, 1);
+            expectArgument(name, args, 0, ValueType::GROUPS);
+            return ValueType::DOUBLE_VECTOR;
+        }
+
+        [[noreturn]] void throwRuntimeError(const std::string &message)
+        {
+            throw std::runtime_error("Runtime error: " + message);
+        }
+
+        bool bothInt(std::span<Value> args)
+        {
+            return args[0].type() == ValueType::INT && args[1].type() == ValueType::INT;
+        }
+
+        Value addBuiltin(Interpreter &, std::span<Value> args)
+        {
+            if (bothInt(args))
+                return Value(args[0].asInt() + args[1].asInt());
+            return Value(args[0].asFloat() + args[1].asFloat());
+        }
+
+        Value subtractBuiltin(Interpreter &, std::span<Value> args)
+        {
+            if (bothInt(args))
+                return Value(args[0].asInt() - args[1].asInt());
+            return Value(args[0].asFloat() - args[1].asFloat());
+        }
+
+        Value multiplyBuiltin(Interpreter &, std::span<Value> args)
+        {
+            if (bothInt(args))
+                return Value(args[0].asInt() * args[1].asInt());
+            return Value(args[0].asFloat() * args[1].asFloat());
+        }
+
+        Value divideBuiltin(Interpreter &, std::span<Value> args)
+        {
+            if (bothInt(args))
+            {
+                if (args[1].asInt() == 0)
+                    throwRuntimeError("integer division by zero");
+                // The smallest Int divided by -1 traps in hardware; negate with wrapping like `subtract`
+                if (args[1].asInt() == -1)
+                    return Value(static_cast<long>(0UL - static_cast<unsigned long>(args[0].asInt())));
+                return Value(args[0].asInt() / args[1].asInt());
+            }
+            return Value(args[0].asFloat() / args[1].asFloat());
+        }
+
+        Value moduloBuiltin(Interpreter &, std::span<Value> args)
+        {
+            if (args[1].asInt() == 0)
+                throwRuntimeError("integer modulo by zero");
+            if (args[1].asInt() == -1)
+                return Value(0L); // the smallest Int modulo -1 traps in hardware
+            return Value(args[0].asInt() % args[1].asInt());
+        }
+
+        Value sqrtBuiltin(Interpreter &, std::span<Value> args)
+        {
+            return Value(std::sqrt(args[0].asFloat()));
+        }
+
+        // Truncates toward zero, as a C++ conversion does, but rejects values no Int can hold
+        Value toIntBuiltin(Interpreter &, std::span<Value> args)
+        {
+            if (args[0].type() == ValueType::INT)
+            {
+                return args[0];
+            }
+            double value = args[0].asFloat();
+            if (!(value >= -0x1p63 && value < 0x1p63))
+            {
+                throwRuntimeError("'to-int' of " + args[0].toString() + " is out of range");
+            }
+            return Value(static_cast<long>(value));
+        }
+
+        Value lessThanBuiltin(Interpreter &, std::span<Value> args)
+        {
+            if (bothInt(args))
+                return Value(args[0].asInt() < args[1].asInt());
+            return Value(args[0].asFloat() < args[1].asFloat());
+        }
+
+        Value lessEqualBuiltin(Interpreter &, std::span<Value> args)
+        {
+            if (bothInt(args))
+                return Value(args[0].asInt() <= args[1].asInt());
+            return Value(args[0].asFloat() <= args[1].asFloat());
+        }
+
+        Value greaterThanBuiltin(Interpreter &, std::span<Value> args)
+        {
+            if (bothInt(args))
+                return Value(args[0].asInt() > args[1].asInt());
+            return Value(args[0].asFloat() > args[1].asFloat());
+        }
+
+        Value greaterEqualBuiltin(Interpreter &, std::span<Value> args)
+        {
+            if (bothInt(args))
+                return Value(args[0].asInt() >= args[1].asInt());
+            return Value(args[0].asFloat() >= args[1].asFloat());
+        }
+
+        Value equalBuiltin(Interpreter &, std::span<Value> args)
+        {
+            return Value(args[0] == args[1]);
+        }
+
+        Value notEqualBuiltin(Interpreter &, std::span<Value> args)
+        {
+            return Value(!(args[0] == args[1]));
+        }
+
+        // `and` and `or` short-circuit in both tiers; these only run when called with evaluated values
+        Value andBuiltin(Interpreter &, std::span<Value> args)
+        {
+            return Value(args[0].asBool() && args[1].asBool());
+        }
+
+        Value orBuiltin(Interpreter &, std::span<Value> args)
+        {
+            return Value(args[0].asBool() || args[1].asBool());
+        }
+
+        Value notBuiltin(Interpreter &, std::span<Value> args)
+        {
+            return Value(!args[0].asBool());
+        }
+
+        Value printBuiltin(Interpreter &interpreter, std::span<Value> args)
+        {
+            std::ostream &out = interpreter.out();
+            for (std::size_t i = 0; i < args.size(); ++i)
+            {
+                out << (i > 0 ? " " : "");
+                // A String is written piece by piece, so a rope is never flattened for printing
+                if (args[i].type() == ValueType::STRING)
+                {
+                    out << args[i].asString();
+                }
+                else
+                {
+                    out << args[i].toString();
+                }
+            }
+            out << "\n";
+            return Value();
+        }
+
+        Value stringAppendBuiltin(Interpreter &, std::span<Value> args)
+        {
+            String result = args[0].asString();
+            for (std::size_t i = 1; i < args.size(); ++i)
+            {
+                result = String::concat(result, args[i].asString());
+            }
+            return Value(std::move(result));
+        }
+
+        Value stringLengthBuiltin(Interpreter &, std::span<Value> args)
+        {
+            return Value(static_cast<long>(args[0].asString().size()));
+        }
+
+        Value toStringBuiltin(Interpreter &, std::span<Value> args)
+        {
+            return args[0].type() == ValueType::STRING ? args[0] : Value(args[0].toString());
+        }
+
+        Value usingBuiltin(Interpreter &, std::span<Value>)
+        {
+            // Builtins are always registered; nothing to load
+            return Value();
+        }
+
+        Value lengthBuiltin(Interpreter &, std::span<Value> args)
+        {
+            if (args[0].type() == ValueType::SEQUENCE)
+            {
+                return Value(static_cast<long>(args[0].asSequence()->count()));
+            }
+            return Value(static_cast<long>(args[0].vectorSize()));
+        }
+
+        Value vectorRefBuiltin(Interpreter &, std::span<Value> args)
+        {
+            return Value(args[0].vectorElement(args[1].asInt()));
+        }
+
+        Value vectorPushBuiltin(Interpreter &, std::span<Value> args)
+        {
+            args[0].asMutableVector().push(args[1].asFloat());
+            return Value();
+        }
+
+        Value makeDoubleVectorBuiltin(Interpreter &, std::span<Value>)
+        {
+            return Value(DoubleVector());
+        }
+
+        Value importDoubleVectorBuiltin(Interpreter &interpreter, std::span<Value> args)
+        {
+            return interpreter.importDoubleVector(args[0].asString().str());
+        }
+
+        Value matrixValue(DoubleMatrix matrix)
+        {
+            return Value(std::make_shared<const DoubleMatrix>(std::move(matrix)));
+        }
+
+        Value makeDoubleMatrixBuiltin(Interpreter &, std::span<Value> args)
+        {
+            DoubleVector elements = args[2].type() == ValueType::SEQUENCE ? args[2].asSequence()->collect() : args[2].asVector();
+            return matrixValue(makeDoubleMatrix(args[0].asInt(), args[1].asInt(), std::move(elements)));
+        }
+
+        Value matrixRefBuiltin(Interpreter &, std::span<Value> args)
+        {
+            return Value(args[0].asMatrix().at(args[1].asInt(), args[2].asInt()));
+        }
+
+        Value matrixRowsBuiltin(Interpreter &, std::span<Value> args)
+        {
+            return Value(static_cast<long>(args[0].asMatrix().rows()));
+        }
+
+        Value matrixColumnsBuiltin(Interpreter &, std::span<Value> args)
+        {
+            return Value(static_cast<long>(args[0].asMatrix().columns()));
+        }
+
+        Value matrixElementsBuiltin(Interpreter &, std::span<Value> args)
+        {
+            return Value(args[0].asMatrix().elements());
+        }
+
+        Value matrixTransposeBuiltin(Interpreter &, std::span<Value> args)
+        {
+            return matrixValue(matrixTranspose(args[0].asMatrix()));
+        }
+
+        Value matrixVectorMultiplyBuiltin(Interpreter &, std::span<Value> args)
+        {
+            return Value(matrixVectorMultiply(args[0].asMatrix(), args[1].asVector()));
+        }
+
+        Value matrixMultiplyBuiltin(Interpreter &, std::span<Value> args)
+        {
+            return matrixValue(matrixMultiply(args[0].asMatrix(), args[1].asMatrix()));
+        }
+
+        // Element-wise builtins return deferred vectors, so that chains of them and the
+        // reduction consuming them are evaluated together in one pass
+        Value elementWise(VectorExpression::Kind kind, const char *name, std::span<Value> args)
+        {
+            return Value(VectorExpression::binary(kind, args[0].asExpression(), args[1].asExpression(), name));
+        }
+
+        Value vectorAddBuiltin(Interpreter &, std::span<Value> args)
+        {
+            return elementWise(VectorExpression::Kind::ADD, "vector-add", args);
+        }
+
+        Value vectorSubtractBuiltin(Interpreter &, std::span<Value> args)
+        {
+            return elementWise(VectorExpression::Kind::SUBTRACT, "vector-subtract", args);
+        }
+
+        Value vectorMultiplyBuiltin(Interpreter &, std::span<Value> args)
+        {
+            return elementWise(VectorExpression::Kind::MULTIPLY, "vector-multiply", args);
+        }
+
+        Value vectorDivideBuiltin(Interpreter &, std::span<Value> args)
+        {
+            return elementWise(VectorExpression::Kind::DIVIDE, "vector-divide", args);
+        }
+
+        Value vectorScaleBuiltin(Interpreter &, std::span<Value> args)
+        {
+            auto vector = args[0].asExpression();
+            auto factor = VectorExpression::constant(args[1].asFloat(), vector->size());
+            return Value(VectorExpression::binary(VectorExpression::Kind::MULTIPLY, vector, factor, "vector-scale"));
+        }
+
+        Value vectorDotBuiltin(Interpreter &, std::span<Value> args)
+        {
+            return Value(VectorExpression::binary(VectorExpression::Kind::MULTIPLY, args[0].asExpression(),
+                                                  args[1].asExpression(), "vector-dot")
+                             ->sum());
+        }
+
+        Value vectorSumBuiltin(Interpreter &, std::span<Value> args)
+        {
+            if (args[0].type() == ValueType::SEQUENCE)
+            {
+                return Value(args[0].asSequence()->sum());
+            }
+            return Value(args[0].asExpression()->sum());
+        }
+
+        void expectNotEmpty(const char *name, const VectorExpression &vector)
+        {
+            if (vector.size() == 0)
+            {
+                throwRuntimeError(std::string("'") + name + "' of an empty vector");
+            }
+        }
+
+        // Sequences are reduced in one pass, so emptiness is only known at the end
+        double nonEmpty(const char *name, std::optional<double> result)
+        {
+            if (!result)
+            {
+                throwRuntimeError(std::string("'") + name + "' of an empty sequence");
+            }
+            return *result;
+        }
+
+        Value vectorMinBuiltin(Interpreter &, std::span<Value> args)
+        {
+            if (args[0].type() == ValueType::SEQUENCE)
+            {
+                return Value(nonEmpty("vector-min", args[0].asSequence()->min()));
+            }
+            auto vector = args[0].asExpression();
+            expectNotEmpty("vector-min", *vector);
+            return Value(vector->min());
+        }
+
+        Value vectorMaxBuiltin(Interpreter &, std::span<Value> args)
+        {
+            if (args[0].type() == ValueType::SEQUENCE)
+            {
+                return Value(nonEmpty("vector-max", args[0].asSequence()->max()));
+            }
+            auto vector = args[0].asExpression();
+            expectNotEmpty("vector-max", *vector);
+            return Value(vector->max());
+        }
+
+        // Statistics of the "math" module, reduced in one pass; see Moments
+        Moments momentsOf(const char *name, const Value &elements)
+        {
+            if (elements.type() == ValueType::SEQUENCE)
+            {
+                Moments moments = elements.asSequence()->moments();
+                if (moments.count_ == 0.0)
+                {
+                    throwRuntimeError(std::string("'") + name + "' of an empty sequence");
+                }
+                return moments;
+            }
+            auto vector = elements.asExpression();
+            expectNotEmpty(name, *vector);
+            return vector->moments();
+        }
+
+        CoMoments coMomentsOf(const char *name, std::span<Value> args)
+        {
+            auto lhs = args[0].asExpression();
+            auto rhs = args[1].asExpression();
+            if (lhs->size() != rhs->size())
+            {
+                throwRuntimeError(std::string("'") + name + "' needs vectors of equal length, got " +
+                                  std::to_string(lhs->size()) + " and " + std::to_string(rhs->size()));
+            }
+            expectNotEmpty(name, *lhs);
+            return VectorExpression::coMoments(*lhs, *rhs);
+        }
+
+        Value vectorMeanBuiltin(Interpreter &, std::span<Value> args)
+        {
+            return Value(momentsOf("vector-mean", args[0]).mean_);
+        }
+
+        Value vectorVarianceBuiltin(Interpreter &, std::span<Value> args)
+        {
+            return Value(momentsOf("vector-variance", args[0]).variance());
+        }
+
+        Value vectorStddevBuiltin(Interpreter &, std::span<Value> args)
+        {
+            return Value(std::sqrt(momentsOf("vector-stddev", args[0]).variance()));
+        }
+
+        Value vectorCovarianceBuiltin(Interpreter &, std::span<Value> args)
+        {
+            return Value(coMomentsOf("vector-covariance", args).covariance());
+        }
+
+        Value vectorCorrelationBuiltin(Interpreter &, std::span<Value> args)
+        {
+            return Value(coMomentsOf("vector-correlation", args).correlation());
+        }
+
+        // Sketches of the "math" module
+        template <typename Sketch>
+        Sketch sketchOf(const Value &elements)
+        {
+            if (elements.type() == ValueType::SEQUENCE)
+            {
+                return sketchElements<Sketch>(*elements.asSequence());
+            }
+            return sketchElements<Sketch>(*elements.asExpression());
+        }
+
+        template <typename Sketch>
+        Value sketchValue(Sketch sketch)
+        {
+            return Value(std::make_shared<const Sketch>(std::move(sketch)));
+        }
+
+        Value quantileSketchBuiltin(Interpreter &, std::span<Value> args)
+        {
+            return sketchValue(sketchOf<QuantileSketch>(args[0]));
+        }
+
+        Value distinctSketchBuiltin(Interpreter &, std::span<Value> args)
+        {
+            return sketchValue(sketchOf<DistinctSketch>(args[0]));
+        }
+
+        Value sketchUpdateBuiltin(Interpreter &, std::span<Value> args)
+        {
+            if (args[0].type() == ValueType::QUANTILE_SKETCH)
+            {
+                QuantileSketch result = args[0].asQuantileSketch();
+                result.merge(sketchOf<QuantileSketch>(args[1]));
+                return sketchValue(std::move(result));
+            }
+            DistinctSketch result = args[0].asDistinctSketch();
+            result.merge(sketchOf<DistinctSketch>(args[1]));
+            return sketchValue(std::move(result));
+        }
+
+        Value sketchMergeBuiltin(Interpreter &, std::span<Value> args)
+        {
+            if (args[0].type() == ValueType::QUANTILE_SKETCH)
+            {
+                QuantileSketch result = args[0].asQuantileSketch();
+                result.merge(args[1].asQuantileSketch());
+                return sketchValue(std::move(result));
+            }
+            DistinctSketch result = args[0].asDistinctSketch();
+            result.merge(args[1].asDistinctSketch());
+            return sketchValue(std::move(result));
+        }
+
+        Value sketchCountBuiltin(Interpreter &, std::span<Value> args)
+        {
+            std::uint64_t count = args[0].type() == ValueType::QUANTILE_SKETCH ? args[0].asQuantileSketch().count()
+                                                                                : args[0].asDistinctSketch().count();
+            return Value(static_cast<long>(count));
+        }
+
+        Value sketchSerializeBuiltin(Interpreter &, std::span<Value> args)
+        {
+            return Value(args[0].type() == ValueType::QUANTILE_SKETCH ? args[0].asQuantileSketch().serialize()
+                                                                       : args[0].asDistinctSketch().serialize());
+        }
+
+        Value sketchQuantileBuiltin(Interpreter &, std::span<Value> args)
+        {
+            const QuantileSketch &sketch = args[0].asQuantileSketch();
+            double fraction = args[1].asFloat();
+            if (!(fraction >= 0.0 && fraction <= 1.0))
+            {
+                throwRuntimeError("'sketch-quantile' fraction must be between 0 and 1, got " + Value(fraction).toString());
+            }
+            if (sketch.count() == 0)
+            {
+                throwRuntimeError("'sketch-quantile' of an empty sketch");
+            }
+            return Value(sketch.quantile(fraction));
+        }
+
+        Value sketchDistinctBuiltin(Interpreter &, std::span<Value> args)
+        {
+            return Value(static_cast<long>(std::llround(args[0].asDistinctSketch().estimate())));
+        }
+
+        Value parseQuantileSketchBuiltin(Interpreter &, std::span<Value> args)
+        {
+            return sketchValue(QuantileSketch::parse(args[0].asString().str()));
+        }
+
+        Value parseDistinctSketchBuiltin(Interpreter &, std::span<Value> args)
+        {
+            return sketchValue(DistinctSketch::parse(args[0].asString().str()));
+        }
+
+        // Sorting needs every element at once, so a sequence is collected first
+        std::shared_ptr<const VectorExpression> collectedElements(const Value &elements)
+        {
+            if (elements.type() == ValueType::SEQUENCE)
+            {
+                return VectorExpression::vector(std::make_shared<const DoubleVector>(elements.asSequence()->collect()));
+            }
+            return elements.asExpression();
+        }
+
+        Value sortBuiltin(Interpreter &, std::span<Value> args)
+        {
+            return Value(sortElements(*collectedElements(args[0])));
+        }
+
+        Value argsortBuiltin(Interpreter &, std::span<Value> args)
+        {
+            return Value(argsortElements(*collectedElements(args[0])));
+        }
+
+        Value topKBuiltin(Interpreter &, std::span<Value> args)
+        {
+            if (args[1].type() == ValueType::SEQUENCE)
+            {
+                return Value(topElements(*args[1].asSequence(), args[0].asInt()));
+            }
+            return Value(topElements(*args[1].asExpression(), args[0].asInt()));
+        }
+
+        Value histogramBuiltin(Interpreter &, std::span<Value> args)
+        {
+            double low = args[1].asFloat();
+            double high = args[2].asFloat();
+            if (args[0].type() == ValueType::SEQUENCE)
+            {
+                return Value(histogramElements(*args[0].asSequence(), low, high, args[3].asInt()));
+            }
+            return Value(histogramElements(*args[0].asExpression(), low, high, args[3].asInt()));
+        }
+
+        Value groupByKeyBuiltin(Interpreter &, std::span<Value> args)
+        {
+            return Value(std::make_shared<const Groups>(Groups::of(*args[0].asExpression(), *args[1].asExpression())));
+        }
+
+        Value groupKeysBuiltin(Interpreter &, std::span<Value> args)
+        {
+            return Value(args[0].asGroups().keys_);
+        }
+
+        Value groupCountsBuiltin(Interpreter &, std::span<Value> args)
+        {
+            return Value(args[0].asGroups().counts_);
+        }
+
+        Value groupSumsBuiltin(Interpreter &, std::span<Value> args)
+        {
+            return Value(args[0].asGroups().sums_);
+        }
+
+        Value groupMeansBuiltin(Interpreter &, std::span<Value> args)
+        {
+            return Value(args[0].asGroups().means());
+        }
+
+        Value rangeBuiltin(Interpreter &, std::span<Value> args)
+        {
+            long step = args.size() > 2 ? args[2].asInt() : 1;
+            return Value(Sequence::range(args[0].asInt(), args[1].asInt(), step));
+        }
+
+        Value takeBuiltin(Interpreter &, std::span<Value> args)
+        {
+            return Value(Sequence::take(args[0].asInt(), args[1].asSequence()));
+        }
+
+        Value collectBuiltin(Interpreter &, std::span<Value> args)
+        {
+            return Value(args[0].asSequence()->collect());
+        }
+    }
+
+    const Builtin *findBuiltin(const std::string &name)
+    {
+        static const std::unordered_map<std::string, Builtin> builtins = {
+            {"add", {arithmeticRule, addBuiltin, true}},
+            {"subtract", {arithmeticRule, subtractBuiltin, true}},
+            {"multiply", {arithmeticRule, multiplyBuiltin, true}},
+            {"divide", {arithmeticRule, divideBuiltin, true}},
+            {"modulo", {moduloRule, moduloBuiltin, true}},
+            {"sqrt", {sqrtRule, sqrtBuiltin, true}},
+            {"to-int", {toIntRule, toIntBuiltin, true}},
+            {"less-than", {comparisonRule, lessThanBuiltin, true}},
+            {"less-equal", {comparisonRule, lessEqualBuiltin, true}},
+            {"greater-than", {comparisonRule, greaterThanBuiltin, true}},
+            {"greater-equal", {comparisonRule, greaterEqualBuiltin, true}},
+            {"equal", {equalityRule, equalBuiltin, true}},
+            {"not-equal", {equalityRule, notEqualBuiltin, true}},
+            {"and", {logicalRule, andBuiltin, true}},
+            {"or", {logicalRule, orBuiltin, true}},
+            {"not", {notRule, notBuiltin, true}},
+            {"print", {printRule, printBuiltin, false}},
+            {"string-append", {stringAppendRule, stringAppendBuiltin, false}},
+            {"string-length", {stringLengthRule, stringLengthBuiltin, false}},
+            {"to-string", {toStringRule, toStringBuiltin, false}},
+            {"using", {usingRule, usingBuiltin, false}},
+            {"length", {lengthRule, lengthBuiltin, false}},
+            {"vector-ref", {vectorRefRule, vectorRefBuiltin, false}},
+            {"vector-push", {vectorPushRule, vectorPushBuiltin, false}},
+            {"make-double-vector", {makeDoubleVectorRule, makeDoubleVectorBuiltin, false}},
+            {"import-double-vector", {importDoubleVectorRule, importDoubleVectorBuiltin, false}},
+            {"vector-add", {vectorBinaryRule, vectorAddBuiltin, false}},
+            {"vector-subtract", {vectorBinaryRule, vectorSubtractBuiltin, false}},
+            {"vector-multiply", {vectorBinaryRule, vectorMultiplyBuiltin, false}},
+            {"vector-divide", {vectorBinaryRule, vectorDivideBuiltin, false}},
+            {"vector-scale", {vectorScaleRule, vectorScaleBuiltin, false}},
+            {"vector-dot", {vectorDotRule, vectorDotBuiltin, false}},
+            {"vector-sum", {vectorReductionRule, vectorSumBuiltin, false}},
+            {"vector-min", {vectorReductionRule, vectorMinBuiltin, false}},
+            {"vector-max", {vectorReductionRule, vectorMaxBuiltin, false}},
+            {"make-double-matrix", {makeDoubleMatrixRule, makeDoubleMatrixBuiltin, false}},
+            {"matrix-ref", {matrixRefRule, matrixRefBuiltin, false}},
+            {"matrix-rows", {matrixQueryRule, matrixRowsBuiltin, false}},
+            {"matrix-columns", {matrixQueryRule, matrixColumnsBuiltin, false}},
+            {"matrix-elements", {matrixQueryRule, matrixElementsBuiltin, false}},
+            {"matrix-transpose", {matrixQueryRule, matrixTransposeBuiltin, false}},
+            {"matrix-vector-multiply", {matrixVectorMultiplyRule, matrixVectorMultiplyBuiltin, false}},
+            {"matrix-multiply", {matrixMultiplyRule, matrixMultiplyBuiltin, false}},
+            {"range", {rangeRule, rangeBuiltin, false}},
+            {"take", {takeRule, takeBuiltin, false}},
+            {"collect", {collectRule, collectBuiltin, false}},
+            {"sort", {sortRule, sortBuiltin, false}},
+            {"argsort", {sortRule, argsortBuiltin, false}},
+            {"top-k", {topKRule, topKBuiltin, false}},
+            {"histogram", {histogramRule, histogramBuiltin, false}},
+            {"group-by-key", {groupByKeyRule, groupByKeyBuiltin, false}},
+            {"group-keys", {groupQueryRule, groupKeysBuiltin, false}},
+            {"group-counts", {groupQueryRule, groupCountsBuiltin, false}},
+            {"group-sums", {groupQueryRule, groupSumsBuiltin, false}},
+            {"group-means", {groupQueryRule, groupMeansBuiltin, false}},
+            {"vector-mean", {vectorReductionRule, vectorMeanBuiltin, false, "math"}},
+            {"vector-variance", {vectorReductionRule, vectorVarianceBuiltin, false, "math"}},
+            {"vector-stddev", {vectorReductionRule, vectorStddevBuiltin, false, "math"}},
+            {"vector-covariance", {vectorDotRule, vectorCovarianceBuiltin, false, "math"}},
+            {"vector-correlation", {vectorDotRule, vectorCorrelationBuiltin, false, "math"}},
+            {"quantile-sketch", {sketchRule, quantileSketchBuiltin, false, "math"}},
+            {"distinct-sketch", {sketchRule, distinctSketchBuiltin, false, "math"}},
+            {"sketch-update", {sketchUpdateRule, sketchUpdateBuiltin, false, "math"}},
+            {"sketch-merge", {sketchMergeRule, sketchMergeBuiltin, false, "math"}},
+            {"sketch-count", {sketchQueryRule, sketchCountBuiltin, false, "math"}},
+            {"sketch-serialize", {sketchQueryRule, sketchSerializeBuiltin, false, "math"}},
+            {"sketch-quantile", {sketchQuantileRule, sketchQuantileBuiltin, false, "math"}},
+            {"sketch-distinct", {sketchDistinctRule, sketchDistinctBuiltin, false, "math"}},
+            {"parse-quantile-sketch", {parseSketchRule, parseQuantileSketchBuiltin, false, "math"}},
+            {"parse-distinct-sketch", {parseSketchRule, parseDistinctSketchBuiltin, false, "math"}},
+        };
+        auto it = builtins.find(name);
+        return it == builtins.end() ? nullptr : &it->second;
+    }
+
+    bool isModule(const std::string &name)
+    {
+        return name == "math";
+    }
+
+    bool isParallelCall(const std::string &name)
+    {
+        return name == "pmap" || name == "preduce";
+    }
+
+    bool isSequenceCall(const std::string &name)
+    {
+        return name == "map" || name == "filter" || name == "zip";
+    }
+
+    bool takesFunctionName(const std::string &name)
+    {
+        return isParallelCall(name) || isSequenceCall(name);
+    }
+
+} // namespace Shattang::MyLisp
@@ -0,0 +1,915 @@
+#include <Shattang/MyLisp/ClosureCompiler.h>
+#include <Shattang/MyLisp/BoundsCheckElimination.h>
+#include <Shattang/MyLisp/Builtins.h>
+#include <Shattang/MyLisp/Interpreter.h>
+#include <Shattang/MyLisp/LoopParallelizer.h>
+#include <Shattang/MyLisp/LoopVectorizer.h>
+#include <Shattang/MyLisp/ThreadPool.h>
+#include <Shattang/MyLisp/VectorExpression.h>
+
+#include <algorithm>
+#include <array>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+
+namespace Shattang::MyLisp
+{
+    namespace
+    {
+        [[noreturn]] void throwRuntimeError(const std::string &message)
+        {
+            throw std::runtime_error("Runtime error: " + message);
+        }
+
+        // Operands are read left to right, as the walker reads them, so the same error is reported
+        // when both would fail; the order of arguments to op() is unspecified
+        template <typename Op>
+        Code intOperation(Code lhs, Code rhs, Op op)
+        {
+            return [lhs = std::move(lhs), rhs = std::move(rhs), op](Frame &frame)
+            {
+                long left = lhs(frame).asInt();
+                return Value(op(left, rhs(frame).asInt()));
+            };
+        }
+
+        template <typename Op>
+        Code floatOperation(Code lhs, Code rhs, Op op)
+        {
+            return [lhs = std::move(lhs), rhs = std::move(rhs), op](Frame &frame)
+            {
+                double left = lhs(frame).asFloat();
+                return Value(op(left, rhs(frame).asFloat()));
+            };
+        }
+
+        template <template <typename> class Op>
+        Code numericOperation(Code lhs, Code rhs, bool isInt)
+        {
+            if (isInt)
+            {
+                return intOperation(std::move(lhs), std::move(rhs), Op<long>());
+            }
+            return floatOperation(std::move(lhs), std::move(rhs), Op<double>());
+        }
+
+        // One vector read by a loop body whose accesses are checked on loop entry
+        struct EntryCheck
+        {
+            int vectorSlot_;
+            long minOffset_;
+            long maxOffset_;
+        };
+
+        Value runBody(const std::vector<Code> &body, Frame &frame)
+        {
+            Value result;
+            for (const auto &statement : body)
+            {
+                result = statement(frame);
+            }
+            return result;
+        }
+    }
+
+    Frame::Frame(Interpreter &interpreter, const SlotLayout &layout, Environment &env)
+        : interpreter_(interpreter), layout_(layout), env_(env),
+          locals_(layout.localCount_, std::pmr::polymorphic_allocator<Value>(&runtimePool())), bound_(layout.names_.size(), nullptr, &runtimePool())
+    {
+        for (std::size_t slot = 0; slot < layout.names_.size(); ++slot)
+        {
+            if (layout.localIndex_[slot] >= 0)
+            {
+                bound_[slot] = &locals_[layout.localIndex_[slot]];
+            }
+        }
+    }
+
+    Frame::Frame(const Frame &parent, const std::vector<int> &privateSlots)
+        : interpreter_(parent.interpreter_), layout_(parent.layout_), env_(parent.env_),
+          locals_(privateSlots.size(), std::pmr::polymorphic_allocator<Value>(&runtimePool())), bound_(parent.bound_, &runtimePool())
+    {
+        for (std::size_t i = 0; i < privateSlots.size(); ++i)
+        {
+            bound_[privateSlots[i]] = &locals_[i];
+        }
+    }
+
+    Value &Frame::bind(int slot, bool declare)
+    {
+        const std::string &name = layout_.names_[slot];
+        Value *value = declare ? env_.findLocal(name) : env_.find(name);
+        if (value == nullptr)
+        {
+            if (!declare)
+            {
+                throwRuntimeError("undefined variable '" + name + "'");
+            }
+            value = &env_.define(name, Value());
+        }
+        bound_[slot] = value;
+        return *value;
+    }
+
+    Value CompiledFunction::invoke(Interpreter &interpreter, std::vector<Value> &args) const
+    {
+        Frame frame(interpreter, layout_, interpreter.globals());
+        for (std::size_t i = 0; i < parameterSlots_.size(); ++i)
+        {
+            frame.declare(parameterSlots_[i]) = convertValue(std::move(args[i]), parameterTypes_[i]);
+        }
+        Value result = runBody(body_, frame);
+        if (returnType_ == ValueType::VOID)
+        {
+            return Value();
+        }
+        return convertValue(std::move(result), returnType_);
+    }
+
+    void CompiledLoop::runFor(Interpreter &interpreter, Environment &env, long index, long end, long step) const
+    {
+        Frame frame(interpreter, layout_, env);
+        forRange_(frame, index, end, step);
+    }
+
+    void CompiledLoop::runWhile(Interpreter &interpreter, Environment &env) const
+    {
+        Frame frame(interpreter, layout_, env);
+        whileLoop_(frame);
+    }
+
+    // Runs a loop matched by planVectorLoop over a range of indices as one VectorExpression
+    class VectorLoop
+    {
+    public:
+        struct Element
+        {
+            ElementExpression::Kind kind_;
+            int vectorSlot_ = -1;
+            Code invariant_;
+            std::unique_ptr<Element> lhs_;
+            std::unique_ptr<Element> rhs_;
+        };
+
+        VectorLoopKind kind_ = VectorLoopKind::SUM;
+        int targetSlot_ = -1;
+        std::vector<int> inputSlots_;
+        std::unique_ptr<Element> element_;
+
+        // Runs the iterations [first, last]. Returns false without running anything if an input
+        // vector is too short, so that the scalar loop can report the failing access.
+        bool run(Frame &frame, long first, long last) const
+        {
+            if (first > last)
+            {
+                return true;
+            }
+            for (int slot : inputSlots_)
+            {
+                if (first < 0 || static_cast<std::size_t>(last) >= frame.get(slot).vectorSize())
+                {
+                    return false;
+                }
+            }
+
+            auto values = bind(*element_, frame, static_cast<std::size_t>(first), static_cast<std::size_t>(last - first) + 1);
+            Value &target = frame.get(targetSlot_);
+            switch (kind_)
+            {
+            case VectorLoopKind::MAP:
+            {
+                // The pushes are deferred, so that a later reduction can fuse with this loop. A target
+                // that is already deferred is materialized first, to keep the expression shallow.
+                auto existing = target.asExpression();
+                if (existing->kind() != VectorExpression::Kind::VECTOR)
+                {
+                    DoubleVector &storage = target.asMutableVector();
+                    existing = VectorExpression::vector(std::make_shared<DoubleVector>(std::move(storage)));
+                }
+                target = Value(VectorExpression::concat(existing, values));
+                break;
+            }
+            case VectorLoopKind::SUM:
+                target = Value(target.asFloat() + values->sum());
+                break;
+            case VectorLoopKind::MIN:
+            {
+                double result = values->min();
+                if (result < target.asFloat())
+                    target = Value(result);
+                break;
+            }
+            case VectorLoopKind::MAX:
+            {
+                double result = values->max();
+                if (result > target.asFloat())
+                    target = Value(result);
+                break;
+            }
+            }
+            return true;
+        }
+
+    private:
+        // `element` over the indices [first, first + count)
+        static std::shared_ptr<const VectorExpression> bind(const Element &element, Frame &frame, std::size_t first,
+                                                            std::size_t count)
+        {
+            using Kind = ElementExpression::Kind;
+            switch (element.kind_)
+            {
+            case Kind::ELEMENT:
+                return VectorExpression::slice(frame.get(element.vectorSlot_).asExpression(), first, count);
+            case Kind::INVARIANT:
+                return VectorExpression::constant(element.invariant_(frame).asFloat(), count);
+            case Kind::ADD:
+                return VectorExpression::binary(VectorExpression::Kind::ADD, bind(*element.lhs_, frame, first, count),
+                                                bind(*element.rhs_, frame, first, count), "add");
+            case Kind::SUBTRACT:
+                return VectorExpression::binary(VectorExpression::Kind::SUBTRACT, bind(*element.lhs_, frame, first, count),
+                                                bind(*element.rhs_, frame, first, count), "subtract");
+            case Kind::MULTIPLY:
+                return VectorExpression::binary(VectorExpression::Kind::MULTIPLY, bind(*element.lhs_, frame, first, count),
+                                                bind(*element.rhs_, frame, first, count), "multiply");
+            default:
+                return VectorExpression::binary(VectorExpression::Kind::DIVIDE, bind(*element.lhs_, frame, first, count),
+                                                bind(*element.rhs_, frame, first, count), "divide");
+            }
+        }
+    };
+
+    // Runs a loop matched by planParallelLoop in partitions on the compute pool. Each partition
+    // gets its own index, accumulators and outputs; the partial results are then combined in
+    // partition order.
+    class ParallelLoop
+    {
+    public:
+        ParallelLoopPlan plan_;
+        int indexSlot_ = -1;
+        std::vector<int> inputSlots_;
+        std::vector<int> privateSlots_; // the index, then the accumulators and outputs in plan_'s order
+        long threshold_ = 0;
+
+        // Runs the iterations index, index + step, .. up to end, `grain` at a time if positive.
+        // Returns false without changing any variable if the loop is too short, reads a stream,
+        // or fails in some iteration; the caller then runs it in order, which reports the
+        // failure where the walker would.
+        bool run(Frame &frame, const std::vector<Code> &body, long index, long end, long step, long grain = 0) const
+        {
+            std::size_t iterations = iterationCount(index, end, step);
+            if (iterations == 0 || iterations < static_cast<std::size_t>(std::max(threshold_, 1L)))
+            {
+                return false;
+            }
+            for (int slot : inputSlots_)
+            {
+                if (frame.get(slot).asExpression()->readsStream())
+                {
+                    return false;
+                }
+            }
+
+            std::size_t size = partitionSize(iterations, grain);
+            std::vector<std::vector<Value>> results((iterations + size - 1) / size);
+            try
+            {
+                computePool().parallelFor(results.size(), [&](std::size_t partition)
+                                          {
+                    Frame local(frame, privateSlots_);
+                    std::vector<Value> &values = results[partition];
+                    values = partitionStart(plan_);
+                    for (std::size_t i = 0; i < values.size(); ++i)
+                    {
+                        local.get(privateSlots_[i + 1]) = std::move(values[i]);
+                    }
+                    Value &indexVariable = local.get(indexSlot_);
+                    std::size_t last = std::min(iterations, (partition + 1) * size);
+                    for (std::size_t k = partition * size; k < last; ++k)
+                    {
+                        indexVariable = Value(index + static_cast<long>(k) * step);
+                        runBody(body, local);
+                    }
+                    for (std::size_t i = 0; i < values.size(); ++i)
+                    {
+                        values[i] = std::move(local.get(privateSlots_[i + 1]));
+                    } });
+            }
+            catch (const std::exception &)
+            {
+                return false;
+            }
+
+            std::vector<Value *> targets;
+            for (std::size_t i = 1; i < privateSlots_.size(); ++i)
+            {
+                targets.push_back(&frame.get(privateSlots_[i]));
+            }
+            combinePartitions(plan_, results, targets);
+            frame.get(indexSlot_) = Value(index + static_cast<long>(iterations - 1) * step);
+            return true;
+        }
+    };
+
+    ClosureCompiler::ClosureCompiler(Interpreter &interpreter, const TypeChecker &checker)
+        : interpreter_(interpreter), checker_(checker) {}
+
+    std::unique_ptr<CompiledFunction> ClosureCompiler::compileFunction(const FunctionDeclarationNode &node)
+    {
+        auto compiled = std::make_unique<CompiledFunction>();
+        function_ = checker_.function(node.functionName_);
+        if (function_ == nullptr)
+        {
+            throwError("function '" + node.functionName_ + "' was not type checked");
+        }
+        layout_ = &compiled->layout_;
+        localsInFrame_ = true;
+
+        for (const auto &param : node.parameters_)
+        {
+            compiled->parameterSlots_.push_back(slotFor(param.name_));
+        }
+        compiled->parameterTypes_ = function_->parameterTypes_;
+        compiled->returnType_ = function_->returnType_;
+        compiled->body_ = compileAll(node.body_);
+        return compiled;
+    }
+
+    std::unique_ptr<CompiledLoop> ClosureCompiler::compileLoop(const ASTNode &loop, const FunctionTypeInfo *function)
+    {
+        auto compiled = std::make_unique<CompiledLoop>();
+        function_ = function;
+        layout_ = &compiled->layout_;
+        localsInFrame_ = false;
+
+        if (loop.getType() == NodeType::FOR_ITERATION)
+        {
+            compiled->forRange_ = compileForRange(static_cast<const ForIterationNode &>(loop));
+        }
+        else if (loop.getType() == NodeType::WHILE_ITERATION)
+        {
+            compiled->whileLoop_ = compileWhileIteration(static_cast<const WhileIterationNode &>(loop));
+        }
+        else
+        {
+            throwError("not a loop: " + loop.toString());
+        }
+        return compiled;
+    }
+
+    Code ClosureCompiler::compile(const ASTNode &node)
+    {
+        switch (node.getType())
+        {
+        case NodeType::SYMBOL:
+        {
+            int slot = slotFor(static_cast<const SymbolNode &>(node).name_);
+            if (function_ != nullptr && function_->lastUses_.count(&node) != 0)
+            {
+                // Never read again, so the value moves out and a vector keeps a single owner
+                return [slot](Frame &frame)
+                {
+                    return std::exchange(frame.get(slot), Value());
+                };
+            }
+            return [slot](Frame &frame)
+            {
+                return frame.get(slot);
+            };
+        }
+
+        case NodeType::INTEGER:
+        case NodeType::FLOAT:
+        case NodeType::BOOLEAN:
+        case NodeType::STRING:
+        {
+            Value constant;
+            if (node.getType() == NodeType::INTEGER)
+                constant = Value(static_cast<const IntegerNode &>(node).value_);
+            else if (node.getType() == NodeType::FLOAT)
+                constant = Value(static_cast<const FloatNode &>(node).value_);
+            else if (node.getType() == NodeType::BOOLEAN)
+                constant = Value(static_cast<const BooleanNode &>(node).value_);
+            else
+                constant = Value(String::intern(static_cast<const StringNode &>(node).text_));
+            return [constant](Frame &)
+            {
+                return constant;
+            };
+        }
+
+        case NodeType::VARIABLE_DECLARATION:
+            return compileVariableDeclaration(static_cast<const VariableDeclarationNode &>(node));
+
+        case NodeType::FUNCTION_CALL:
+            return compileFunctionCall(static_cast<const FunctionCallNode &>(node));
+
+        case NodeType::VARIABLE_ASSIGNMENT:
+            return compileVariableAssignment(static_cast<const VariableAssignmentNode &>(node));
+
+        case NodeType::FOR_ITERATION:
+            return compileForIteration(static_cast<const ForIterationNode &>(node));
+
+        case NodeType::WHILE_ITERATION:
+            return compileWhileIteration(static_cast<const WhileIterationNode &>(node));
+
+        case NodeType::IF:
+            return compileIf(static_cast<const IfNode &>(node));
+
+        default:
+            throwError("cannot compile " + node.toString());
+        }
+    }
+
+    std::vector<Code> ClosureCompiler::compileAll(const std::vector<std::unique_ptr<ASTNode>> &nodes)
+    {
+        std::vector<Code> result;
+        result.reserve(nodes.size());
+        for (const auto &node : nodes)
+        {
+            result.push_back(compile(*node));
+        }
+        return result;
+    }
+
+    Code ClosureCompiler::compileVariableDeclaration(const VariableDeclarationNode &node)
+    {
+        ValueType type = ValueTypeFromName(node.typeNode_->name_);
+        Code value = compile(*node.valueNode_);
+        int slot = slotFor(node.variableName_);
+        return [type, value = std::move(value), slot](Frame &frame)
+        {
+            Value result = convertValue(value(frame), type);
+            frame.declare(slot) = std::move(result);
+            return Value();
+        };
+    }
+
+    Code ClosureCompiler::compileVariableAssignment(const VariableAssignmentNode &node)
+    {
+        ValueType type = variableType(node.variableName_);
+        Code value = compile(*node.valueNode_);
+        int slot = slotFor(node.variableName_);
+        return [type, value = std::move(value), slot](Frame &frame)
+        {
+            Value result = convertValue(value(frame), type);
+            frame.get(slot) = std::move(result);
+            return Value();
+        };
+    }
+
+    Code ClosureCompiler::compileFunctionCall(const FunctionCallNode &node)
+    {
+        if (findBuiltin(node.functionName_) != nullptr)
+        {
+            return compileBuiltinCall(node);
+        }
+        if (takesFunctionName(node.functionName_))
+        {
+            return compileCallWithFunction(node);
+        }
+
+        FunctionEntry *entry = interpreter_.findFunction(node.functionName_);
+        if (entry == nullptr)
+        {
+            throwError("unknown function '" + node.functionName_ + "'");
+        }
+        std::vector<Code> args = compileAll(node.arguments_);
+        return [entry, args = std::move(args)](Frame &frame)
+        {
+            std::vector<Value> values;
+            values.reserve(args.size());
+            for (const auto &arg : args)
+            {
+                values.push_back(arg(frame));
+            }
+            return frame.interpreter().callFunction(*entry, values);
+        };
+    }
+
+    Code ClosureCompiler::compileCallWithFunction(const FunctionCallNode &node)
+    {
+        const std::string &functionName = static_cast<const SymbolNode &>(*node.arguments_[0]).name_;
+        FunctionEntry *entry = interpreter_.findFunction(functionName);
+        if (entry == nullptr)
+        {
+            throwError("unknown function '" + functionName + "'");
+        }
+        // The function name is not an expression; everything after it is
+        std::vector<Code> args;
+        for (std::size_t i = 1; i < node.arguments_.size(); ++i)
+        {
+            args.push_back(compile(*node.arguments_[i]));
+        }
+        return [entry, form = node.functionName_, args = std::move(args)](Frame &frame)
+        {
+            std::vector<Value> values;
+            values.reserve(args.size());
+            for (const auto &arg : args)
+            {
+                values.push_back(arg(frame));
+            }
+            return frame.interpreter().callWithFunction(form, *entry, values);
+        };
+    }
+
+    Code ClosureCompiler::compileBuiltinCall(const FunctionCallNode &node)
+    {
+        const std::string &name = node.functionName_;
+        const Builtin *builtin = findBuiltin(name);
+        std::vector<Code> args = compileAll(node.arguments_);
+
+        if (args.size() == 2)
+        {
+            bool intResult = checker_.typeOf(node) == ValueType::INT;
+            bool intOperands = checker_.typeOf(*node.arguments_[0]) == ValueType::INT &&
+                               checker_.typeOf(*node.arguments_[1]) == ValueType::INT;
+            Code lhs = args[0];
+            Code rhs = args[1];
+
+            if (name == "add")
+                return numericOperation<std::plus>(lhs, rhs, intResult);
+            if (name == "subtract")
+                return numericOperation<std::minus>(lhs, rhs, intResult);
+            if (name == "multiply")
+                return numericOperation<std::multiplies>(lhs, rhs, intResult);
+            if (name == "divide" && !intResult)
+                return floatOperation(lhs, rhs, std::divides<double>());
+            if (name == "less-than")
+                return numericOperation<std::less>(lhs, rhs, intOperands);
+            if (name == "less-equal")
+                return numericOperation<std::less_equal>(lhs, rhs, intOperands);
+            if (name == "greater-than")
+                return numericOperation<std::greater>(lhs, rhs, intOperands);
+            if (name == "greater-equal")
+                return numericOperation<std::greater_equal>(lhs, rhs, intOperands);
+            if (name == "and")
+            {
+                return [lhs, rhs](Frame &frame)
+                {
+                    return Value(lhs(frame).asBool() && rhs(frame).asBool());
+                };
+            }
+            if (name == "or")
+            {
+                return [lhs, rhs](Frame &frame)
+                {
+                    return Value(lhs(frame).asBool() || rhs(frame).asBool());
+                };
+            }
+        }
+
+        if (name == "vector-ref" && uncheckedAccesses_.count(&node) != 0)
+        {
+            // The vector is a plain variable, read in place rather than copied out of its slot
+            int vectorSlot = slotFor(static_cast<const SymbolNode &>(*node.arguments_[0]).name_);
+            Code index = args[1];
+            return [vectorSlot, index = std::move(index)](Frame &frame)
+            {
+                return Value(frame.get(vectorSlot).vectorElementUnchecked(static_cast<std::size_t>(index(frame).asInt())));
+            };
+        }
+
+        if (name == "vector-push" && node.arguments_[0]->getType() == NodeType::SYMBOL)
+        {
+            // Pushed through the variable's own slot; a copy of its Value would get its own vector
+            int vectorSlot = slotFor(static_cast<const SymbolNode &>(*node.arguments_[0]).name_);
+            Code element = args[1];
+            return [vectorSlot, element = std::move(element)](Frame &frame)
+            {
+                double value = element(frame).asFloat();
+                frame.get(vectorSlot).asMutableVector().push(value);
+                return Value();
+            };
+        }
+
+        if (builtin->function_ == nullptr)
+        {
+            throwError("builtin '" + name + "' is not available in this runtime");
+        }
+
+        BuiltinFunction function = builtin->function_;
+        if (args.size() <= 4)
+        {
+            return [function, args = std::move(args)](Frame &frame)
+            {
+                std::array<Value, 4> values;
+                for (std::size_t i = 0; i < args.size(); ++i)
+                {
+                    values[i] = args[i](frame);
+                }
+                return function(frame.interpreter(), std::span<Value>(values.data(), args.size()));
+            };
+        }
+        return [function, args = std::move(args)](Frame &frame)
+        {
+            std::vector<Value> values;
+            values.reserve(args.size());
+            for (const auto &arg : args)
+            {
+                values.push_back(arg(frame));
+            }
+            return function(frame.interpreter(), values);
+        };
+    }
+
+    Code ClosureCompiler::compileForIteration(const ForIterationNode &node)
+    {
+        if (node.isParallel_)
+        {
+            return compileParallelFor(node);
+        }
+        Code start = compile(*node.start_);
+        Code end = compile(*node.end_);
+        Code step = compile(*node.step_);
+        ForRange range = compileForRange(node);
+        return [start = std::move(start), end = std::move(end), step = std::move(step),
+                range = std::move(range)](Frame &frame)
+        {
+            long index = start(frame).asInt();
+            long last = end(frame).asInt();
+            long increment = step(frame).asInt();
+            if (increment == 0)
+            {
+                throwRuntimeError("'for' step must not be zero");
+            }
+            range(frame, index, last, increment);
+            return Value();
+        };
+    }
+
+    Code ClosureCompiler::compileParallelFor(const ForIterationNode &node)
+    {
+        Code start = compile(*node.start_);
+        Code end = compile(*node.end_);
+        Code step = compile(*node.step_);
+        Code grain = node.grain_ != nullptr ? compile(*node.grain_) : nullptr;
+        int indexSlot = slotFor(node.index_);
+        std::vector<Code> body = compileAll(node.body_);
+        std::shared_ptr<const ParallelLoop> parallel = compileParallelLoop(*checker_.parallelPlan(node), node.index_, true);
+        return [start = std::move(start), end = std::move(end), step = std::move(step), grain = std::move(grain),
+                indexSlot, body = std::move(body), parallel = std::move(parallel)](Frame &frame)
+        {
+            long index = start(frame).asInt();
+            long last = end(frame).asInt();
+            long increment = step(frame).asInt();
+            if (increment == 0)
+            {
+                throwRuntimeError("'pfor' step must not be zero");
+            }
+            long grainSize = grain != nullptr ? grain(frame).asInt() : 0;
+            if (grain != nullptr && grainSize <= 0)
+            {
+                throwRuntimeError("'pfor' grain must be positive, got " + std::to_string(grainSize));
+            }
+
+            Value &indexVariable = frame.declare(indexSlot);
+            if (parallel->run(frame, body, index, last, increment, grainSize))
+            {
+                return Value();
+            }
+            indexVariable = Value(index);
+            while (increment > 0 ? index <= last : index >= last)
+            {
+                indexVariable = Value(index);
+                runBody(body, frame);
+                index = indexVariable.asInt() + increment;
+                frame.interpreter().checkCancelled();
+            }
+            return Value();
+        };
+    }
+
+    ForRange ClosureCompiler::compileForRange(const ForIterationNode &node)
+    {
+        int indexSlot = slotFor(node.index_);
+        std::vector<Code> body = compileAll(node.body_);
+        std::unique_ptr<VectorLoopPlan> plan = planVectorLoop(node, checker_);
+        std::shared_ptr<const VectorLoop> vector = plan != nullptr ? compileVectorLoop(*plan) : nullptr;
+        std::shared_ptr<const ParallelLoop> parallel;
+        if (interpreter_.options().parallelLoops_)
+        {
+            if (std::unique_ptr<ParallelLoopPlan> parallelPlan = planParallelLoop(node, checker_))
+            {
+                parallel = compileParallelLoop(*parallelPlan, node.index_);
+            }
+        }
+
+        // A second copy of the body, used when the loop's vector-refs are all in range on entry
+        std::vector<EntryCheck> checks;
+        std::vector<Code> uncheckedBody;
+        if (std::unique_ptr<BoundsCheckPlan> boundsChecks = planBoundsChecks(node, function_))
+        {
+            for (const auto &indexed : boundsChecks->vectors_)
+            {
+                checks.push_back({slotFor(indexed.vector_), indexed.minOffset_, indexed.maxOffset_});
+            }
+            std::unordered_set<const ASTNode *> enclosing = uncheckedAccesses_;
+            uncheckedAccesses_.insert(boundsChecks->accesses_.begin(), boundsChecks->accesses_.end());
+            uncheckedBody = compileAll(node.body_);
+            uncheckedAccesses_ = std::move(enclosing);
+        }
+
+        return [indexSlot, body = std::move(body), vector = std::move(vector), parallel = std::move(parallel),
+                checks = std::move(checks), uncheckedBody = std::move(uncheckedBody)](Frame &frame, long index, long end,
+                                                                                      long step)
+        {
+            Value &indexVariable = frame.declare(indexSlot);
+            if (vector != nullptr && step == 1 && vector->run(frame, index, end))
+            {
+                // Leave the index where the scalar loop would: at the last iteration run
+                indexVariable = Value(index <= end ? end : index);
+                return;
+            }
+            bool inRange = !checks.empty();
+            for (const EntryCheck &check : checks)
+            {
+                std::size_t size = frame.get(check.vectorSlot_).vectorSize();
+                inRange = inRange && forIndicesInRange(index, end, step, check.minOffset_, check.maxOffset_, size);
+            }
+            const std::vector<Code> &active = inRange ? uncheckedBody : body;
+            if (parallel != nullptr && parallel->run(frame, active, index, end, step))
+            {
+                return;
+            }
+            indexVariable = Value(index);
+            while (step > 0 ? index <= end : index >= end)
+            {
+                indexVariable = Value(index);
+                runBody(active, frame);
+                index = indexVariable.asInt() + step;
+                frame.interpreter().checkCancelled();
+            }
+        };
+    }
+
+    Code ClosureCompiler::compileWhileIteration(const WhileIterationNode &node)
+    {
+        Code condition = compile(*node.condition_);
+        std::vector<Code> body = compileAll(node.body_);
+        Code whileLoop = [condition = std::move(condition), body = std::move(body)](Frame &frame)
+        {
+            while (condition(frame).asBool())
+            {
+                runBody(body, frame);
+                frame.interpreter().checkCancelled();
+            }
+            return Value();
+        };
+
+        std::unique_ptr<VectorLoopPlan> plan = planVectorLoop(node, checker_);
+        if (plan == nullptr || (plan->kind_ == VectorLoopKind::SUM && interpreter_.options().orderedFloatSums_))
+        {
+            return whileLoop;
+        }
+        std::shared_ptr<const VectorLoop> vector = compileVectorLoop(*plan);
+        if (vector == nullptr)
+        {
+            return whileLoop;
+        }
+        int indexSlot = slotFor(plan->index_);
+        Code bound = compile(*plan->bound_);
+        bool inclusive = plan->inclusiveBound_;
+        return [whileLoop = std::move(whileLoop), vector = std::move(vector), indexSlot, bound = std::move(bound),
+                inclusive](Frame &frame)
+        {
+            long first = frame.get(indexSlot).asInt();
+            long last = bound(frame).asInt() - (inclusive ? 0 : 1);
+            if (vector->run(frame, first, last))
+            {
+                if (first <= last)
+                {
+                    frame.get(indexSlot) = Value(last + 1);
+                }
+                return Value();
+            }
+            return whileLoop(frame);
+        };
+    }
+
+    std::shared_ptr<const VectorLoop> ClosureCompiler::compileVectorLoop(const VectorLoopPlan &plan)
+    {
+        // Vectorized sums add in a different order
+        if (plan.kind_ == VectorLoopKind::SUM && interpreter_.options().orderedFloatSums_)
+        {
+            return nullptr;
+        }
+
+        std::function<std::unique_ptr<VectorLoop::Element>(const ElementExpression &)> compileElement =
+            [this, &compileElement](const ElementExpression &expression)
+        {
+            auto element = std::make_unique<VectorLoop::Element>();
+            element->kind_ = expression.kind_;
+            if (expression.kind_ == ElementExpression::Kind::ELEMENT)
+            {
+                element->vectorSlot_ = slotFor(expression.vector_);
+            }
+            else if (expression.kind_ == ElementExpression::Kind::INVARIANT)
+            {
+                element->invariant_ = compile(*expression.invariant_);
+            }
+            else
+            {
+                element->lhs_ = compileElement(*expression.lhs_);
+                element->rhs_ = compileElement(*expression.rhs_);
+            }
+            return element;
+        };
+
+        auto vector = std::make_shared<VectorLoop>();
+        vector->kind_ = plan.kind_;
+        vector->targetSlot_ = slotFor(plan.target_);
+        for (const auto &input : plan.inputs_)
+        {
+            vector->inputSlots_.push_back(slotFor(input));
+        }
+        vector->element_ = compileElement(*plan.element_);
+        return vector;
+    }
+
+    std::shared_ptr<const ParallelLoop> ClosureCompiler::compileParallelLoop(const ParallelLoopPlan &plan,
+                                                                             const std::string &index, bool isExplicit)
+    {
+        const TierOptions &options = interpreter_.options();
+        auto parallel = std::make_shared<ParallelLoop>();
+        parallel->plan_ = plan;
+        parallel->indexSlot_ = slotFor(index);
+        parallel->privateSlots_.push_back(parallel->indexSlot_);
+        for (const Reduction &reduction : plan.reductions_)
+        {
+            // Partial sums would change the order Float values are added in, which a `pfor` accepts
+            if (reduction.kind_ == ReductionKind::SUM && reduction.type_ == ValueType::FLOAT &&
+                options.orderedFloatSums_ && !isExplicit)
+            {
+                return nullptr;
+            }
+            parallel->privateSlots_.push_back(slotFor(reduction.variable_));
+        }
+        for (const auto &output : plan.outputs_)
+        {
+            parallel->privateSlots_.push_back(slotFor(output));
+        }
+        for (const auto &input : plan.inputs_)
+        {
+            parallel->inputSlots_.push_back(slotFor(input));
+        }
+        parallel->threshold_ = isExplicit ? 1 : options.parallelThreshold_;
+        return parallel;
+    }
+
+    Code ClosureCompiler::compileIf(const IfNode &node)
+    {
+        ValueType type = checker_.typeOf(node);
+        Code condition = compile(*node.condition_);
+        Code thenBranch = compile(*node.thenBranch_);
+        Code elseBranch = compile(*node.elseBranch_);
+        return [type, condition = std::move(condition), thenBranch = std::move(thenBranch),
+                elseBranch = std::move(elseBranch)](Frame &frame)
+        {
+            Value result = condition(frame).asBool() ? thenBranch(frame) : elseBranch(frame);
+            if (type == ValueType::VOID)
+            {
+                return Value();
+            }
+            return convertValue(std::move(result), type);
+        };
+    }
+
+    int ClosureCompiler::slotFor(const std::string &name)
+    {
+        auto it = std::find(layout_->names_.begin(), layout_->names_.end(), name);
+        if (it != layout_->names_.end())
+        {
+            return static_cast<int>(it - layout_->names_.begin());
+        }
+
+        layout_->names_.push_back(name);
+        bool isLocal = localsInFrame_ && function_ != nullptr && function_->locals_.count(name) != 0;
+        layout_->localIndex_.push_back(isLocal ? layout_->localCount_++ : -1);
+        return static_cast<int>(layout_->names_.size()) - 1;
+    }
+
+    ValueType ClosureCompiler::variableType(const std::string &name) const
+    {
+        if (function_ != nullptr)
+        {
+            auto local = function_->locals_.find(name);
+            if (local != function_->locals_.end())
+            {
+                return local->second;
+            }
+        }
+        auto global = checker_.globals().find(name);
+        if (global == checker_.globals().end())
+        {
+            throwError("undefined variable '" + name + "'");
+        }
+        return global->second;
+    }
+
+    void ClosureCompiler::throwError(const std::string &message) const
+    {
+        throw std::runtime_error("Compile error: " + message);
+    }
+
+} // namespace Shattang::MyLisp
@@ -0,0 +1,736 @@
+#include <Shattang/MyLisp/CppTranspiler.h>
+#include <Shattang/MyLisp/ASTWalk.h>
+#include <Shattang/MyLisp/BoundsCheckElimination.h>
+
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include <unordered_set>
+
+namespace Shattang::MyLisp
+{
+    namespace
+    {
+        const std::unordered_set<std::string> &cppKeywords()
+        {
+            static const std::unordered_set<std::string> keywords = {
+                "alignas", "alignof", "and", "and_eq", "asm", "auto", "bitand", "bitor", "bool", "break", "case",
+                "catch", "char", "class", "compl", "concept", "const", "consteval", "constexpr", "constinit",
+                "const_cast", "continue", "co_await", "co_return", "co_yield", "decltype", "default", "delete", "do",
+                "double", "dynamic_cast", "else", "enum", "explicit", "export", "extern", "false", "float", "for",
+                "friend", "goto", "if", "inline", "int", "long", "mutable", "namespace", "new", "noexcept", "not",
+                "not_eq", "nullptr", "operator", "or", "or_eq", "private", "protected", "public", "register",
+                "reinterpret_cast", "requires", "return", "short", "signed", "sizeof", "static", "static_assert",
+                "static_cast", "struct", "switch", "template", "this", "thread_local", "throw", "true", "try",
+                "typedef", "typeid", "typename", "union", "unsigned", "using", "virtual", "void", "volatile",
+                "wchar_t", "while", "xor", "xor_eq", "std", "Aot", "run", "main"};
+            return keywords;
+        }
+
+        const std::unordered_map<std::string, std::string> &binaryOperators()
+        {
+            static const std::unordered_map<std::string, std::string> operators = {
+                {"add", "+"},
+                {"subtract", "-"},
+                {"multiply", "*"},
+                {"less-than", "<"},
+                {"less-equal", "<="},
+                {"greater-than", ">"},
+                {"greater-equal", ">="},
+                {"equal", "=="},
+                {"not-equal", "!="},
+                {"and", "&&"},
+                {"or", "||"},
+            };
+            return operators;
+        }
+
+        bool isValueType(ValueType type)
+        {
+            return type != ValueType::VOID;
+        }
+    }
+
+    CppTranspiler::CppTranspiler(const ScriptNode &script, const TypeChecker &checker, const std::string &moduleName)
+        : script_(script), checker_(checker), moduleName_(moduleName) {}
+
+    void CppTranspiler::emitHeader(std::ostream &out)
+    {
+        out << "// Generated by MyLispCompiler from module '" << moduleName_ << "'. Do not edit.\n"
+            << "#pragma once\n\n"
+            << "#include <Shattang/MyLisp/AotRuntime.h>\n\n"
+            << "namespace " << mangle(moduleName_) << "\n{\n";
+        indentLevel_ = 1;
+        indent(out);
+        out << "namespace Aot = Shattang::MyLisp::Aot;\n\n";
+        for (const auto &statement : script_.statements_)
+        {
+            if (statement->getType() == NodeType::FUNCTION_DECLARATION)
+            {
+                indent(out);
+                out << signature(static_cast<const FunctionDeclarationNode &>(*statement)) << ";\n";
+            }
+        }
+        indent(out);
+        out << "void run();\n";
+        out << "}\n";
+        indentLevel_ = 0;
+    }
+
+    void CppTranspiler::emitSource(std::ostream &out, const std::string &headerName)
+    {
+        out << "// Generated by MyLispCompiler from module '" << moduleName_ << "'. Do not edit.\n"
+            << "#include \"" << headerName << "\"\n\n"
+            << "namespace " << mangle(moduleName_) << "\n{\n";
+        indentLevel_ = 1;
+
+        // Globals live for the whole program, like top-level `let`s in the interpreter
+        std::vector<std::pair<std::string, ValueType>> globals(checker_.globals().begin(), checker_.globals().end());
+        std::sort(globals.begin(), globals.end());
+        if (!globals.empty())
+        {
+            indent(out);
+            out << "namespace\n";
+            indent(out);
+            out << "{\n";
+            indentLevel_++;
+            for (const auto &[name, type] : globals)
+            {
+                if (checker_.function(name) != nullptr)
+                {
+                    throwError("global variable '" + name + "' has the same name as a function");
+                }
+                indent(out);
+                out << cppType(type) << " " << mangle(name) << "{};\n";
+            }
+            indentLevel_--;
+            indent(out);
+            out << "}\n\n";
+        }
+
+        for (const auto &statement : script_.statements_)
+        {
+            if (statement->getType() == NodeType::FUNCTION_DECLARATION)
+            {
+                emitFunction(out, static_cast<const FunctionDeclarationNode &>(*statement));
+                out << "\n";
+            }
+        }
+
+        indent(out);
+        out << "void run()\n";
+        indent(out);
+        out << "{\n";
+        indentLevel_++;
+        for (const auto &statement : script_.statements_)
+        {
+            if (statement->getType() != NodeType::FUNCTION_DECLARATION)
+            {
+                emitStatement(out, *statement);
+            }
+        }
+        indentLevel_--;
+        indent(out);
+        out << "}\n";
+        out << "}\n";
+        indentLevel_ = 0;
+    }
+
+    std::string CppTranspiler::mangle(const std::string &name)
+    {
+        std::string result;
+        for (char c : name)
+        {
+            if (c == '-')
+                result += '_';
+            else if (c == '?')
+                result += "_p";
+            else
+                result += c;
+        }
+        if (cppKeywords().count(result) != 0)
+        {
+            result += '_';
+        }
+
+        auto [it, inserted] = mangledNames_.emplace(result, name);
+        if (!inserted && it->second != name)
+        {
+            throwError("names '" + it->second + "' and '" + name + "' both map to C++ identifier '" + result + "'");
+        }
+        return result;
+    }
+
+    std::string CppTranspiler::cppType(ValueType type) const
+    {
+        switch (type)
+        {
+        case ValueType::VOID:
+            return "void";
+        case ValueType::INT:
+            return "long";
+        case ValueType::FLOAT:
+            return "double";
+        case ValueType::BOOLEAN:
+            return "bool";
+        case ValueType::STRING:
+            return "std::string";
+        case ValueType::DOUBLE_VECTOR:
+            return "Aot::DoubleVector";
+        case ValueType::DOUBLE_MATRIX:
+            return "Aot::DoubleMatrix";
+        case ValueType::SEQUENCE:
+            return "Aot::Sequence";
+        case ValueType::QUANTILE_SKETCH:
+            return "Aot::QuantileSketch";
+        case ValueType::DISTINCT_SKETCH:
+            return "Aot::DistinctSketch";
+        case ValueType::GROUPS:
+            return "Aot::Groups";
+        default:
+            throwError("unsupported type " + ValueTypeToString(type));
+        }
+    }
+
+    std::string CppTranspiler::signature(const FunctionDeclarationNode &node)
+    {
+        const FunctionTypeInfo *info = checker_.function(node.functionName_);
+        std::ostringstream oss;
+        oss << cppType(info->returnType_) << " " << mangle(node.functionName_) << "(";
+        for (std::size_t i = 0; i < node.parameters_.size(); ++i)
+        {
+            ValueType type = info->parameterTypes_[i];
+            const std::string &name = node.parameters_[i].name_;
+            bool byReference = (type == ValueType::STRING || type == ValueType::DOUBLE_VECTOR) &&
+                               !isMutatedParameter(node, name);
+            oss << (i > 0 ? ", " : "")
+                << (byReference ? "const " + cppType(type) + " &" : cppType(type) + " ")
+                << mangle(name);
+        }
+        oss << ")";
+        return oss.str();
+    }
+
+    bool CppTranspiler::isMutatedParameter(const FunctionDeclarationNode &node, const std::string &name) const
+    {
+        bool mutated = false;
+        forEachNode(node, [&](const ASTNode &child)
+                    {
+            if (child.getType() == NodeType::VARIABLE_ASSIGNMENT)
+            {
+                mutated = mutated || static_cast<const VariableAssignmentNode &>(child).variableName_ == name;
+            }
+            else if (child.getType() == NodeType::VARIABLE_DECLARATION)
+            {
+                mutated = mutated || static_cast<const VariableDeclarationNode &>(child).variableName_ == name;
+            }
+            else if (child.getType() == NodeType::FUNCTION_CALL)
+            {
+                const auto &call = static_cast<const FunctionCallNode &>(child);
+                mutated = mutated || (call.functionName_ == "vector-push" && !call.arguments_.empty() &&
+                                      call.arguments_[0]->getType() == NodeType::SYMBOL &&
+                                      static_cast<const SymbolNode &>(*call.arguments_[0]).name_ == name);
+            } });
+        return mutated;
+    }
+
+    void CppTranspiler::emitFunction(std::ostream &out, const FunctionDeclarationNode &node)
+    {
+        const FunctionTypeInfo *info = checker_.function(node.functionName_);
+        function_ = info;
+
+        indent(out);
+        out << signature(node) << "\n";
+        indent(out);
+        out << "{\n";
+        indentLevel_++;
+
+        // MyLisp locals are function scoped, so declare them all up front
+        std::vector<std::pair<std::string, ValueType>> locals(info->locals_.begin(), info->locals_.end());
+        std::sort(locals.begin(), locals.end());
+        for (const auto &[name, type] : locals)
+        {
+            bool isParameter = std::any_of(node.parameters_.begin(), node.parameters_.end(),
+                                           [&name](const Parameter &param)
+                                           { return param.name_ == name; });
+            if (isParameter)
+                continue;
+            if (checker_.function(name) != nullptr)
+            {
+                throwError("local variable '" + name + "' in '" + node.functionName_ + "' has the same name as a function");
+            }
+            indent(out);
+            out << cppType(type) << " " << mangle(name) << "{};\n";
+        }
+
+        emitBody(out, node.body_, info->returnType_ != ValueType::VOID);
+        indentLevel_--;
+        indent(out);
+        out << "}\n";
+        function_ = nullptr;
+    }
+
+    void CppTranspiler::emitBody(std::ostream &out, const std::vector<std::unique_ptr<ASTNode>> &body, bool returnsLast)
+    {
+        for (std::size_t i = 0; i < body.size(); ++i)
+        {
+            if (returnsLast && i + 1 == body.size())
+            {
+                indent(out);
+                out << "return " << emitExpression(*body[i]) << ";\n";
+            }
+            else
+            {
+                emitStatement(out, *body[i]);
+            }
+        }
+    }
+
+    void CppTranspiler::emitStatement(std::ostream &out, const ASTNode &node)
+    {
+        switch (node.getType())
+        {
+        case NodeType::VARIABLE_DECLARATION:
+        {
+            const auto &varDecl = static_cast<const VariableDeclarationNode &>(node);
+            indent(out);
+            out << mangle(varDecl.variableName_) << " = " << emitExpression(*varDecl.valueNode_) << ";\n";
+            break;
+        }
+
+        case NodeType::VARIABLE_ASSIGNMENT:
+        {
+            const auto &varAssign = static_cast<const VariableAssignmentNode &>(node);
+            indent(out);
+            out << mangle(varAssign.variableName_) << " = " << emitExpression(*varAssign.valueNode_) << ";\n";
+            break;
+        }
+
+        case NodeType::FOR_ITERATION:
+        {
+            // Bounds and step are evaluated once on entry; the end bound is inclusive. A `pfor`
+            // runs in order: its iterations are independent, so the results match up to the
+            // rounding of Float sums
+            const auto &forNode = static_cast<const ForIterationNode &>(node);
+            std::string id = std::to_string(loopCounter_++);
+            std::string end = mangle("loopEnd" + id + "_");
+            std::string step = mangle("loopStep" + id + "_");
+
+            indent(out);
+            out << "{\n";
+            indentLevel_++;
+            indent(out);
+            out << "const long " << end << " = " << emitExpression(*forNode.end_) << ";\n";
+            indent(out);
+            out << "const long " << step << " = " << emitExpression(*forNode.step_) << ";\n";
+            indent(out);
+            out << "Aot::checkStep(" << step << ");\n";
+            if (forNode.grain_ != nullptr)
+            {
+                indent(out);
+                out << "(void)Aot::checkGrain(\"pfor\", " << emitExpression(*forNode.grain_) << ");\n";
+            }
+
+            std::unique_ptr<BoundsCheckPlan> checks = planBoundsChecks(forNode, function_);
+            if (checks == nullptr)
+            {
+                emitForLoop(out, forNode, emitExpression(*forNode.start_), end, step);
+            }
+            else
+            {
+                // Two copies of the loop; the first reads vectors without checking each access
+                std::string start = mangle("loopStart" + id + "_");
+                indent(out);
+                out << "const long " << start << " = " << emitExpression(*forNode.start_) << ";\n";
+                indent(out);
+                out << "if (";
+                for (std::size_t i = 0; i < checks->vectors_.size(); ++i)
+                {
+                    const IndexedVector &indexed = checks->vectors_[i];
+                    out << (i > 0 ? " &&\n" + std::string((indentLevel_ + 1) * 4, ' ') : "")
+                        << "Aot::forIndicesInRange(" << start << ", " << end << ", " << step << ", "
+                        << indexed.minOffset_ << "L, " << indexed.maxOffset_ << "L, " << mangle(indexed.vector_)
+                        << ".size())";
+                }
+                out << ")\n";
+                indent(out);
+                out << "{\n";
+                indentLevel_++;
+                std::unordered_set<const ASTNode *> enclosing = uncheckedAccesses_;
+                uncheckedAccesses_.insert(checks->accesses_.begin(), checks->accesses_.end());
+                emitForLoop(out, forNode, start, end, step);
+                uncheckedAccesses_ = std::move(enclosing);
+                indentLevel_--;
+                indent(out);
+                out << "}\n";
+                indent(out);
+                out << "else\n";
+                indent(out);
+                out << "{\n";
+                indentLevel_++;
+                emitForLoop(out, forNode, start, end, step);
+                indentLevel_--;
+                indent(out);
+                out << "}\n";
+            }
+            indentLevel_--;
+            indent(out);
+            out << "}\n";
+            break;
+        }
+
+        case NodeType::WHILE_ITERATION:
+        {
+            const auto &whileNode = static_cast<const WhileIterationNode &>(node);
+            indent(out);
+            out << "while (" << emitExpression(*whileNode.condition_) << ")\n";
+            indent(out);
+            out << "{\n";
+            indentLevel_++;
+            for (const auto &statement : whileNode.body_)
+            {
+                emitStatement(out, *statement);
+            }
+            indentLevel_--;
+            indent(out);
+            out << "}\n";
+            break;
+        }
+
+        case NodeType::IF:
+        {
+            const auto &ifNode = static_cast<const IfNode &>(node);
+            if (isValueType(checker_.typeOf(ifNode)))
+            {
+                indent(out);
+                out << "(void)" << emitExpression(ifNode) << ";\n";
+                break;
+            }
+            indent(out);
+            out << "if (" << emitExpression(*ifNode.condition_) << ")\n";
+            indent(out);
+            out << "{\n";
+            indentLevel_++;
+            emitStatement(out, *ifNode.thenBranch_);
+            indentLevel_--;
+            indent(out);
+            out << "}\n";
+            indent(out);
+            out << "else\n";
+            indent(out);
+            out << "{\n";
+            indentLevel_++;
+            emitStatement(out, *ifNode.elseBranch_);
+            indentLevel_--;
+            indent(out);
+            out << "}\n";
+            break;
+        }
+
+        case NodeType::FUNCTION_CALL:
+            indent(out);
+            out << emitCall(static_cast<const FunctionCallNode &>(node)) << ";\n";
+            break;
+
+        case NodeType::FUNCTION_DECLARATION:
+            throwError("nested function definitions are not supported");
+
+        default:
+            indent(out);
+            out << "(void)" << emitExpression(node) << ";\n";
+            break;
+        }
+    }
+
+    void CppTranspiler::emitForLoop(std::ostream &out, const ForIterationNode &node, const std::string &start,
+                                    const std::string &end, const std::string &step)
+    {
+        std::string index = mangle(node.index_);
+        indent(out);
+        out << "for (" << index << " = " << start << "; " << step << " > 0 ? " << index << " <= " << end << " : " << index
+            << " >= " << end << "; " << index << " += " << step << ")\n";
+        indent(out);
+        out << "{\n";
+        indentLevel_++;
+        for (const auto &statement : node.body_)
+        {
+            emitStatement(out, *statement);
+        }
+        indentLevel_--;
+        indent(out);
+        out << "}\n";
+    }
+
+    std::string CppTranspiler::emitExpression(const ASTNode &node)
+    {
+        switch (node.getType())
+        {
+        case NodeType::SYMBOL:
+        {
+            const std::string &name = static_cast<const SymbolNode &>(node).name_;
+            if (function_ != nullptr && function_->lastUses_.count(&node) != 0)
+            {
+                // Never read again, so the vector can move; a const reference parameter cannot
+                const FunctionDeclarationNode &declaration = *function_->declaration_;
+                bool isParameter = std::any_of(declaration.parameters_.begin(), declaration.parameters_.end(),
+                                               [&name](const Parameter &parameter)
+                                               { return parameter.name_ == name; });
+                if (!isParameter || isMutatedParameter(declaration, name))
+                {
+                    return "std::move(" + mangle(name) + ")";
+                }
+            }
+            return mangle(name);
+        }
+        case NodeType::INTEGER:
+        {
+            long value = static_cast<const IntegerNode &>(node).value_;
+            // The literal 9223372036854775808L does not fit a long, so the smallest Int is spelled out
+            if (value == std::numeric_limits<long>::min())
+                return "(-9223372036854775807L - 1)";
+            return std::to_string(value) + "L";
+        }
+        case NodeType::FLOAT:
+        {
+            std::ostringstream oss;
+            oss.precision(17);
+            oss << std::showpoint << static_cast<const FloatNode &>(node).value_;
+            return oss.str();
+        }
+        case NodeType::BOOLEAN:
+            return static_cast<const BooleanNode &>(node).value_ ? "true" : "false";
+        case NodeType::STRING:
+            return emitStringLiteral(static_cast<const StringNode &>(node).value_);
+        case NodeType::FUNCTION_CALL:
+            return emitCall(static_cast<const FunctionCallNode &>(node));
+        case NodeType::IF:
+        {
+            const auto &ifNode = static_cast<const IfNode &>(node);
+            if (!isValueType(checker_.typeOf(ifNode)))
+            {
+                throwError("'if' without a common branch type used as a value");
+            }
+            return "(" + emitExpression(*ifNode.condition_) + " ? " + emitExpression(*ifNode.thenBranch_) + " : " +
+                   emitExpression(*ifNode.elseBranch_) + ")";
+        }
+        default:
+            throwError("statement used as a value: " + node.toString());
+        }
+    }
+
+    std::string CppTranspiler::emitCall(const FunctionCallNode &node)
+    {
+        std::vector<std::string> args;
+        for (const auto &arg : node.arguments_)
+        {
+            args.push_back(emitExpression(*arg));
+        }
+        auto joined = [&args]()
+        {
+            std::string result;
+            for (std::size_t i = 0; i < args.size(); ++i)
+            {
+                result += (i > 0 ? ", " : "") + args[i];
+            }
+            return result;
+        };
+
+        const std::string &name = node.functionName_;
+        if (checker_.function(name) != nullptr)
+        {
+            return mangle(name) + "(" + joined() + ")";
+        }
+        if (name == "pmap" || name == "preduce")
+        {
+            // The first argument is the mangled function name
+            std::size_t grainPosition = name == "pmap" ? 2 : 3;
+            if (args.size() > grainPosition)
+            {
+                args[grainPosition] = "Aot::checkGrain(\"" + name + "\", " + args[grainPosition] + ")";
+            }
+            return "Aot::" + name + "(" + joined() + ")";
+        }
+        if (name == "map" || name == "filter" || name == "zip")
+        {
+            return "Aot::" + name + "(" + joined() + ")";
+        }
+
+        // Matrices are shared in generated code, so `equal` has to compare what they point to
+        if ((name == "equal" || name == "not-equal") && checker_.typeOf(*node.arguments_[0]) == ValueType::DOUBLE_MATRIX)
+        {
+            return std::string(name == "equal" ? "" : "!") + "Aot::matrixEqual(" + joined() + ")";
+        }
+        auto op = binaryOperators().find(name);
+        if (op != binaryOperators().end())
+        {
+            return "(" + args[0] + " " + op->second + " " + args[1] + ")";
+        }
+        if (name == "divide")
+            return "Aot::divide(" + joined() + ")";
+        if (name == "modulo")
+            return "Aot::modulo(" + joined() + ")";
+        if (name == "not")
+            return "(!" + args[0] + ")";
+        if (name == "sqrt")
+            return "std::sqrt(static_cast<double>(" + args[0] + "))";
+        if (name == "to-int")
+            return "Aot::toInt(" + args[0] + ")";
+        if (name == "print")
+            return "Aot::print(" + joined() + ")";
+        if (name == "string-append")
+            return "Aot::stringAppend(" + joined() + ")";
+        if (name == "string-length")
+            return "Aot::stringLength(" + args[0] + ")";
+        if (name == "to-string")
+            return "Aot::toString(" + args[0] + ")";
+        if (name == "using")
+            return "Aot::useModule(" + args[0] + ")";
+        if (name == "length")
+            return "Aot::length(" + args[0] + ")";
+        if (name == "vector-ref" && uncheckedAccesses_.count(&node) != 0)
+            return "Aot::vectorRefUnchecked(" + joined() + ")";
+        if (name == "vector-ref")
+            return "Aot::vectorRef(" + joined() + ")";
+        if (name == "vector-push")
+            return args[0] + ".push(static_cast<double>(" + args[1] + "))";
+        if (name == "make-double-vector")
+            return "Aot::DoubleVector()";
+        if (name == "import-double-vector")
+            return "Aot::importDoubleVector(" + args[0] + ")";
+        if (name == "vector-add")
+            return "Aot::vectorAdd(" + joined() + ")";
+        if (name == "vector-subtract")
+            return "Aot::vectorSubtract(" + joined() + ")";
+        if (name == "vector-multiply")
+            return "Aot::vectorMultiply(" + joined() + ")";
+        if (name == "vector-divide")
+            return "Aot::vectorDivide(" + joined() + ")";
+        if (name == "vector-scale")
+            return "Aot::vectorScale(" + joined() + ")";
+        if (name == "vector-dot")
+            return "Aot::vectorDot(" + joined() + ")";
+        if (name == "vector-sum")
+            return "Aot::vectorSum(" + args[0] + ")";
+        if (name == "vector-min")
+            return "Aot::vectorMin(" + args[0] + ")";
+        if (name == "vector-max")
+            return "Aot::vectorMax(" + args[0] + ")";
+        if (name == "make-double-matrix")
+            return "Aot::makeDoubleMatrix(" + joined() + ")";
+        if (name == "matrix-ref")
+            return "Aot::matrixRef(" + joined() + ")";
+        if (name == "matrix-rows")
+            return "Aot::matrixRows(" + args[0] + ")";
+        if (name == "matrix-columns")
+            return "Aot::matrixColumns(" + args[0] + ")";
+        if (name == "matrix-elements")
+            return "Aot::matrixElements(" + args[0] + ")";
+        if (name == "matrix-transpose")
+            return "Aot::matrixTranspose(" + args[0] + ")";
+        if (name == "matrix-vector-multiply")
+            return "Aot::matrixVectorMultiply(" + joined() + ")";
+        if (name == "matrix-multiply")
+            return "Aot::matrixMultiply(" + joined() + ")";
+        if (name == "range")
+            return "Aot::range(" + joined() + ")";
+        if (name == "take")
+            return "Aot::take(" + joined() + ")";
+        if (name == "collect")
+            return "Aot::collect(" + args[0] + ")";
+        if (name == "sort")
+            return "Aot::sort(" + args[0] + ")";
+        if (name == "argsort")
+            return "Aot::argsort(" + args[0] + ")";
+        if (name == "top-k")
+            return "Aot::topK(" + joined() + ")";
+        if (name == "histogram")
+            return "Aot::histogram(" + joined() + ")";
+        if (name == "group-by-key")
+            return "Aot::groupByKey(" + joined() + ")";
+        if (name == "group-keys")
+            return "Aot::groupKeys(" + args[0] + ")";
+        if (name == "group-counts")
+            return "Aot::groupCounts(" + args[0] + ")";
+        if (name == "group-sums")
+            return "Aot::groupSums(" + args[0] + ")";
+        if (name == "group-means")
+            return "Aot::groupMeans(" + args[0] + ")";
+        if (name == "vector-mean")
+            return "Aot::vectorMean(" + args[0] + ")";
+        if (name == "vector-variance")
+            return "Aot::vectorVariance(" + args[0] + ")";
+        if (name == "vector-stddev")
+            return "Aot::vectorStddev(" + args[0] + ")";
+        if (name == "vector-covariance")
+            return "Aot::vectorCovariance(" + joined() + ")";
+        if (name == "vector-correlation")
+            return "Aot::vectorCorrelation(" + joined() + ")";
+        if (name == "quantile-sketch")
+            return "Aot::quantileSketch(" + args[0] + ")";
+        if (name == "distinct-sketch")
+            return "Aot::distinctSketch(" + args[0] + ")";
+        if (name == "sketch-update")
+            return "Aot::sketchUpdate(" + joined() + ")";
+        if (name == "sketch-merge")
+            return "Aot::sketchMerge(" + joined() + ")";
+        if (name == "sketch-count")
+            return "Aot::sketchCount(" + args[0] + ")";
+        if (name == "sketch-serialize")
+            return "Aot::sketchSerialize(" + args[0] + ")";
+        if (name == "sketch-quantile")
+            return "Aot::sketchQuantile(" + joined() + ")";
+        if (name == "sketch-distinct")
+            return "Aot::sketchDistinct(" + args[0] + ")";
+        if (name == "parse-quantile-sketch")
+            return "Aot::parseQuantileSketch(" + args[0] + ")";
+        if (name == "parse-distinct-sketch")
+            return "Aot::parseDistinctSketch(" + args[0] + ")";
+
+        throwError("builtin '" + name + "' is not supported by the C++ backend");
+    }
+
+    std::string CppTranspiler::emitStringLiteral(const std::string &quoted) const
+    {
+        // StringNode keeps the surrounding quotes from the source text
+        std::string content = quoted.size() >= 2 ? quoted.substr(1, quoted.size() - 2) : quoted;
+        std::string result = "std::string(\"";
+        for (char c : content)
+        {
+            switch (c)
+            {
+            case '\\':
+                result += "\\\\";
+                break;
+            case '"':
+                result += "\\\"";
+                break;
+            case '\n':
+                result += "\\n";
+                break;
+            case '\t':
+                result += "\\t";
+                break;
+            case '\r':
+                result += "\\r";
+                break;
+            default:
+                result += c;
+                break;
+            }
+        }
+        return result + "\")";
+    }
+
+    void CppTranspiler::indent(std::ostream &out) const
+    {
+        out << std::string(indentLevel_ * 4, ' ');
+    }
+
+    void CppTranspiler::throwError(const std::string &message) const
+    {
+        throw std::runtime_error("Compile error: " + message);
+    }
+
+} // namespace Shattang::MyLisp
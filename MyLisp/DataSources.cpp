@@ -0,0 +1,638 @@
+#include <Shattang/MyLisp/DataSources.h>
+
+#include <algorithm>
+#include <bit>
+#include <cctype>
+#include <cerrno>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace Shattang::MyLisp
+{
+    namespace
+    {
+        constexpr char ColumnMagic[8] = {'M', 'Y', 'L', 'C', 'O', 'L', '0', '1'};
+        constexpr std::size_t ColumnEntrySize = 64;
+        constexpr std::size_t ColumnAlignment = 64;
+        constexpr std::size_t MinimumChunk = std::size_t(1) << 20; // smaller inputs are parsed on one thread
+
+        [[noreturn]] void throwSourceError(const std::string &path, const std::string &message)
+        {
+            throw std::runtime_error("Runtime error: data source '" + path + "': " + message);
+        }
+
+        // A whole file mapped read-only; vectors viewing it hold a shared_ptr to it
+        class MappedFile
+        {
+        public:
+            explicit MappedFile(const std::string &path)
+            {
+                int fd = ::open(path.c_str(), O_RDONLY);
+                if (fd < 0)
+                {
+                    throwSourceError(path, std::strerror(errno));
+                }
+                struct stat info;
+                if (::fstat(fd, &info) != 0)
+                {
+                    int error = errno;
+                    ::close(fd);
+                    throwSourceError(path, std::strerror(error));
+                }
+                size_ = static_cast<std::size_t>(info.st_size);
+                if (size_ > 0)
+                {
+                    void *data = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+                    if (data == MAP_FAILED)
+                    {
+                        int error = errno;
+                        ::close(fd);
+                        throwSourceError(path, std::strerror(error));
+                    }
+                    // Scripts mostly scan front to back, so let the kernel read ahead
+                    ::madvise(data, size_, MADV_SEQUENTIAL);
+                    data_ = static_cast<const char *>(data);
+                }
+                ::close(fd);
+            }
+
+            ~MappedFile()
+            {
+                if (data_ != nullptr)
+                {
+                    ::munmap(const_cast<char *>(data_), size_);
+                }
+            }
+
+            MappedFile(const MappedFile &) = delete;
+            MappedFile &operator=(const MappedFile &) = delete;
+
+            const char *data() const { return data_; }
+            std::size_t size() const { return size_; }
+
+        private:
+            const char *data_ = nullptr;
+            std::size_t size_ = 0;
+        };
+
+        std::uint64_t readUint64(const char *data)
+        {
+            unsigned char bytes[8];
+            std::memcpy(bytes, data, 8);
+            std::uint64_t value = 0;
+            for (int i = 7; i >= 0; --i)
+            {
+                value = (value << 8) | bytes[i];
+            }
+            return value;
+        }
+
+        void writeUint64(std::ostream &out, std::uint64_t value)
+        {
+            char bytes[8];
+            for (char &byte : bytes)
+            {
+                byte = static_cast<char>(value & 0xff);
+                value >>= 8;
+            }
+            out.write(bytes, 8);
+        }
+
+        // `count` values starting at `data`, without copying unless the host is big-endian
+        DoubleVector viewDoubles(const std::shared_ptr<const MappedFile> &file, const char *data, std::size_t count)
+        {
+            if constexpr (std::endian::native == std::endian::little)
+            {
+                return DoubleVector::view(reinterpret_cast<const double *>(data), count, file);
+            }
+            else
+            {
+                DoubleVector result(count);
+                for (std::size_t i = 0; i < count; ++i)
+                {
+                    std::uint64_t bits = readUint64(data + i * 8);
+                    std::memcpy(&result[i], &bits, 8);
+                }
+                return result;
+            }
+        }
+
+        struct Column
+        {
+            std::string name_;
+            std::uint64_t offset_;
+            std::uint64_t count_;
+        };
+
+        std::vector<Column> readColumns(const MappedFile &file, const std::string &path)
+        {
+            if (file.size() < 16 || std::memcmp(file.data(), ColumnMagic, sizeof(ColumnMagic)) != 0)
+            {
+                throwSourceError(path, "not a columnar file");
+            }
+            std::uint64_t count = readUint64(file.data() + 8);
+            if (count > (file.size() - 16) / ColumnEntrySize)
+            {
+                throwSourceError(path, "truncated column table");
+            }
+
+            std::vector<Column> columns;
+            for (std::uint64_t i = 0; i < count; ++i)
+            {
+                const char *entry = file.data() + 16 + i * ColumnEntrySize;
+                Column column;
+                column.name_.assign(entry, strnlen(entry, ColumnNameSize + 1));
+                column.offset_ = readUint64(entry + 48);
+                column.count_ = readUint64(entry + 56);
+                if (column.offset_ % sizeof(double) != 0 || column.offset_ > file.size() ||
+                    column.count_ > (file.size() - column.offset_) / sizeof(double))
+                {
+                    throwSourceError(path, "column '" + column.name_ + "' lies outside the file");
+                }
+                columns.push_back(std::move(column));
+            }
+            return columns;
+        }
+
+        // An open file read with pread; streams over it share it
+        class ReadFile
+        {
+        public:
+            explicit ReadFile(const std::string &path) : path_(path)
+            {
+                fd_ = ::open(path.c_str(), O_RDONLY);
+                if (fd_ < 0)
+                {
+                    throwSourceError(path, std::strerror(errno));
+                }
+                struct stat info;
+                if (::fstat(fd_, &info) != 0)
+                {
+                    int error = errno;
+                    ::close(fd_);
+                    throwSourceError(path, std::strerror(error));
+                }
+                size_ = static_cast<std::size_t>(info.st_size);
+                ::posix_fadvise(fd_, 0, 0, POSIX_FADV_SEQUENTIAL);
+            }
+
+            ~ReadFile() { ::close(fd_); }
+
+            ReadFile(const ReadFile &) = delete;
+            ReadFile &operator=(const ReadFile &) = delete;
+
+            std::size_t size() const { return size_; }
+
+            // `count` values starting at byte `offset`, and a hint to read the next range ahead
+            void readDoubles(std::size_t offset, std::size_t count, double *out) const
+            {
+                char *bytes = reinterpret_cast<char *>(out);
+                std::size_t remaining = count * sizeof(double);
+                std::size_t position = offset;
+                while (remaining > 0)
+                {
+                    ssize_t n = ::pread(fd_, bytes, remaining, static_cast<off_t>(position));
+                    if (n < 0 && errno == EINTR)
+                    {
+                        continue;
+                    }
+                    if (n <= 0)
+                    {
+                        throwSourceError(path_, n < 0 ? std::strerror(errno) : "file shrank while it was read");
+                    }
+                    bytes += n;
+                    position += static_cast<std::size_t>(n);
+                    remaining -= static_cast<std::size_t>(n);
+                }
+                ::posix_fadvise(fd_, static_cast<off_t>(position), static_cast<off_t>(count * sizeof(double)),
+                                POSIX_FADV_WILLNEED);
+                if constexpr (std::endian::native != std::endian::little)
+                {
+                    for (std::size_t i = 0; i < count; ++i)
+                    {
+                        std::uint64_t bits = readUint64(reinterpret_cast<const char *>(out + i));
+                        std::memcpy(out + i, &bits, 8);
+                    }
+                }
+            }
+
+        private:
+            std::string path_;
+            int fd_ = -1;
+            std::size_t size_ = 0;
+        };
+
+        std::shared_ptr<VectorStream> streamDoubles(const std::string &path, std::shared_ptr<const ReadFile> file,
+                                                    std::size_t offset, std::size_t count,
+                                                    std::shared_ptr<StreamBufferPool> pool)
+        {
+            return std::make_shared<VectorStream>(
+                path, count, [file = std::move(file), offset](std::size_t first, std::size_t n, double *out)
+                { file->readDoubles(offset + first * sizeof(double), n, out); },
+                std::move(pool));
+        }
+
+        // How DataSources reads a name: the spec it was added with, split into its parts
+        struct SourceSpec
+        {
+            std::string spec_;
+            std::string path_;
+            std::string selector_; // after '#'
+            std::string extension_; // lower case
+
+            bool isDoubleFile() const { return (extension_ == "f64" || extension_ == "bin") && selector_.empty(); }
+            bool isColumn() const { return extension_ == "mlc" && !selector_.empty(); }
+        };
+
+        SourceSpec parseSpec(const std::string &name, const std::unordered_map<std::string, std::string> &specs)
+        {
+            auto it = specs.find(name);
+            SourceSpec source;
+            source.spec_ = it != specs.end() ? it->second : name;
+
+            std::size_t hash = source.spec_.rfind('#');
+            source.path_ = source.spec_.substr(0, hash);
+            source.selector_ = hash == std::string::npos ? "" : source.spec_.substr(hash + 1);
+            std::size_t dot = source.path_.rfind('.');
+            source.extension_ = dot == std::string::npos ? "" : source.path_.substr(dot + 1);
+            std::transform(source.extension_.begin(), source.extension_.end(), source.extension_.begin(),
+                           [](unsigned char c)
+                           { return static_cast<char>(std::tolower(c)); });
+            return source;
+        }
+
+        [[noreturn]] void throwUnknownSource(const std::string &name)
+        {
+            throw std::runtime_error("Runtime error: unknown data source '" + name +
+                                     "' (expected a .f64, .bin, .mlc#column, .csv, .tsv or .txt file)");
+        }
+
+        const Column &findColumn(const std::vector<Column> &columns, const std::string &path, const std::string &column)
+        {
+            for (const auto &entry : columns)
+            {
+                if (entry.name_ == column)
+                {
+                    return entry;
+                }
+            }
+            std::string available;
+            for (const auto &entry : columns)
+            {
+                available += (available.empty() ? "" : ", ") + entry.name_;
+            }
+            throwSourceError(path, "no column '" + column + "' (has " + (available.empty() ? "none" : available) + ")");
+        }
+
+        bool isSpace(char c)
+        {
+            return c == ' ' || c == '\t' || c == '\r';
+        }
+
+        // The outcome of parsing part of a text; on failure, where and what the bad field was
+        struct ParsedChunk
+        {
+            DoubleVector values_;
+            const char *error_ = nullptr;
+            std::string message_;
+        };
+
+        bool parseField(const char *first, const char *last, DoubleVector &values)
+        {
+            if (first != last && *first == '+')
+            {
+                ++first;
+            }
+            double value = 0.0;
+            auto [end, error] = std::from_chars(first, last, value);
+            if (error != std::errc() || end != last)
+            {
+                return false;
+            }
+            values.push(value);
+            return true;
+        }
+
+        // Parses the lines in [first, last), which starts at the beginning of a line
+        void parseLines(const char *first, const char *last, const TextOptions &options, ParsedChunk &chunk)
+        {
+            bool splitOnSpace = isSpace(options.delimiter_);
+            const char *line = first;
+            while (line < last && chunk.error_ == nullptr)
+            {
+                const char *lineEnd = std::find(line, last, '\n');
+                long field = 0;
+                bool selected = false;
+                const char *p = line;
+                while (p < lineEnd)
+                {
+                    while (p < lineEnd && isSpace(*p))
+                    {
+                        ++p;
+                    }
+                    if (p == lineEnd)
+                    {
+                        break;
+                    }
+                    const char *fieldStart = p;
+                    while (p < lineEnd && *p != options.delimiter_ && !(isSpace(*p) && (splitOnSpace || options.column_ < 0)))
+                    {
+                        ++p;
+                    }
+                    const char *fieldEnd = p;
+                    while (fieldEnd > fieldStart && isSpace(fieldEnd[-1]))
+                    {
+                        --fieldEnd;
+                    }
+                    // Step over trailing spaces and one delimiter
+                    while (p < lineEnd && isSpace(*p) && !splitOnSpace)
+                    {
+                        ++p;
+                    }
+                    if (p < lineEnd && *p == options.delimiter_)
+                    {
+                        ++p;
+                    }
+
+                    if (options.column_ < 0 || field == options.column_)
+                    {
+                        if (fieldStart != fieldEnd && !parseField(fieldStart, fieldEnd, chunk.values_))
+                        {
+                            chunk.error_ = fieldStart;
+                            chunk.message_ = "'" + std::string(fieldStart, fieldEnd) + "' is not a number";
+                            return;
+                        }
+                        selected = selected || fieldStart != fieldEnd;
+                    }
+                    ++field;
+                }
+                if (options.column_ >= 0 && field > 0 && !selected)
+                {
+                    chunk.error_ = line;
+                    chunk.message_ = "no value in field " + std::to_string(options.column_);
+                    return;
+                }
+                line = lineEnd + 1;
+            }
+        }
+
+        DoubleVector parseText(std::string_view text, const TextOptions &options, const std::string &source)
+        {
+            const char *first = text.data();
+            const char *last = text.data() + text.size();
+
+            // Skip a header line, recognized by not parsing
+            const char *firstLineEnd = std::find(first, last, '\n');
+            ParsedChunk header;
+            parseLines(first, firstLineEnd, options, header);
+            if (header.error_ != nullptr)
+            {
+                first = firstLineEnd == last ? last : firstLineEnd + 1;
+            }
+
+            std::size_t threads = options.threads_ != 0 ? options.threads_ : std::max(1u, std::thread::hardware_concurrency());
+            threads = std::max<std::size_t>(1, std::min(threads, static_cast<std::size_t>(last - first) / MinimumChunk));
+
+            // Chunk boundaries, moved forward to the start of a line
+            std::vector<const char *> bounds{first};
+            for (std::size_t i = 1; i < threads; ++i)
+            {
+                const char *bound = first + (last - first) * i / threads;
+                bound = std::max(bound, bounds.back());
+                bound = std::find(bound, last, '\n');
+                bounds.push_back(bound == last ? last : bound + 1);
+            }
+            bounds.push_back(last);
+
+            std::vector<ParsedChunk> chunks(threads);
+            std::vector<std::thread> workers;
+            for (std::size_t i = 1; i < threads; ++i)
+            {
+                workers.emplace_back([&, i]()
+                                     { parseLines(bounds[i], bounds[i + 1], options, chunks[i]); });
+            }
+            parseLines(bounds[0], bounds[1], options, chunks[0]);
+            for (auto &worker : workers)
+            {
+                worker.join();
+            }
+
+            std::size_t total = 0;
+            for (const auto &chunk : chunks)
+            {
+                if (chunk.error_ != nullptr)
+                {
+                    long line = 1 + std::count(text.data(), chunk.error_, '\n');
+                    throw std::runtime_error("Runtime error: " + source + " line " + std::to_string(line) + ": " +
+                                             chunk.message_);
+                }
+                total += chunk.values_.size();
+            }
+            if (chunks.size() == 1)
+            {
+                return std::move(chunks[0].values_);
+            }
+            DoubleVector result;
+            result.reserve(total);
+            for (const auto &chunk : chunks)
+            {
+                result.append(chunk.values_.data(), chunk.values_.size());
+            }
+            return result;
+        }
+    }
+
+    DoubleVector mapDoubleFile(const std::string &path)
+    {
+        auto file = std::make_shared<const MappedFile>(path);
+        if (file->size() % sizeof(double) != 0)
+        {
+            throwSourceError(path, "size " + std::to_string(file->size()) + " is not a multiple of 8 bytes");
+        }
+        return viewDoubles(file, file->data(), file->size() / sizeof(double));
+    }
+
+    DoubleVector mapColumn(const std::string &path, const std::string &column)
+    {
+        auto file = std::make_shared<const MappedFile>(path);
+        Column entry = findColumn(readColumns(*file, path), path, column);
+        return viewDoubles(file, file->data() + entry.offset_, entry.count_);
+    }
+
+    std::shared_ptr<VectorStream> streamDoubleFile(const std::string &path, std::shared_ptr<StreamBufferPool> pool)
+    {
+        auto file = std::make_shared<const ReadFile>(path);
+        if (file->size() % sizeof(double) != 0)
+        {
+            throwSourceError(path, "size " + std::to_string(file->size()) + " is not a multiple of 8 bytes");
+        }
+        std::size_t count = file->size() / sizeof(double);
+        return streamDoubles(path, std::move(file), 0, count, std::move(pool));
+    }
+
+    std::shared_ptr<VectorStream> streamColumn(const std::string &path, const std::string &column,
+                                               std::shared_ptr<StreamBufferPool> pool)
+    {
+        // Mapping only touches the pages of the column table
+        Column entry = findColumn(readColumns(MappedFile(path), path), path, column);
+        return streamDoubles(path + "#" + column, std::make_shared<const ReadFile>(path), entry.offset_, entry.count_,
+                             std::move(pool));
+    }
+
+    void prefetchPages(const DoubleVector &vector)
+    {
+        if (!vector.isView() || vector.empty())
+        {
+            return;
+        }
+        const char *first = reinterpret_cast<const char *>(vector.data());
+        std::size_t bytes = vector.size() * sizeof(double);
+        std::size_t page = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+
+        // Start read-ahead of the whole range, then wait for it page by page
+        std::uintptr_t start = reinterpret_cast<std::uintptr_t>(first) / page * page;
+        ::madvise(reinterpret_cast<void *>(start), bytes + (reinterpret_cast<std::uintptr_t>(first) - start), MADV_WILLNEED);
+        char touched = 0;
+        for (std::size_t offset = 0; offset < bytes; offset += page)
+        {
+            touched = static_cast<char>(touched ^ first[offset]);
+        }
+        // Keeps the loads without storing anything; only the compiler sees this
+        asm volatile("" : : "r"(touched));
+    }
+
+    std::vector<std::string> columnNames(const std::string &path)
+    {
+        MappedFile file(path);
+        std::vector<std::string> names;
+        for (auto &column : readColumns(file, path))
+        {
+            names.push_back(std::move(column.name_));
+        }
+        return names;
+    }
+
+    void writeColumnFile(const std::string &path, const std::vector<std::pair<std::string, const DoubleVector *>> &columns)
+    {
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        if (!out)
+        {
+            throwSourceError(path, "cannot be created");
+        }
+        auto align = [](std::uint64_t offset)
+        {
+            return (offset + ColumnAlignment - 1) / ColumnAlignment * ColumnAlignment;
+        };
+
+        out.write(ColumnMagic, sizeof(ColumnMagic));
+        writeUint64(out, columns.size());
+        std::uint64_t offset = align(16 + columns.size() * ColumnEntrySize);
+        for (const auto &[name, vector] : columns)
+        {
+            if (name.size() > ColumnNameSize)
+            {
+                throwSourceError(path, "column name '" + name + "' is longer than " + std::to_string(ColumnNameSize));
+            }
+            char entryName[48] = {};
+            std::memcpy(entryName, name.data(), name.size());
+            out.write(entryName, sizeof(entryName));
+            writeUint64(out, offset);
+            writeUint64(out, vector->size());
+            offset = align(offset + vector->size() * sizeof(double));
+        }
+
+        std::uint64_t position = 16 + columns.size() * ColumnEntrySize;
+        static const char padding[ColumnAlignment] = {};
+        for (const auto &[name, vector] : columns)
+        {
+            out.write(padding, static_cast<std::streamsize>(align(position) - position));
+            position = align(position);
+            for (double value : *vector)
+            {
+                std::uint64_t bits;
+                std::memcpy(&bits, &value, sizeof(bits));
+                writeUint64(out, bits);
+            }
+            position += vector->size() * sizeof(double);
+        }
+        if (!out.flush())
+        {
+            throwSourceError(path, "write failed");
+        }
+    }
+
+    DoubleVector parseNumberText(std::string_view text, const TextOptions &options)
+    {
+        return parseText(text, options, "text");
+    }
+
+    DoubleVector loadNumberText(const std::string &path, const TextOptions &options)
+    {
+        MappedFile file(path);
+        return parseText(std::string_view(file.data(), file.size()), options, "data source '" + path + "'");
+    }
+
+    void DataSources::add(const std::string &name, const std::string &spec)
+    {
+        specs_[name] = spec;
+    }
+
+    DoubleVector DataSources::open(const std::string &name) const
+    {
+        SourceSpec source = parseSpec(name, specs_);
+        if (source.isDoubleFile())
+        {
+            return mapDoubleFile(source.path_);
+        }
+        if (source.isColumn())
+        {
+            return mapColumn(source.path_, source.selector_);
+        }
+        if (source.extension_ == "csv" || source.extension_ == "tsv" || source.extension_ == "txt")
+        {
+            TextOptions options;
+            options.delimiter_ = source.extension_ == "tsv" ? '\t' : ',';
+            if (!source.selector_.empty())
+            {
+                const std::string &selector = source.selector_;
+                auto [end, error] = std::from_chars(selector.data(), selector.data() + selector.size(), options.column_);
+                if (error != std::errc() || end != selector.data() + selector.size() || options.column_ < 0)
+                {
+                    throwSourceError(source.spec_, "'" + selector + "' is not a field number");
+                }
+            }
+            return loadNumberText(source.path_, options);
+        }
+        throwUnknownSource(name);
+    }
+
+    std::shared_ptr<VectorStream> DataSources::openStream(const std::string &name,
+                                                          std::shared_ptr<StreamBufferPool> pool) const
+    {
+        SourceSpec source = parseSpec(name, specs_);
+        if (source.isDoubleFile())
+        {
+            return streamDoubleFile(source.path_, std::move(pool));
+        }
+        if (source.isColumn())
+        {
+            return streamColumn(source.path_, source.selector_, std::move(pool));
+        }
+        if (source.extension_ == "csv" || source.extension_ == "tsv" || source.extension_ == "txt")
+        {
+            return nullptr;
+        }
+        throwUnknownSource(name);
+    }
+
+} // namespace Shattang::MyLisp
@@ -0,0 +1,242 @@
+#include <Shattang/MyLisp/DoubleMatrix.h>
+#include <Shattang/MyLisp/ThreadPool.h>
+#include <Shattang/MyLisp/VectorKernels.h>
+
+#include <algorithm>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace Shattang::MyLisp
+{
+    namespace
+    {
+        using Kernels::TileColumns;
+        using Kernels::TileRows;
+
+        // Jobs that touch fewer elements than this run on the calling thread
+        constexpr std::size_t ParallelThreshold = 64 * 1024;
+
+        // Blocking of matrixMultiply(). A packed panel of lhs, RowBlock x DepthBlock, takes 128 KB
+        // and stays in L2; a packed panel of rhs, DepthBlock x ColumnBlock, takes 2 MB and is shared
+        // by every thread from L3.
+        constexpr std::size_t DepthBlock = 256;
+        constexpr std::size_t RowBlock = 64;
+        constexpr std::size_t ColumnBlock = 1024;
+        static_assert(RowBlock % TileRows == 0 && ColumnBlock % TileColumns == 0);
+
+        // Square blocks of matrixTranspose(), small enough that the rows read and written stay in L1
+        constexpr std::size_t TransposeBlock = 32;
+
+        std::string dimensions(const DoubleMatrix &matrix)
+        {
+            return std::to_string(matrix.rows()) + "x" + std::to_string(matrix.columns());
+        }
+
+        // Runs task(0) .. task(count - 1), on the compute pool if `work` elements are worth it
+        void forEachTask(std::size_t count, std::size_t work, const std::function<void(std::size_t)> &task)
+        {
+            if (work < ParallelThreshold)
+            {
+                for (std::size_t i = 0; i < count; ++i)
+                {
+                    task(i);
+                }
+                return;
+            }
+            computePool().parallelFor(count, task);
+        }
+
+        // Copies rows [first, first + count) and columns [depth, depth + depthCount) of `lhs` into
+        // panels of TileRows rows, each stored column by column and padded with zeros
+        void packLhs(const DoubleMatrix &lhs, std::size_t first, std::size_t count, std::size_t depth,
+                     std::size_t depthCount, double *out)
+        {
+            for (std::size_t panel = 0; panel < count; panel += TileRows)
+            {
+                for (std::size_t p = 0; p < depthCount; ++p)
+                {
+                    for (std::size_t r = 0; r < TileRows; ++r)
+                    {
+                        *out++ = panel + r < count ? lhs(first + panel + r, depth + p) : 0.0;
+                    }
+                }
+            }
+        }
+
+        // Copies rows [depth, depth + depthCount) and columns [first, first + count) of `rhs` into
+        // panels of TileColumns columns, each stored row by row and padded with zeros
+        void packRhs(const DoubleMatrix &rhs, std::size_t depth, std::size_t depthCount, std::size_t first,
+                     std::size_t count, double *out)
+        {
+            for (std::size_t panel = 0; panel < count; panel += TileColumns)
+            {
+                std::size_t width = std::min(TileColumns, count - panel);
+                for (std::size_t p = 0; p < depthCount; ++p)
+                {
+                    const double *row = rhs.row(depth + p) + first + panel;
+                    std::copy(row, row + width, out);
+                    std::fill(out + width, out + TileColumns, 0.0);
+                    out += TileColumns;
+                }
+            }
+        }
+    }
+
+    DoubleMatrix::DoubleMatrix(std::size_t rows, std::size_t columns, double value)
+        : rows_(rows), columns_(columns), elements_(rows * columns, value)
+    {
+    }
+
+    DoubleMatrix::DoubleMatrix(std::size_t rows, std::size_t columns, DoubleVector elements)
+        : rows_(rows), columns_(columns), elements_(std::move(elements))
+    {
+        bool fits = columns_ == 0 ? elements_.empty()
+                                  : elements_.size() % columns_ == 0 && elements_.size() / columns_ == rows_;
+        if (!fits)
+        {
+            throw std::runtime_error("Runtime error: a " + dimensions(*this) + " matrix needs " +
+                                     std::to_string(rows_ * columns_) + " elements, got " +
+                                     std::to_string(elements_.size()));
+        }
+    }
+
+    double DoubleMatrix::at(long row, long column) const
+    {
+        if (row < 0 || column < 0 || static_cast<std::size_t>(row) >= rows_ || static_cast<std::size_t>(column) >= columns_)
+        {
+            throw std::runtime_error("Runtime error: matrix-ref index (" + std::to_string(row) + ", " +
+                                     std::to_string(column) + ") out of range for a " + dimensions(*this) + " matrix");
+        }
+        return (*this)(row, column);
+    }
+
+    bool DoubleMatrix::operator==(const DoubleMatrix &other) const
+    {
+        return rows_ == other.rows_ && columns_ == other.columns_ && elements_ == other.elements_;
+    }
+
+    DoubleMatrix makeDoubleMatrix(long rows, long columns, DoubleVector elements)
+    {
+        if (rows < 0 || columns < 0)
+        {
+            throw std::runtime_error("Runtime error: 'make-double-matrix' dimensions must not be negative, got " +
+                                     std::to_string(rows) + "x" + std::to_string(columns));
+        }
+        return DoubleMatrix(static_cast<std::size_t>(rows), static_cast<std::size_t>(columns), std::move(elements));
+    }
+
+    DoubleMatrix matrixTranspose(const DoubleMatrix &matrix)
+    {
+        std::size_t rows = matrix.rows();
+        std::size_t columns = matrix.columns();
+        DoubleVector result(rows * columns);
+        // Task `band` writes rows [band * TransposeBlock, ..) of the result
+        std::size_t bands = (columns + TransposeBlock - 1) / TransposeBlock;
+        forEachTask(bands, rows * columns, [&matrix, &result, rows, columns](std::size_t band)
+                    {
+            std::size_t firstColumn = band * TransposeBlock;
+            std::size_t lastColumn = std::min(columns, firstColumn + TransposeBlock);
+            for (std::size_t firstRow = 0; firstRow < rows; firstRow += TransposeBlock)
+            {
+                std::size_t lastRow = std::min(rows, firstRow + TransposeBlock);
+                for (std::size_t column = firstColumn; column < lastColumn; ++column)
+                {
+                    for (std::size_t row = firstRow; row < lastRow; ++row)
+                    {
+                        result[column * rows + row] = matrix(row, column);
+                    }
+                }
+            } });
+        return DoubleMatrix(columns, rows, std::move(result));
+    }
+
+    DoubleVector matrixVectorMultiply(const DoubleMatrix &matrix, const DoubleVector &vector)
+    {
+        if (matrix.columns() != vector.size())
+        {
+            throw std::runtime_error("Runtime error: 'matrix-vector-multiply' needs a vector of length " +
+                                     std::to_string(matrix.columns()) + " for a " + dimensions(matrix) +
+                                     " matrix, got " + std::to_string(vector.size()));
+        }
+        DoubleVector result(matrix.rows());
+        // Each task takes about ParallelThreshold elements, in whole rows
+        std::size_t rowsPerTask = std::max<std::size_t>(1, ParallelThreshold / std::max<std::size_t>(1, matrix.columns()));
+        std::size_t tasks = (matrix.rows() + rowsPerTask - 1) / rowsPerTask;
+        forEachTask(tasks, matrix.elements().size(), [&matrix, &vector, &result, rowsPerTask](std::size_t task)
+                    {
+            std::size_t last = std::min(matrix.rows(), (task + 1) * rowsPerTask);
+            for (std::size_t row = task * rowsPerTask; row < last; ++row)
+            {
+                result[row] = Kernels::dot(matrix.row(row), vector.data(), matrix.columns());
+            } });
+        return result;
+    }
+
+    DoubleMatrix matrixMultiply(const DoubleMatrix &lhs, const DoubleMatrix &rhs)
+    {
+        if (lhs.columns() != rhs.rows())
+        {
+            throw std::runtime_error("Runtime error: 'matrix-multiply' needs the columns of the first matrix to match "
+                                     "the rows of the second, got " +
+                                     dimensions(lhs) + " and " + dimensions(rhs));
+        }
+        std::size_t rows = lhs.rows();
+        std::size_t columns = rhs.columns();
+        std::size_t depth = lhs.columns();
+        DoubleVector result(rows * columns);
+        // Panels are padded to whole tiles
+        std::size_t paddedColumns = (std::min(ColumnBlock, columns) + TileColumns - 1) / TileColumns * TileColumns;
+        std::size_t paddedRows = (std::min(RowBlock, rows) + TileRows - 1) / TileRows * TileRows;
+        std::vector<double> packedRhs(std::min(DepthBlock, depth) * paddedColumns);
+        std::size_t rowBlocks = (rows + RowBlock - 1) / RowBlock;
+        std::size_t work = rows * columns * depth;
+
+        for (std::size_t firstColumn = 0; firstColumn < columns; firstColumn += ColumnBlock)
+        {
+            std::size_t columnCount = std::min(ColumnBlock, columns - firstColumn);
+            // Every element sums its DepthBlock slices in this order, whatever thread runs its rows
+            for (std::size_t firstDepth = 0; firstDepth < depth; firstDepth += DepthBlock)
+            {
+                std::size_t depthCount = std::min(DepthBlock, depth - firstDepth);
+                packRhs(rhs, firstDepth, depthCount, firstColumn, columnCount, packedRhs.data());
+                forEachTask(rowBlocks, work, [&, firstColumn, columnCount, firstDepth, depthCount](std::size_t block)
+                            {
+                    std::size_t firstRow = block * RowBlock;
+                    std::size_t rowCount = std::min(RowBlock, rows - firstRow);
+                    std::vector<double> packedLhs(paddedRows * depthCount);
+                    packLhs(lhs, firstRow, rowCount, firstDepth, depthCount, packedLhs.data());
+                    for (std::size_t panel = 0; panel < columnCount; panel += TileColumns)
+                    {
+                        const double *rhsPanel = packedRhs.data() + panel * depthCount;
+                        std::size_t width = std::min(TileColumns, columnCount - panel);
+                        for (std::size_t tile = 0; tile < rowCount; tile += TileRows)
+                        {
+                            const double *lhsPanel = packedLhs.data() + tile * depthCount;
+                            std::size_t height = std::min(TileRows, rowCount - tile);
+                            double *out = result.data() + (firstRow + tile) * columns + firstColumn + panel;
+                            if (width == TileColumns && height == TileRows)
+                            {
+                                Kernels::multiplyTile(lhsPanel, rhsPanel, depthCount, out, columns);
+                                continue;
+                            }
+                            // Edge tiles are computed in full and only their valid part added
+                            double edge[TileRows * TileColumns] = {};
+                            Kernels::multiplyTile(lhsPanel, rhsPanel, depthCount, edge, TileColumns);
+                            for (std::size_t r = 0; r < height; ++r)
+                            {
+                                for (std::size_t c = 0; c < width; ++c)
+                                {
+                                    out[r * columns + c] += edge[r * TileColumns + c];
+                                }
+                            }
+                        }
+                    } });
+            }
+        }
+        return DoubleMatrix(rows, columns, std::move(result));
+    }
+
+} // namespace Shattang::MyLisp
@@ -0,0 +1,275 @@
+#include <Shattang/MyLisp/DoubleVector.h>
+#include <Shattang/MyLisp/Memory.h>
+#include <Shattang/MyLisp/VectorKernels.h>
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+namespace Shattang::MyLisp
+{
+    namespace
+    {
+        // Buffers come from the runtime pool, so short vectors made and dropped in a loop reuse
+        // the same few blocks
+        double *allocate(std::size_t capacity)
+        {
+            return static_cast<double *>(runtimePool().allocate(capacity * sizeof(double), DoubleVector::Alignment));
+        }
+
+        void deallocate(double *data, std::size_t capacity)
+        {
+            if (data != nullptr)
+            {
+                runtimePool().deallocate(data, capacity * sizeof(double), DoubleVector::Alignment);
+            }
+        }
+
+        void expectSameLength(const char *name, const DoubleVector &lhs, const DoubleVector &rhs)
+        {
+            if (lhs.size() != rhs.size())
+            {
+                throw std::runtime_error(std::string("Runtime error: '") + name + "' needs vectors of equal length, got " +
+                                         std::to_string(lhs.size()) + " and " + std::to_string(rhs.size()));
+            }
+        }
+
+        void expectNotEmpty(const char *name, const DoubleVector &vector)
+        {
+            if (vector.empty())
+            {
+                throw std::runtime_error(std::string("Runtime error: '") + name + "' of an empty vector");
+            }
+        }
+
+        template <typename Kernel>
+        DoubleVector elementWise(const char *name, const DoubleVector &lhs, const DoubleVector &rhs, Kernel kernel)
+        {
+            expectSameLength(name, lhs, rhs);
+            DoubleVector result(lhs.size());
+            kernel(lhs.data(), rhs.data(), result.data(), lhs.size());
+            return result;
+        }
+    }
+
+    DoubleVector::DoubleVector(std::size_t size, double value)
+    {
+        resize(size, value);
+    }
+
+    DoubleVector::DoubleVector(std::initializer_list<double> values)
+        : DoubleVector(values.begin(), values.end()) {}
+
+    DoubleVector::DoubleVector(const double *first, const double *last)
+    {
+        std::size_t count = static_cast<std::size_t>(last - first);
+        reserve(count);
+        std::copy(first, last, data_);
+        size_ = count;
+    }
+
+    DoubleVector DoubleVector::view(const double *data, std::size_t size, std::shared_ptr<const void> owner)
+    {
+        DoubleVector result;
+        result.data_ = const_cast<double *>(data);
+        result.size_ = size;
+        result.owner_ = std::move(owner);
+        return result;
+    }
+
+    DoubleVector::DoubleVector(const DoubleVector &other)
+    {
+        if (other.isView())
+        {
+            data_ = other.data_;
+            size_ = other.size_;
+            owner_ = other.owner_;
+            return;
+        }
+        reserve(other.size_);
+        std::copy(other.begin(), other.end(), data_);
+        size_ = other.size_;
+    }
+
+    DoubleVector::DoubleVector(DoubleVector &&other) noexcept
+        : data_(std::exchange(other.data_, nullptr)),
+          size_(std::exchange(other.size_, 0)),
+          capacity_(std::exchange(other.capacity_, 0)),
+          owner_(std::move(other.owner_)) {}
+
+    DoubleVector &DoubleVector::operator=(const DoubleVector &other)
+    {
+        if (this != &other)
+        {
+            DoubleVector copy(other);
+            *this = std::move(copy);
+        }
+        return *this;
+    }
+
+    DoubleVector &DoubleVector::operator=(DoubleVector &&other) noexcept
+    {
+        if (this != &other)
+        {
+            if (!isView())
+            {
+                deallocate(data_, capacity_);
+            }
+            data_ = std::exchange(other.data_, nullptr);
+            size_ = std::exchange(other.size_, 0);
+            capacity_ = std::exchange(other.capacity_, 0);
+            owner_ = std::move(other.owner_);
+        }
+        return *this;
+    }
+
+    DoubleVector::~DoubleVector()
+    {
+        if (!isView())
+        {
+            deallocate(data_, capacity_);
+        }
+    }
+
+    double DoubleVector::at(long index) const
+    {
+        if (index < 0 || static_cast<std::size_t>(index) >= size_)
+        {
+            throw std::runtime_error("Runtime error: vector-ref index " + std::to_string(index) +
+                                     " out of range for length " + std::to_string(size_));
+        }
+        return data_[index];
+    }
+
+    void DoubleVector::append(const double *values, std::size_t count)
+    {
+        if (size_ + count > capacity_)
+        {
+            grow(size_ + count);
+        }
+        std::copy(values, values + count, data_ + size_);
+        size_ += count;
+    }
+
+    void DoubleVector::reserve(std::size_t capacity)
+    {
+        if (capacity <= capacity_)
+        {
+            return;
+        }
+        double *data = allocate(capacity);
+        std::copy(data_, data_ + size_, data);
+        if (isView())
+        {
+            owner_.reset();
+        }
+        else
+        {
+            deallocate(data_, capacity_);
+        }
+        data_ = data;
+        capacity_ = capacity;
+    }
+
+    void DoubleVector::resize(std::size_t size, double value)
+    {
+        reserve(size);
+        if (size > size_)
+        {
+            std::fill(data_ + size_, data_ + size, value);
+        }
+        size_ = size;
+    }
+
+    bool DoubleVector::operator==(const DoubleVector &other) const
+    {
+        return std::equal(begin(), end(), other.begin(), other.end());
+    }
+
+    void DoubleVector::grow(std::size_t minimumCapacity)
+    {
+        // One cache line to start with, then doubling
+        std::size_t initial = Alignment / sizeof(double);
+        reserve(std::max({minimumCapacity, capacity_ * 2, initial}));
+    }
+
+    bool forIndicesInRange(long start, long end, long step, long minOffset, long maxOffset, std::size_t size)
+    {
+        long lowest = start;
+        long highest = start;
+        // Unsigned arithmetic keeps the distance exact for any pair of bounds
+        if (step > 0)
+        {
+            if (start > end)
+            {
+                return true;
+            }
+            unsigned long span = static_cast<unsigned long>(end) - static_cast<unsigned long>(start);
+            unsigned long stride = static_cast<unsigned long>(step);
+            highest = static_cast<long>(static_cast<unsigned long>(start) + span / stride * stride);
+        }
+        else
+        {
+            if (start < end)
+            {
+                return true;
+            }
+            unsigned long span = static_cast<unsigned long>(start) - static_cast<unsigned long>(end);
+            unsigned long stride = 0UL - static_cast<unsigned long>(step);
+            lowest = static_cast<long>(static_cast<unsigned long>(start) - span / stride * stride);
+        }
+        return lowest >= -minOffset && highest < static_cast<long>(size) - maxOffset;
+    }
+
+    DoubleVector vectorAdd(const DoubleVector &lhs, const DoubleVector &rhs)
+    {
+        return elementWise("vector-add", lhs, rhs, Kernels::add);
+    }
+
+    DoubleVector vectorSubtract(const DoubleVector &lhs, const DoubleVector &rhs)
+    {
+        return elementWise("vector-subtract", lhs, rhs, Kernels::subtract);
+    }
+
+    DoubleVector vectorMultiply(const DoubleVector &lhs, const DoubleVector &rhs)
+    {
+        return elementWise("vector-multiply", lhs, rhs, Kernels::multiply);
+    }
+
+    DoubleVector vectorDivide(const DoubleVector &lhs, const DoubleVector &rhs)
+    {
+        return elementWise("vector-divide", lhs, rhs, Kernels::divide);
+    }
+
+    DoubleVector vectorScale(const DoubleVector &vector, double factor)
+    {
+        DoubleVector result(vector.size());
+        Kernels::scale(vector.data(), factor, result.data(), vector.size());
+        return result;
+    }
+
+    double vectorDot(const DoubleVector &lhs, const DoubleVector &rhs)
+    {
+        expectSameLength("vector-dot", lhs, rhs);
+        return Kernels::dot(lhs.data(), rhs.data(), lhs.size());
+    }
+
+    double vectorSum(const DoubleVector &vector)
+    {
+        return Kernels::sum(vector.data(), vector.size());
+    }
+
+    double vectorMin(const DoubleVector &vector)
+    {
+        expectNotEmpty("vector-min", vector);
+        return Kernels::min(vector.data(), vector.size());
+    }
+
+    double vectorMax(const DoubleVector &vector)
+    {
+        expectNotEmpty("vector-max", vector);
+        return Kernels::max(vector.data(), vector.size());
+    }
+
+} // namespace Shattang::MyLisp
@@ -0,0 +1,53 @@
+#include <Shattang/MyLisp/Environment.h>
+
+#include <stdexcept>
+#include <tuple>
+#include <utility>
+
+namespace Shattang::MyLisp
+{
+    Environment::Environment(Environment *parent) : variables_(&arena_), parent_(parent) {}
+
+    Value &Environment::define(const std::string &name, Value value)
+    {
+        auto it = variables_.find(std::string_view(name));
+        if (it != variables_.end())
+        {
+            it->second = std::move(value);
+            return it->second;
+        }
+        // The key is built with the table's allocator, so its text is in the arena too
+        return variables_.emplace(std::piecewise_construct, std::forward_as_tuple(name.data(), name.size()),
+                                  std::forward_as_tuple(std::move(value)))
+            .first->second;
+    }
+
+    Value *Environment::find(const std::string &name)
+    {
+        for (Environment *env = this; env != nullptr; env = env->parent_)
+        {
+            if (Value *value = env->findLocal(name))
+            {
+                return value;
+            }
+        }
+        return nullptr;
+    }
+
+    Value *Environment::findLocal(const std::string &name)
+    {
+        auto it = variables_.find(std::string_view(name));
+        return it == variables_.end() ? nullptr : &it->second;
+    }
+
+    Value &Environment::get(const std::string &name)
+    {
+        Value *value = find(name);
+        if (value == nullptr)
+        {
+            throw std::runtime_error("Runtime error: undefined variable '" + name + "'");
+        }
+        return *value;
+    }
+
+} // namespace Shattang::MyLisp
@@ -0,0 +1,153 @@
+#include <Shattang/MyLisp/FlatParser.h>
+
+#include <charconv>
+#include <sstream>
+#include <stdexcept>
+
+namespace Shattang::MyLisp
+{
+    namespace
+    {
+        std::vector<int> childrenOf(std::span<const FlatNode> nodes, int index)
+        {
+            std::vector<int> children;
+            for (int child = nodes[index].firstChild_; child >= 0; child = nodes[child].nextSibling_)
+            {
+                children.push_back(child);
+            }
+            return children;
+        }
+
+        std::unique_ptr<ASTNode> buildNode(std::span<const FlatNode> nodes, int index);
+
+        std::vector<std::unique_ptr<ASTNode>> buildNodes(std::span<const FlatNode> nodes, const std::vector<int> &indices, std::size_t from)
+        {
+            std::vector<std::unique_ptr<ASTNode>> result;
+            for (std::size_t i = from; i < indices.size(); ++i)
+            {
+                result.push_back(buildNode(nodes, indices[i]));
+            }
+            return result;
+        }
+
+        std::unique_ptr<ASTNode> buildNode(std::span<const FlatNode> nodes, int index)
+        {
+            const FlatNode &node = nodes[index];
+            std::vector<int> children = childrenOf(nodes, index);
+            std::string text(node.text_);
+
+            switch (node.type_)
+            {
+            case NodeType::SYMBOL:
+                return std::make_unique<SymbolNode>(text);
+            case NodeType::INTEGER:
+                return std::make_unique<IntegerNode>(node.intValue_);
+            case NodeType::FLOAT:
+            {
+                double value = 0;
+                std::string_view error = ParseFloatLiteral(node.text_, value);
+                if (!error.empty())
+                {
+                    throw std::runtime_error(FormatParseError(FlatParseError{error, node.text_, TokenType::FLOAT, std::nullopt,
+                                                                             node.line_, node.column_}));
+                }
+                return std::make_unique<FloatNode>(value);
+            }
+            case NodeType::BOOLEAN:
+                return std::make_unique<BooleanNode>(node.intValue_ != 0);
+            case NodeType::STRING:
+                return std::make_unique<StringNode>(text);
+            case NodeType::VARIABLE_DECLARATION:
+                return std::make_unique<VariableDeclarationNode>(text,
+                                                                 std::make_unique<SymbolNode>(std::string(node.typeName_)),
+                                                                 buildNode(nodes, children[0]));
+            case NodeType::FUNCTION_DECLARATION:
+            {
+                std::vector<Parameter> parameters;
+                for (int i = 0; i < node.parameterCount_; ++i)
+                {
+                    const FlatNode &param = nodes[children[i]];
+                    parameters.emplace_back(Parameter{std::string(param.text_), std::make_unique<SymbolNode>(std::string(param.typeName_))});
+                }
+                return std::make_unique<FunctionDeclarationNode>(text,
+                                                                 std::move(parameters),
+                                                                 std::make_unique<SymbolNode>(std::string(node.typeName_)),
+                                                                 buildNodes(nodes, children, node.parameterCount_));
+            }
+            case NodeType::FUNCTION_CALL:
+                return std::make_unique<FunctionCallNode>(text, buildNodes(nodes, children, 0));
+            case NodeType::VARIABLE_ASSIGNMENT:
+                return std::make_unique<VariableAssignmentNode>(text, buildNode(nodes, children[0]));
+            case NodeType::FOR_ITERATION:
+            {
+                std::size_t first = node.intValue_ == 2 ? 1 : 0; // after the grain of a `pfor`
+                return std::make_unique<ForIterationNode>(text,
+                                                          buildNode(nodes, children[first]),
+                                                          buildNode(nodes, children[first + 1]),
+                                                          buildNode(nodes, children[first + 2]),
+                                                          buildNodes(nodes, children, first + 3),
+                                                          node.intValue_ != 0,
+                                                          first == 1 ? buildNode(nodes, children[0]) : nullptr);
+            }
+            case NodeType::WHILE_ITERATION:
+                return std::make_unique<WhileIterationNode>(buildNode(nodes, children[0]), buildNodes(nodes, children, 1));
+            case NodeType::IF:
+                return std::make_unique<IfNode>(buildNode(nodes, children[0]),
+                                                buildNode(nodes, children[1]),
+                                                buildNode(nodes, children[2]));
+            case NodeType::SCRIPT:
+                return std::make_unique<ScriptNode>(buildNodes(nodes, children, 0));
+            }
+            throw std::runtime_error("Parse error: unknown flat node type");
+        }
+    }
+
+    std::string_view ParseFloatLiteral(std::string_view text, double &value)
+    {
+        // The lexer allows a leading '+', which std::from_chars does not
+        std::string_view digits = !text.empty() && text[0] == '+' ? text.substr(1) : text;
+        auto [end, error] = std::from_chars(digits.data(), digits.data() + digits.size(), value);
+        if (error == std::errc::result_out_of_range)
+        {
+            return "Floating point literal out of range";
+        }
+        if (error != std::errc() || end != digits.data() + digits.size())
+        {
+            return "Invalid floating point literal";
+        }
+        return std::string_view();
+    }
+
+    std::string FormatParseError(const FlatParseError &error)
+    {
+        std::ostringstream oss;
+        oss << "Parse error: " << error.message_;
+        if (error.expected_)
+        {
+            oss << ": expected " << TokenTypeToString(*error.expected_) << ", but got " << TokenTypeToString(error.found_);
+        }
+        else if (error.message_ == "Unexpected token")
+        {
+            oss << ": " << TokenTypeToString(error.found_);
+        }
+        oss << " at line " << error.line_
+            << ", column " << error.column_
+            << ": '" << error.token_ << "'";
+        return oss.str();
+    }
+
+    void syntaxErrorInEmbeddedMyLispScript(const FlatParseError &error)
+    {
+        throw std::runtime_error(FormatParseError(error));
+    }
+
+    std::unique_ptr<ASTNode> BuildAST(std::span<const FlatNode> nodes)
+    {
+        if (nodes.empty())
+        {
+            throw std::runtime_error("Parse error: empty flat script");
+        }
+        return buildNode(nodes, 0);
+    }
+
+} // namespace Shattang::MyLisp
@@ -0,0 +1,1142 @@
+#include <Shattang/MyLisp/Interpreter.h>
+#include <Shattang/MyLisp/ASTWalk.h>
+#include <Shattang/MyLisp/Builtins.h>
+#include <Shattang/MyLisp/DataSources.h>
+#include <Shattang/MyLisp/LoopParallelizer.h>
+#include <Shattang/MyLisp/Program.h>
+#include <Shattang/MyLisp/Sequence.h>
+#include <Shattang/MyLisp/StatementGraph.h>
+#include <Shattang/MyLisp/VectorExpression.h>
+
+#include <algorithm>
+#include <exception>
+#include <queue>
+#include <stdexcept>
+#include <unordered_set>
+#include <utility>
+
+namespace Shattang::MyLisp
+{
+    namespace
+    {
+        // Imports are I/O bound, so a few more threads than cores still help
+        constexpr unsigned ImportThreads = 4;
+
+        [[noreturn]] void throwRuntimeError(const std::string &message)
+        {
+            throw std::runtime_error("Runtime error: " + message);
+        }
+
+        // The optional grain of `pmap` and `preduce` at `position`, or 0 if it was left out
+        long grainArgument(const std::string &form, const std::vector<Value> &args, std::size_t position)
+        {
+            if (args.size() <= position)
+            {
+                return 0;
+            }
+            long grain = args[position].asInt();
+            if (grain <= 0)
+            {
+                throwRuntimeError("'" + form + "' grain must be positive, got " + std::to_string(grain));
+            }
+            return grain;
+        }
+
+        // Counts nested calls per thread, since each pool thread has its own stack
+        thread_local long callDepth = 0;
+
+        class CallDepthGuard
+        {
+        public:
+            explicit CallDepthGuard(long limit)
+            {
+                if (limit > 0 && callDepth >= limit)
+                {
+                    throwRuntimeError("call depth exceeds " + std::to_string(limit));
+                }
+                ++callDepth;
+            }
+            ~CallDepthGuard() { --callDepth; }
+            CallDepthGuard(const CallDepthGuard &) = delete;
+            CallDepthGuard &operator=(const CallDepthGuard &) = delete;
+        };
+
+        // Nested native calls allowed when TierOptions sets no depth limit; native frames are
+        // small, but the walker that takes over after a deoptimization still needs stack
+        constexpr long NativeDepthBudget = 10000;
+
+        // Deoptimizations after which a function no longer enters its native code
+        constexpr long MaxDeoptimizations = 100;
+
+        // Progress through a StatementGraph, shared by the thread in run() and the pool threads
+        // helping it. Statements start in program order among those that are ready.
+        struct StatementSchedule : std::enable_shared_from_this<StatementSchedule>
+        {
+            StatementSchedule(const StatementGraph &graph, std::function<void(std::size_t)> execute)
+                : waitingFor_(graph.dependencies_.size()), dependents_(graph.dependencies_.size()),
+                  failedAt_(graph.dependencies_.size()), execute_(std::move(execute))
+            {
+                for (std::size_t statement = 0; statement < graph.dependencies_.size(); ++statement)
+                {
+                    waitingFor_[statement] = graph.dependencies_[statement].size();
+                    for (std::size_t dependency : graph.dependencies_[statement])
+                    {
+                        dependents_[dependency].push_back(statement);
+                    }
+                    if (waitingFor_[statement] == 0)
+                    {
+                        ready_.push(statement);
+                    }
+                }
+            }
+
+            std::mutex mutex_;
+            std::condition_variable changed_;
+            std::priority_queue<std::size_t, std::vector<std::size_t>, std::greater<>> ready_;
+            std::vector<std::size_t> waitingFor_; // unfinished dependencies
+            std::vector<std::vector<std::size_t>> dependents_;
+            std::size_t running_ = 0;
+            std::size_t helpers_ = 0; // posted to the pool and not yet returned
+            std::size_t failedAt_;    // the first statement that failed, or the statement count
+            std::exception_ptr error_;
+            std::function<void(std::size_t)> execute_; // only used while statements remain
+
+            // Posts a helper for each ready statement the threads already taking part cannot start.
+            // Called with mutex_ held.
+            void wake()
+            {
+                std::size_t wanted = std::min(ready_.size(), computePool().size());
+                while (helpers_ < wanted)
+                {
+                    ++helpers_;
+                    computePool().post([self = shared_from_this()]()
+                                       { self->participate(false); });
+                }
+                changed_.notify_all();
+            }
+
+            // Runs ready statements. Helpers return once nothing is ready; the caller waits until
+            // nothing is running either.
+            void participate(bool isCaller)
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                while (true)
+                {
+                    if (ready_.empty())
+                    {
+                        if (!isCaller)
+                        {
+                            --helpers_;
+                            return;
+                        }
+                        if (running_ == 0)
+                        {
+                            return;
+                        }
+                        changed_.wait(lock);
+                        continue;
+                    }
+                    std::size_t statement = ready_.top();
+                    ready_.pop();
+                    if (statement > failedAt_)
+                    {
+                        continue; // running in order would never get here
+                    }
+
+                    ++running_;
+                    lock.unlock();
+                    std::exception_ptr error;
+                    try
+                    {
+                        execute_(statement);
+                    }
+                    catch (...)
+                    {
+                        error = std::current_exception();
+                    }
+                    lock.lock();
+                    --running_;
+
+                    if (error && statement < failedAt_)
+                    {
+                        failedAt_ = statement;
+                        error_ = error;
+                    }
+                    else if (!error)
+                    {
+                        for (std::size_t dependent : dependents_[statement])
+                        {
+                            if (--waitingFor_[dependent] == 0)
+                            {
+                                ready_.push(dependent);
+                            }
+                        }
+                    }
+                    wake();
+                }
+            }
+        };
+    }
+
+    Interpreter::Interpreter(std::ostream &out, TierOptions options)
+        : out_(out), options_(options), globals_(ownGlobals_) {}
+
+    Interpreter::Interpreter(Environment &globals, std::ostream &out, TierOptions options)
+        : out_(out), options_(options), globals_(globals) {}
+
+    Interpreter::~Interpreter()
+    {
+        {
+            std::lock_guard<std::mutex> lock(queueMutex_);
+            stopping_ = true;
+            jobs_.clear();
+        }
+        queueChanged_.notify_all();
+        if (compilerThread_.joinable())
+        {
+            compilerThread_.join();
+        }
+    }
+
+    void Interpreter::run(const ScriptNode &script)
+    {
+        auto checker = std::make_unique<TypeChecker>();
+        checker->check(script);
+        checkers_.push_back(std::move(checker));
+        execute(script, *checkers_.back(), nullptr);
+    }
+
+    void Interpreter::run(const Program &program)
+    {
+        for (const auto &[name, type] : program.inputs())
+        {
+            Value *value = globals_.find(name);
+            if (value == nullptr)
+            {
+                throwRuntimeError("input '" + name + "' is not defined");
+            }
+            if (!isAssignable(value->type(), type))
+            {
+                throwRuntimeError("input '" + name + "' is declared " + ValueTypeToString(type) + " but is " +
+                                  ValueTypeToString(value->type()));
+            }
+            *value = convertValue(std::move(*value), type);
+        }
+        execute(program.script(), program.checker(), &program.statementGraph());
+    }
+
+    void Interpreter::execute(const ScriptNode &script, const TypeChecker &checker, const StatementGraph *graph)
+    {
+        {
+            std::lock_guard<std::mutex> lock(functionsMutex_);
+            for (const auto &[name, info] : checker.functions())
+            {
+                auto entry = std::make_unique<FunctionEntry>();
+                entry->declaration_ = info.declaration_;
+                entry->typeInfo_ = &info;
+                entry->checker_ = &checker;
+                functions_[name] = entry.get();
+                entries_.push_back(std::move(entry));
+            }
+        }
+        // Statements only read the table, so concurrent ones share it without a lock
+        forEachNode(script, [this](const ASTNode &node)
+                    {
+            if (node.getType() == NodeType::STRING)
+            {
+                literals_.try_emplace(&node, String::intern(static_cast<const StringNode &>(node).text_));
+            } });
+        prefetchImports(script);
+
+        Scope scope{globals_, checker, nullptr};
+        // Streams share a buffer pool that is only used from one thread
+        if (options_.parallelStatements_ && !streamHandler_ && computePool().size() > 0)
+        {
+            if (graph != nullptr)
+            {
+                runStatements(script, scope, *graph);
+            }
+            else
+            {
+                runStatements(script, scope, buildStatementGraph(script));
+            }
+            return;
+        }
+        for (const auto &statement : script.statements_)
+        {
+            evaluate(*statement, scope);
+        }
+    }
+
+    void Interpreter::runStatements(const ScriptNode &script, Scope &scope, const StatementGraph &graph)
+    {
+        // Every global exists before anything runs, so that concurrent statements only ever look
+        // up variables and never insert them
+        for (const auto &name : graph.globals_)
+        {
+            if (globals_.findLocal(name) == nullptr)
+            {
+                globals_.define(name, Value());
+            }
+        }
+
+        auto schedule = std::make_shared<StatementSchedule>(graph, [this, &script, &scope](std::size_t statement)
+                                                            { evaluate(*script.statements_[statement], scope); });
+        {
+            std::lock_guard<std::mutex> lock(schedule->mutex_);
+            schedule->wake();
+        }
+        schedule->participate(true);
+        // Helpers may still hold the schedule; the error is released on this thread
+        if (std::exception_ptr error = std::move(schedule->error_))
+        {
+            std::rethrow_exception(error);
+        }
+    }
+
+    Value Interpreter::call(const std::string &name, std::vector<Value> args)
+    {
+        FunctionEntry *entry = findFunction(name);
+        if (entry == nullptr)
+        {
+            throwRuntimeError("unknown function '" + name + "'");
+        }
+        if (args.size() != entry->typeInfo_->parameterTypes_.size())
+        {
+            throwRuntimeError("'" + name + "' expects " + std::to_string(entry->typeInfo_->parameterTypes_.size()) +
+                              " argument(s), got " + std::to_string(args.size()));
+        }
+        for (std::size_t i = 0; i < args.size(); ++i)
+        {
+            if (!isAssignable(args[i].type(), entry->typeInfo_->parameterTypes_[i]))
+            {
+                throwRuntimeError("argument " + std::to_string(i + 1) + " of '" + name + "' must be " +
+                                  ValueTypeToString(entry->typeInfo_->parameterTypes_[i]));
+            }
+        }
+        return callFunction(*entry, args);
+    }
+
+    void Interpreter::setImportHandler(ImportHandler handler, bool prefetch)
+    {
+        importHandler_ = std::move(handler);
+        prefetchImports_ = prefetch;
+    }
+
+    Value Interpreter::importDoubleVector(const std::string &name)
+    {
+        std::lock_guard<std::mutex> lock(importsMutex_);
+        auto opened = openedStreams_.find(name);
+        if (opened != openedStreams_.end())
+        {
+            Value result(VectorExpression::stream(std::move(opened->second)));
+            openedStreams_.erase(opened);
+            return result;
+        }
+        if (streamHandler_)
+        {
+            if (std::shared_ptr<VectorStream> stream = streamHandler_(name))
+            {
+                return Value(VectorExpression::stream(std::move(stream)));
+            }
+        }
+        if (!importHandler_)
+        {
+            throwRuntimeError("no import handler set for data source '" + name + "'");
+        }
+        auto it = prefetched_.find(name);
+        if (it != prefetched_.end())
+        {
+            Value result(std::move(it->second));
+            prefetched_.erase(it);
+            return result;
+        }
+        if (!prefetchImports_)
+        {
+            return Value(importHandler_(name));
+        }
+        return Value(startImport(name));
+    }
+
+    void Interpreter::prefetchImports(const ScriptNode &script)
+    {
+        if (!importHandler_ || !prefetchImports_)
+        {
+            return;
+        }
+
+        auto prefetch = [this](const std::string &name)
+        {
+            if (prefetched_.count(name) != 0 || openedStreams_.count(name) != 0)
+            {
+                return;
+            }
+            // Streams are read as the script consumes them, so they are only opened here
+            std::shared_ptr<VectorStream> stream;
+            try
+            {
+                stream = streamHandler_ ? streamHandler_(name) : nullptr;
+            }
+            catch (const std::exception &)
+            {
+                return; // reported when the import runs
+            }
+            if (stream != nullptr)
+            {
+                openedStreams_.emplace(name, std::move(stream));
+            }
+            else
+            {
+                prefetched_.emplace(name, startImport(name));
+            }
+        };
+
+        // Only top-level statements and the functions they can call are searched, so a function
+        // that is never called loads nothing
+        std::unordered_map<std::string, std::vector<const FunctionDeclarationNode *>> declarations;
+        std::vector<const ASTNode *> reached;
+        for (const auto &statement : script.statements_)
+        {
+            if (statement->getType() == NodeType::FUNCTION_DECLARATION)
+            {
+                const auto &function = static_cast<const FunctionDeclarationNode &>(*statement);
+                declarations[function.functionName_].push_back(&function);
+            }
+            else
+            {
+                reached.push_back(statement.get());
+            }
+        }
+
+        std::unordered_set<std::string> called;
+        for (std::size_t next = 0; next < reached.size(); ++next)
+        {
+            forEachNode(*reached[next], [&](const ASTNode &node)
+                        {
+                if (node.getType() != NodeType::FUNCTION_CALL)
+                {
+                    return;
+                }
+                const auto &call = static_cast<const FunctionCallNode &>(node);
+                if (call.functionName_ == "import-double-vector" && call.arguments_.size() == 1 &&
+                    call.arguments_[0]->getType() == NodeType::STRING)
+                {
+                    prefetch(static_cast<const StringNode &>(*call.arguments_[0]).text_);
+                    return;
+                }
+
+                // `pmap` and the like call the function named by their first argument
+                std::string callee = call.functionName_;
+                if (takesFunctionName(callee) && !call.arguments_.empty() &&
+                    call.arguments_[0]->getType() == NodeType::SYMBOL)
+                {
+                    callee = static_cast<const SymbolNode &>(*call.arguments_[0]).name_;
+                }
+                auto it = declarations.find(callee);
+                if (it != declarations.end() && called.insert(callee).second)
+                {
+                    for (const FunctionDeclarationNode *function : it->second)
+                    {
+                        for (const auto &statement : function->body_)
+                        {
+                            reached.push_back(statement.get());
+                        }
+                    }
+                } });
+        }
+    }
+
+    std::future<DoubleVector> Interpreter::startImport(const std::string &name)
+    {
+        if (ioPool_ == nullptr)
+        {
+            ioPool_ = std::make_unique<ThreadPool>(ImportThreads);
+        }
+        return ioPool_->submit([handler = importHandler_, name]()
+                               {
+            DoubleVector vector = handler(name);
+            prefetchPages(vector);
+            return vector; });
+    }
+
+    void Interpreter::waitForCompilation()
+    {
+        std::unique_lock<std::mutex> lock(queueMutex_);
+        queueChanged_.wait(lock, [this]()
+                           { return jobs_.empty() && !compiling_; });
+    }
+
+    TierStatistics Interpreter::statistics() const
+    {
+        return TierStatistics{compiledFunctions_.load(), compiledLoops_.load(), failedCompilations_.load(),
+                              nativeFunctions_.load(), deoptimizations_.load()};
+    }
+
+    FunctionEntry *Interpreter::findFunction(const std::string &name)
+    {
+        std::lock_guard<std::mutex> lock(functionsMutex_);
+        auto it = functions_.find(name);
+        return it == functions_.end() ? nullptr : it->second;
+    }
+
+    Value Interpreter::callFunction(FunctionEntry &entry, std::vector<Value> &args)
+    {
+        checkCancelled();
+        CallDepthGuard depth(options_.maxCallDepth_);
+        const NativeFunction *native = entry.native_.load(std::memory_order_acquire);
+        if (native == nullptr && isNativeCandidate(entry) && !entry.nativeQueued_ &&
+            ++entry.nativeCalls_ >= options_.nativeThreshold_)
+        {
+            promoteNative(entry);
+            native = entry.native_.load(std::memory_order_acquire);
+        }
+        if (native != nullptr)
+        {
+            Value result;
+            if (invokeNative(entry, *native, args, result))
+            {
+                return result;
+            }
+        }
+        if (const CompiledFunction *code = entry.compiled_.load(std::memory_order_acquire))
+        {
+            return code->invoke(*this, args);
+        }
+        if (options_.enableTiering_ && !entry.queued_ && ++entry.calls_ >= options_.callThreshold_)
+        {
+            promoteFunction(entry);
+            if (const CompiledFunction *code = entry.compiled_.load(std::memory_order_acquire))
+            {
+                return code->invoke(*this, args);
+            }
+        }
+        return interpretFunction(entry, args);
+    }
+
+    Value Interpreter::callWithFunction(const std::string &form, FunctionEntry &function, std::vector<Value> &args)
+    {
+        if (form == "pmap")
+        {
+            return parallelMap(function, args);
+        }
+        if (form == "preduce")
+        {
+            return parallelReduce(function, args);
+        }
+
+        FunctionEntry *entry = &function;
+        if (form == "map")
+        {
+            return Value(Sequence::map([this, entry](double element)
+                                       {
+                std::vector<Value> call{Value(element)};
+                return callFunction(*entry, call).asFloat(); }, args[0].asSequence()));
+        }
+        if (form == "filter")
+        {
+            return Value(Sequence::filter([this, entry](double element)
+                                          {
+                std::vector<Value> call{Value(element)};
+                return callFunction(*entry, call).asBool(); }, args[0].asSequence()));
+        }
+        return Value(Sequence::zip([this, entry](double lhs, double rhs)
+                                   {
+            std::vector<Value> call{Value(lhs), Value(rhs)};
+            return callFunction(*entry, call).asFloat(); }, args[0].asSequence(), args[1].asSequence()));
+    }
+
+    Value Interpreter::parallelMap(FunctionEntry &function, std::vector<Value> &args)
+    {
+        // Materialized here, so the partitions only read plain storage
+        const DoubleVector &input = args[0].asVector();
+        long grain = grainArgument("pmap", args, 1);
+        std::size_t size = partitionSize(input.size(), grain);
+        std::size_t partitions = (input.size() + size - 1) / size;
+
+        DoubleVector result(input.size());
+        auto mapPartition = [this, &function, &input, &result, size](std::size_t partition)
+        {
+            std::vector<Value> call(1);
+            std::size_t last = std::min(input.size(), (partition + 1) * size);
+            for (std::size_t i = partition * size; i < last; ++i)
+            {
+                call[0] = Value(input[i]);
+                result[i] = callFunction(function, call).asFloat();
+            }
+        };
+        try
+        {
+            computePool().parallelFor(partitions, mapPartition);
+        }
+        catch (const std::exception &)
+        {
+            for (std::size_t partition = 0; partition < partitions; ++partition)
+            {
+                mapPartition(partition);
+            }
+        }
+        return Value(std::move(result));
+    }
+
+    Value Interpreter::parallelReduce(FunctionEntry &function, std::vector<Value> &args)
+    {
+        const DoubleVector &input = args[1].asVector();
+        long grain = grainArgument("preduce", args, 2);
+        std::size_t size = partitionSize(input.size(), grain);
+        std::size_t partitions = (input.size() + size - 1) / size;
+
+        auto fold = [this, &function](Value accumulator, double element)
+        {
+            std::vector<Value> call{std::move(accumulator), Value(element)};
+            return callFunction(function, call);
+        };
+        std::vector<Value> partials(partitions);
+        auto reducePartition = [&fold, &input, &partials, size](std::size_t partition)
+        {
+            std::size_t first = partition * size;
+            std::size_t last = std::min(input.size(), first + size);
+            Value accumulator(input[first]);
+            for (std::size_t i = first + 1; i < last; ++i)
+            {
+                accumulator = fold(std::move(accumulator), input[i]);
+            }
+            partials[partition] = std::move(accumulator);
+        };
+        try
+        {
+            computePool().parallelFor(partitions, reducePartition);
+        }
+        catch (const std::exception &)
+        {
+            for (std::size_t partition = 0; partition < partitions; ++partition)
+            {
+                reducePartition(partition);
+            }
+        }
+
+        Value total = args[0];
+        for (const Value &partial : partials)
+        {
+            total = fold(std::move(total), partial.asFloat());
+        }
+        return Value(total.asFloat());
+    }
+
+    Value Interpreter::interpretFunction(FunctionEntry &entry, std::vector<Value> &args)
+    {
+        const FunctionDeclarationNode &decl = *entry.declaration_;
+        Environment env(&globals_);
+        for (std::size_t i = 0; i < decl.parameters_.size(); ++i)
+        {
+            env.define(decl.parameters_[i].name_, convertValue(std::move(args[i]), entry.typeInfo_->parameterTypes_[i]));
+        }
+
+        Scope scope{env, *entry.checker_, entry.typeInfo_};
+        Value result;
+        for (const auto &statement : decl.body_)
+        {
+            result = evaluate(*statement, scope);
+        }
+        if (entry.typeInfo_->returnType_ == ValueType::VOID)
+        {
+            return Value();
+        }
+        return convertValue(std::move(result), entry.typeInfo_->returnType_);
+    }
+
+    Value Interpreter::evaluate(const ASTNode &node, Scope &scope)
+    {
+        switch (node.getType())
+        {
+        case NodeType::SYMBOL:
+        {
+            Value &value = scope.env_.get(static_cast<const SymbolNode &>(node).name_);
+            if (scope.function_ != nullptr && scope.function_->lastUses_.count(&node) != 0)
+            {
+                // Never read again, so the value moves out and a vector keeps a single owner
+                return std::exchange(value, Value());
+            }
+            return value;
+        }
+
+        case NodeType::INTEGER:
+            return Value(static_cast<const IntegerNode &>(node).value_);
+
+        case NodeType::FLOAT:
+            return Value(static_cast<const FloatNode &>(node).value_);
+
+        case NodeType::BOOLEAN:
+            return Value(static_cast<const BooleanNode &>(node).value_);
+
+        case NodeType::STRING:
+        {
+            auto it = literals_.find(&node);
+            return Value(it != literals_.end() ? it->second : String::intern(static_cast<const StringNode &>(node).text_));
+        }
+
+        case NodeType::VARIABLE_DECLARATION:
+        {
+            const auto &varDecl = static_cast<const VariableDeclarationNode &>(node);
+            Value value = evaluate(*varDecl.valueNode_, scope);
+            scope.env_.define(varDecl.variableName_, convertValue(std::move(value), ValueTypeFromName(varDecl.typeNode_->name_)));
+            return Value();
+        }
+
+        case NodeType::FUNCTION_DECLARATION:
+            // Registered by run() before execution starts
+            return Value();
+
+        case NodeType::FUNCTION_CALL:
+            return evaluateFunctionCall(static_cast<const FunctionCallNode &>(node), scope);
+
+        case NodeType::VARIABLE_ASSIGNMENT:
+        {
+            const auto &varAssign = static_cast<const VariableAssignmentNode &>(node);
+            Value value = evaluate(*varAssign.valueNode_, scope);
+            Value &target = scope.env_.get(varAssign.variableName_);
+            target = convertValue(std::move(value), target.type());
+            return Value();
+        }
+
+        case NodeType::FOR_ITERATION:
+            return evaluateForIteration(static_cast<const ForIterationNode &>(node), scope);
+
+        case NodeType::WHILE_ITERATION:
+            return evaluateWhileIteration(static_cast<const WhileIterationNode &>(node), scope);
+
+        case NodeType::IF:
+        {
+            const auto &ifNode = static_cast<const IfNode &>(node);
+            const ASTNode &branch = evaluate(*ifNode.condition_, scope).asBool() ? *ifNode.thenBranch_ : *ifNode.elseBranch_;
+            Value result = evaluate(branch, scope);
+            if (scope.checker_.typeOf(ifNode) == ValueType::VOID)
+            {
+                return Value();
+            }
+            return convertValue(std::move(result), scope.checker_.typeOf(ifNode));
+        }
+
+        case NodeType::SCRIPT:
+        {
+            Value result;
+            for (const auto &statement : static_cast<const ScriptNode &>(node).statements_)
+            {
+                result = evaluate(*statement, scope);
+            }
+            return result;
+        }
+        }
+        throwRuntimeError("unknown node type");
+    }
+
+    Value Interpreter::evaluateFunctionCall(const FunctionCallNode &node, Scope &scope)
+    {
+        const std::string &name = node.functionName_;
+        if (name == "and" || name == "or")
+        {
+            bool lhs = evaluate(*node.arguments_[0], scope).asBool();
+            if (lhs == (name == "or"))
+            {
+                return Value(lhs);
+            }
+            return Value(evaluate(*node.arguments_[1], scope).asBool());
+        }
+        if (takesFunctionName(name))
+        {
+            // The first argument names the function; the rest are expressions
+            std::vector<Value> args;
+            for (std::size_t i = 1; i < node.arguments_.size(); ++i)
+            {
+                args.push_back(evaluate(*node.arguments_[i], scope));
+            }
+            const std::string &functionName = static_cast<const SymbolNode &>(*node.arguments_[0]).name_;
+            FunctionEntry *entry = findFunction(functionName);
+            if (entry == nullptr)
+            {
+                throwRuntimeError("unknown function '" + functionName + "'");
+            }
+            return callWithFunction(name, *entry, args);
+        }
+
+        if (name == "vector-push" && node.arguments_[0]->getType() == NodeType::SYMBOL)
+        {
+            // Pushed through the variable itself; a copy of its Value would get its own vector
+            double element = evaluate(*node.arguments_[1], scope).asFloat();
+            scope.env_.get(static_cast<const SymbolNode &>(*node.arguments_[0]).name_).asMutableVector().push(element);
+            return Value();
+        }
+
+        std::vector<Value> args;
+        args.reserve(node.arguments_.size());
+        for (const auto &arg : node.arguments_)
+        {
+            args.push_back(evaluate(*arg, scope));
+        }
+
+        if (const Builtin *builtin = findBuiltin(name))
+        {
+            if (builtin->function_ == nullptr)
+            {
+                throwRuntimeError("builtin '" + name + "' is not available in this runtime");
+            }
+            return builtin->function_(*this, args);
+        }
+
+        FunctionEntry *entry = findFunction(name);
+        if (entry == nullptr)
+        {
+            throwRuntimeError("unknown function '" + name + "'");
+        }
+        return callFunction(*entry, args);
+    }
+
+    Value Interpreter::evaluateForIteration(const ForIterationNode &node, Scope &scope)
+    {
+        if (node.isParallel_)
+        {
+            return evaluateParallelFor(node, scope);
+        }
+
+        // Bounds and step are evaluated once on entry; the end bound is inclusive
+        long index = evaluate(*node.start_, scope).asInt();
+        long end = evaluate(*node.end_, scope).asInt();
+        long step = evaluate(*node.step_, scope).asInt();
+        if (step == 0)
+        {
+            throwRuntimeError("'for' step must not be zero");
+        }
+
+        LoopEntry *entry = options_.enableTiering_ ? loopEntry(node) : nullptr;
+        Value &indexVariable = scope.env_.define(node.index_, Value(index));
+        while (step > 0 ? index <= end : index >= end)
+        {
+            if (entry != nullptr)
+            {
+                if (const CompiledLoop *code = entry->compiled_.load(std::memory_order_acquire))
+                {
+                    code->runFor(*this, scope.env_, index, end, step);
+                    return Value();
+                }
+            }
+
+            indexVariable = Value(index);
+            for (const auto &statement : node.body_)
+            {
+                evaluate(*statement, scope);
+            }
+            index = indexVariable.asInt() + step;
+
+            checkCancelled();
+            if (entry != nullptr)
+            {
+                countBackEdge(*entry, node, scope);
+            }
+        }
+        return Value();
+    }
+
+    Value Interpreter::evaluateParallelFor(const ForIterationNode &node, Scope &scope)
+    {
+        long index = evaluate(*node.start_, scope).asInt();
+        long end = evaluate(*node.end_, scope).asInt();
+        long step = evaluate(*node.step_, scope).asInt();
+        if (step == 0)
+        {
+            throwRuntimeError("'pfor' step must not be zero");
+        }
+        long grain = node.grain_ != nullptr ? evaluate(*node.grain_, scope).asInt() : 0;
+        if (node.grain_ != nullptr && grain <= 0)
+        {
+            throwRuntimeError("'pfor' grain must be positive, got " + std::to_string(grain));
+        }
+
+        Value &indexVariable = scope.env_.define(node.index_, Value(index));
+        if (runParallelFor(node, scope, index, end, step, grain))
+        {
+            return Value();
+        }
+        while (step > 0 ? index <= end : index >= end)
+        {
+            indexVariable = Value(index);
+            for (const auto &statement : node.body_)
+            {
+                evaluate(*statement, scope);
+            }
+            index = indexVariable.asInt() + step;
+        }
+        return Value();
+    }
+
+    // Like ParallelLoop::run in tier 1: each partition evaluates the body in an Environment of its
+    // own that holds the index, the accumulators and the outputs. Returns false without changing
+    // any variable if the loop is empty, reads a stream or fails; the caller then runs it in order.
+    bool Interpreter::runParallelFor(const ForIterationNode &node, Scope &scope, long index, long end, long step,
+                                     long grain)
+    {
+        const ParallelLoopPlan &plan = *scope.checker_.parallelPlan(node);
+        std::size_t iterations = iterationCount(index, end, step);
+        if (iterations == 0)
+        {
+            return false;
+        }
+        for (const auto &input : plan.inputs_)
+        {
+            if (scope.env_.get(input).asExpression()->readsStream())
+            {
+                return false;
+            }
+        }
+
+        std::vector<std::string> privateNames;
+        for (const Reduction &reduction : plan.reductions_)
+        {
+            privateNames.push_back(reduction.variable_);
+        }
+        privateNames.insert(privateNames.end(), plan.outputs_.begin(), plan.outputs_.end());
+
+        std::size_t size = partitionSize(iterations, grain);
+        std::vector<std::vector<Value>> results((iterations + size - 1) / size);
+        try
+        {
+            computePool().parallelFor(results.size(), [&](std::size_t partition)
+                                      {
+                Environment local(&scope.env_);
+                std::vector<Value> &values = results[partition];
+                values = partitionStart(plan);
+                for (std::size_t i = 0; i < values.size(); ++i)
+                {
+                    local.define(privateNames[i], std::move(values[i]));
+                }
+                Value &indexVariable = local.define(node.index_, Value(index));
+                Scope partitionScope{local, scope.checker_, scope.function_};
+                std::size_t last = std::min(iterations, (partition + 1) * size);
+                for (std::size_t k = partition * size; k < last; ++k)
+                {
+                    indexVariable = Value(index + static_cast<long>(k) * step);
+                    for (const auto &statement : node.body_)
+                    {
+                        evaluate(*statement, partitionScope);
+                    }
+                }
+                for (std::size_t i = 0; i < values.size(); ++i)
+                {
+                    values[i] = std::move(*local.findLocal(privateNames[i]));
+                } });
+        }
+        catch (const std::exception &)
+        {
+            return false;
+        }
+
+        std::vector<Value *> targets;
+        for (const auto &name : privateNames)
+        {
+            targets.push_back(&scope.env_.get(name));
+        }
+        combinePartitions(plan, results, targets);
+        scope.env_.get(node.index_) = Value(index + static_cast<long>(iterations - 1) * step);
+        return true;
+    }
+
+    Value Interpreter::evaluateWhileIteration(const WhileIterationNode &node, Scope &scope)
+    {
+        LoopEntry *entry = options_.enableTiering_ ? loopEntry(node) : nullptr;
+        while (true)
+        {
+            if (entry != nullptr)
+            {
+                if (const CompiledLoop *code = entry->compiled_.load(std::memory_order_acquire))
+                {
+                    code->runWhile(*this, scope.env_);
+                    return Value();
+                }
+            }
+
+            if (!evaluate(*node.condition_, scope).asBool())
+            {
+                break;
+            }
+            for (const auto &statement : node.body_)
+            {
+                evaluate(*statement, scope);
+            }
+
+            checkCancelled();
+            if (entry != nullptr)
+            {
+                countBackEdge(*entry, node, scope);
+            }
+        }
+        return Value();
+    }
+
+    void Interpreter::throwCancelled()
+    {
+        throwRuntimeError("cancelled");
+    }
+
+    LoopEntry *Interpreter::loopEntry(const ASTNode &loop)
+    {
+        std::lock_guard<std::mutex> lock(loopsMutex_);
+        auto &entry = loops_[&loop];
+        if (!entry)
+        {
+            entry = std::make_unique<LoopEntry>();
+        }
+        return entry.get();
+    }
+
+    void Interpreter::countBackEdge(LoopEntry &entry, const ASTNode &loop, const Scope &scope)
+    {
+        if (entry.queued_ || ++entry.backEdges_ < options_.backEdgeThreshold_ || entry.queued_.exchange(true))
+        {
+            return;
+        }
+
+        const TypeChecker *checker = &scope.checker_;
+        const FunctionTypeInfo *function = scope.function_;
+        LoopEntry *target = &entry;
+        const ASTNode *node = &loop;
+        schedule([this, checker, function, target, node]()
+                 {
+            try
+            {
+                ClosureCompiler compiler(*this, *checker);
+                target->code_ = compiler.compileLoop(*node, function);
+                target->compiled_.store(target->code_.get(), std::memory_order_release);
+                compiledLoops_++;
+            }
+            catch (const std::exception &)
+            {
+                // Stays in the AST walker
+                failedCompilations_++;
+            } });
+
+        // A hot loop makes its function worth machine code for the next call
+        if (function != nullptr)
+        {
+            FunctionEntry *owner = findFunction(function->declaration_->functionName_);
+            if (owner != nullptr && owner->typeInfo_ == function && isNativeCandidate(*owner))
+            {
+                promoteNative(*owner);
+            }
+        }
+    }
+
+    void Interpreter::promoteFunction(FunctionEntry &entry)
+    {
+        if (entry.queued_.exchange(true))
+        {
+            return;
+        }
+        FunctionEntry *target = &entry;
+        schedule([this, target]()
+                 {
+            try
+            {
+                ClosureCompiler compiler(*this, *target->checker_);
+                target->code_ = compiler.compileFunction(*target->declaration_);
+                target->compiled_.store(target->code_.get(), std::memory_order_release);
+                compiledFunctions_++;
+            }
+            catch (const std::exception &)
+            {
+                // Stays in the AST walker
+                failedCompilations_++;
+            } });
+    }
+
+    bool Interpreter::isNativeCandidate(const FunctionEntry &entry) const
+    {
+        return options_.enableTiering_ && options_.enableNative_ && nativeCodeSupported() &&
+               entry.typeInfo_->isNumeric_ && entry.typeInfo_->isPure_;
+    }
+
+    void Interpreter::promoteNative(FunctionEntry &entry)
+    {
+        if (entry.nativeQueued_.exchange(true))
+        {
+            return;
+        }
+        FunctionEntry *target = &entry;
+        schedule([this, target]()
+                 {
+            try
+            {
+                target->nativeCode_ = compileNativeFunction(*target->declaration_, *target->checker_);
+                target->native_.store(target->nativeCode_.get(), std::memory_order_release);
+                nativeFunctions_++;
+            }
+            catch (const std::exception &)
+            {
+                // Stays in the lower tiers
+                failedCompilations_++;
+            } });
+    }
+
+    // Runs native code within what is left of the call depth limit. On a deoptimization nothing
+    // has happened yet, since native functions are pure, and the caller runs a lower tier.
+    bool Interpreter::invokeNative(FunctionEntry &entry, const NativeFunction &code, std::vector<Value> &args,
+                                   Value &result)
+    {
+        long budget = NativeDepthBudget;
+        if (options_.maxCallDepth_ > 0)
+        {
+            budget = std::min(budget, options_.maxCallDepth_ - callDepth + 1);
+        }
+        NativeContext context{&cancelled_, budget};
+        if (code.invoke(context, args, result))
+        {
+            return true;
+        }
+        deoptimizations_++;
+        if (++entry.deoptimizations_ == MaxDeoptimizations)
+        {
+            entry.native_.store(nullptr, std::memory_order_release);
+        }
+        return false;
+    }
+
+    void Interpreter::schedule(std::function<void()> job)
+    {
+        if (!options_.backgroundCompilation_)
+        {
+            job();
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(queueMutex_);
+            jobs_.push_back(std::move(job));
+            if (!compilerThread_.joinable())
+            {
+                compilerThread_ = std::thread(&Interpreter::compilerLoop, this);
+            }
+        }
+        queueChanged_.notify_all();
+    }
+
+    void Interpreter::compilerLoop()
+    {
+        std::unique_lock<std::mutex> lock(queueMutex_);
+        while (true)
+        {
+            queueChanged_.wait(lock, [this]()
+                               { return stopping_ || !jobs_.empty(); });
+            if (stopping_)
+            {
+                return;
+            }
+
+            std::function<void()> job = std::move(jobs_.front());
+            jobs_.pop_front();
+            compiling_ = true;
+            lock.unlock();
+            job();
+            lock.lock();
+            compiling_ = false;
+            queueChanged_.notify_all();
+        }
+    }
+
+} // namespace Shattang::MyLisp
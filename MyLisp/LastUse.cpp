@@ -0,0 +1,143 @@
+#include <Shattang/MyLisp/LastUse.h>
+#include <Shattang/MyLisp/ASTWalk.h>
+#include <Shattang/MyLisp/Builtins.h>
+
+#include <string>
+#include <unordered_map>
+
+namespace Shattang::MyLisp
+{
+    namespace
+    {
+        class LastUseFinder
+        {
+        public:
+            void addCandidate(const std::string &name)
+            {
+                lastRead_[name] = nullptr;
+            }
+
+            // Reads in `node` made while `pinned` keep the variable alive
+            void visit(const ASTNode &node, bool pinned)
+            {
+                switch (node.getType())
+                {
+                case NodeType::SYMBOL:
+                    read(static_cast<const SymbolNode &>(node), pinned);
+                    break;
+                case NodeType::VARIABLE_DECLARATION:
+                    visit(*static_cast<const VariableDeclarationNode &>(node).valueNode_, pinned);
+                    break;
+                case NodeType::VARIABLE_ASSIGNMENT:
+                    visit(*static_cast<const VariableAssignmentNode &>(node).valueNode_, pinned);
+                    break;
+                case NodeType::FUNCTION_CALL:
+                    visitCall(static_cast<const FunctionCallNode &>(node), pinned);
+                    break;
+                case NodeType::IF:
+                {
+                    const auto &ifNode = static_cast<const IfNode &>(node);
+                    visit(*ifNode.condition_, pinned);
+                    visit(*ifNode.thenBranch_, pinned);
+                    visit(*ifNode.elseBranch_, pinned);
+                    break;
+                }
+                case NodeType::FOR_ITERATION:
+                case NodeType::WHILE_ITERATION:
+                    // A later iteration reads the variable again
+                    forEachNode(node, [this](const ASTNode &child)
+                                {
+                        if (child.getType() == NodeType::SYMBOL)
+                        {
+                            read(static_cast<const SymbolNode &>(child), true);
+                        } });
+                    break;
+                default:
+                    break;
+                }
+            }
+
+            std::unordered_set<const ASTNode *> lastReads() const
+            {
+                std::unordered_set<const ASTNode *> result;
+                for (const auto &[name, node] : lastRead_)
+                {
+                    if (node != nullptr)
+                    {
+                        result.insert(node);
+                    }
+                }
+                return result;
+            }
+
+        private:
+            std::unordered_map<std::string, const ASTNode *> lastRead_; // candidates; nullptr while pinned
+            std::unordered_map<std::string, std::size_t> reads_;
+
+            void read(const SymbolNode &node, bool pinned)
+            {
+                auto it = lastRead_.find(node.name_);
+                if (it != lastRead_.end())
+                {
+                    it->second = pinned ? nullptr : &node;
+                    ++reads_[node.name_];
+                }
+            }
+
+            void visitCall(const FunctionCallNode &call, bool pinned)
+            {
+                // The first argument of these names a function, not a variable
+                std::size_t first = takesFunctionName(call.functionName_) ? 1 : 0;
+                std::unordered_map<std::string, std::size_t> readingArguments;
+                for (std::size_t i = first; i < call.arguments_.size(); ++i)
+                {
+                    bool isPushed = i == 0 && call.functionName_ == "vector-push";
+                    std::unordered_map<std::string, std::size_t> before = reads_;
+                    visit(*call.arguments_[i], pinned || isPushed);
+                    for (const auto &[name, count] : reads_)
+                    {
+                        auto previous = before.find(name);
+                        if (previous == before.end() || previous->second != count)
+                        {
+                            ++readingArguments[name];
+                        }
+                    }
+                }
+                for (const auto &[name, count] : readingArguments)
+                {
+                    if (count > 1)
+                    {
+                        lastRead_[name] = nullptr;
+                    }
+                }
+            }
+        };
+    }
+
+    std::unordered_set<const ASTNode *> findLastUses(const FunctionDeclarationNode &function, const FunctionTypeInfo &info)
+    {
+        LastUseFinder finder;
+        for (std::size_t i = 0; i < function.parameters_.size(); ++i)
+        {
+            if (info.parameterTypes_[i] == ValueType::DOUBLE_VECTOR)
+            {
+                finder.addCandidate(function.parameters_[i].name_);
+            }
+        }
+        for (const auto &statement : function.body_)
+        {
+            finder.visit(*statement, false);
+            // Only once declared does the name refer to the local rather than a global
+            if (statement->getType() == NodeType::VARIABLE_DECLARATION)
+            {
+                const auto &declaration = static_cast<const VariableDeclarationNode &>(*statement);
+                if (ValueTypeFromName(declaration.typeNode_->name_) == ValueType::DOUBLE_VECTOR)
+                {
+                    finder.addCandidate(declaration.variableName_);
+                }
+            }
+        }
+        return finder.lastReads();
+    }
+
+} // namespace Shattang::MyLisp
@@ -0,0 +1,344 @@
+#include <Shattang/MyLisp/LoopParallelizer.h>
+#include <Shattang/MyLisp/Builtins.h>
+#include <Shattang/MyLisp/LoopVectorizer.h>
+
+#include <algorithm>
+#include <limits>
+#include <unordered_set>
+
+namespace Shattang::MyLisp
+{
+    namespace
+    {
+        bool isSymbol(const ASTNode &node, const std::string &name)
+        {
+            return node.getType() == NodeType::SYMBOL && static_cast<const SymbolNode &>(node).name_ == name;
+        }
+
+        // Builtins that only read their arguments; vector results are left out, so that every
+        // vector an iteration reads is a variable the loop can check before splitting
+        bool isPureBuiltin(const std::string &name)
+        {
+            static const std::unordered_set<std::string> readers = {"length", "vector-ref", "vector-sum", "vector-min",
+                                                                    "vector-max", "vector-dot"};
+            const Builtin *builtin = findBuiltin(name);
+            return builtin != nullptr && (builtin->isScalar_ || readers.count(name) != 0);
+        }
+
+        class Analysis
+        {
+        public:
+            Analysis(const TypeChecker &checker, ParallelLoopPlan &plan, bool allowFunctions)
+                : checker_(checker), plan_(plan), allowFunctions_(allowFunctions) {}
+
+            // Collects the accumulators and outputs; false if a variable is written any other way
+            bool collectTargets(const ASTNode &node)
+            {
+                bool valid = true;
+                auto visit = [this, &valid](const ASTNode &child, auto &self) -> void
+                {
+                    switch (child.getType())
+                    {
+                    case NodeType::VARIABLE_ASSIGNMENT:
+                        accumulators_.insert(static_cast<const VariableAssignmentNode &>(child).variableName_);
+                        self(*static_cast<const VariableAssignmentNode &>(child).valueNode_, self);
+                        break;
+                    case NodeType::FUNCTION_CALL:
+                    {
+                        const auto &call = static_cast<const FunctionCallNode &>(child);
+                        if (call.functionName_ == "vector-push" && call.arguments_.size() == 2 &&
+                            call.arguments_[0]->getType() == NodeType::SYMBOL)
+                        {
+                            outputs_.insert(static_cast<const SymbolNode &>(*call.arguments_[0]).name_);
+                        }
+                        for (const auto &arg : call.arguments_)
+                        {
+                            self(*arg, self);
+                        }
+                        break;
+                    }
+                    case NodeType::IF:
+                    {
+                        const auto &ifNode = static_cast<const IfNode &>(child);
+                        self(*ifNode.condition_, self);
+                        self(*ifNode.thenBranch_, self);
+                        self(*ifNode.elseBranch_, self);
+                        break;
+                    }
+                    case NodeType::INTEGER:
+                    case NodeType::FLOAT:
+                    case NodeType::BOOLEAN:
+                    case NodeType::STRING:
+                    case NodeType::SYMBOL:
+                        break;
+                    default:
+                        valid = false; // declarations and nested loops
+                        break;
+                    }
+                };
+                visit(node, visit);
+                return valid;
+            }
+
+            bool isTarget(const std::string &name) const
+            {
+                return accumulators_.count(name) != 0 || outputs_.count(name) != 0;
+            }
+
+            bool statement(const ASTNode &node)
+            {
+                if (node.getType() == NodeType::VARIABLE_ASSIGNMENT)
+                {
+                    return reduction(static_cast<const VariableAssignmentNode &>(node));
+                }
+                if (node.getType() == NodeType::FUNCTION_CALL)
+                {
+                    const auto &call = static_cast<const FunctionCallNode &>(node);
+                    if (call.functionName_ == "vector-push")
+                    {
+                        if (call.arguments_.size() != 2 || call.arguments_[0]->getType() != NodeType::SYMBOL)
+                        {
+                            return false;
+                        }
+                        const std::string &output = static_cast<const SymbolNode &>(*call.arguments_[0]).name_;
+                        if (std::find(plan_.outputs_.begin(), plan_.outputs_.end(), output) == plan_.outputs_.end())
+                        {
+                            plan_.outputs_.push_back(output);
+                        }
+                        return expression(*call.arguments_[1]);
+                    }
+                }
+                if (node.getType() == NodeType::IF)
+                {
+                    const auto &ifNode = static_cast<const IfNode &>(node);
+                    return expression(*ifNode.condition_) && statement(*ifNode.thenBranch_) &&
+                           statement(*ifNode.elseBranch_);
+                }
+                return expression(node);
+            }
+
+        private:
+            const TypeChecker &checker_;
+            ParallelLoopPlan &plan_;
+            bool allowFunctions_;
+            std::unordered_set<std::string> accumulators_;
+            std::unordered_set<std::string> outputs_;
+
+            // Side effect free, and independent of what other iterations write
+            bool expression(const ASTNode &node)
+            {
+                switch (node.getType())
+                {
+                case NodeType::INTEGER:
+                case NodeType::FLOAT:
+                case NodeType::BOOLEAN:
+                case NodeType::STRING:
+                    return true;
+                case NodeType::SYMBOL:
+                {
+                    const std::string &name = static_cast<const SymbolNode &>(node).name_;
+                    if (isTarget(name))
+                    {
+                        return false;
+                    }
+                    if (checker_.typeOf(node) == ValueType::DOUBLE_VECTOR &&
+                        std::find(plan_.inputs_.begin(), plan_.inputs_.end(), name) == plan_.inputs_.end())
+                    {
+                        plan_.inputs_.push_back(name);
+                    }
+                    return true;
+                }
+                case NodeType::FUNCTION_CALL:
+                {
+                    const auto &call = static_cast<const FunctionCallNode &>(node);
+                    const FunctionTypeInfo *function = allowFunctions_ ? checker_.function(call.functionName_) : nullptr;
+                    bool isPure = isPureBuiltin(call.functionName_) || (function != nullptr && function->isPure_);
+                    return isPure &&
+                           std::all_of(call.arguments_.begin(), call.arguments_.end(),
+                                       [this](const auto &arg)
+                                       { return expression(*arg); });
+                }
+                case NodeType::IF:
+                {
+                    const auto &ifNode = static_cast<const IfNode &>(node);
+                    return expression(*ifNode.condition_) && expression(*ifNode.thenBranch_) &&
+                           expression(*ifNode.elseBranch_);
+                }
+                default:
+                    return false;
+                }
+            }
+
+            bool reduction(const VariableAssignmentNode &node)
+            {
+                const std::string &acc = node.variableName_;
+                const ASTNode &value = *node.valueNode_;
+                Reduction reduction{acc, ReductionKind::SUM, ValueType::VOID, false};
+                const ASTNode *element = nullptr;
+
+                if (value.getType() == NodeType::FUNCTION_CALL &&
+                    static_cast<const FunctionCallNode &>(value).functionName_ == "add" &&
+                    static_cast<const FunctionCallNode &>(value).arguments_.size() == 2)
+                {
+                    const auto &add = static_cast<const FunctionCallNode &>(value);
+                    const ASTNode &lhs = *add.arguments_[0];
+                    const ASTNode &rhs = *add.arguments_[1];
+                    element = isSymbol(lhs, acc) ? &rhs : isSymbol(rhs, acc) ? &lhs : nullptr;
+                    reduction.type_ = isSymbol(lhs, acc) ? checker_.typeOf(lhs) : checker_.typeOf(rhs);
+                }
+                else
+                {
+                    bool isMin = false;
+                    element = matchSelection(value, acc, isMin, reduction.isInclusive_);
+                    reduction.kind_ = isMin ? ReductionKind::MIN : ReductionKind::MAX;
+                    if (element == nullptr || checker_.typeOf(*static_cast<const IfNode &>(value).elseBranch_) != ValueType::FLOAT)
+                    {
+                        return false;
+                    }
+                    reduction.type_ = ValueType::FLOAT;
+                }
+                if (element == nullptr || (reduction.type_ != ValueType::INT && reduction.type_ != ValueType::FLOAT) ||
+                    !expression(*element))
+                {
+                    return false;
+                }
+
+                // Every update of an accumulator must combine the same way
+                auto it = std::find_if(plan_.reductions_.begin(), plan_.reductions_.end(),
+                                       [&acc](const Reduction &existing)
+                                       { return existing.variable_ == acc; });
+                if (it == plan_.reductions_.end())
+                {
+                    plan_.reductions_.push_back(reduction);
+                    return true;
+                }
+                return it->kind_ == reduction.kind_ && it->isInclusive_ == reduction.isInclusive_;
+            }
+        };
+    }
+
+    std::unique_ptr<ParallelLoopPlan> planParallelLoop(const ForIterationNode &loop, const TypeChecker &checker)
+    {
+        auto plan = std::make_unique<ParallelLoopPlan>();
+        Analysis analysis(checker, *plan, loop.isParallel_);
+        for (const auto &statement : loop.body_)
+        {
+            if (!analysis.collectTargets(*statement))
+            {
+                return nullptr;
+            }
+        }
+        if (analysis.isTarget(loop.index_))
+        {
+            return nullptr;
+        }
+        for (const auto &statement : loop.body_)
+        {
+            if (!analysis.statement(*statement))
+            {
+                return nullptr;
+            }
+        }
+        // A loop that writes nothing has nothing to gain
+        if (plan->reductions_.empty() && plan->outputs_.empty())
+        {
+            return nullptr;
+        }
+        for (const auto &output : plan->outputs_)
+        {
+            bool isAccumulator = std::any_of(plan->reductions_.begin(), plan->reductions_.end(),
+                                             [&output](const Reduction &reduction)
+                                             { return reduction.variable_ == output; });
+            if (isAccumulator)
+            {
+                return nullptr;
+            }
+        }
+        return plan;
+    }
+
+    std::size_t iterationCount(long index, long end, long step)
+    {
+        if (step > 0 ? index > end : index < end)
+        {
+            return 0;
+        }
+        unsigned long distance = step > 0 ? static_cast<unsigned long>(end) - static_cast<unsigned long>(index)
+                                          : static_cast<unsigned long>(index) - static_cast<unsigned long>(end);
+        unsigned long stride = step > 0 ? static_cast<unsigned long>(step) : -static_cast<unsigned long>(step);
+        return distance / stride + 1;
+    }
+
+    std::vector<Value> partitionStart(const ParallelLoopPlan &plan)
+    {
+        std::vector<Value> values;
+        values.reserve(plan.reductions_.size() + plan.outputs_.size());
+        for (const Reduction &reduction : plan.reductions_)
+        {
+            switch (reduction.kind_)
+            {
+            case ReductionKind::SUM:
+                values.push_back(reduction.type_ == ValueType::INT ? Value(0L) : Value(0.0));
+                break;
+            case ReductionKind::MIN:
+                values.push_back(Value(std::numeric_limits<double>::infinity()));
+                break;
+            case ReductionKind::MAX:
+                values.push_back(Value(-std::numeric_limits<double>::infinity()));
+                break;
+            }
+        }
+        for (std::size_t i = 0; i < plan.outputs_.size(); ++i)
+        {
+            values.push_back(Value(DoubleVector()));
+        }
+        return values;
+    }
+
+    void combinePartitions(const ParallelLoopPlan &plan, const std::vector<std::vector<Value>> &partitions,
+                           const std::vector<Value *> &targets)
+    {
+        std::size_t position = 0;
+        for (const Reduction &reduction : plan.reductions_)
+        {
+            Value &total = *targets[position];
+            for (const auto &partition : partitions)
+            {
+                const Value &partial = partition[position];
+                if (reduction.kind_ == ReductionKind::SUM)
+                {
+                    total = reduction.type_ == ValueType::INT ? Value(total.asInt() + partial.asInt())
+                                                              : Value(total.asFloat() + partial.asFloat());
+                    continue;
+                }
+                // The same comparison the loop makes, so ties resolve as they would in order
+                double value = partial.asFloat();
+                double current = total.asFloat();
+                bool replace = reduction.kind_ == ReductionKind::MIN
+                                   ? (reduction.isInclusive_ ? value <= current : value < current)
+                                   : (reduction.isInclusive_ ? value >= current : value > current);
+                if (replace)
+                {
+                    total = partial;
+                }
+            }
+            ++position;
+        }
+        for (std::size_t i = 0; i < plan.outputs_.size(); ++i, ++position)
+        {
+            DoubleVector &output = targets[position]->asMutableVector();
+            std::size_t size = output.size();
+            for (const auto &partition : partitions)
+            {
+                size += partition[position].vectorSize();
+            }
+            output.reserve(size);
+            for (const auto &partition : partitions)
+            {
+                const DoubleVector &part = partition[position].asVector();
+                output.append(part.data(), part.size());
+            }
+        }
+    }
+
+} // namespace Shattang::MyLisp
@@ -0,0 +1,311 @@
+#include <Shattang/MyLisp/LoopVectorizer.h>
+#include <Shattang/MyLisp/ASTWalk.h>
+#include <Shattang/MyLisp/Builtins.h>
+
+#include <algorithm>
+#include <unordered_set>
+
+namespace Shattang::MyLisp
+{
+    namespace
+    {
+        const FunctionCallNode *asCall(const ASTNode &node, const std::string &name, std::size_t arity)
+        {
+            if (node.getType() != NodeType::FUNCTION_CALL)
+            {
+                return nullptr;
+            }
+            const auto &call = static_cast<const FunctionCallNode &>(node);
+            return call.functionName_ == name && call.arguments_.size() == arity ? &call : nullptr;
+        }
+
+        bool isSymbol(const ASTNode &node, const std::string &name)
+        {
+            return node.getType() == NodeType::SYMBOL && static_cast<const SymbolNode &>(node).name_ == name;
+        }
+
+        bool isIntegerOne(const ASTNode &node)
+        {
+            return node.getType() == NodeType::INTEGER && static_cast<const IntegerNode &>(node).value_ == 1;
+        }
+
+        std::unordered_set<std::string> writtenVariables(const std::vector<std::unique_ptr<ASTNode>> &body)
+        {
+            std::unordered_set<std::string> written;
+            for (const auto &statement : body)
+            {
+                collectWrittenVariables(*statement, written);
+            }
+            return written;
+        }
+
+        class Planner
+        {
+        public:
+            Planner(const TypeChecker &checker, VectorLoopPlan &plan, std::unordered_set<std::string> written)
+                : checker_(checker), plan_(plan), written_(std::move(written)) {}
+
+            // True if `node` has the same value on every iteration and no side effects
+            bool isInvariant(const ASTNode &node) const
+            {
+                switch (node.getType())
+                {
+                case NodeType::INTEGER:
+                case NodeType::FLOAT:
+                case NodeType::BOOLEAN:
+                    return true;
+                case NodeType::SYMBOL:
+                    return written_.count(static_cast<const SymbolNode &>(node).name_) == 0;
+                case NodeType::FUNCTION_CALL:
+                {
+                    const auto &call = static_cast<const FunctionCallNode &>(node);
+                    const Builtin *builtin = findBuiltin(call.functionName_);
+                    if (builtin == nullptr || !(builtin->isScalar_ || call.functionName_ == "length"))
+                    {
+                        return false;
+                    }
+                    return std::all_of(call.arguments_.begin(), call.arguments_.end(),
+                                       [this](const auto &arg)
+                                       { return isInvariant(*arg); });
+                }
+                default:
+                    return false;
+                }
+            }
+
+            std::unique_ptr<ElementExpression> element(const ASTNode &node)
+            {
+                auto result = std::make_unique<ElementExpression>();
+                if (isInvariant(node))
+                {
+                    if (!isNumericType(checker_.typeOf(node)))
+                    {
+                        return nullptr;
+                    }
+                    result->kind_ = ElementExpression::Kind::INVARIANT;
+                    result->invariant_ = &node;
+                    return result;
+                }
+
+                if (const FunctionCallNode *ref = asCall(node, "vector-ref", 2))
+                {
+                    const ASTNode &vector = *ref->arguments_[0];
+                    if (vector.getType() != NodeType::SYMBOL || !isInvariant(vector) ||
+                        !isSymbol(*ref->arguments_[1], plan_.index_))
+                    {
+                        return nullptr;
+                    }
+                    result->kind_ = ElementExpression::Kind::ELEMENT;
+                    result->vector_ = static_cast<const SymbolNode &>(vector).name_;
+                    if (std::find(plan_.inputs_.begin(), plan_.inputs_.end(), result->vector_) == plan_.inputs_.end())
+                    {
+                        plan_.inputs_.push_back(result->vector_);
+                    }
+                    return result;
+                }
+
+                static const std::pair<const char *, ElementExpression::Kind> operations[] = {
+                    {"add", ElementExpression::Kind::ADD},
+                    {"subtract", ElementExpression::Kind::SUBTRACT},
+                    {"multiply", ElementExpression::Kind::MULTIPLY},
+                    {"divide", ElementExpression::Kind::DIVIDE},
+                };
+                for (const auto &[name, kind] : operations)
+                {
+                    if (const FunctionCallNode *call = asCall(node, name, 2))
+                    {
+                        result->kind_ = kind;
+                        result->lhs_ = element(*call->arguments_[0]);
+                        result->rhs_ = element(*call->arguments_[1]);
+                        return result->lhs_ && result->rhs_ ? std::move(result) : nullptr;
+                    }
+                }
+                return nullptr;
+            }
+
+            // Fills in kind_, target_ and element_ from the single statement of the loop body
+            bool statement(const ASTNode &node)
+            {
+                if (const FunctionCallNode *push = asCall(node, "vector-push", 2))
+                {
+                    if (push->arguments_[0]->getType() != NodeType::SYMBOL)
+                    {
+                        return false;
+                    }
+                    plan_.kind_ = VectorLoopKind::MAP;
+                    plan_.target_ = static_cast<const SymbolNode &>(*push->arguments_[0]).name_;
+                    return setElement(*push->arguments_[1]);
+                }
+
+                if (node.getType() != NodeType::VARIABLE_ASSIGNMENT)
+                {
+                    return false;
+                }
+                const auto &assignment = static_cast<const VariableAssignmentNode &>(node);
+                const std::string &acc = assignment.variableName_;
+                plan_.target_ = acc;
+                const ASTNode &value = *assignment.valueNode_;
+
+                if (const FunctionCallNode *add = asCall(value, "add", 2))
+                {
+                    const ASTNode &lhs = *add->arguments_[0];
+                    const ASTNode &rhs = *add->arguments_[1];
+                    const ASTNode *accumulator = isSymbol(lhs, acc) ? &lhs : isSymbol(rhs, acc) ? &rhs : nullptr;
+                    if (accumulator == nullptr || checker_.typeOf(*accumulator) != ValueType::FLOAT)
+                    {
+                        return false;
+                    }
+                    plan_.kind_ = VectorLoopKind::SUM;
+                    return setElement(accumulator == &lhs ? rhs : lhs);
+                }
+
+                if (value.getType() == NodeType::IF)
+                {
+                    return selection(static_cast<const IfNode &>(value), acc);
+                }
+                return false;
+            }
+
+        private:
+            const TypeChecker &checker_;
+            VectorLoopPlan &plan_;
+            std::unordered_set<std::string> written_;
+
+            bool setElement(const ASTNode &node)
+            {
+                plan_.element_ = element(node);
+                // A loop without any vector element is not worth vectorizing
+                return plan_.element_ != nullptr && !plan_.inputs_.empty();
+            }
+
+            bool selection(const IfNode &node, const std::string &acc)
+            {
+                bool isMin = false;
+                bool isInclusive = false;
+                const ASTNode *element = matchSelection(node, acc, isMin, isInclusive);
+                if (element == nullptr || checker_.typeOf(*node.elseBranch_) != ValueType::FLOAT)
+                {
+                    return false;
+                }
+                plan_.kind_ = isMin ? VectorLoopKind::MIN : VectorLoopKind::MAX;
+                return setElement(*element);
+            }
+        };
+    }
+
+    const ASTNode *matchSelection(const ASTNode &value, const std::string &acc, bool &isMin, bool &isInclusive)
+    {
+        if (value.getType() != NodeType::IF)
+        {
+            return nullptr;
+        }
+        const auto &node = static_cast<const IfNode &>(value);
+        if (node.condition_->getType() != NodeType::FUNCTION_CALL || !isSymbol(*node.elseBranch_, acc))
+        {
+            return nullptr;
+        }
+        const auto &condition = static_cast<const FunctionCallNode &>(*node.condition_);
+        const std::string &op = condition.functionName_;
+        bool less = op == "less-than" || op == "less-equal";
+        if ((!less && op != "greater-than" && op != "greater-equal") || condition.arguments_.size() != 2)
+        {
+            return nullptr;
+        }
+
+        const ASTNode &lhs = *condition.arguments_[0];
+        const ASTNode &rhs = *condition.arguments_[1];
+        const ASTNode *element = nullptr;
+        if (isSymbol(rhs, acc))
+        {
+            element = &lhs;
+        }
+        else if (isSymbol(lhs, acc))
+        {
+            element = &rhs;
+            less = !less;
+        }
+        if (element == nullptr || element->toString() != node.thenBranch_->toString())
+        {
+            return nullptr;
+        }
+        isMin = less;
+        isInclusive = op == "less-equal" || op == "greater-equal";
+        return element;
+    }
+
+    std::unique_ptr<VectorLoopPlan> planVectorLoop(const ASTNode &loop, const TypeChecker &checker)
+    {
+        auto plan = std::make_unique<VectorLoopPlan>();
+
+        if (loop.getType() == NodeType::FOR_ITERATION)
+        {
+            const auto &forNode = static_cast<const ForIterationNode &>(loop);
+            if (!isIntegerOne(*forNode.step_) || forNode.body_.size() != 1)
+            {
+                return nullptr;
+            }
+            std::unordered_set<std::string> written = writtenVariables(forNode.body_);
+            if (written.count(forNode.index_) != 0)
+            {
+                return nullptr;
+            }
+            plan->index_ = forNode.index_;
+            written.insert(forNode.index_);
+            Planner planner(checker, *plan, std::move(written));
+            return planner.statement(*forNode.body_[0]) ? std::move(plan) : nullptr;
+        }
+
+        if (loop.getType() == NodeType::WHILE_ITERATION)
+        {
+            const auto &whileNode = static_cast<const WhileIterationNode &>(loop);
+            if (whileNode.body_.size() != 2 || whileNode.condition_->getType() != NodeType::FUNCTION_CALL)
+            {
+                return nullptr;
+            }
+            const auto &condition = static_cast<const FunctionCallNode &>(*whileNode.condition_);
+            bool inclusive = condition.functionName_ == "less-equal";
+            if ((!inclusive && condition.functionName_ != "less-than") || condition.arguments_.size() != 2 ||
+                condition.arguments_[0]->getType() != NodeType::SYMBOL ||
+                checker.typeOf(*condition.arguments_[0]) != ValueType::INT)
+            {
+                return nullptr;
+            }
+            const std::string &index = static_cast<const SymbolNode &>(*condition.arguments_[0]).name_;
+
+            // The last statement must be the only write to the index: (set i (add i 1))
+            const ASTNode &increment = *whileNode.body_[1];
+            if (increment.getType() != NodeType::VARIABLE_ASSIGNMENT ||
+                static_cast<const VariableAssignmentNode &>(increment).variableName_ != index)
+            {
+                return nullptr;
+            }
+            const FunctionCallNode *add = asCall(*static_cast<const VariableAssignmentNode &>(increment).valueNode_, "add", 2);
+            if (add == nullptr || !((isSymbol(*add->arguments_[0], index) && isIntegerOne(*add->arguments_[1])) ||
+                                    (isIntegerOne(*add->arguments_[0]) && isSymbol(*add->arguments_[1], index))))
+            {
+                return nullptr;
+            }
+
+            std::unordered_set<std::string> payloadWrites;
+            collectWrittenVariables(*whileNode.body_[0], payloadWrites);
+            if (payloadWrites.count(index) != 0)
+            {
+                return nullptr;
+            }
+            std::unordered_set<std::string> written = writtenVariables(whileNode.body_);
+
+            plan->index_ = index;
+            plan->bound_ = condition.arguments_[1].get();
+            plan->inclusiveBound_ = inclusive;
+            Planner planner(checker, *plan, std::move(written));
+            if (!planner.isInvariant(*plan->bound_) || checker.typeOf(*plan->bound_) != ValueType::INT)
+            {
+                return nullptr;
+            }
+            return planner.statement(*whileNode.body_[0]) ? std::move(plan) : nullptr;
+        }
+
+        return nullptr;
+    }
+
+} // namespace Shattang::MyLisp
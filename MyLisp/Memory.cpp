@@ -0,0 +1,205 @@
+#include <Shattang/MyLisp/Memory.h>
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <mutex>
+#include <new>
+
+namespace Shattang::MyLisp
+{
+    namespace
+    {
+        constexpr std::size_t ClassCount =
+            std::countr_zero(BlockPool::LargestBlock) - std::countr_zero(BlockPool::SmallestBlock) + 1;
+
+        // New blocks of a class are carved out of chunks of this size
+        constexpr std::size_t ChunkBytes = 256 * 1024;
+        static_assert(ChunkBytes % BlockPool::LargestBlock == 0);
+
+        // About this many bytes of blocks move between a thread and the shared lists at a time
+        constexpr std::size_t BatchBytes = 16 * 1024;
+
+        struct FreeBlock
+        {
+            FreeBlock *next_;
+        };
+
+        struct FreeList
+        {
+            FreeBlock *head_ = nullptr;
+            std::size_t count_ = 0;
+
+            void push(void *pointer)
+            {
+                auto *block = static_cast<FreeBlock *>(pointer);
+                block->next_ = head_;
+                head_ = block;
+                ++count_;
+            }
+
+            void *pop()
+            {
+                FreeBlock *block = head_;
+                head_ = block->next_;
+                --count_;
+                return block;
+            }
+
+            // Moves up to `count` blocks from the front of `from` to this list
+            void take(FreeList &from, std::size_t count)
+            {
+                for (; count > 0 && from.head_ != nullptr; --count)
+                {
+                    push(from.pop());
+                }
+            }
+        };
+
+        std::size_t blockSize(std::size_t sizeClass)
+        {
+            return BlockPool::SmallestBlock << sizeClass;
+        }
+
+        std::size_t batchSize(std::size_t sizeClass)
+        {
+            return std::clamp<std::size_t>(BatchBytes / blockSize(sizeClass), 2, 64);
+        }
+
+        std::size_t sizeClassOf(std::size_t bytes, std::size_t alignment)
+        {
+            std::size_t size = std::bit_ceil(std::max({bytes, alignment, BlockPool::SmallestBlock}));
+            return std::countr_zero(size) - std::countr_zero(BlockPool::SmallestBlock);
+        }
+
+        bool isSmall(std::size_t bytes, std::size_t alignment)
+        {
+            return bytes <= BlockPool::LargestBlock && alignment <= BlockPool::MaxAlignment;
+        }
+
+        std::align_val_t largeAlignment(std::size_t alignment)
+        {
+            return std::align_val_t(std::max(alignment, alignof(std::max_align_t)));
+        }
+
+        // The free lists every thread trades with
+        class SharedLists
+        {
+        public:
+            // Moves up to `count` blocks of `sizeClass` to `to`, carving a new chunk if none are free
+            void acquire(std::size_t sizeClass, FreeList &to, std::size_t count)
+            {
+                std::lock_guard lock(mutex_);
+                FreeList &list = lists_[sizeClass];
+                if (list.head_ == nullptr)
+                {
+                    // Chunks are never given back, since their blocks may be in use on any thread
+                    auto *chunk = static_cast<char *>(::operator new(ChunkBytes, std::align_val_t(BlockPool::MaxAlignment)));
+                    std::size_t size = blockSize(sizeClass);
+                    for (std::size_t offset = ChunkBytes; offset > 0; offset -= size)
+                    {
+                        list.push(chunk + offset - size);
+                    }
+                }
+                to.take(list, count);
+            }
+
+            void release(std::size_t sizeClass, FreeList &from, std::size_t count)
+            {
+                std::lock_guard lock(mutex_);
+                lists_[sizeClass].take(from, count);
+            }
+
+        private:
+            std::mutex mutex_;
+            std::array<FreeList, ClassCount> lists_;
+        };
+
+        SharedLists &sharedLists()
+        {
+            static SharedLists *lists = new SharedLists;
+            return *lists;
+        }
+
+        // Set once the thread's cache is gone; later requests on the thread use the shared lists
+        thread_local bool cacheRetired = false;
+
+        struct ThreadCache
+        {
+            std::array<FreeList, ClassCount> lists_;
+
+            ~ThreadCache()
+            {
+                for (std::size_t sizeClass = 0; sizeClass < ClassCount; ++sizeClass)
+                {
+                    sharedLists().release(sizeClass, lists_[sizeClass], lists_[sizeClass].count_);
+                }
+                cacheRetired = true;
+            }
+        };
+
+        ThreadCache *threadCache()
+        {
+            if (cacheRetired)
+            {
+                return nullptr;
+            }
+            thread_local ThreadCache cache;
+            return &cache;
+        }
+    }
+
+    void *BlockPool::do_allocate(std::size_t bytes, std::size_t alignment)
+    {
+        if (!isSmall(bytes, alignment))
+        {
+            return ::operator new(bytes, largeAlignment(alignment));
+        }
+        std::size_t sizeClass = sizeClassOf(bytes, alignment);
+        ThreadCache *cache = threadCache();
+        if (cache == nullptr)
+        {
+            FreeList single;
+            sharedLists().acquire(sizeClass, single, 1);
+            return single.pop();
+        }
+        FreeList &list = cache->lists_[sizeClass];
+        if (list.head_ == nullptr)
+        {
+            sharedLists().acquire(sizeClass, list, batchSize(sizeClass));
+        }
+        return list.pop();
+    }
+
+    void BlockPool::do_deallocate(void *pointer, std::size_t bytes, std::size_t alignment)
+    {
+        if (!isSmall(bytes, alignment))
+        {
+            ::operator delete(pointer, largeAlignment(alignment));
+            return;
+        }
+        std::size_t sizeClass = sizeClassOf(bytes, alignment);
+        ThreadCache *cache = threadCache();
+        if (cache == nullptr)
+        {
+            FreeList single;
+            single.push(pointer);
+            sharedLists().release(sizeClass, single, 1);
+            return;
+        }
+        FreeList &list = cache->lists_[sizeClass];
+        list.push(pointer);
+        // A thread that frees more than it allocates hands the surplus back
+        if (list.count_ > 2 * batchSize(sizeClass))
+        {
+            sharedLists().release(sizeClass, list, batchSize(sizeClass));
+        }
+    }
+
+    BlockPool &runtimePool()
+    {
+        static BlockPool *pool = new BlockPool;
+        return *pool;
+    }
+
+} // namespace Shattang::MyLisp
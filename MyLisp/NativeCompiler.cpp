@@ -0,0 +1,1116 @@
+#include <Shattang/MyLisp/NativeCompiler.h>
+#include <Shattang/MyLisp/Builtins.h>
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstring>
+#include <limits>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+
+#if defined(__x86_64__) && defined(__unix__)
+#define MYLISP_NATIVE_X86_64 1
+#include <sys/mman.h>
+#include <unistd.h>
+#else
+#define MYLISP_NATIVE_X86_64 0
+#endif
+
+namespace Shattang::MyLisp
+{
+    static_assert(offsetof(NativeContext, cancelled_) == 0 && offsetof(NativeContext, depthBudget_) == 8,
+                  "NativeContext is read by generated code");
+
+    namespace
+    {
+        [[noreturn]] void throwError(const std::string &message)
+        {
+            throw std::runtime_error("Compile error: " + message);
+        }
+
+        // General purpose registers by their encoding; the XMM registers share it
+        enum Register
+        {
+            RAX = 0,
+            RCX = 1,
+            RDX = 2,
+            RBX = 3,
+            RSP = 4,
+            RBP = 5,
+            RSI = 6,
+            RDI = 7,
+            R12 = 12,
+            XMM0 = 0,
+            XMM1 = 1
+        };
+
+        // Condition codes as encoded in Jcc and SETcc
+        enum Condition
+        {
+            ABOVE_EQUAL = 0x3,
+            EQUAL = 0x4,
+            NOT_EQUAL = 0x5,
+            ABOVE = 0x7,
+            SIGN = 0x8,
+            PARITY = 0xA,
+            NO_PARITY = 0xB,
+            LESS = 0xC,
+            GREATER_EQUAL = 0xD,
+            LESS_EQUAL = 0xE,
+            GREATER = 0xF
+        };
+
+        // Emits the x86-64 instructions the native tier uses. Memory operands are always
+        // [base + disp32]; jumps and calls go to labels that finish() resolves.
+        class Assembler
+        {
+        public:
+            int newLabel()
+            {
+                labels_.emplace_back();
+                return static_cast<int>(labels_.size() - 1);
+            }
+
+            void bind(int label) { labels_[label].position_ = bytes_.size(); }
+
+            std::vector<unsigned char> finish()
+            {
+                for (const Label &label : labels_)
+                {
+                    for (std::size_t use : label.uses_)
+                    {
+                        if (label.position_ == Unbound)
+                        {
+                            throwError("jump to an unbound label");
+                        }
+                        patch32(use, static_cast<std::int32_t>(static_cast<long>(label.position_) - static_cast<long>(use + 4)));
+                    }
+                }
+                return std::move(bytes_);
+            }
+
+            void patch32(std::size_t at, std::int32_t value)
+            {
+                for (int i = 0; i < 4; ++i)
+                {
+                    bytes_[at + i] = static_cast<unsigned char>(static_cast<std::uint32_t>(value) >> (8 * i));
+                }
+            }
+
+            void push(Register reg)
+            {
+                rex(false, 0, reg);
+                byte(0x50 + (reg & 7));
+            }
+
+            void pop(Register reg)
+            {
+                rex(false, 0, reg);
+                byte(0x58 + (reg & 7));
+            }
+
+            void ret() { byte(0xC3); }
+
+            void move(Register dst, Register src) { registerForm(0x89, src, dst); }
+            void load(Register dst, Register base, std::int32_t disp) { memoryForm(true, 0x8B, dst, base, disp); }
+            void store(Register base, std::int32_t disp, Register src) { memoryForm(true, 0x89, src, base, disp); }
+            void lea(Register dst, Register base, std::int32_t disp) { memoryForm(true, 0x8D, dst, base, disp); }
+
+            void moveImmediate(Register dst, std::int64_t value)
+            {
+                rex(true, 0, dst);
+                if (value >= INT32_MIN && value <= INT32_MAX)
+                {
+                    byte(0xC7);
+                    registerOperand(0, dst);
+                    imm32(value);
+                    return;
+                }
+                byte(0xB8 + (dst & 7));
+                for (int i = 0; i < 8; ++i)
+                {
+                    byte(static_cast<unsigned>(static_cast<std::uint64_t>(value) >> (8 * i)) & 0xFF);
+                }
+            }
+
+            // dst op= src on 64-bit integers; cmp sets the flags of dst - src
+            void add(Register dst, Register src) { registerForm(0x01, src, dst); }
+            void sub(Register dst, Register src) { registerForm(0x29, src, dst); }
+            void cmp(Register dst, Register src) { registerForm(0x39, src, dst); }
+            void test(Register lhs, Register rhs) { registerForm(0x85, rhs, lhs); }
+
+            void imul(Register dst, Register src)
+            {
+                rex(true, dst, src);
+                byte(0x0F);
+                byte(0xAF);
+                registerOperand(dst, src);
+            }
+
+            // rdx:rax / divisor, leaving the quotient in rax and the remainder in rdx
+            void signedDivide(Register divisor)
+            {
+                byte(0x48); // cqo
+                byte(0x99);
+                rex(true, 0, divisor);
+                byte(0xF7);
+                registerOperand(7, divisor);
+            }
+
+            // Returns where the immediate is, so that the frame size can be patched in later
+            std::size_t subImmediate(Register dst, std::int32_t value)
+            {
+                rex(true, 0, dst);
+                byte(0x81);
+                registerOperand(5, dst);
+                std::size_t at = bytes_.size();
+                imm32(value);
+                return at;
+            }
+
+            void incrementMemory(Register base, std::int32_t disp) { memoryForm(true, 0xFF, 0, base, disp); }
+            void decrementMemory(Register base, std::int32_t disp) { memoryForm(true, 0xFF, 1, base, disp); }
+
+            void compareByteMemory(Register base, std::int32_t disp, unsigned char value)
+            {
+                memoryForm(false, 0x80, 7, base, disp);
+                byte(value);
+            }
+
+            // The low byte of rax, rcx, rdx or rbx
+            void setIf(Condition condition, Register dst)
+            {
+                byte(0x0F);
+                byte(0x90 + condition);
+                registerOperand(0, dst);
+            }
+
+            void zeroExtendByte(Register dst, Register src)
+            {
+                byte(0x0F);
+                byte(0xB6);
+                registerOperand(dst, src);
+            }
+
+            void andByte(Register dst, Register src)
+            {
+                byte(0x20);
+                registerOperand(src, dst);
+            }
+
+            void orByte(Register dst, Register src)
+            {
+                byte(0x08);
+                registerOperand(src, dst);
+            }
+
+            void xorImmediate(Register dst, unsigned char value)
+            {
+                rex(true, 0, dst);
+                byte(0x83);
+                registerOperand(6, dst);
+                byte(value);
+            }
+
+            // Scalar double precision SSE2
+            void addsd(Register dst, Register src) { sse(0xF2, 0x58, dst, src); }
+            void subsd(Register dst, Register src) { sse(0xF2, 0x5C, dst, src); }
+            void mulsd(Register dst, Register src) { sse(0xF2, 0x59, dst, src); }
+            void divsd(Register dst, Register src) { sse(0xF2, 0x5E, dst, src); }
+            void sqrtsd(Register dst, Register src) { sse(0xF2, 0x51, dst, src); }
+            void ucomisd(Register lhs, Register rhs) { sse(0x66, 0x2E, lhs, rhs); }
+            void movapd(Register dst, Register src) { sse(0x66, 0x28, dst, src); }
+
+            void loadDouble(Register dst, Register base, std::int32_t disp)
+            {
+                byte(0xF2);
+                memoryForm(false, 0x0F10, dst, base, disp);
+            }
+
+            void storeDouble(Register base, std::int32_t disp, Register src)
+            {
+                byte(0xF2);
+                memoryForm(false, 0x0F11, src, base, disp);
+            }
+
+            // Converts a 64-bit integer register to a double
+            void cvtsi2sd(Register dst, Register src)
+            {
+                byte(0xF2);
+                rex(true, dst, src);
+                byte(0x0F);
+                byte(0x2A);
+                registerOperand(dst, src);
+            }
+
+            // Converts a double to a 64-bit integer, truncating; NaN and out of range give INT64_MIN
+            void cvttsd2si(Register dst, Register src)
+            {
+                byte(0xF2);
+                rex(true, dst, src);
+                byte(0x0F);
+                byte(0x2C);
+                registerOperand(dst, src);
+            }
+
+            // Moves the bits of a 64-bit integer register into an XMM register
+            void movq(Register dst, Register src)
+            {
+                byte(0x66);
+                rex(true, dst, src);
+                byte(0x0F);
+                byte(0x6E);
+                registerOperand(dst, src);
+            }
+
+            void jump(int label)
+            {
+                byte(0xE9);
+                use(label);
+            }
+
+            void jumpIf(Condition condition, int label)
+            {
+                byte(0x0F);
+                byte(0x80 + condition);
+                use(label);
+            }
+
+            void call(int label)
+            {
+                byte(0xE8);
+                use(label);
+            }
+
+        private:
+            static constexpr std::size_t Unbound = static_cast<std::size_t>(-1);
+
+            struct Label
+            {
+                std::size_t position_ = Unbound;
+                std::vector<std::size_t> uses_; // rel32 fields that jump here
+            };
+
+            std::vector<unsigned char> bytes_;
+            std::vector<Label> labels_;
+
+            void byte(unsigned value) { bytes_.push_back(static_cast<unsigned char>(value)); }
+
+            void imm32(std::int64_t value)
+            {
+                for (int i = 0; i < 4; ++i)
+                {
+                    byte(static_cast<unsigned>(static_cast<std::uint64_t>(value) >> (8 * i)) & 0xFF);
+                }
+            }
+
+            void use(int label)
+            {
+                labels_[label].uses_.push_back(bytes_.size());
+                imm32(0);
+            }
+
+            // W selects 64-bit operands; R and B extend the ModRM reg and rm fields to r8-r15
+            void rex(bool wide, int reg, int rm)
+            {
+                unsigned value = 0x40 | (wide ? 8 : 0) | ((reg & 8) != 0 ? 4 : 0) | ((rm & 8) != 0 ? 1 : 0);
+                if (value != 0x40)
+                {
+                    byte(value);
+                }
+            }
+
+            void registerOperand(int reg, int rm) { byte(0xC0 | ((reg & 7) << 3) | (rm & 7)); }
+
+            // [base + disp32]; rsp and r12 as a base need a SIB byte
+            void memoryOperand(int reg, int base, std::int32_t disp)
+            {
+                byte(0x80 | ((reg & 7) << 3) | (base & 7));
+                if ((base & 7) == 4)
+                {
+                    byte(0x24);
+                }
+                imm32(disp);
+            }
+
+            void registerForm(unsigned opcode, int reg, int rm)
+            {
+                rex(true, reg, rm);
+                byte(opcode);
+                registerOperand(reg, rm);
+            }
+
+            // `opcode` is one byte, or 0x0Fxx for the two byte opcodes
+            void memoryForm(bool wide, unsigned opcode, int reg, int base, std::int32_t disp)
+            {
+                rex(wide, reg, base);
+                if (opcode > 0xFF)
+                {
+                    byte(opcode >> 8);
+                }
+                byte(opcode & 0xFF);
+                memoryOperand(reg, base, disp);
+            }
+
+            void sse(unsigned prefix, unsigned opcode, int reg, int rm)
+            {
+                byte(prefix);
+                rex(false, reg, rm);
+                byte(0x0F);
+                byte(opcode);
+                registerOperand(reg, rm);
+            }
+        };
+
+        // Slot k of a frame is the quadword at [rbp - 24 - 8k], below the saved rbx and r12
+        std::int32_t slotOffset(int slot)
+        {
+            return -24 - 8 * slot;
+        }
+
+        // Compiles a function and, on demand, each function it calls into one piece of code that
+        // starts with the first. Every function is entered as NativeFunction::Entry:
+        //   rdi = NativeContext, rsi = arguments, rdx = where the result goes, eax = status
+        // and keeps the context in rbx and the result pointer in r12. Values are computed into rax
+        // (Int and Boolean, as 0 or 1) or xmm0 (Float); anything still needed while another value
+        // is computed is kept in a frame slot, so no register is live across a call.
+        class NativeCompiler
+        {
+        public:
+            explicit NativeCompiler(const TypeChecker &checker) : checker_(checker) {}
+
+            std::vector<unsigned char> compile(const FunctionDeclarationNode &function)
+            {
+                functionLabel(function);
+                for (std::size_t next = 0; next < pending_.size(); ++next)
+                {
+                    compileFunction(*pending_[next]);
+                }
+                return assembler_.finish();
+            }
+
+        private:
+            const TypeChecker &checker_;
+            Assembler assembler_;
+            std::unordered_map<const FunctionDeclarationNode *, int> functionLabels_;
+            std::vector<const FunctionDeclarationNode *> pending_; // in the order they are emitted
+
+            const FunctionTypeInfo *function_ = nullptr;
+            std::unordered_map<std::string, int> localSlots_;
+            std::vector<std::unordered_set<std::string>> blocks_; // locals declared in each enclosing block
+            int slotCount_ = 0;
+            int maxSlots_ = 0;
+            int deoptimize_ = -1;
+
+            int functionLabel(const FunctionDeclarationNode &function)
+            {
+                auto [it, inserted] = functionLabels_.emplace(&function, 0);
+                if (inserted)
+                {
+                    it->second = assembler_.newLabel();
+                    pending_.push_back(&function);
+                }
+                return it->second;
+            }
+
+            void compileFunction(const FunctionDeclarationNode &node)
+            {
+                function_ = checker_.function(node.functionName_);
+                if (function_ == nullptr || function_->declaration_ != &node)
+                {
+                    throwError("function '" + node.functionName_ + "' was not type checked");
+                }
+                if (!function_->isNumeric_ || !function_->isPure_)
+                {
+                    throwError("function '" + node.functionName_ + "' is not numeric and pure");
+                }
+
+                // Locals keep one slot for the whole call; temporaries are allocated above them
+                localSlots_.clear();
+                for (const auto &[name, type] : function_->locals_)
+                {
+                    localSlots_.emplace(name, static_cast<int>(localSlots_.size()));
+                }
+                slotCount_ = maxSlots_ = static_cast<int>(localSlots_.size());
+                blocks_.assign(1, {});
+                deoptimize_ = assembler_.newLabel();
+                int exit = assembler_.newLabel();
+
+                assembler_.bind(functionLabels_.at(&node));
+                assembler_.push(RBP);
+                assembler_.move(RBP, RSP);
+                assembler_.push(RBX);
+                assembler_.push(R12);
+                std::size_t frameSize = assembler_.subImmediate(RSP, 0);
+                assembler_.move(RBX, RDI);
+                assembler_.move(R12, RDX);
+                assembler_.decrementMemory(RBX, offsetof(NativeContext, depthBudget_));
+                assembler_.jumpIf(SIGN, deoptimize_);
+                emitCancellationCheck();
+                for (std::size_t i = 0; i < node.parameters_.size(); ++i)
+                {
+                    assembler_.load(RAX, RSI, static_cast<std::int32_t>(8 * i));
+                    assembler_.store(RBP, slotOffset(localSlots_.at(node.parameters_[i].name_)), RAX);
+                    declare(node.parameters_[i].name_);
+                }
+
+                for (std::size_t i = 0; i + 1 < node.body_.size(); ++i)
+                {
+                    emitStatement(*node.body_[i]);
+                }
+                emitExpression(*node.body_.back(), function_->returnType_);
+                if (function_->returnType_ == ValueType::FLOAT)
+                {
+                    assembler_.storeDouble(R12, 0, XMM0);
+                }
+                else
+                {
+                    assembler_.store(R12, 0, RAX);
+                }
+                assembler_.incrementMemory(RBX, offsetof(NativeContext, depthBudget_));
+                assembler_.moveImmediate(RAX, 0);
+
+                assembler_.bind(exit);
+                assembler_.lea(RSP, RBP, -16);
+                assembler_.pop(R12);
+                assembler_.pop(RBX);
+                assembler_.pop(RBP);
+                assembler_.ret();
+
+                assembler_.bind(deoptimize_);
+                assembler_.moveImmediate(RAX, 1);
+                assembler_.jump(exit);
+
+                // Keeps rsp 16-byte aligned at calls: the return address, rbp, rbx and r12 take 32 bytes
+                assembler_.patch32(frameSize, (8 * maxSlots_ + 15) / 16 * 16);
+            }
+
+            void emitCancellationCheck()
+            {
+                assembler_.load(RAX, RBX, offsetof(NativeContext, cancelled_));
+                assembler_.compareByteMemory(RAX, 0, 0);
+                assembler_.jumpIf(NOT_EQUAL, deoptimize_);
+            }
+
+            int allocateSlots(int count)
+            {
+                int first = slotCount_;
+                slotCount_ += count;
+                maxSlots_ = std::max(maxSlots_, slotCount_);
+                return first;
+            }
+
+            void releaseSlots(int count) { slotCount_ -= count; }
+
+            void declare(const std::string &name) { blocks_.back().insert(name); }
+
+            // A local that is declared in this block or an enclosing one. The walker keeps one
+            // Environment per call, so a name used elsewhere may be a global; those stay in tier 1.
+            int localSlot(const std::string &name) const
+            {
+                for (const auto &block : blocks_)
+                {
+                    if (block.count(name) != 0)
+                    {
+                        return localSlots_.at(name);
+                    }
+                }
+                throwError("'" + name + "' is not a local declared in an enclosing block");
+            }
+
+            ValueType localType(const std::string &name) const { return function_->locals_.at(name); }
+
+            // Moves the value just computed into `slot`, and back
+            void storeResult(int slot, ValueType type)
+            {
+                if (type == ValueType::FLOAT)
+                {
+                    assembler_.storeDouble(RBP, slotOffset(slot), XMM0);
+                }
+                else
+                {
+                    assembler_.store(RBP, slotOffset(slot), RAX);
+                }
+            }
+
+            void loadResult(int slot, ValueType type)
+            {
+                if (type == ValueType::FLOAT)
+                {
+                    assembler_.loadDouble(XMM0, RBP, slotOffset(slot));
+                }
+                else
+                {
+                    assembler_.load(RAX, RBP, slotOffset(slot));
+                }
+            }
+
+            void loadDoubleConstant(Register dst, double value, Register scratch)
+            {
+                assembler_.moveImmediate(scratch, std::bit_cast<std::int64_t>(value));
+                assembler_.movq(dst, scratch);
+            }
+
+            void emitStatement(const ASTNode &node)
+            {
+                switch (node.getType())
+                {
+                case NodeType::VARIABLE_DECLARATION:
+                {
+                    const auto &declaration = static_cast<const VariableDeclarationNode &>(node);
+                    ValueType type = ValueTypeFromName(declaration.typeNode_->name_);
+                    emitExpression(*declaration.valueNode_, type);
+                    storeResult(localSlots_.at(declaration.variableName_), type);
+                    declare(declaration.variableName_);
+                    return;
+                }
+                case NodeType::VARIABLE_ASSIGNMENT:
+                {
+                    const auto &assignment = static_cast<const VariableAssignmentNode &>(node);
+                    int slot = localSlot(assignment.variableName_);
+                    ValueType type = localType(assignment.variableName_);
+                    emitExpression(*assignment.valueNode_, type);
+                    storeResult(slot, type);
+                    return;
+                }
+                case NodeType::FOR_ITERATION:
+                    emitFor(static_cast<const ForIterationNode &>(node));
+                    return;
+                case NodeType::WHILE_ITERATION:
+                    emitWhile(static_cast<const WhileIterationNode &>(node));
+                    return;
+                case NodeType::IF:
+                    if (checker_.typeOf(node) == ValueType::VOID)
+                    {
+                        emitIf(static_cast<const IfNode &>(node), ValueType::VOID);
+                        return;
+                    }
+                    break;
+                default:
+                    break;
+                }
+
+                ValueType type = checker_.typeOf(node);
+                if (type == ValueType::VOID)
+                {
+                    throwError("cannot compile " + node.toString());
+                }
+                emitExpression(node, type); // for its effects; the value is dropped
+            }
+
+            // Leaves the value of `node` as `wanted` in rax or xmm0
+            void emitExpression(const ASTNode &node, ValueType wanted)
+            {
+                ValueType type = emitValue(node);
+                if (type == wanted)
+                {
+                    return;
+                }
+                if (type == ValueType::INT && wanted == ValueType::FLOAT)
+                {
+                    assembler_.cvtsi2sd(XMM0, RAX);
+                    return;
+                }
+                throwError("cannot use " + ValueTypeToString(type) + " as " + ValueTypeToString(wanted) + " in " +
+                           node.toString());
+            }
+
+            ValueType emitValue(const ASTNode &node)
+            {
+                switch (node.getType())
+                {
+                case NodeType::INTEGER:
+                    assembler_.moveImmediate(RAX, static_cast<const IntegerNode &>(node).value_);
+                    return ValueType::INT;
+                case NodeType::FLOAT:
+                    loadDoubleConstant(XMM0, static_cast<const FloatNode &>(node).value_, RAX);
+                    return ValueType::FLOAT;
+                case NodeType::BOOLEAN:
+                    assembler_.moveImmediate(RAX, static_cast<const BooleanNode &>(node).value_ ? 1 : 0);
+                    return ValueType::BOOLEAN;
+                case NodeType::SYMBOL:
+                {
+                    const std::string &name = static_cast<const SymbolNode &>(node).name_;
+                    int slot = localSlot(name);
+                    loadResult(slot, localType(name));
+                    return localType(name);
+                }
+                case NodeType::IF:
+                {
+                    ValueType type = checker_.typeOf(node);
+                    emitIf(static_cast<const IfNode &>(node), type);
+                    return type;
+                }
+                case NodeType::FUNCTION_CALL:
+                    return emitCall(static_cast<const FunctionCallNode &>(node));
+                default:
+                    throwError("cannot compile " + node.toString());
+                }
+            }
+
+            // With a Void `type` the branches are statements
+            void emitIf(const IfNode &node, ValueType type)
+            {
+                int otherwise = assembler_.newLabel();
+                int done = assembler_.newLabel();
+                emitExpression(*node.condition_, ValueType::BOOLEAN);
+                assembler_.test(RAX, RAX);
+                assembler_.jumpIf(EQUAL, otherwise);
+                emitBranch(*node.thenBranch_, type);
+                assembler_.jump(done);
+                assembler_.bind(otherwise);
+                emitBranch(*node.elseBranch_, type);
+                assembler_.bind(done);
+            }
+
+            void emitBranch(const ASTNode &node, ValueType type)
+            {
+                blocks_.emplace_back();
+                if (type == ValueType::VOID)
+                {
+                    emitStatement(node);
+                }
+                else
+                {
+                    emitExpression(node, type);
+                }
+                blocks_.pop_back();
+            }
+
+            void emitBody(const std::vector<std::unique_ptr<ASTNode>> &body)
+            {
+                blocks_.emplace_back();
+                for (const auto &statement : body)
+                {
+                    emitStatement(*statement);
+                }
+                blocks_.pop_back();
+            }
+
+            // As the walker runs it: bounds and step are evaluated once, the end bound is inclusive,
+            // and the next index is the index variable after the body plus the step
+            void emitFor(const ForIterationNode &node)
+            {
+                if (node.isParallel_)
+                {
+                    throwError("'pfor' has no native code");
+                }
+                int next = allocateSlots(3);
+                int end = next + 1;
+                int step = next + 2;
+                emitExpression(*node.start_, ValueType::INT);
+                storeResult(next, ValueType::INT);
+                emitExpression(*node.end_, ValueType::INT);
+                storeResult(end, ValueType::INT);
+                emitExpression(*node.step_, ValueType::INT);
+                storeResult(step, ValueType::INT);
+                assembler_.test(RAX, RAX);
+                assembler_.jumpIf(EQUAL, deoptimize_);
+                int index = localSlots_.at(node.index_);
+                assembler_.load(RAX, RBP, slotOffset(next));
+                assembler_.store(RBP, slotOffset(index), RAX);
+                declare(node.index_);
+
+                int top = assembler_.newLabel();
+                int body = assembler_.newLabel();
+                int done = assembler_.newLabel();
+                assembler_.bind(top);
+                assembler_.load(RAX, RBP, slotOffset(next));
+                assembler_.load(RDX, RBP, slotOffset(end));
+                if (node.step_->getType() == NodeType::INTEGER)
+                {
+                    bool upward = static_cast<const IntegerNode &>(*node.step_).value_ > 0;
+                    assembler_.cmp(RAX, RDX);
+                    assembler_.jumpIf(upward ? GREATER : LESS, done);
+                }
+                else
+                {
+                    int downward = assembler_.newLabel();
+                    assembler_.load(RCX, RBP, slotOffset(step));
+                    assembler_.test(RCX, RCX);
+                    assembler_.jumpIf(SIGN, downward);
+                    assembler_.cmp(RAX, RDX);
+                    assembler_.jumpIf(GREATER, done);
+                    assembler_.jump(body);
+                    assembler_.bind(downward);
+                    assembler_.cmp(RAX, RDX);
+                    assembler_.jumpIf(LESS, done);
+                }
+                assembler_.bind(body);
+                assembler_.store(RBP, slotOffset(index), RAX);
+                emitBody(node.body_);
+                assembler_.load(RAX, RBP, slotOffset(index));
+                assembler_.load(RCX, RBP, slotOffset(step));
+                assembler_.add(RAX, RCX);
+                assembler_.store(RBP, slotOffset(next), RAX);
+                emitCancellationCheck();
+                assembler_.jump(top);
+                assembler_.bind(done);
+                releaseSlots(3);
+            }
+
+            void emitWhile(const WhileIterationNode &node)
+            {
+                int top = assembler_.newLabel();
+                int done = assembler_.newLabel();
+                assembler_.bind(top);
+                emitExpression(*node.condition_, ValueType::BOOLEAN);
+                assembler_.test(RAX, RAX);
+                assembler_.jumpIf(EQUAL, done);
+                emitBody(node.body_);
+                emitCancellationCheck();
+                assembler_.jump(top);
+                assembler_.bind(done);
+            }
+
+            // Leaves `lhs` in rax or xmm0 and `rhs` in rcx or xmm1, both as `type`
+            void emitOperands(const ASTNode &lhs, const ASTNode &rhs, ValueType type)
+            {
+                emitExpression(lhs, type);
+                if (loadSimpleOperand(rhs, type))
+                {
+                    return;
+                }
+                int spill = allocateSlots(1);
+                storeResult(spill, type);
+                emitExpression(rhs, type);
+                if (type == ValueType::FLOAT)
+                {
+                    assembler_.movapd(XMM1, XMM0);
+                }
+                else
+                {
+                    assembler_.move(RCX, RAX);
+                }
+                loadResult(spill, type);
+                releaseSlots(1);
+            }
+
+            // Loads a literal or a local into rcx or xmm1 without touching rax and xmm0
+            bool loadSimpleOperand(const ASTNode &node, ValueType type)
+            {
+                switch (node.getType())
+                {
+                case NodeType::INTEGER:
+                {
+                    long value = static_cast<const IntegerNode &>(node).value_;
+                    if (type == ValueType::FLOAT)
+                    {
+                        loadDoubleConstant(XMM1, static_cast<double>(value), RCX);
+                    }
+                    else
+                    {
+                        assembler_.moveImmediate(RCX, value);
+                    }
+                    return true;
+                }
+                case NodeType::FLOAT:
+                    loadDoubleConstant(XMM1, static_cast<const FloatNode &>(node).value_, RCX);
+                    return true;
+                case NodeType::BOOLEAN:
+                    assembler_.moveImmediate(RCX, static_cast<const BooleanNode &>(node).value_ ? 1 : 0);
+                    return true;
+                case NodeType::SYMBOL:
+                {
+                    const std::string &name = static_cast<const SymbolNode &>(node).name_;
+                    std::int32_t offset = slotOffset(localSlot(name));
+                    if (type != ValueType::FLOAT)
+                    {
+                        assembler_.load(RCX, RBP, offset);
+                    }
+                    else if (localType(name) == ValueType::INT)
+                    {
+                        assembler_.load(RCX, RBP, offset);
+                        assembler_.cvtsi2sd(XMM1, RCX);
+                    }
+                    else
+                    {
+                        assembler_.loadDouble(XMM1, RBP, offset);
+                    }
+                    return true;
+                }
+                default:
+                    return false;
+                }
+            }
+
+            ValueType emitCall(const FunctionCallNode &node)
+            {
+                const std::string &name = node.functionName_;
+                const auto &args = node.arguments_;
+                ValueType type = checker_.typeOf(node);
+
+                if (name == "add" || name == "subtract" || name == "multiply" || name == "divide")
+                {
+                    emitOperands(*args[0], *args[1], type);
+                    bool isFloat = type == ValueType::FLOAT;
+                    if (name == "add")
+                        isFloat ? assembler_.addsd(XMM0, XMM1) : assembler_.add(RAX, RCX);
+                    else if (name == "subtract")
+                        isFloat ? assembler_.subsd(XMM0, XMM1) : assembler_.sub(RAX, RCX);
+                    else if (name == "multiply")
+                        isFloat ? assembler_.mulsd(XMM0, XMM1) : assembler_.imul(RAX, RCX);
+                    else if (isFloat)
+                        assembler_.divsd(XMM0, XMM1);
+                    else
+                        emitIntDivision(false);
+                    return type;
+                }
+                if (name == "modulo")
+                {
+                    emitOperands(*args[0], *args[1], ValueType::INT);
+                    emitIntDivision(true);
+                    return ValueType::INT;
+                }
+                if (name == "sqrt")
+                {
+                    emitExpression(*args[0], ValueType::FLOAT);
+                    assembler_.sqrtsd(XMM0, XMM0);
+                    return ValueType::FLOAT;
+                }
+                if (name == "to-int")
+                {
+                    if (emitValue(*args[0]) == ValueType::FLOAT)
+                    {
+                        // INT64_MIN may also be a real result; the lower tiers tell the two apart
+                        assembler_.cvttsd2si(RAX, XMM0);
+                        assembler_.moveImmediate(RCX, std::numeric_limits<std::int64_t>::min());
+                        assembler_.cmp(RAX, RCX);
+                        assembler_.jumpIf(EQUAL, deoptimize_);
+                    }
+                    return ValueType::INT;
+                }
+                if (name == "less-than" || name == "less-equal" || name == "greater-than" || name == "greater-equal" ||
+                    name == "equal" || name == "not-equal")
+                {
+                    emitComparison(node);
+                    return ValueType::BOOLEAN;
+                }
+                if (name == "and" || name == "or")
+                {
+                    // Short-circuits like the other tiers; the left value is the result when it decides
+                    int done = assembler_.newLabel();
+                    emitExpression(*args[0], ValueType::BOOLEAN);
+                    assembler_.test(RAX, RAX);
+                    assembler_.jumpIf(name == "and" ? EQUAL : NOT_EQUAL, done);
+                    emitExpression(*args[1], ValueType::BOOLEAN);
+                    assembler_.bind(done);
+                    return ValueType::BOOLEAN;
+                }
+                if (name == "not")
+                {
+                    emitExpression(*args[0], ValueType::BOOLEAN);
+                    assembler_.xorImmediate(RAX, 1);
+                    return ValueType::BOOLEAN;
+                }
+                if (findBuiltin(name) != nullptr || takesFunctionName(name))
+                {
+                    throwError("'" + name + "' has no native code");
+                }
+                return emitFunctionCall(node);
+            }
+
+            // rax / rcx; a zero divisor deoptimizes so that a lower tier reports it, and so does -1,
+            // since idiv traps on INT64_MIN / -1 where the lower tiers wrap
+            void emitIntDivision(bool remainder)
+            {
+                assembler_.test(RCX, RCX);
+                assembler_.jumpIf(EQUAL, deoptimize_);
+                assembler_.moveImmediate(RDX, -1);
+                assembler_.cmp(RCX, RDX);
+                assembler_.jumpIf(EQUAL, deoptimize_);
+                assembler_.signedDivide(RCX);
+                if (remainder)
+                {
+                    assembler_.move(RAX, RDX);
+                }
+            }
+
+            // Int and Boolean operands compare as integers, anything with a Float as doubles, where
+            // every comparison with NaN is false except not-equal
+            void emitComparison(const FunctionCallNode &node)
+            {
+                const std::string &name = node.functionName_;
+                ValueType lhs = checker_.typeOf(*node.arguments_[0]);
+                ValueType rhs = checker_.typeOf(*node.arguments_[1]);
+                ValueType type = lhs == ValueType::FLOAT || rhs == ValueType::FLOAT ? ValueType::FLOAT : lhs;
+                emitOperands(*node.arguments_[0], *node.arguments_[1], type);
+
+                if (type != ValueType::FLOAT)
+                {
+                    static const std::unordered_map<std::string, Condition> conditions = {
+                        {"less-than", LESS}, {"less-equal", LESS_EQUAL}, {"greater-than", GREATER},
+                        {"greater-equal", GREATER_EQUAL}, {"equal", EQUAL}, {"not-equal", NOT_EQUAL}};
+                    assembler_.cmp(RAX, RCX);
+                    assembler_.setIf(conditions.at(name), RAX);
+                }
+                else if (name == "equal" || name == "not-equal")
+                {
+                    bool equal = name == "equal";
+                    assembler_.ucomisd(XMM0, XMM1);
+                    assembler_.setIf(equal ? EQUAL : NOT_EQUAL, RAX);
+                    assembler_.setIf(equal ? NO_PARITY : PARITY, RCX);
+                    equal ? assembler_.andByte(RAX, RCX) : assembler_.orByte(RAX, RCX);
+                }
+                else
+                {
+                    // `above` is false for unordered operands, so less-than compares the other way round
+                    bool less = name == "less-than" || name == "less-equal";
+                    less ? assembler_.ucomisd(XMM1, XMM0) : assembler_.ucomisd(XMM0, XMM1);
+                    bool strict = name == "less-than" || name == "greater-than";
+                    assembler_.setIf(strict ? ABOVE : ABOVE_EQUAL, RAX);
+                }
+                assembler_.zeroExtendByte(RAX, RAX);
+            }
+
+            // The arguments go to consecutive slots, placed so that they ascend in memory
+            ValueType emitFunctionCall(const FunctionCallNode &node)
+            {
+                const FunctionTypeInfo *callee = checker_.function(node.functionName_);
+                if (callee == nullptr)
+                {
+                    throwError("unknown function '" + node.functionName_ + "'");
+                }
+                int label = functionLabel(*callee->declaration_);
+                int count = static_cast<int>(node.arguments_.size());
+                int first = allocateSlots(count + 1);
+                int result = first + count;
+                for (int i = 0; i < count; ++i)
+                {
+                    emitExpression(*node.arguments_[i], callee->parameterTypes_[i]);
+                    storeResult(first + count - 1 - i, callee->parameterTypes_[i]);
+                }
+                assembler_.move(RDI, RBX);
+                assembler_.lea(RSI, RBP, slotOffset(count > 0 ? first + count - 1 : result));
+                assembler_.lea(RDX, RBP, slotOffset(result));
+                assembler_.call(label);
+                assembler_.test(RAX, RAX);
+                assembler_.jumpIf(NOT_EQUAL, deoptimize_);
+                loadResult(result, callee->returnType_);
+                releaseSlots(count + 1);
+                return callee->returnType_;
+            }
+        };
+    }
+
+    NativeFunction::NativeFunction(const std::vector<unsigned char> &code, std::vector<ValueType> parameterTypes,
+                                   ValueType returnType)
+        : codeSize_(code.size()), parameterTypes_(std::move(parameterTypes)), returnType_(returnType)
+    {
+#if MYLISP_NATIVE_X86_64
+        std::size_t page = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+        mappedSize_ = (code.size() + page - 1) / page * page;
+        void *memory = ::mmap(nullptr, mappedSize_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (memory == MAP_FAILED)
+        {
+            throwError("cannot map memory for native code");
+        }
+        std::memcpy(memory, code.data(), code.size());
+        // Never writable and executable at the same time
+        if (::mprotect(memory, mappedSize_, PROT_READ | PROT_EXEC) != 0)
+        {
+            ::munmap(memory, mappedSize_);
+            throwError("cannot make native code executable");
+        }
+        memory_ = memory;
+        entry_ = reinterpret_cast<Entry>(memory);
+#else
+        throwError("native code is not supported on this platform");
+#endif
+    }
+
+    NativeFunction::~NativeFunction()
+    {
+#if MYLISP_NATIVE_X86_64
+        if (memory_ != nullptr)
+        {
+            ::munmap(memory_, mappedSize_);
+        }
+#endif
+    }
+
+    bool NativeFunction::invoke(NativeContext &context, const std::vector<Value> &args, Value &result) const
+    {
+        std::array<std::int64_t, 8> fixed;
+        std::vector<std::int64_t> overflow;
+        std::int64_t *raw = fixed.data();
+        if (args.size() > fixed.size())
+        {
+            overflow.resize(args.size());
+            raw = overflow.data();
+        }
+
+        // The type checker makes a mismatch rare, but call() and older callers hand over any Value
+        for (std::size_t i = 0; i < args.size(); ++i)
+        {
+            ValueType type = args[i].type();
+            switch (parameterTypes_[i])
+            {
+            case ValueType::INT:
+                if (type != ValueType::INT)
+                    return false;
+                raw[i] = args[i].asInt();
+                break;
+            case ValueType::FLOAT:
+                if (type != ValueType::FLOAT && type != ValueType::INT)
+                    return false;
+                raw[i] = std::bit_cast<std::int64_t>(args[i].asFloat());
+                break;
+            case ValueType::BOOLEAN:
+                if (type != ValueType::BOOLEAN)
+                    return false;
+                raw[i] = args[i].asBool() ? 1 : 0;
+                break;
+            default:
+                return false;
+            }
+        }
+
+        std::int64_t output = 0;
+        if (entry_(&context, raw, &output) != 0)
+        {
+            return false;
+        }
+        switch (returnType_)
+        {
+        case ValueType::INT:
+            result = Value(static_cast<long>(output));
+            break;
+        case ValueType::FLOAT:
+            result = Value(std::bit_cast<double>(output));
+            break;
+        default:
+            result = Value(output != 0);
+            break;
+        }
+        return true;
+    }
+
+    bool nativeCodeSupported()
+    {
+        return MYLISP_NATIVE_X86_64 != 0;
+    }
+
+    std::unique_ptr<NativeFunction> compileNativeFunction(const FunctionDeclarationNode &function,
+                                                          const TypeChecker &checker)
+    {
+        if (!nativeCodeSupported())
+        {
+            throwError("native code is not supported on this platform");
+        }
+        const FunctionTypeInfo *info = checker.function(function.functionName_);
+        if (info == nullptr)
+        {
+            throwError("function '" + function.functionName_ + "' was not type checked");
+        }
+        NativeCompiler compiler(checker);
+        std::vector<unsigned char> code = compiler.compile(function);
+        return std::make_unique<NativeFunction>(code, info->parameterTypes_, info->returnType_);
+    }
+
+} // namespace Shattang::MyLisp
@@ -1,9 +1,23 @@
 #include <Shattang/MyLisp/Parser.h>
+#include <Shattang/MyLisp/FlatParser.h>
 
 #include <sstream>
+#include <stdexcept>
 
 namespace Shattang::MyLisp
 {
+    namespace
+    {
+        // String tokens keep the quotes from the source
+        std::string unquoteStringLiteral(const std::string &quoted)
+        {
+            if (quoted.size() >= 2 && quoted.front() == '"' && quoted.back() == '"')
+            {
+                return quoted.substr(1, quoted.size() - 2);
+            }
+            return quoted;
+        }
+    }
 
     // Converts a NodeType to its string representation
     std::string ASTNodeTypeToString(NodeType type)
@@ -86,7 +100,8 @@ namespace Shattang::MyLisp
     }
 
     // StringNode implementation
-    StringNode::StringNode(const std::string &value) : value_(value) {}
+    StringNode::StringNode(const std::string &value)
+        : value_(value), text_(unquoteStringLiteral(value)) {}
 
     NodeType StringNode::getType() const
     {
@@ -209,8 +224,11 @@ namespace Shattang::MyLisp
                                        std::unique_ptr<ASTNode> start,
                                        std::unique_ptr<ASTNode> end,
                                        std::unique_ptr<ASTNode> step,
-                                       std::vector<std::unique_ptr<ASTNode>> body)
-        : index_(index), start_(std::move(start)), end_(std::move(end)), step_(std::move(step)), body_(std::move(body)) {}
+                                       std::vector<std::unique_ptr<ASTNode>> body,
+                                       bool isParallel,
+                                       std::unique_ptr<ASTNode> grain)
+        : index_(index), start_(std::move(start)), end_(std::move(end)), step_(std::move(step)), body_(std::move(body)),
+          isParallel_(isParallel), grain_(std::move(grain)) {}
 
     NodeType ForIterationNode::getType() const
     {
@@ -220,7 +238,12 @@ namespace Shattang::MyLisp
     std::string ForIterationNode::toString() const
     {
         std::ostringstream oss;
-        oss << "ForIteration: " << index_ << " from " << start_->toString() << " to " << end_->toString()
+        oss << (isParallel_ ? "ParallelForIteration: " : "ForIteration: ") << index_;
+        if (grain_ != nullptr)
+        {
+            oss << " grain " << grain_->toString();
+        }
+        oss << " from " << start_->toString() << " to " << end_->toString()
             << " step " << step_->toString() << " { ";
         for (const auto &expr : body_)
         {
@@ -271,313 +294,16 @@ namespace Shattang::MyLisp
         return oss.str();
     }
 
-    // Parser constructor
-    Parser::Parser(Lexer &lexer) : lexer_(lexer), currentToken_(lexer.GetNextToken()) {}
+    Parser::Parser(Lexer &lexer) : lexer_(lexer) {}
 
-    // Main parsing function
     std::unique_ptr<ASTNode> Parser::parse()
     {
-        std::vector<std::unique_ptr<ASTNode>> statements;
-        while (currentToken_.type_ != TokenType::END_OF_FILE)
-        {
-            statements.push_back(parseExpression());
-        }
-        return std::make_unique<ScriptNode>(std::move(statements));
-    }
-
-    // Parsing expressions
-    std::unique_ptr<ASTNode> Parser::parseExpression()
-    {
-        int openParenCount = 0;
-
-        // Unwrap nested parentheses
-        while (currentToken_.type_ == TokenType::OPEN_PAREN)
-        {
-            consume(TokenType::OPEN_PAREN);
-            openParenCount++;
-        }
-
-        // Parse the actual expression after unwrapping
-        std::unique_ptr<ASTNode> expr;
-        if (currentToken_.type_ == TokenType::SYMBOL)
-        {
-            if (currentToken_.value_ == "let")
-            {
-                expr = parseLet();
-            }
-            else if (currentToken_.value_ == "define")
-            {
-                expr = parseDefine();
-            }
-            else if (currentToken_.value_ == "set")
-            {
-                expr = parseSet();
-            }
-            else if (currentToken_.value_ == "for")
-            {
-                expr = parseForIteration();
-            }
-            else if (currentToken_.value_ == "while")
-            {
-                expr = parseWhileIteration();
-            }
-            else if (currentToken_.value_ == "if")
-            {
-                expr = parseIf();
-            }
-            else if (openParenCount > 0)
-            {
-                expr = parseFunctionCall();
-            }
-            else
-            {
-                expr = parseAtom();
-            }
-        }
-        else
+        FlatParser parser(lexer_);
+        if (!parser.parse())
         {
-            expr = parseAtom();
+            throw std::runtime_error(FormatParseError(parser.error()));
         }
-
-        // Consume the matching number of closing parentheses
-        while (openParenCount > 0 && currentToken_.type_ == TokenType::CLOSE_PAREN)
-        {
-            consume(TokenType::CLOSE_PAREN);
-            openParenCount--;
-        }
-
-        // If there are still unclosed opening parentheses, it should be an error
-        if (openParenCount != 0)
-        {
-            throwError("Mismatched parentheses: more opening than closing parentheses.");
-        }
-
-        return expr;
-    }
-
-    std::unique_ptr<ASTNode> Parser::parseIf()
-    {
-        consume(TokenType::SYMBOL); // Consume `if`
-
-        auto condition = parseExpression();  // Parse the condition
-        auto thenBranch = parseExpression(); // Parse the then-branch
-        auto elseBranch = parseExpression(); // Parse the else-branch
-
-        return std::make_unique<IfNode>(std::move(condition), std::move(thenBranch), std::move(elseBranch));
-    }
-
-    std::unique_ptr<ASTNode> Parser::parseForIteration()
-    {
-        consume(TokenType::SYMBOL); // Consume `for`
-
-        if (currentToken_.type_ != TokenType::SYMBOL)
-        {
-            throwError("Expected an index variable name after 'for'");
-        }
-        std::string index = std::string(currentToken_.value_);
-        consume(TokenType::SYMBOL);
-
-        auto start_ = parseExpression(); // Parse the start expression
-        auto end_ = parseExpression();   // Parse the end expression
-        auto step_ = parseExpression();  // Parse the step expression
-
-        std::vector<std::unique_ptr<ASTNode>> body_;
-        while (currentToken_.type_ != TokenType::CLOSE_PAREN)
-        {
-            body_.push_back(parseExpression()); // Parse each expression in the loop body
-        }
-
-        return std::make_unique<ForIterationNode>(index, std::move(start_), std::move(end_), std::move(step_), std::move(body_));
-    }
-
-    std::unique_ptr<ASTNode> Parser::parseWhileIteration()
-    {
-        consume(TokenType::SYMBOL); // Consume `while`
-
-        auto condition = parseExpression(); // Parse the condition
-
-        std::vector<std::unique_ptr<ASTNode>> body;
-        while (currentToken_.type_ != TokenType::CLOSE_PAREN)
-        {
-            body.push_back(parseExpression()); // Parse each expression in the loop body
-        }
-
-        return std::make_unique<WhileIterationNode>(std::move(condition), std::move(body));
-    }
-
-    std::unique_ptr<ASTNode> Parser::parseSet()
-    {
-        consume(TokenType::SYMBOL); // Consume `set`
-
-        if (currentToken_.type_ != TokenType::SYMBOL)
-        {
-            throwError("Expected a variable name after 'set'");
-        }
-        std::string variableName = std::string(currentToken_.value_);
-        consume(TokenType::SYMBOL);
-
-        std::unique_ptr<ASTNode> valueNode = parseExpression(); // Parse the new value
-
-        return std::make_unique<VariableAssignmentNode>(variableName, std::move(valueNode));
-    }
-
-    // Parsing atomic expressions
-    std::unique_ptr<ASTNode> Parser::parseAtom()
-    {
-        auto doParse = [this](TokenType type, std::unique_ptr<ASTNode> &&node)
-        {
-            consume(type);
-            return std::move(node);
-        };
-
-        switch (currentToken_.type_)
-        {
-        case TokenType::SYMBOL:
-            return doParse(currentToken_.type_, std::make_unique<SymbolNode>(std::string(currentToken_.value_)));
-        case TokenType::INTEGER:
-            return doParse(currentToken_.type_, std::make_unique<IntegerNode>(std::stol(std::string(currentToken_.value_))));
-        case TokenType::FLOAT:
-            return doParse(currentToken_.type_, std::make_unique<FloatNode>(std::stod(std::string(currentToken_.value_))));
-        case TokenType::BOOL_TRUE:
-            return doParse(currentToken_.type_, std::make_unique<BooleanNode>(true));
-        case TokenType::BOOL_FALSE:
-            return doParse(currentToken_.type_, std::make_unique<BooleanNode>(false));
-        case TokenType::STRING:
-            return doParse(currentToken_.type_, std::make_unique<StringNode>(std::string(currentToken_.value_)));
-        default:
-            throwError("Unexpected token: " + TokenTypeToString(currentToken_.type_));
-        }
-        return nullptr;
-    }
-
-    // Parsing let expressions
-    std::unique_ptr<ASTNode> Parser::parseLet()
-    {
-        consume(TokenType::SYMBOL); // Consume `let`
-
-        consume(TokenType::OPEN_PAREN); // Consume opening parenthesis for variable declaration
-        if (currentToken_.type_ != TokenType::SYMBOL)
-        {
-            throwError("Expected a variable name after 'let'");
-        }
-        std::string varName = std::string(currentToken_.value_);
-        consume(TokenType::SYMBOL);
-
-        if (currentToken_.type_ != TokenType::SYMBOL)
-        {
-            throwError("Expected a type after variable name");
-        }
-        std::unique_ptr<SymbolNode> typeNode = std::make_unique<SymbolNode>(std::string(currentToken_.value_));
-        consume(TokenType::SYMBOL);
-        consume(TokenType::CLOSE_PAREN); // Consume closing parenthesis for variable declaration
-
-        std::unique_ptr<ASTNode> valueNode = parseExpression();
-
-        return std::make_unique<VariableDeclarationNode>(varName, std::move(typeNode), std::move(valueNode));
-    }
-
-    // Parsing function definitions
-    std::unique_ptr<ASTNode> Parser::parseDefine()
-    {
-        if (isParsingDefine_)
-            throwError("Nested function definition not supported");
-
-        isParsingDefine_ = true;
-
-        consume(TokenType::SYMBOL); // Consume `define`
-
-        if (currentToken_.type_ != TokenType::SYMBOL)
-        {
-            throwError("Expected a function name after 'define'");
-        }
-        std::string funcName = std::string(currentToken_.value_);
-        consume(TokenType::SYMBOL);
-
-        std::vector<Parameter> parameters;
-        consume(TokenType::OPEN_PAREN); // Consume the opening parenthesis for parameter list
-        while (currentToken_.type_ != TokenType::CLOSE_PAREN)
-        {
-            consume(TokenType::OPEN_PAREN); // Consume the opening parenthesis for each parameter
-            if (currentToken_.type_ != TokenType::SYMBOL)
-            {
-                throwError("Expected a parameter name");
-            }
-            std::string paramName = std::string(currentToken_.value_);
-            consume(TokenType::SYMBOL);
-
-            if (currentToken_.type_ != TokenType::SYMBOL)
-            {
-                throwError("Expected a parameter type");
-            }
-            auto paramType = std::make_unique<SymbolNode>(std::string(currentToken_.value_));
-            consume(TokenType::SYMBOL);
-            consume(TokenType::CLOSE_PAREN); // Consume the closing parenthesis for each parameter
-
-            parameters.emplace_back(Parameter{paramName, std::move(paramType)});
-        }
-        consume(TokenType::CLOSE_PAREN); // Consume the closing parenthesis for the parameter list
-
-        if (currentToken_.type_ != TokenType::SYMBOL)
-        {
-            throwError("Expected a return type for the function");
-        }
-        auto returnType = std::make_unique<SymbolNode>(std::string(currentToken_.value_));
-        consume(TokenType::SYMBOL);
-
-        std::vector<std::unique_ptr<ASTNode>> body;
-        while (currentToken_.type_ != TokenType::CLOSE_PAREN)
-        {
-            body.push_back(parseExpression());
-        }
-
-        isParsingDefine_ = false;
-        return std::make_unique<FunctionDeclarationNode>(funcName, std::move(parameters), std::move(returnType), std::move(body));
-    }
-
-    // Parsing function calls
-    std::unique_ptr<ASTNode> Parser::parseFunctionCall()
-    {
-        if (currentToken_.type_ != TokenType::SYMBOL)
-        {
-            throwError("Expected a function name");
-        }
-        std::string funcName = std::string(currentToken_.value_);
-        consume(TokenType::SYMBOL);
-
-        std::vector<std::unique_ptr<ASTNode>> arguments;
-        while (currentToken_.type_ != TokenType::CLOSE_PAREN)
-        {
-            arguments.push_back(parseExpression());
-        }
-
-        return std::make_unique<FunctionCallNode>(funcName, std::move(arguments));
-    }
-
-    // Consuming expected tokens and error handling
-    void Parser::consume(TokenType expectedType)
-    {
-        if (currentToken_.type_ == expectedType)
-        {
-            currentToken_ = lexer_.GetNextToken();
-        }
-        else
-        {
-            std::ostringstream oss;
-            oss << "Unexpected token: expected " << TokenTypeToString(expectedType)
-                << ", but got " << TokenTypeToString(currentToken_.type_) << " '" << currentToken_.value_ << "'"
-                << " at line " << currentToken_.line_ << ", column " << currentToken_.column_;
-            throw std::runtime_error(oss.str());
-        }
-    }
-
-    void Parser::throwError(const std::string &message)
-    {
-        std::ostringstream oss;
-        oss << "Parse error: " << message
-            << " at line " << currentToken_.line_
-            << ", column " << currentToken_.column_
-            << ": '" << currentToken_.value_ << "'";
-        throw std::runtime_error(oss.str());
+        return BuildAST(parser.nodes());
     }
 
     void ASTNode::visit(ASTVisitor &visit) const
@@ -0,0 +1,41 @@
+#include <Shattang/MyLisp/Program.h>
+#include <Shattang/MyLisp/Lexer.h>
+#include <Shattang/MyLisp/Parser.h>
+
+#include <stdexcept>
+#include <utility>
+
+namespace Shattang::MyLisp
+{
+    Program::Program(std::unique_ptr<const ScriptNode> script, ProgramInputs inputs)
+        : script_(std::move(script)), inputs_(std::move(inputs))
+    {
+        checker_.check(*script_, inputs_);
+        graph_ = buildStatementGraph(*script_);
+    }
+
+    void Program::run(Environment &globals, std::ostream &out, TierOptions options) const
+    {
+        Interpreter interpreter(globals, out, options);
+        interpreter.run(*this);
+    }
+
+    std::shared_ptr<const Program> compile(std::string_view source, ProgramInputs inputs)
+    {
+        // The lexer and parser only live for this call, so concurrent compiles share nothing
+        Lexer lexer(source);
+        Parser parser(lexer);
+        return compile(parser.parse(), std::move(inputs));
+    }
+
+    std::shared_ptr<const Program> compile(std::unique_ptr<ASTNode> script, ProgramInputs inputs)
+    {
+        if (script == nullptr || script->getType() != NodeType::SCRIPT)
+        {
+            throw std::runtime_error("Type error: compile() expects a whole script");
+        }
+        std::unique_ptr<const ScriptNode> parsed(static_cast<const ScriptNode *>(script.release()));
+        return std::shared_ptr<const Program>(new Program(std::move(parsed), std::move(inputs)));
+    }
+
+} // namespace Shattang::MyLisp
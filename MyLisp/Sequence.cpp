@@ -0,0 +1,347 @@
+#include <Shattang/MyLisp/Sequence.h>
+#include <Shattang/MyLisp/LoopParallelizer.h>
+#include <Shattang/MyLisp/VectorKernels.h>
+
+#include <algorithm>
+#include <stdexcept>
+#include <vector>
+
+namespace Shattang::MyLisp
+{
+    namespace
+    {
+        using Cursor = Sequence::Cursor;
+
+        class VectorCursor : public Cursor
+        {
+        public:
+            explicit VectorCursor(std::shared_ptr<const VectorExpression> elements)
+                : elements_(std::move(elements)), scratch_(elements_->scratchBlocks() * Sequence::BlockSize) {}
+
+            std::size_t read(double *out, std::size_t capacity) override
+            {
+                std::size_t total = std::min(capacity, elements_->size() - offset_);
+                for (std::size_t done = 0; done < total;)
+                {
+                    std::size_t count = std::min(Sequence::BlockSize, total - done);
+                    const double *values = elements_->evaluate(offset_, count, scratch_.data());
+                    std::copy(values, values + count, out + done);
+                    offset_ += count;
+                    done += count;
+                }
+                return total;
+            }
+
+        private:
+            std::shared_ptr<const VectorExpression> elements_;
+            std::vector<double> scratch_;
+            std::size_t offset_ = 0;
+        };
+
+        class RangeCursor : public Cursor
+        {
+        public:
+            RangeCursor(long start, long end, long step)
+                : next_(start), step_(step), remaining_(iterationCount(start, end, step)) {}
+
+            std::size_t read(double *out, std::size_t capacity) override
+            {
+                std::size_t count = std::min(capacity, remaining_);
+                for (std::size_t i = 0; i < count; ++i)
+                {
+                    out[i] = static_cast<double>(next_);
+                    // Stepping past the last element could overflow
+                    if (--remaining_ > 0)
+                    {
+                        next_ += step_;
+                    }
+                }
+                return count;
+            }
+
+        private:
+            long next_;
+            long step_;
+            std::size_t remaining_;
+        };
+
+        class MapCursor : public Cursor
+        {
+        public:
+            MapCursor(const Sequence::UnaryFunction &function, std::unique_ptr<Cursor> source)
+                : function_(function), source_(std::move(source)) {}
+
+            std::size_t read(double *out, std::size_t capacity) override
+            {
+                std::size_t count = source_->read(out, capacity);
+                for (std::size_t i = 0; i < count; ++i)
+                {
+                    out[i] = function_(out[i]);
+                }
+                return count;
+            }
+
+        private:
+            const Sequence::UnaryFunction &function_;
+            std::unique_ptr<Cursor> source_;
+        };
+
+        class FilterCursor : public Cursor
+        {
+        public:
+            FilterCursor(const Sequence::Predicate &predicate, std::unique_ptr<Cursor> source)
+                : predicate_(predicate), source_(std::move(source)), buffer_(Sequence::BlockSize) {}
+
+            std::size_t read(double *out, std::size_t capacity) override
+            {
+                std::size_t count = 0;
+                // Asks for no more than could still be used, so a `take` downstream stops the
+                // stages upstream early
+                while (!exhausted_ && count < capacity)
+                {
+                    std::size_t wanted = std::min(buffer_.size(), capacity - count);
+                    std::size_t read = source_->read(buffer_.data(), wanted);
+                    exhausted_ = read < wanted;
+                    for (std::size_t i = 0; i < read; ++i)
+                    {
+                        if (predicate_(buffer_[i]))
+                        {
+                            out[count++] = buffer_[i];
+                        }
+                    }
+                }
+                return count;
+            }
+
+        private:
+            const Sequence::Predicate &predicate_;
+            std::unique_ptr<Cursor> source_;
+            std::vector<double> buffer_;
+            bool exhausted_ = false;
+        };
+
+        class TakeCursor : public Cursor
+        {
+        public:
+            TakeCursor(std::size_t count, std::unique_ptr<Cursor> source) : remaining_(count), source_(std::move(source)) {}
+
+            std::size_t read(double *out, std::size_t capacity) override
+            {
+                std::size_t wanted = std::min(capacity, remaining_);
+                if (wanted == 0)
+                {
+                    return 0;
+                }
+                std::size_t count = source_->read(out, wanted);
+                remaining_ = count < wanted ? 0 : remaining_ - count;
+                return count;
+            }
+
+        private:
+            std::size_t remaining_;
+            std::unique_ptr<Cursor> source_;
+        };
+
+        class ZipCursor : public Cursor
+        {
+        public:
+            ZipCursor(const Sequence::BinaryFunction &function, std::unique_ptr<Cursor> lhs, std::unique_ptr<Cursor> rhs)
+                : function_(function), lhs_(std::move(lhs)), rhs_(std::move(rhs)) {}
+
+            std::size_t read(double *out, std::size_t capacity) override
+            {
+                std::size_t count = lhs_->read(out, capacity);
+                buffer_.resize(std::max(buffer_.size(), count));
+                count = std::min(count, rhs_->read(buffer_.data(), count));
+                for (std::size_t i = 0; i < count; ++i)
+                {
+                    out[i] = function_(out[i], buffer_[i]);
+                }
+                return count;
+            }
+
+        private:
+            const Sequence::BinaryFunction &function_;
+            std::unique_ptr<Cursor> lhs_;
+            std::unique_ptr<Cursor> rhs_;
+            std::vector<double> buffer_;
+        };
+    }
+
+    std::shared_ptr<const Sequence> Sequence::vector(std::shared_ptr<const VectorExpression> elements)
+    {
+        auto sequence = std::make_shared<Sequence>();
+        sequence->kind_ = Kind::VECTOR;
+        sequence->elements_ = std::move(elements);
+        return sequence;
+    }
+
+    std::shared_ptr<const Sequence> Sequence::range(long start, long end, long step)
+    {
+        if (step == 0)
+        {
+            throw std::runtime_error("Runtime error: 'range' step must not be zero");
+        }
+        auto sequence = std::make_shared<Sequence>();
+        sequence->kind_ = Kind::RANGE;
+        sequence->start_ = start;
+        sequence->end_ = end;
+        sequence->step_ = step;
+        return sequence;
+    }
+
+    std::shared_ptr<const Sequence> Sequence::map(UnaryFunction function, std::shared_ptr<const Sequence> source)
+    {
+        auto sequence = std::make_shared<Sequence>();
+        sequence->kind_ = Kind::MAP;
+        sequence->function_ = std::move(function);
+        sequence->lhs_ = std::move(source);
+        return sequence;
+    }
+
+    std::shared_ptr<const Sequence> Sequence::filter(Predicate predicate, std::shared_ptr<const Sequence> source)
+    {
+        auto sequence = std::make_shared<Sequence>();
+        sequence->kind_ = Kind::FILTER;
+        sequence->predicate_ = std::move(predicate);
+        sequence->lhs_ = std::move(source);
+        return sequence;
+    }
+
+    std::shared_ptr<const Sequence> Sequence::take(long count, std::shared_ptr<const Sequence> source)
+    {
+        if (count < 0)
+        {
+            throw std::runtime_error("Runtime error: 'take' count must not be negative, got " + std::to_string(count));
+        }
+        auto sequence = std::make_shared<Sequence>();
+        sequence->kind_ = Kind::TAKE;
+        sequence->count_ = count;
+        sequence->lhs_ = std::move(source);
+        return sequence;
+    }
+
+    std::shared_ptr<const Sequence> Sequence::zip(BinaryFunction function, std::shared_ptr<const Sequence> lhs,
+                                                  std::shared_ptr<const Sequence> rhs)
+    {
+        auto sequence = std::make_shared<Sequence>();
+        sequence->kind_ = Kind::ZIP;
+        sequence->binaryFunction_ = std::move(function);
+        sequence->lhs_ = std::move(lhs);
+        sequence->rhs_ = std::move(rhs);
+        return sequence;
+    }
+
+    // Cursors refer to the functions of this Sequence, which the consumer keeps alive
+    std::unique_ptr<Sequence::Cursor> Sequence::open() const
+    {
+        switch (kind_)
+        {
+        case Kind::VECTOR:
+            return std::make_unique<VectorCursor>(elements_);
+        case Kind::RANGE:
+            return std::make_unique<RangeCursor>(start_, end_, step_);
+        case Kind::MAP:
+            return std::make_unique<MapCursor>(function_, lhs_->open());
+        case Kind::FILTER:
+            return std::make_unique<FilterCursor>(predicate_, lhs_->open());
+        case Kind::TAKE:
+            return std::make_unique<TakeCursor>(static_cast<std::size_t>(count_), lhs_->open());
+        default:
+            return std::make_unique<ZipCursor>(binaryFunction_, lhs_->open(), rhs_->open());
+        }
+    }
+
+    template <typename Reduce>
+    void Sequence::forEachBlock(Reduce reduce) const
+    {
+        std::unique_ptr<Cursor> cursor = open();
+        std::vector<double> block(BlockSize);
+        while (true)
+        {
+            std::size_t count = cursor->read(block.data(), BlockSize);
+            if (count > 0)
+            {
+                reduce(block.data(), count);
+            }
+            if (count < BlockSize)
+            {
+                break;
+            }
+        }
+    }
+
+    DoubleVector Sequence::collect() const
+    {
+        DoubleVector result;
+        forEachBlock([&result](const double *values, std::size_t count)
+                     { result.append(values, count); });
+        return result;
+    }
+
+    std::size_t Sequence::count() const
+    {
+        std::size_t result = 0;
+        forEachBlock([&result](const double *, std::size_t count)
+                     { result += count; });
+        return result;
+    }
+
+    double Sequence::sum() const
+    {
+        double result = 0.0;
+        double partition = 0.0;
+        std::size_t inPartition = 0;
+        forEachBlock([&](const double *values, std::size_t count)
+                     {
+            partition += Kernels::sum(values, count);
+            inPartition += count;
+            if (inPartition == VectorExpression::PartitionSize)
+            {
+                result += partition;
+                partition = 0.0;
+                inPartition = 0;
+            } });
+        return inPartition > 0 ? result + partition : result;
+    }
+
+    Moments Sequence::moments() const
+    {
+        Moments result;
+        Moments partition;
+        std::size_t inPartition = 0;
+        forEachBlock([&](const double *values, std::size_t count)
+                     {
+            partition.merge(Moments::of(values, count));
+            inPartition += count;
+            if (inPartition == VectorExpression::PartitionSize)
+            {
+                result.merge(partition);
+                partition = Moments();
+                inPartition = 0;
+            } });
+        result.merge(partition);
+        return result;
+    }
+
+    std::optional<double> Sequence::min() const
+    {
+        std::optional<double> result;
+        forEachBlock([&result](const double *values, std::size_t count)
+                     {
+            double blockMin = Kernels::min(values, count);
+            result = !result || blockMin < *result ? blockMin : *result; });
+        return result;
+    }
+
+    std::optional<double> Sequence::max() const
+    {
+        std::optional<double> result;
+        forEachBlock([&result](const double *values, std::size_t count)
+                     {
+            double blockMax = Kernels::max(values, count);
+            result = !result || blockMax > *result ? blockMax : *result; });
+        return result;
+    }
+
+} // namespace Shattang::MyLisp
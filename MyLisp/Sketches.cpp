@@ -0,0 +1,432 @@
+#include <Shattang/MyLisp/Sketches.h>
+#include <Shattang/MyLisp/Sequence.h>
+#include <Shattang/MyLisp/VectorExpression.h>
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include <utility>
+
+namespace Shattang::MyLisp
+{
+    namespace
+    {
+        // The SplitMix64 generator steps its state by this constant and returns mix(state)
+        constexpr std::uint64_t CoinSeed = 0x9e3779b97f4a7c15ULL;
+
+        // The SplitMix64 output function; also a fast, well mixed 64-bit hash
+        std::uint64_t mix(std::uint64_t z)
+        {
+            z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+            z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+            return z ^ (z >> 31);
+        }
+
+        [[noreturn]] void throwMalformed(const char *type)
+        {
+            throw std::runtime_error(std::string("Runtime error: malformed ") + type);
+        }
+
+        // Reads whitespace separated fields of a serialized sketch
+        class FieldReader
+        {
+        public:
+            FieldReader(const std::string &text, const char *type) : in_(text), type_(type) {}
+
+            std::string word()
+            {
+                std::string result;
+                if (!(in_ >> result))
+                {
+                    throwMalformed(type_);
+                }
+                return result;
+            }
+
+            std::uint64_t integer()
+            {
+                std::string text = word();
+                char *end = nullptr;
+                unsigned long long result = std::strtoull(text.c_str(), &end, 10);
+                if (text.empty() || text[0] == '-' || *end != '\0')
+                {
+                    throwMalformed(type_);
+                }
+                return result;
+            }
+
+            double real()
+            {
+                std::string text = word();
+                char *end = nullptr;
+                double result = std::strtod(text.c_str(), &end);
+                if (*end != '\0' || std::isnan(result))
+                {
+                    throwMalformed(type_);
+                }
+                return result;
+            }
+
+            void expectEnd()
+            {
+                std::string rest;
+                if (in_ >> rest)
+                {
+                    throwMalformed(type_);
+                }
+            }
+
+        private:
+            std::istringstream in_;
+            const char *type_;
+        };
+    }
+
+    QuantileSketch::QuantileSketch(std::size_t k) : k_(std::max<std::size_t>(k, 2)), coin_(CoinSeed)
+    {
+        addLevel();
+    }
+
+    std::size_t QuantileSketch::levelCapacity(std::size_t level) const
+    {
+        std::size_t depth = levels_.size() - level - 1;
+        return static_cast<std::size_t>(std::ceil(std::pow(2.0 / 3.0, static_cast<double>(depth)) * k_)) + 1;
+    }
+
+    void QuantileSketch::addLevel()
+    {
+        levels_.emplace_back();
+        capacity_ = 0;
+        for (std::size_t level = 0; level < levels_.size(); ++level)
+        {
+            capacity_ += levelCapacity(level);
+        }
+    }
+
+    void QuantileSketch::update(const double *values, std::size_t count)
+    {
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            double value = values[i];
+            if (std::isnan(value))
+            {
+                continue;
+            }
+            min_ = count_ == 0 || value < min_ ? value : min_;
+            max_ = count_ == 0 || value > max_ ? value : max_;
+            ++count_;
+            levels_[0].push_back(value);
+            if (++retained_ >= capacity_)
+            {
+                compress();
+            }
+        }
+    }
+
+    void QuantileSketch::compress()
+    {
+        for (std::size_t level = 0; level < levels_.size(); ++level)
+        {
+            if (levels_[level].size() < levelCapacity(level))
+            {
+                continue;
+            }
+            if (level + 1 == levels_.size())
+            {
+                addLevel();
+            }
+            std::vector<double> &values = levels_[level];
+            std::sort(values.begin(), values.end());
+            // With an odd count the smallest value stays behind
+            std::size_t first = values.size() % 2;
+            coin_ += CoinSeed;
+            for (std::size_t i = first + (mix(coin_) & 1); i < values.size(); i += 2)
+            {
+                levels_[level + 1].push_back(values[i]);
+            }
+            values.resize(first);
+
+            retained_ = 0;
+            for (const auto &remaining : levels_)
+            {
+                retained_ += remaining.size();
+            }
+            if (retained_ < capacity_)
+            {
+                break;
+            }
+        }
+    }
+
+    void QuantileSketch::merge(const QuantileSketch &other)
+    {
+        if (other.count_ == 0)
+        {
+            return;
+        }
+        while (levels_.size() < other.levels_.size())
+        {
+            addLevel();
+        }
+        for (std::size_t level = 0; level < other.levels_.size(); ++level)
+        {
+            levels_[level].insert(levels_[level].end(), other.levels_[level].begin(), other.levels_[level].end());
+            retained_ += other.levels_[level].size();
+        }
+        min_ = count_ == 0 || other.min_ < min_ ? other.min_ : min_;
+        max_ = count_ == 0 || other.max_ > max_ ? other.max_ : max_;
+        count_ += other.count_;
+        while (retained_ >= capacity_)
+        {
+            compress();
+        }
+    }
+
+    double QuantileSketch::quantile(double fraction) const
+    {
+        if (fraction <= 0.0)
+        {
+            return min_;
+        }
+        if (fraction >= 1.0)
+        {
+            return max_;
+        }
+        // Each value on level h stands for 2^h input values
+        std::vector<std::pair<double, std::uint64_t>> weighted;
+        weighted.reserve(retained_);
+        for (std::size_t level = 0; level < levels_.size(); ++level)
+        {
+            for (double value : levels_[level])
+            {
+                weighted.emplace_back(value, std::uint64_t(1) << level);
+            }
+        }
+        std::sort(weighted.begin(), weighted.end());
+
+        std::uint64_t total = 0;
+        for (const auto &entry : weighted)
+        {
+            total += entry.second;
+        }
+        double target = fraction * static_cast<double>(total);
+        std::uint64_t rank = 0;
+        for (const auto &[value, weight] : weighted)
+        {
+            rank += weight;
+            if (static_cast<double>(rank) >= target)
+            {
+                return std::clamp(value, min_, max_);
+            }
+        }
+        return max_;
+    }
+
+    // kll 1 k count min max coin levels, then each level's size and values
+    std::string QuantileSketch::serialize() const
+    {
+        std::ostringstream out;
+        out << std::hexfloat << "kll 1 " << k_ << " " << count_ << " " << min_ << " " << max_ << " " << coin_ << " "
+            << levels_.size();
+        for (const auto &values : levels_)
+        {
+            out << " " << values.size();
+            for (double value : values)
+            {
+                out << " " << value;
+            }
+        }
+        return out.str();
+    }
+
+    QuantileSketch QuantileSketch::parse(const std::string &text)
+    {
+        FieldReader in(text, "QuantileSketch");
+        if (in.word() != "kll" || in.integer() != 1)
+        {
+            throwMalformed("QuantileSketch");
+        }
+        std::uint64_t k = in.integer();
+        if (k < 2 || k > 1000000)
+        {
+            throwMalformed("QuantileSketch");
+        }
+        QuantileSketch sketch(static_cast<std::size_t>(k));
+        sketch.count_ = in.integer();
+        sketch.min_ = in.real();
+        sketch.max_ = in.real();
+        sketch.coin_ = in.integer();
+        std::uint64_t levels = in.integer();
+        if (levels == 0 || levels > 64)
+        {
+            throwMalformed("QuantileSketch");
+        }
+        while (sketch.levels_.size() < levels)
+        {
+            sketch.addLevel();
+        }
+        for (auto &values : sketch.levels_)
+        {
+            std::uint64_t size = in.integer();
+            if (size > sketch.capacity_)
+            {
+                throwMalformed("QuantileSketch");
+            }
+            for (std::uint64_t i = 0; i < size; ++i)
+            {
+                values.push_back(in.real());
+            }
+            sketch.retained_ += values.size();
+        }
+        in.expectEnd();
+        if ((sketch.count_ == 0) != (sketch.retained_ == 0) || sketch.retained_ >= sketch.capacity_)
+        {
+            throwMalformed("QuantileSketch");
+        }
+        return sketch;
+    }
+
+    DistinctSketch::DistinctSketch() : registers_(std::size_t(1) << Precision, 0) {}
+
+    void DistinctSketch::update(const double *values, std::size_t count)
+    {
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            double value = values[i];
+            if (value == 0.0)
+            {
+                value = 0.0;
+            }
+            else if (std::isnan(value))
+            {
+                value = std::numeric_limits<double>::quiet_NaN();
+            }
+            std::uint64_t hash = mix(std::bit_cast<std::uint64_t>(value) + CoinSeed);
+            std::size_t index = static_cast<std::size_t>(hash >> (64 - Precision));
+            std::uint64_t rest = hash << Precision;
+            auto rank = static_cast<std::uint8_t>(rest == 0 ? 64 - Precision + 1 : std::countl_zero(rest) + 1);
+            registers_[index] = std::max(registers_[index], rank);
+        }
+        count_ += count;
+    }
+
+    void DistinctSketch::merge(const DistinctSketch &other)
+    {
+        for (std::size_t i = 0; i < registers_.size(); ++i)
+        {
+            registers_[i] = std::max(registers_[i], other.registers_[i]);
+        }
+        count_ += other.count_;
+    }
+
+    double DistinctSketch::estimate() const
+    {
+        double m = static_cast<double>(registers_.size());
+        double sum = 0.0;
+        std::size_t zeros = 0;
+        for (std::uint8_t rank : registers_)
+        {
+            sum += std::ldexp(1.0, -rank);
+            zeros += rank == 0 ? 1 : 0;
+        }
+        double estimate = 0.7213 / (1.0 + 1.079 / m) * m * m / sum;
+        // Linear counting is more accurate while many registers are still empty. With a
+        // 64-bit hash no correction is needed at the large end.
+        if (estimate <= 2.5 * m && zeros > 0)
+        {
+            estimate = m * std::log(m / static_cast<double>(zeros));
+        }
+        return estimate;
+    }
+
+    // hll 1 precision count, then the registers as two hex digits each
+    std::string DistinctSketch::serialize() const
+    {
+        static constexpr char Digits[] = "0123456789abcdef";
+        std::string registers;
+        registers.reserve(registers_.size() * 2);
+        for (std::uint8_t rank : registers_)
+        {
+            registers += Digits[rank >> 4];
+            registers += Digits[rank & 15];
+        }
+        return "hll 1 " + std::to_string(Precision) + " " + std::to_string(count_) + " " + registers;
+    }
+
+    DistinctSketch DistinctSketch::parse(const std::string &text)
+    {
+        FieldReader in(text, "DistinctSketch");
+        if (in.word() != "hll" || in.integer() != 1 || in.integer() != Precision)
+        {
+            throwMalformed("DistinctSketch");
+        }
+        DistinctSketch sketch;
+        sketch.count_ = in.integer();
+        std::string registers = in.word();
+        in.expectEnd();
+        if (registers.size() != sketch.registers_.size() * 2)
+        {
+            throwMalformed("DistinctSketch");
+        }
+        for (std::size_t i = 0; i < sketch.registers_.size(); ++i)
+        {
+            char *end = nullptr;
+            std::string digits = registers.substr(2 * i, 2);
+            unsigned long rank = std::strtoul(digits.c_str(), &end, 16);
+            if (*end != '\0' || rank > 64 - Precision + 1)
+            {
+                throwMalformed("DistinctSketch");
+            }
+            sketch.registers_[i] = static_cast<std::uint8_t>(rank);
+        }
+        return sketch;
+    }
+
+    template <typename Sketch>
+    Sketch sketchElements(const VectorExpression &elements)
+    {
+        std::vector<Sketch> partitions(elements.partitionCount());
+        elements.forEachPartitionBlock([&partitions](std::size_t partition, const double *values, std::size_t count)
+                                       { partitions[partition].update(values, count); });
+        Sketch result;
+        for (const Sketch &partition : partitions)
+        {
+            result.merge(partition);
+        }
+        return result;
+    }
+
+    template <typename Sketch>
+    Sketch sketchElements(const Sequence &elements)
+    {
+        std::unique_ptr<Sequence::Cursor> cursor = elements.open();
+        std::vector<double> block(Sequence::BlockSize);
+        Sketch result;
+        Sketch partition;
+        std::size_t inPartition = 0;
+        for (std::size_t count = block.size(); count == block.size();)
+        {
+            count = cursor->read(block.data(), block.size());
+            partition.update(block.data(), count);
+            inPartition += count;
+            if (inPartition == VectorExpression::PartitionSize)
+            {
+                result.merge(partition);
+                partition = Sketch();
+                inPartition = 0;
+            }
+        }
+        result.merge(partition);
+        return result;
+    }
+
+    template QuantileSketch sketchElements<QuantileSketch>(const VectorExpression &);
+    template QuantileSketch sketchElements<QuantileSketch>(const Sequence &);
+    template DistinctSketch sketchElements<DistinctSketch>(const VectorExpression &);
+    template DistinctSketch sketchElements<DistinctSketch>(const Sequence &);
+
+} // namespace Shattang::MyLisp
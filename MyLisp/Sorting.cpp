@@ -0,0 +1,545 @@
+#include <Shattang/MyLisp/Sorting.h>
+#include <Shattang/MyLisp/Sequence.h>
+#include <Shattang/MyLisp/ThreadPool.h>
+#include <Shattang/MyLisp/VectorExpression.h>
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace Shattang::MyLisp
+{
+    namespace
+    {
+        constexpr std::size_t PartitionSize = VectorExpression::PartitionSize;
+        constexpr std::uint64_t SignBit = 1ULL << 63;
+        constexpr std::uint64_t NaNKey = std::numeric_limits<std::uint64_t>::max();
+
+        // An unsigned integer with the same order as `value`: flipping the sign bit of positive
+        // values and every bit of negative ones turns IEEE order into integer order. NaNs all
+        // map to the largest key, above infinity.
+        std::uint64_t orderedKey(double value)
+        {
+            if (std::isnan(value))
+            {
+                return NaNKey;
+            }
+            std::uint64_t bits = std::bit_cast<std::uint64_t>(value);
+            return (bits & SignBit) != 0 ? ~bits : bits | SignBit;
+        }
+
+        double fromOrderedKey(std::uint64_t key)
+        {
+            if (key == NaNKey)
+            {
+                return std::numeric_limits<double>::quiet_NaN();
+            }
+            return std::bit_cast<double>((key & SignBit) != 0 ? key & ~SignBit : ~key);
+        }
+
+        // A key that argsort carries along with the index it came from
+        struct IndexedKey
+        {
+            std::uint64_t key_;
+            std::uint64_t index_;
+        };
+
+        std::uint64_t keyOf(std::uint64_t key)
+        {
+            return key;
+        }
+
+        std::uint64_t keyOf(const IndexedKey &element)
+        {
+            return element.key_;
+        }
+
+        void runPartitions(std::size_t count, const std::function<void(std::size_t)> &task)
+        {
+            computePool().parallelFor(count, task);
+        }
+
+        // Stable LSD radix sort of data[0, count) by key, a byte at a time, using `scratch` of the
+        // same size. All eight digit histograms are taken in one pass, and a digit that every key
+        // shares, like the exponent bytes of values of similar magnitude, is skipped.
+        template <typename Element>
+        void radixSort(Element *data, Element *scratch, std::size_t count)
+        {
+            std::array<std::array<std::size_t, 256>, 8> counts{};
+            for (std::size_t i = 0; i < count; ++i)
+            {
+                std::uint64_t key = keyOf(data[i]);
+                for (std::size_t digit = 0; digit < 8; ++digit)
+                {
+                    counts[digit][(key >> (8 * digit)) & 0xff]++;
+                }
+            }
+            Element *from = data;
+            Element *to = scratch;
+            for (std::size_t digit = 0; digit < 8 && count > 0; ++digit)
+            {
+                std::size_t shift = 8 * digit;
+                if (counts[digit][(keyOf(from[0]) >> shift) & 0xff] == count)
+                {
+                    continue;
+                }
+                std::array<std::size_t, 256> offsets;
+                std::size_t offset = 0;
+                for (std::size_t byte = 0; byte < 256; ++byte)
+                {
+                    offsets[byte] = offset;
+                    offset += counts[digit][byte];
+                }
+                for (std::size_t i = 0; i < count; ++i)
+                {
+                    to[offsets[(keyOf(from[i]) >> shift) & 0xff]++] = from[i];
+                }
+                std::swap(from, to);
+            }
+            if (from != data)
+            {
+                std::copy(from, from + count, data);
+            }
+        }
+
+        // How many of the first `diagonal` elements of the merge of `lhs` and `rhs` come from
+        // `lhs`, where equal keys take lhs first
+        template <typename Element>
+        std::size_t mergePathSplit(const Element *lhs, std::size_t lhsCount, const Element *rhs, std::size_t rhsCount,
+                                   std::size_t diagonal)
+        {
+            std::size_t low = diagonal > rhsCount ? diagonal - rhsCount : 0;
+            std::size_t high = std::min(diagonal, lhsCount);
+            while (low < high)
+            {
+                std::size_t middle = low + (high - low) / 2;
+                if (keyOf(lhs[middle]) <= keyOf(rhs[diagonal - middle - 1]))
+                {
+                    low = middle + 1;
+                }
+                else
+                {
+                    high = middle;
+                }
+            }
+            return low;
+        }
+
+        // Writes elements [first, last) of the merge of two sorted runs to out[first, last)
+        template <typename Element>
+        void mergePiece(const Element *lhs, std::size_t lhsCount, const Element *rhs, std::size_t rhsCount,
+                        Element *out, std::size_t first, std::size_t last)
+        {
+            std::size_t i = mergePathSplit(lhs, lhsCount, rhs, rhsCount, first);
+            std::size_t j = first - i;
+            for (std::size_t k = first; k < last; ++k)
+            {
+                bool takeLhs = j == rhsCount || (i < lhsCount && keyOf(lhs[i]) <= keyOf(rhs[j]));
+                out[k] = takeLhs ? lhs[i++] : rhs[j++];
+            }
+        }
+
+        // Fills partitions with load(first, last, out), radix sorts each and merges them into one run
+        template <typename Element, typename Load>
+        std::vector<Element> sortPartitions(std::size_t count, Load load)
+        {
+            std::vector<Element> data(count);
+            std::vector<Element> scratch(count);
+            std::size_t partitions = (count + PartitionSize - 1) / PartitionSize;
+            runPartitions(partitions, [&data, &scratch, &load, count](std::size_t partition)
+                          {
+                std::size_t first = partition * PartitionSize;
+                std::size_t last = std::min(count, first + PartitionSize);
+                load(first, last, data.data() + first);
+                radixSort(data.data() + first, scratch.data() + first, last - first); });
+
+            for (std::size_t width = PartitionSize; width < count; width *= 2)
+            {
+                // Output piece `partition` lies within the merge of the pair of runs at `start`
+                runPartitions(partitions, [&data, &scratch, count, width](std::size_t partition)
+                              {
+                    std::size_t start = partition * PartitionSize / (2 * width) * (2 * width);
+                    std::size_t lhsCount = std::min(width, count - start);
+                    std::size_t rhsCount = std::min(width, count - start - lhsCount);
+                    std::size_t first = partition * PartitionSize - start;
+                    std::size_t last = std::min(count, (partition + 1) * PartitionSize) - start;
+                    mergePiece(data.data() + start, lhsCount, data.data() + start + lhsCount, rhsCount,
+                               scratch.data() + start, first, last); });
+                data.swap(scratch);
+            }
+            return data;
+        }
+
+        // Per-partition state of topElements() and histogramElements(): update(values, count)
+        // takes a block and merge() adds another partition's state
+        class TopKeys
+        {
+        public:
+            explicit TopKeys(std::size_t count) : count_(count) {}
+
+            void update(const double *values, std::size_t count)
+            {
+                for (std::size_t i = 0; i < count; ++i)
+                {
+                    if (!std::isnan(values[i]))
+                    {
+                        keys_.push_back(orderedKey(values[i]));
+                    }
+                }
+                // Amortizes selection over at least a block
+                if (keys_.size() >= 2 * std::max(count_, VectorExpression::BlockSize))
+                {
+                    prune();
+                }
+            }
+
+            void merge(const TopKeys &other)
+            {
+                keys_.insert(keys_.end(), other.keys_.begin(), other.keys_.end());
+                prune();
+            }
+
+            DoubleVector result()
+            {
+                prune();
+                std::sort(keys_.begin(), keys_.end(), std::greater<std::uint64_t>());
+                DoubleVector result;
+                result.reserve(keys_.size());
+                for (std::uint64_t key : keys_)
+                {
+                    result.push(fromOrderedKey(key));
+                }
+                return result;
+            }
+
+        private:
+            std::size_t count_;
+            std::vector<std::uint64_t> keys_;
+
+            void prune()
+            {
+                if (keys_.size() > count_)
+                {
+                    std::nth_element(keys_.begin(), keys_.begin() + count_, keys_.end(), std::greater<std::uint64_t>());
+                    keys_.resize(count_);
+                }
+            }
+        };
+
+        class BinCounts
+        {
+        public:
+            BinCounts(double low, double high, std::size_t bins)
+                : low_(low), high_(high), scale_(bins / (high - low)), counts_(bins)
+            {
+            }
+
+            void update(const double *values, std::size_t count)
+            {
+                for (std::size_t i = 0; i < count; ++i)
+                {
+                    double value = values[i];
+                    if (value >= low_ && value <= high_)
+                    {
+                        // Rounding can put a value just below `high` past the last bin
+                        std::size_t bin = static_cast<std::size_t>((value - low_) * scale_);
+                        counts_[std::min(bin, counts_.size() - 1)]++;
+                    }
+                }
+            }
+
+            void merge(const BinCounts &other)
+            {
+                for (std::size_t bin = 0; bin < counts_.size(); ++bin)
+                {
+                    counts_[bin] += other.counts_[bin];
+                }
+            }
+
+            DoubleVector result()
+            {
+                DoubleVector result;
+                result.reserve(counts_.size());
+                for (std::uint64_t count : counts_)
+                {
+                    result.push(static_cast<double>(count));
+                }
+                return result;
+            }
+
+        private:
+            double low_;
+            double high_;
+            double scale_;
+            std::vector<std::uint64_t> counts_;
+        };
+
+        // Partitions are summarized on the compute pool, copying `empty` for each
+        template <typename State>
+        State summarize(const VectorExpression &elements, const State &empty)
+        {
+            std::vector<State> partitions(elements.partitionCount(), empty);
+            elements.forEachPartitionBlock([&partitions](std::size_t partition, const double *values, std::size_t count)
+                                           { partitions[partition].update(values, count); });
+            State result = empty;
+            for (const State &partition : partitions)
+            {
+                result.merge(partition);
+            }
+            return result;
+        }
+
+        // Neither summary depends on how the elements are split, so a sequence is read in one pass
+        template <typename State>
+        State summarize(const Sequence &elements, State state)
+        {
+            std::unique_ptr<Sequence::Cursor> cursor = elements.open();
+            std::vector<double> block(Sequence::BlockSize);
+            for (std::size_t count = block.size(); count == block.size();)
+            {
+                count = cursor->read(block.data(), block.size());
+                state.update(block.data(), count);
+            }
+            return state;
+        }
+
+        std::size_t checkedTopCount(long count)
+        {
+            if (count < 0)
+            {
+                throw std::runtime_error("Runtime error: 'top-k' count must not be negative, got " + std::to_string(count));
+            }
+            return static_cast<std::size_t>(count);
+        }
+
+        BinCounts checkedBins(double low, double high, long bins)
+        {
+            if (bins < 1)
+            {
+                throw std::runtime_error("Runtime error: 'histogram' needs at least one bin, got " + std::to_string(bins));
+            }
+            if (!(low < high) || !std::isfinite(high - low))
+            {
+                throw std::runtime_error("Runtime error: 'histogram' needs a finite range with low below high");
+            }
+            return BinCounts(low, high, static_cast<std::size_t>(bins));
+        }
+
+        // The SplitMix64 output function, as a hash of the bits of a key
+        std::uint64_t mix(std::uint64_t z)
+        {
+            z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+            z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+            return z ^ (z >> 31);
+        }
+
+        // Gives every key one bit pattern, so that keys can be hashed and compared as integers
+        std::uint64_t canonicalBits(double key)
+        {
+            if (std::isnan(key))
+            {
+                return std::bit_cast<std::uint64_t>(std::numeric_limits<double>::quiet_NaN());
+            }
+            return std::bit_cast<std::uint64_t>(key == 0.0 ? 0.0 : key);
+        }
+
+        // Inputs of more than one partition are scattered into this many buckets by the top bits
+        // of the key hash; the bottom bits pick a slot in the bucket's table
+        constexpr unsigned BucketBits = 8;
+
+        struct KeyedValue
+        {
+            std::uint64_t key_;
+            double value_;
+        };
+
+        struct Group
+        {
+            std::uint64_t key_;
+            double count_;
+            double sum_;
+        };
+
+        // Groups the pairs of one bucket in input order
+        std::vector<Group> aggregate(const KeyedValue *pairs, std::size_t count)
+        {
+            constexpr std::size_t Empty = std::numeric_limits<std::size_t>::max();
+            std::size_t capacity = std::bit_ceil(std::max<std::size_t>(16, 2 * count));
+            std::vector<std::size_t> slots(capacity, Empty);
+            std::vector<Group> groups;
+            for (std::size_t i = 0; i < count; ++i)
+            {
+                std::size_t slot = mix(pairs[i].key_) & (capacity - 1);
+                while (slots[slot] != Empty && groups[slots[slot]].key_ != pairs[i].key_)
+                {
+                    slot = (slot + 1) & (capacity - 1);
+                }
+                if (slots[slot] == Empty)
+                {
+                    slots[slot] = groups.size();
+                    groups.push_back({pairs[i].key_, 0.0, 0.0});
+                }
+                Group &group = groups[slots[slot]];
+                group.count_ += 1.0;
+                group.sum_ += pairs[i].value_;
+            }
+            return groups;
+        }
+    }
+
+    DoubleVector sortElements(const VectorExpression &elements)
+    {
+        DoubleVector values = elements.materialize();
+        std::vector<std::uint64_t> keys = sortPartitions<std::uint64_t>(
+            values.size(), [&values](std::size_t first, std::size_t last, std::uint64_t *out)
+            {
+                for (std::size_t i = first; i < last; ++i)
+                {
+                    *out++ = orderedKey(values[i]);
+                } });
+        runPartitions((values.size() + PartitionSize - 1) / PartitionSize, [&values, &keys](std::size_t partition)
+                      {
+            std::size_t first = partition * PartitionSize;
+            std::size_t last = std::min(values.size(), first + PartitionSize);
+            for (std::size_t i = first; i < last; ++i)
+            {
+                values[i] = fromOrderedKey(keys[i]);
+            } });
+        return values;
+    }
+
+    DoubleVector argsortElements(const VectorExpression &elements)
+    {
+        DoubleVector values = elements.materialize();
+        std::vector<IndexedKey> keys = sortPartitions<IndexedKey>(
+            values.size(), [&values](std::size_t first, std::size_t last, IndexedKey *out)
+            {
+                for (std::size_t i = first; i < last; ++i)
+                {
+                    *out++ = {orderedKey(values[i]), i};
+                } });
+        runPartitions((values.size() + PartitionSize - 1) / PartitionSize, [&values, &keys](std::size_t partition)
+                      {
+            std::size_t first = partition * PartitionSize;
+            std::size_t last = std::min(values.size(), first + PartitionSize);
+            for (std::size_t i = first; i < last; ++i)
+            {
+                values[i] = static_cast<double>(keys[i].index_);
+            } });
+        return values;
+    }
+
+    DoubleVector topElements(const VectorExpression &elements, long count)
+    {
+        return summarize(elements, TopKeys(checkedTopCount(count))).result();
+    }
+
+    DoubleVector topElements(const Sequence &elements, long count)
+    {
+        return summarize(elements, TopKeys(checkedTopCount(count))).result();
+    }
+
+    DoubleVector histogramElements(const VectorExpression &elements, double low, double high, long bins)
+    {
+        return summarize(elements, checkedBins(low, high, bins)).result();
+    }
+
+    DoubleVector histogramElements(const Sequence &elements, double low, double high, long bins)
+    {
+        return summarize(elements, checkedBins(low, high, bins)).result();
+    }
+
+    Groups Groups::of(const VectorExpression &keys, const VectorExpression &values)
+    {
+        if (keys.size() != values.size())
+        {
+            throw std::runtime_error("Runtime error: 'group-by-key' needs vectors of equal length, got " +
+                                     std::to_string(keys.size()) + " and " + std::to_string(values.size()));
+        }
+        DoubleVector keyData = keys.materialize();
+        DoubleVector valueData = values.materialize();
+        std::size_t count = keyData.size();
+        std::size_t partitions = (count + PartitionSize - 1) / PartitionSize;
+        unsigned bucketBits = partitions > 1 ? BucketBits : 0;
+        std::size_t buckets = std::size_t(1) << bucketBits;
+        auto bucketOf = [bucketBits](std::uint64_t key)
+        { return bucketBits == 0 ? 0 : mix(key) >> (64 - bucketBits); };
+
+        // Sizes of each partition's share of each bucket, then where each share starts, bucket by bucket
+        std::vector<std::size_t> offsets(partitions * buckets);
+        runPartitions(partitions, [&](std::size_t partition)
+                      {
+            std::size_t *shares = offsets.data() + partition * buckets;
+            for (std::size_t i = partition * PartitionSize; i < std::min(count, (partition + 1) * PartitionSize); ++i)
+            {
+                shares[bucketOf(canonicalBits(keyData[i]))]++;
+            } });
+        std::vector<std::size_t> bucketStarts(buckets + 1);
+        std::size_t offset = 0;
+        for (std::size_t bucket = 0; bucket < buckets; ++bucket)
+        {
+            bucketStarts[bucket] = offset;
+            for (std::size_t partition = 0; partition < partitions; ++partition)
+            {
+                std::size_t share = offsets[partition * buckets + bucket];
+                offsets[partition * buckets + bucket] = offset;
+                offset += share;
+            }
+        }
+        bucketStarts[buckets] = offset;
+
+        std::vector<KeyedValue> pairs(count);
+        runPartitions(partitions, [&](std::size_t partition)
+                      {
+            std::size_t *next = offsets.data() + partition * buckets;
+            for (std::size_t i = partition * PartitionSize; i < std::min(count, (partition + 1) * PartitionSize); ++i)
+            {
+                std::uint64_t key = canonicalBits(keyData[i]);
+                pairs[next[bucketOf(key)]++] = {key, valueData[i]};
+            } });
+
+        std::vector<std::vector<Group>> bucketGroups(buckets);
+        runPartitions(buckets, [&pairs, &bucketStarts, &bucketGroups](std::size_t bucket)
+                      { bucketGroups[bucket] = aggregate(pairs.data() + bucketStarts[bucket],
+                                                         bucketStarts[bucket + 1] - bucketStarts[bucket]); });
+
+        std::vector<Group> groups;
+        for (const std::vector<Group> &bucket : bucketGroups)
+        {
+            groups.insert(groups.end(), bucket.begin(), bucket.end());
+        }
+        std::sort(groups.begin(), groups.end(), [](const Group &lhs, const Group &rhs)
+                  { return orderedKey(std::bit_cast<double>(lhs.key_)) < orderedKey(std::bit_cast<double>(rhs.key_)); });
+        Groups result;
+        result.keys_.reserve(groups.size());
+        result.counts_.reserve(groups.size());
+        result.sums_.reserve(groups.size());
+        for (const Group &group : groups)
+        {
+            result.keys_.push(std::bit_cast<double>(group.key_));
+            result.counts_.push(group.count_);
+            result.sums_.push(group.sum_);
+        }
+        return result;
+    }
+
+    DoubleVector Groups::means() const
+    {
+        DoubleVector result(size());
+        for (std::size_t i = 0; i < size(); ++i)
+        {
+            result[i] = sums_[i] / counts_[i];
+        }
+        return result;
+    }
+
+} // namespace Shattang::MyLisp
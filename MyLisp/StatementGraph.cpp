@@ -0,0 +1,170 @@
+#include <Shattang/MyLisp/StatementGraph.h>
+#include <Shattang/MyLisp/ASTWalk.h>
+#include <Shattang/MyLisp/Builtins.h>
+
+#include <algorithm>
+#include <unordered_map>
+
+namespace Shattang::MyLisp
+{
+    namespace
+    {
+        // Builtins whose effects are visible outside the variables they are passed
+        bool hasSideEffects(const std::string &name)
+        {
+            return name == "print" || name == "using";
+        }
+
+        // The globals a statement or function body may read and write
+        struct Effects
+        {
+            std::unordered_set<std::string> reads_;
+            std::unordered_set<std::string> writes_;
+            std::unordered_set<std::string> callees_; // script functions
+            bool isBarrier_ = false;
+
+            void merge(const Effects &other)
+            {
+                reads_.insert(other.reads_.begin(), other.reads_.end());
+                writes_.insert(other.writes_.begin(), other.writes_.end());
+                isBarrier_ = isBarrier_ || other.isBarrier_;
+            }
+        };
+
+        Effects directEffects(const ASTNode &node, const std::unordered_set<std::string> &functions)
+        {
+            Effects effects;
+            collectWrittenVariables(node, effects.writes_);
+            forEachNode(node, [&effects, &functions](const ASTNode &child)
+                        {
+                if (child.getType() == NodeType::SYMBOL)
+                {
+                    effects.reads_.insert(static_cast<const SymbolNode &>(child).name_);
+                }
+                else if (child.getType() == NodeType::FUNCTION_CALL)
+                {
+                    const auto &call = static_cast<const FunctionCallNode &>(child);
+                    const std::string &name = call.functionName_;
+                    if (takesFunctionName(name))
+                    {
+                        // The mapped function is named by a symbol, not called
+                        const std::string &function = static_cast<const SymbolNode &>(*call.arguments_[0]).name_;
+                        if (functions.count(function) != 0)
+                        {
+                            effects.callees_.insert(function);
+                        }
+                        else
+                        {
+                            effects.isBarrier_ = true;
+                        }
+                    }
+                    else if (findBuiltin(name) != nullptr)
+                    {
+                        effects.isBarrier_ = effects.isBarrier_ || hasSideEffects(name);
+                    }
+                    else if (functions.count(name) != 0)
+                    {
+                        effects.callees_.insert(name);
+                    }
+                    else
+                    {
+                        effects.isBarrier_ = true; // defined by an earlier script; not analyzed
+                    }
+                } });
+            return effects;
+        }
+
+        bool intersects(const std::unordered_set<std::string> &a, const std::unordered_set<std::string> &b)
+        {
+            const auto &smaller = a.size() <= b.size() ? a : b;
+            const auto &larger = a.size() <= b.size() ? b : a;
+            return std::any_of(smaller.begin(), smaller.end(), [&larger](const std::string &name)
+                               { return larger.count(name) != 0; });
+        }
+    }
+
+    StatementGraph buildStatementGraph(const ScriptNode &script)
+    {
+        std::unordered_set<std::string> functionNames;
+        for (const auto &statement : script.statements_)
+        {
+            if (statement->getType() == NodeType::FUNCTION_DECLARATION)
+            {
+                functionNames.insert(static_cast<const FunctionDeclarationNode &>(*statement).functionName_);
+            }
+        }
+
+        // Function bodies, without their parameters, and then everything their callees do
+        std::unordered_map<std::string, Effects> functions;
+        for (const auto &statement : script.statements_)
+        {
+            if (statement->getType() != NodeType::FUNCTION_DECLARATION)
+            {
+                continue;
+            }
+            const auto &decl = static_cast<const FunctionDeclarationNode &>(*statement);
+            Effects effects;
+            for (const auto &bodyStatement : decl.body_)
+            {
+                Effects body = directEffects(*bodyStatement, functionNames);
+                effects.merge(body);
+                effects.callees_.insert(body.callees_.begin(), body.callees_.end());
+            }
+            for (const auto &parameter : decl.parameters_)
+            {
+                effects.reads_.erase(parameter.name_);
+                effects.writes_.erase(parameter.name_);
+            }
+            functions[decl.functionName_] = std::move(effects);
+        }
+        for (bool changed = true; changed;)
+        {
+            changed = false;
+            for (auto &[name, effects] : functions)
+            {
+                std::size_t before = effects.reads_.size() + effects.writes_.size();
+                bool wasBarrier = effects.isBarrier_;
+                for (const auto &callee : effects.callees_)
+                {
+                    effects.merge(functions.at(callee));
+                }
+                changed = changed || wasBarrier != effects.isBarrier_ ||
+                          before != effects.reads_.size() + effects.writes_.size();
+            }
+        }
+
+        StatementGraph graph;
+        std::vector<Effects> statements;
+        for (const auto &statement : script.statements_)
+        {
+            Effects effects;
+            // Declarations were registered before the script runs
+            if (statement->getType() != NodeType::FUNCTION_DECLARATION)
+            {
+                effects = directEffects(*statement, functionNames);
+                for (const auto &callee : effects.callees_)
+                {
+                    effects.merge(functions.at(callee));
+                }
+                collectWrittenVariables(*statement, graph.globals_);
+            }
+
+            std::size_t index = statements.size();
+            std::vector<std::size_t> dependencies;
+            for (std::size_t earlier = 0; earlier < index; ++earlier)
+            {
+                const Effects &other = statements[earlier];
+                if (effects.isBarrier_ || intersects(other.writes_, effects.reads_) ||
+                    intersects(other.writes_, effects.writes_) || intersects(other.reads_, effects.writes_))
+                {
+                    dependencies.push_back(earlier);
+                }
+            }
+            graph.dependencies_.push_back(std::move(dependencies));
+            graph.isBarrier_.push_back(effects.isBarrier_);
+            statements.push_back(std::move(effects));
+        }
+        return graph;
+    }
+
+} // namespace Shattang::MyLisp
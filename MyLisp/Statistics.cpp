@@ -0,0 +1,74 @@
+#include <Shattang/MyLisp/Statistics.h>
+#include <Shattang/MyLisp/VectorKernels.h>
+
+#include <cmath>
+
+namespace Shattang::MyLisp
+{
+    Moments Moments::of(const double *values, std::size_t count)
+    {
+        Moments result;
+        if (count == 0)
+        {
+            return result;
+        }
+        result.count_ = static_cast<double>(count);
+        result.mean_ = Kernels::sum(values, count) / result.count_;
+        result.m2_ = Kernels::squaredDeviations(values, result.mean_, count);
+        return result;
+    }
+
+    void Moments::merge(const Moments &other)
+    {
+        if (other.count_ == 0.0)
+        {
+            return;
+        }
+        if (count_ == 0.0)
+        {
+            *this = other;
+            return;
+        }
+        double count = count_ + other.count_;
+        double delta = other.mean_ - mean_;
+        mean_ += delta * (other.count_ / count);
+        m2_ += other.m2_ + delta * delta * (count_ * other.count_ / count);
+        count_ = count;
+    }
+
+    CoMoments CoMoments::of(const double *lhs, const double *rhs, std::size_t count)
+    {
+        CoMoments result;
+        result.lhs_ = Moments::of(lhs, count);
+        result.rhs_ = Moments::of(rhs, count);
+        if (count > 0)
+        {
+            result.comoment_ = Kernels::crossDeviations(lhs, result.lhs_.mean_, rhs, result.rhs_.mean_, count);
+        }
+        return result;
+    }
+
+    void CoMoments::merge(const CoMoments &other)
+    {
+        double count = lhs_.count_ + other.lhs_.count_;
+        if (other.lhs_.count_ != 0.0 && lhs_.count_ != 0.0)
+        {
+            // Uses the means from before they are merged
+            double lhsDelta = other.lhs_.mean_ - lhs_.mean_;
+            double rhsDelta = other.rhs_.mean_ - rhs_.mean_;
+            comoment_ += other.comoment_ + lhsDelta * rhsDelta * (lhs_.count_ * other.lhs_.count_ / count);
+        }
+        else if (lhs_.count_ == 0.0)
+        {
+            comoment_ = other.comoment_;
+        }
+        lhs_.merge(other.lhs_);
+        rhs_.merge(other.rhs_);
+    }
+
+    double CoMoments::correlation() const
+    {
+        return comoment_ / std::sqrt(lhs_.m2_ * rhs_.m2_);
+    }
+
+} // namespace Shattang::MyLisp
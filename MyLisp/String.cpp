@@ -0,0 +1,355 @@
+#include <Shattang/MyLisp/String.h>
+#include <Shattang/MyLisp/Memory.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <mutex>
+#include <new>
+#include <ostream>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace Shattang::MyLisp
+{
+    namespace
+    {
+        // Concatenations up to this size are copied into one flat node, so every rope is longer
+        constexpr std::size_t FlatLimit = 256;
+
+        // A rope deeper than this is rebuilt as a balanced tree over its leaves
+        constexpr std::size_t MaxDepth = 48;
+    }
+
+    struct String::Node
+    {
+        std::atomic<std::size_t> references_{1};
+        std::size_t size_ = 0;
+        std::size_t depth_ = 0; // 0 for flat text, which follows the Node in the same block
+        bool interned_ = false;
+        String left_; // the two sides of a rope
+        String right_;
+
+        const char *text() const { return reinterpret_cast<const char *>(this + 1); }
+        char *text() { return reinterpret_cast<char *>(this + 1); }
+        std::size_t blockSize() const { return sizeof(Node) + (depth_ == 0 ? size_ : 0); }
+    };
+
+    struct String::InternTable
+    {
+        std::mutex mutex_;
+        std::unordered_map<std::string_view, Node *> nodes_; // keyed by the text of the node itself
+    };
+
+    String::String() noexcept : bytes_() {}
+
+    String::String(std::string_view text) : bytes_()
+    {
+        if (text.size() > SmallCapacity)
+        {
+            Node *node = makeFlat(text);
+            std::memcpy(bytes_, &node, sizeof node);
+            bytes_[SmallCapacity] = HeapTag;
+            return;
+        }
+        std::copy(text.begin(), text.end(), bytes_);
+        bytes_[SmallCapacity] = static_cast<unsigned char>(text.size());
+    }
+
+    String::String(Node *node) noexcept : bytes_()
+    {
+        std::memcpy(bytes_, &node, sizeof node);
+        bytes_[SmallCapacity] = HeapTag;
+    }
+
+    String::String(const String &other) noexcept
+    {
+        std::memcpy(bytes_, other.bytes_, sizeof bytes_);
+        if (isHeap())
+        {
+            node()->references_.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    String::String(String &&other) noexcept
+    {
+        std::memcpy(bytes_, other.bytes_, sizeof bytes_);
+        std::memset(other.bytes_, 0, sizeof other.bytes_);
+    }
+
+    String &String::operator=(const String &other) noexcept
+    {
+        if (this != &other)
+        {
+            *this = String(other);
+        }
+        return *this;
+    }
+
+    String &String::operator=(String &&other) noexcept
+    {
+        if (this != &other)
+        {
+            unsigned char previous[sizeof bytes_];
+            std::memcpy(previous, bytes_, sizeof bytes_);
+            std::memcpy(bytes_, other.bytes_, sizeof bytes_);
+            std::memset(other.bytes_, 0, sizeof other.bytes_);
+            if (previous[SmallCapacity] == HeapTag)
+            {
+                Node *node;
+                std::memcpy(&node, previous, sizeof node);
+                release(node);
+            }
+        }
+        return *this;
+    }
+
+    String::~String()
+    {
+        if (isHeap())
+        {
+            release(node());
+        }
+    }
+
+    String String::intern(std::string_view text)
+    {
+        if (text.size() <= SmallCapacity)
+        {
+            return String(text);
+        }
+        InternTable &table = internTable();
+        std::lock_guard lock(table.mutex_);
+        auto it = table.nodes_.find(text);
+        if (it != table.nodes_.end())
+        {
+            // A node whose last reference is being dropped on another thread is not revived;
+            // it gives way to a new one
+            Node *node = it->second;
+            std::size_t references = node->references_.load(std::memory_order_relaxed);
+            while (references != 0)
+            {
+                if (node->references_.compare_exchange_weak(references, references + 1, std::memory_order_relaxed))
+                {
+                    return String(node);
+                }
+            }
+            table.nodes_.erase(it);
+        }
+        Node *node = makeFlat(text);
+        node->interned_ = true;
+        table.nodes_.emplace(std::string_view(node->text(), node->size_), node);
+        return String(node);
+    }
+
+    String String::concat(const String &lhs, const String &rhs)
+    {
+        if (lhs.empty())
+        {
+            return rhs;
+        }
+        if (rhs.empty())
+        {
+            return lhs;
+        }
+        std::size_t size = lhs.size() + rhs.size();
+        if (size <= FlatLimit)
+        {
+            char buffer[FlatLimit];
+            std::string_view left = lhs.flat();
+            std::string_view right = rhs.flat();
+            std::copy(left.begin(), left.end(), buffer);
+            std::copy(right.begin(), right.end(), buffer + left.size());
+            return String(std::string_view(buffer, size));
+        }
+        // A short piece joins the nearest leaf of a rope rather than adding a level
+        if (lhs.isRope() && rhs.size() < FlatLimit)
+        {
+            const Node &rope = *lhs.node();
+            if (!rope.right_.isRope() && rope.right_.size() + rhs.size() <= FlatLimit)
+            {
+                return makeConcat(rope.left_, concat(rope.right_, rhs));
+            }
+        }
+        if (rhs.isRope() && lhs.size() < FlatLimit)
+        {
+            const Node &rope = *rhs.node();
+            if (!rope.left_.isRope() && lhs.size() + rope.left_.size() <= FlatLimit)
+            {
+                return makeConcat(concat(lhs, rope.left_), rope.right_);
+            }
+        }
+        return makeConcat(lhs, rhs);
+    }
+
+    std::size_t String::size() const
+    {
+        return isHeap() ? node()->size_ : bytes_[SmallCapacity];
+    }
+
+    std::string String::str() const
+    {
+        std::string result;
+        result.reserve(size());
+        forEachPiece([&result](std::string_view piece)
+                     { result.append(piece); });
+        return result;
+    }
+
+    void String::forEachPiece(const std::function<void(std::string_view)> &visit) const
+    {
+        if (!isRope())
+        {
+            visit(flat());
+            return;
+        }
+        std::vector<const String *> pending{this};
+        while (!pending.empty())
+        {
+            const String *piece = pending.back();
+            pending.pop_back();
+            if (piece->isRope())
+            {
+                pending.push_back(&piece->node()->right_);
+                pending.push_back(&piece->node()->left_);
+            }
+            else
+            {
+                visit(piece->flat());
+            }
+        }
+    }
+
+    bool String::operator==(const String &other) const
+    {
+        // Equal inline text, or the same node
+        if (std::memcmp(bytes_, other.bytes_, sizeof bytes_) == 0)
+        {
+            return true;
+        }
+        // Text short enough to be inline always is
+        if (!isHeap() || !other.isHeap())
+        {
+            return false;
+        }
+        const Node &lhs = *node();
+        const Node &rhs = *other.node();
+        if (lhs.size_ != rhs.size_ || (lhs.interned_ && rhs.interned_))
+        {
+            return false;
+        }
+        if (!isRope() && !other.isRope())
+        {
+            return std::memcmp(lhs.text(), rhs.text(), lhs.size_) == 0;
+        }
+        return str() == other.str();
+    }
+
+    String::Node *String::node() const
+    {
+        Node *node;
+        std::memcpy(&node, bytes_, sizeof node);
+        return node;
+    }
+
+    std::size_t String::depth() const
+    {
+        return isHeap() ? node()->depth_ : 0;
+    }
+
+    std::string_view String::flat() const
+    {
+        if (isHeap())
+        {
+            return std::string_view(node()->text(), node()->size_);
+        }
+        return std::string_view(reinterpret_cast<const char *>(bytes_), bytes_[SmallCapacity]);
+    }
+
+    String::Node *String::makeFlat(std::string_view text)
+    {
+        Node *node = new (runtimePool().allocate(sizeof(Node) + text.size(), alignof(Node))) Node;
+        node->size_ = text.size();
+        std::copy(text.begin(), text.end(), node->text());
+        return node;
+    }
+
+    String String::makeConcat(String lhs, String rhs)
+    {
+        Node *node = new (runtimePool().allocate(sizeof(Node), alignof(Node))) Node;
+        node->size_ = lhs.size() + rhs.size();
+        node->depth_ = 1 + std::max(lhs.depth(), rhs.depth());
+        node->left_ = std::move(lhs);
+        node->right_ = std::move(rhs);
+        String rope(node);
+        return node->depth_ > MaxDepth ? rebalance(rope) : rope;
+    }
+
+    String String::rebalance(const String &rope)
+    {
+        std::vector<String> leaves;
+        std::vector<const String *> pending{&rope};
+        while (!pending.empty())
+        {
+            const String *piece = pending.back();
+            pending.pop_back();
+            if (piece->isRope())
+            {
+                pending.push_back(&piece->node()->right_);
+                pending.push_back(&piece->node()->left_);
+            }
+            else
+            {
+                leaves.push_back(*piece);
+            }
+        }
+        // Halving the leaves gives a depth of log2(leaves), well below MaxDepth
+        auto build = [&leaves](auto &self, std::size_t first, std::size_t last) -> String
+        {
+            if (last - first == 1)
+            {
+                return leaves[first];
+            }
+            std::size_t middle = first + (last - first) / 2;
+            return makeConcat(self(self, first, middle), self(self, middle, last));
+        };
+        return build(build, 0, leaves.size());
+    }
+
+    void String::release(Node *node)
+    {
+        if (node->references_.fetch_sub(1, std::memory_order_acq_rel) != 1)
+        {
+            return;
+        }
+        if (node->interned_)
+        {
+            InternTable &table = internTable();
+            std::lock_guard lock(table.mutex_);
+            auto it = table.nodes_.find(std::string_view(node->text(), node->size_));
+            if (it != table.nodes_.end() && it->second == node)
+            {
+                table.nodes_.erase(it);
+            }
+        }
+        std::size_t bytes = node->blockSize();
+        node->~Node();
+        runtimePool().deallocate(node, bytes, alignof(Node));
+    }
+
+    String::InternTable &String::internTable()
+    {
+        // Never destroyed, so Strings released during static destruction still find it
+        static InternTable *table = new InternTable;
+        return *table;
+    }
+
+    std::ostream &operator<<(std::ostream &out, const String &text)
+    {
+        text.forEachPiece([&out](std::string_view piece)
+                          { out.write(piece.data(), static_cast<std::streamsize>(piece.size())); });
+        return out;
+    }
+
+} // namespace Shattang::MyLisp
@@ -0,0 +1,210 @@
+#include <Shattang/MyLisp/ThreadPool.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <exception>
+#include <stdexcept>
+
+namespace Shattang::MyLisp
+{
+    namespace
+    {
+        // Automatic partitions have at least this many items, and there are at most this many
+        constexpr std::size_t MinimumGrain = 1024;
+        constexpr std::size_t MaxPartitions = 4096;
+
+        // The tasks [front, back) a participant has left, packed into one word so that its owner
+        // taking from the front and thieves taking from the back agree through a single CAS
+        struct alignas(64) TaskRange
+        {
+            std::atomic<std::uint64_t> bounds_{0};
+        };
+
+        std::uint64_t packRange(std::uint64_t front, std::uint64_t back)
+        {
+            return (front << 32) | back;
+        }
+
+        bool takeTask(TaskRange &range, bool fromFront, std::size_t &task)
+        {
+            std::uint64_t bounds = range.bounds_.load(std::memory_order_relaxed);
+            while (true)
+            {
+                std::uint64_t front = bounds >> 32;
+                std::uint64_t back = bounds & 0xffffffff;
+                if (front >= back)
+                {
+                    return false;
+                }
+                std::uint64_t next = fromFront ? packRange(front + 1, back) : packRange(front, back - 1);
+                if (range.bounds_.compare_exchange_weak(bounds, next, std::memory_order_acq_rel))
+                {
+                    task = fromFront ? front : back - 1;
+                    return true;
+                }
+            }
+        }
+
+        struct ParallelJob
+        {
+            ParallelJob(std::size_t participants, std::size_t count, const std::function<void(std::size_t)> &task)
+                : ranges_(std::make_unique<TaskRange[]>(participants)), participants_(participants), task_(task),
+                  remaining_(count)
+            {
+                for (std::size_t p = 0; p < participants; ++p)
+                {
+                    ranges_[p].bounds_.store(packRange(count * p / participants, count * (p + 1) / participants));
+                }
+            }
+
+            std::unique_ptr<TaskRange[]> ranges_;
+            std::size_t participants_;
+            const std::function<void(std::size_t)> &task_; // only used while tasks remain
+            std::atomic<std::size_t> nextParticipant_{1};   // 0 is the calling thread
+            std::atomic<std::size_t> remaining_;
+            std::atomic<bool> failed_{false};
+            std::mutex mutex_;
+            std::condition_variable finished_;
+            std::exception_ptr error_;
+
+            void participate(std::size_t self)
+            {
+                std::size_t task = 0;
+                while (true)
+                {
+                    bool found = takeTask(ranges_[self], true, task);
+                    for (std::size_t i = 1; !found && i < participants_; ++i)
+                    {
+                        found = takeTask(ranges_[(self + i) % participants_], false, task);
+                    }
+                    if (!found)
+                    {
+                        return;
+                    }
+                    if (!failed_.load(std::memory_order_relaxed))
+                    {
+                        try
+                        {
+                            task_(task);
+                        }
+                        catch (...)
+                        {
+                            std::lock_guard<std::mutex> lock(mutex_);
+                            if (!failed_.exchange(true))
+                            {
+                                error_ = std::current_exception();
+                            }
+                        }
+                    }
+                    if (remaining_.fetch_sub(1, std::memory_order_acq_rel) == 1)
+                    {
+                        std::lock_guard<std::mutex> lock(mutex_);
+                        finished_.notify_all();
+                    }
+                }
+            }
+        };
+    }
+
+    ThreadPool::ThreadPool(unsigned threads)
+    {
+        for (unsigned i = 0; i < threads; ++i)
+        {
+            workers_.emplace_back([this]()
+                                  { workerLoop(); });
+        }
+    }
+
+    ThreadPool::~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        changed_.notify_all();
+        for (auto &worker : workers_)
+        {
+            worker.join();
+        }
+    }
+
+    void ThreadPool::post(std::function<void()> job)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            jobs_.push_back(std::move(job));
+        }
+        changed_.notify_one();
+    }
+
+    void ThreadPool::parallelFor(std::size_t count, const std::function<void(std::size_t)> &task)
+    {
+        if (count > 0xffffffff)
+        {
+            throw std::length_error("parallelFor: too many tasks");
+        }
+        std::size_t participants = std::min(count, workers_.size() + 1);
+        if (participants <= 1)
+        {
+            for (std::size_t i = 0; i < count; ++i)
+            {
+                task(i);
+            }
+            return;
+        }
+
+        // Helpers that start after the work is done find nothing to take and return at once
+        auto job = std::make_shared<ParallelJob>(participants, count, task);
+        for (std::size_t p = 1; p < participants; ++p)
+        {
+            post([job]()
+                 { job->participate(job->nextParticipant_.fetch_add(1)); });
+        }
+        job->participate(0);
+
+        std::unique_lock<std::mutex> lock(job->mutex_);
+        job->finished_.wait(lock, [&job]()
+                            { return job->remaining_.load() == 0; });
+        if (job->error_)
+        {
+            std::rethrow_exception(job->error_);
+        }
+    }
+
+    ThreadPool &computePool()
+    {
+        static ThreadPool pool(std::max(1u, std::thread::hardware_concurrency()) - 1);
+        return pool;
+    }
+
+    std::size_t partitionSize(std::size_t count, long grain)
+    {
+        if (grain > 0)
+        {
+            return static_cast<std::size_t>(grain);
+        }
+        return std::max(MinimumGrain, (count + MaxPartitions - 1) / MaxPartitions);
+    }
+
+    void ThreadPool::workerLoop()
+    {
+        while (true)
+        {
+            std::function<void()> job;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                changed_.wait(lock, [this]()
+                              { return stopping_ || !jobs_.empty(); });
+                if (jobs_.empty())
+                {
+                    return; // stopping, and everything queued has run
+                }
+                job = std::move(jobs_.front());
+                jobs_.pop_front();
+            }
+            job();
+        }
+    }
+
+} // namespace Shattang::MyLisp
@@ -0,0 +1,686 @@
+#include <Shattang/MyLisp/TypeChecker.h>
+#include <Shattang/MyLisp/Builtins.h>
+#include <Shattang/MyLisp/LastUse.h>
+#include <Shattang/MyLisp/LoopParallelizer.h>
+#include <Shattang/MyLisp/Value.h>
+
+#include <algorithm>
+#include <sstream>
+#include <stdexcept>
+
+namespace Shattang::MyLisp
+{
+    std::string ValueTypeToString(ValueType type)
+    {
+        switch (type)
+        {
+        case ValueType::VOID:
+            return "Void";
+        case ValueType::INT:
+            return "Int";
+        case ValueType::FLOAT:
+            return "Float";
+        case ValueType::BOOLEAN:
+            return "Boolean";
+        case ValueType::STRING:
+            return "String";
+        case ValueType::DOUBLE_VECTOR:
+            return "DoubleVector";
+        case ValueType::DOUBLE_MATRIX:
+            return "DoubleMatrix";
+        case ValueType::SEQUENCE:
+            return "Sequence";
+        case ValueType::QUANTILE_SKETCH:
+            return "QuantileSketch";
+        case ValueType::DISTINCT_SKETCH:
+            return "DistinctSketch";
+        case ValueType::GROUPS:
+            return "Groups";
+        default:
+            return "UNKNOWN";
+        }
+    }
+
+    ValueType ValueTypeFromName(const std::string &name)
+    {
+        if (name == "Int")
+            return ValueType::INT;
+        if (name == "Float")
+            return ValueType::FLOAT;
+        if (name == "Boolean")
+            return ValueType::BOOLEAN;
+        if (name == "String")
+            return ValueType::STRING;
+        if (name == "DoubleVector")
+            return ValueType::DOUBLE_VECTOR;
+        if (name == "DoubleMatrix")
+            return ValueType::DOUBLE_MATRIX;
+        if (name == "Sequence")
+            return ValueType::SEQUENCE;
+        if (name == "QuantileSketch")
+            return ValueType::QUANTILE_SKETCH;
+        if (name == "DistinctSketch")
+            return ValueType::DISTINCT_SKETCH;
+        if (name == "Groups")
+            return ValueType::GROUPS;
+        if (name == "Void")
+            return ValueType::VOID;
+        throw std::runtime_error("Type error: unknown type '" + name + "'");
+    }
+
+    bool isNumericType(ValueType type)
+    {
+        return type == ValueType::INT || type == ValueType::FLOAT;
+    }
+
+    bool isAssignable(ValueType from, ValueType to)
+    {
+        return from == to || (from == ValueType::INT && to == ValueType::FLOAT);
+    }
+
+    namespace
+    {
+        bool isScalarType(ValueType type)
+        {
+            return type == ValueType::INT || type == ValueType::FLOAT || type == ValueType::BOOLEAN;
+        }
+    }
+
+    void TypeChecker::check(const ScriptNode &script)
+    {
+        check(script, {});
+    }
+
+    void TypeChecker::check(const ScriptNode &script, const std::unordered_map<std::string, ValueType> &inputs)
+    {
+        functions_.clear();
+        globals_ = inputs;
+        types_.clear();
+        callees_.clear();
+        callsNonScalarBuiltin_.clear();
+        hasSideEffects_.clear();
+        parallelPlans_.clear();
+        functionForms_.clear();
+        currentFunction_ = nullptr;
+
+        // Hoist function signatures and global declarations so that functions may call
+        // each other and refer to globals regardless of declaration order
+        for (const auto &statement : script.statements_)
+        {
+            if (statement->getType() == NodeType::FUNCTION_DECLARATION)
+            {
+                const auto &funcDecl = static_cast<const FunctionDeclarationNode &>(*statement);
+                if (functions_.count(funcDecl.functionName_) != 0)
+                {
+                    throwError("function '" + funcDecl.functionName_ + "' is already defined");
+                }
+                if (findBuiltin(funcDecl.functionName_) != nullptr || takesFunctionName(funcDecl.functionName_))
+                {
+                    throwError("function '" + funcDecl.functionName_ + "' redefines a builtin");
+                }
+
+                FunctionTypeInfo info;
+                info.declaration_ = &funcDecl;
+                for (const auto &param : funcDecl.parameters_)
+                {
+                    info.parameterTypes_.push_back(ValueTypeFromName(param.type_->name_));
+                }
+                info.returnType_ = ValueTypeFromName(funcDecl.returnType_->name_);
+                functions_.emplace(funcDecl.functionName_, std::move(info));
+            }
+            else if (statement->getType() == NodeType::VARIABLE_DECLARATION)
+            {
+                const auto &varDecl = static_cast<const VariableDeclarationNode &>(*statement);
+                declareVariable(varDecl.variableName_, ValueTypeFromName(varDecl.typeNode_->name_));
+            }
+            else if (statement->getType() == NodeType::FUNCTION_CALL &&
+                     static_cast<const FunctionCallNode &>(*statement).functionName_ == "using")
+            {
+                importModule(static_cast<const FunctionCallNode &>(*statement));
+            }
+        }
+
+        types_[&script] = checkBody(script.statements_);
+        computeNumericFunctions();
+        computePureFunctions();
+        checkFunctionForms();
+    }
+
+    void TypeChecker::importModule(const FunctionCallNode &node)
+    {
+        if (node.arguments_.size() != 1 || node.arguments_[0]->getType() != NodeType::STRING)
+        {
+            return; // reported when the call is checked
+        }
+        const std::string &name = static_cast<const StringNode &>(*node.arguments_[0]).text_;
+        if (!isModule(name))
+        {
+            throwError("unknown module \"" + name + "\"");
+        }
+        modules_.insert(name);
+    }
+
+    ValueType TypeChecker::typeOf(const ASTNode &node) const
+    {
+        auto it = types_.find(&node);
+        if (it == types_.end())
+        {
+            throw std::runtime_error("Type error: node was not type checked: " + node.toString());
+        }
+        return it->second;
+    }
+
+    const FunctionTypeInfo *TypeChecker::function(const std::string &name) const
+    {
+        auto it = functions_.find(name);
+        return it == functions_.end() ? nullptr : &it->second;
+    }
+
+    const ParallelLoopPlan *TypeChecker::parallelPlan(const ForIterationNode &node) const
+    {
+        auto it = parallelPlans_.find(&node);
+        if (it == parallelPlans_.end())
+        {
+            throw std::runtime_error("Type error: 'pfor' was not type checked: " + node.toString());
+        }
+        return it->second.get();
+    }
+
+    ValueType TypeChecker::checkNode(const ASTNode &node)
+    {
+        ValueType type = ValueType::VOID;
+        switch (node.getType())
+        {
+        case NodeType::SYMBOL:
+            type = checkSymbol(static_cast<const SymbolNode &>(node));
+            break;
+        case NodeType::INTEGER:
+            type = ValueType::INT;
+            break;
+        case NodeType::FLOAT:
+            type = ValueType::FLOAT;
+            break;
+        case NodeType::BOOLEAN:
+            type = ValueType::BOOLEAN;
+            break;
+        case NodeType::STRING:
+            type = ValueType::STRING;
+            break;
+        case NodeType::VARIABLE_DECLARATION:
+            type = checkVariableDeclaration(static_cast<const VariableDeclarationNode &>(node));
+            break;
+        case NodeType::FUNCTION_DECLARATION:
+            type = checkFunctionDeclaration(static_cast<const FunctionDeclarationNode &>(node));
+            break;
+        case NodeType::FUNCTION_CALL:
+            type = checkFunctionCall(static_cast<const FunctionCallNode &>(node));
+            break;
+        case NodeType::VARIABLE_ASSIGNMENT:
+            type = checkVariableAssignment(static_cast<const VariableAssignmentNode &>(node));
+            break;
+        case NodeType::FOR_ITERATION:
+            type = checkForIteration(static_cast<const ForIterationNode &>(node));
+            break;
+        case NodeType::WHILE_ITERATION:
+            type = checkWhileIteration(static_cast<const WhileIterationNode &>(node));
+            break;
+        case NodeType::IF:
+            type = checkIf(static_cast<const IfNode &>(node));
+            break;
+        case NodeType::SCRIPT:
+            type = checkBody(static_cast<const ScriptNode &>(node).statements_);
+            break;
+        }
+        types_[&node] = type;
+        return type;
+    }
+
+    ValueType TypeChecker::checkSymbol(const SymbolNode &node)
+    {
+        const ValueType *type = lookupVariable(node.name_);
+        if (type == nullptr)
+        {
+            throwError("undefined variable '" + node.name_ + "'");
+        }
+        return *type;
+    }
+
+    ValueType TypeChecker::checkVariableDeclaration(const VariableDeclarationNode &node)
+    {
+        ValueType declared = ValueTypeFromName(node.typeNode_->name_);
+        if (declared == ValueType::VOID)
+        {
+            throwError("variable '" + node.variableName_ + "' cannot be declared Void");
+        }
+        ValueType valueType = checkNode(*node.valueNode_);
+        if (!isAssignable(valueType, declared))
+        {
+            throwError("cannot initialize '" + node.variableName_ + "' of type " + ValueTypeToString(declared) +
+                       " with " + ValueTypeToString(valueType));
+        }
+        declareVariable(node.variableName_, declared);
+        return ValueType::VOID;
+    }
+
+    ValueType TypeChecker::checkFunctionDeclaration(const FunctionDeclarationNode &node)
+    {
+        FunctionTypeInfo &info = functions_.at(node.functionName_);
+        currentFunction_ = &info;
+        callees_[node.functionName_];
+        callsNonScalarBuiltin_[node.functionName_] = false;
+        hasSideEffects_[node.functionName_] = false;
+
+        for (std::size_t i = 0; i < node.parameters_.size(); ++i)
+        {
+            if (info.parameterTypes_[i] == ValueType::VOID)
+            {
+                throwError("parameter '" + node.parameters_[i].name_ + "' cannot be Void");
+            }
+            if (info.locals_.count(node.parameters_[i].name_) != 0)
+            {
+                throwError("duplicate parameter '" + node.parameters_[i].name_ + "'");
+            }
+            info.locals_[node.parameters_[i].name_] = info.parameterTypes_[i];
+        }
+
+        ValueType bodyType = checkBody(node.body_);
+        if (info.returnType_ != ValueType::VOID && !isAssignable(bodyType, info.returnType_))
+        {
+            throwError("function '" + node.functionName_ + "' returns " + ValueTypeToString(bodyType) +
+                       " but is declared " + ValueTypeToString(info.returnType_));
+        }
+        info.lastUses_ = findLastUses(node, info);
+
+        currentFunction_ = nullptr;
+        return ValueType::VOID;
+    }
+
+    ValueType TypeChecker::checkFunctionCall(const FunctionCallNode &node)
+    {
+        if (isParallelCall(node.functionName_))
+        {
+            return checkParallelCall(node);
+        }
+        if (isSequenceCall(node.functionName_))
+        {
+            return checkSequenceCall(node);
+        }
+
+        std::vector<ValueType> argTypes;
+        argTypes.reserve(node.arguments_.size());
+        for (const auto &arg : node.arguments_)
+        {
+            argTypes.push_back(checkNode(*arg));
+        }
+
+        const Builtin *builtin = findBuiltin(node.functionName_);
+        if (builtin != nullptr)
+        {
+            if (builtin->module_ != nullptr && modules_.count(builtin->module_) == 0)
+            {
+                throwError("'" + node.functionName_ + "' needs (using \"" + builtin->module_ + "\")");
+            }
+            if (currentFunction_ != nullptr && !builtin->isScalar_)
+            {
+                callsNonScalarBuiltin_[currentFunction_->declaration_->functionName_] = true;
+            }
+            if (currentFunction_ != nullptr && (node.functionName_ == "print" || node.functionName_ == "using"))
+            {
+                hasSideEffects_[currentFunction_->declaration_->functionName_] = true;
+            }
+            if (node.functionName_ == "vector-push" && !node.arguments_.empty() &&
+                node.arguments_[0]->getType() == NodeType::SYMBOL)
+            {
+                noteWrite(static_cast<const SymbolNode &>(*node.arguments_[0]).name_);
+            }
+            try
+            {
+                return builtin->typeRule_(node.functionName_, argTypes);
+            }
+            catch (const std::runtime_error &e)
+            {
+                throwError(e.what());
+            }
+        }
+
+        const FunctionTypeInfo *callee = function(node.functionName_);
+        if (callee == nullptr)
+        {
+            throwError("unknown function '" + node.functionName_ + "'");
+        }
+        if (argTypes.size() != callee->parameterTypes_.size())
+        {
+            throwError("'" + node.functionName_ + "' expects " + std::to_string(callee->parameterTypes_.size()) +
+                       " argument(s), got " + std::to_string(argTypes.size()));
+        }
+        for (std::size_t i = 0; i < argTypes.size(); ++i)
+        {
+            if (!isAssignable(argTypes[i], callee->parameterTypes_[i]))
+            {
+                throwError("argument " + std::to_string(i + 1) + " of '" + node.functionName_ + "' must be " +
+                           ValueTypeToString(callee->parameterTypes_[i]) + ", got " + ValueTypeToString(argTypes[i]));
+            }
+        }
+        if (currentFunction_ != nullptr)
+        {
+            callees_[currentFunction_->declaration_->functionName_].push_back(node.functionName_);
+        }
+        return callee->returnType_;
+    }
+
+    // (pmap f vector [grain]) and (preduce f init vector [grain])
+    ValueType TypeChecker::checkParallelCall(const FunctionCallNode &node)
+    {
+        const std::string &name = node.functionName_;
+        bool isMap = name == "pmap";
+        std::size_t required = isMap ? 2 : 3;
+        if (node.arguments_.size() != required && node.arguments_.size() != required + 1)
+        {
+            throwError("'" + name + "' expects " + std::to_string(required) + " or " + std::to_string(required + 1) +
+                       " argument(s), got " + std::to_string(node.arguments_.size()));
+        }
+        checkFunctionArgument(node, isMap ? 1 : 2, ValueType::FLOAT);
+
+        for (std::size_t i = 1; i < node.arguments_.size(); ++i)
+        {
+            ValueType type = checkNode(*node.arguments_[i]);
+            bool isInit = !isMap && i == 1;
+            bool isVector = i == required - 1;
+            ValueType expected = isVector ? ValueType::DOUBLE_VECTOR : ValueType::INT;
+            if (isInit ? !isNumericType(type) : type != expected)
+            {
+                throwError("argument " + std::to_string(i + 1) + " of '" + name + "' must be " +
+                           (isInit ? std::string("Int or Float") : ValueTypeToString(expected)) + ", got " +
+                           ValueTypeToString(type));
+            }
+        }
+        return isMap ? ValueType::DOUBLE_VECTOR : ValueType::FLOAT;
+    }
+
+    // (map f elements), (filter f elements) and (zip f elements elements), where the elements
+    // are a DoubleVector or a Sequence
+    ValueType TypeChecker::checkSequenceCall(const FunctionCallNode &node)
+    {
+        const std::string &name = node.functionName_;
+        bool isZip = name == "zip";
+        std::size_t required = isZip ? 3 : 2;
+        if (node.arguments_.size() != required)
+        {
+            throwError("'" + name + "' expects " + std::to_string(required) + " argument(s), got " +
+                       std::to_string(node.arguments_.size()));
+        }
+        checkFunctionArgument(node, isZip ? 2 : 1, name == "filter" ? ValueType::BOOLEAN : ValueType::FLOAT);
+
+        for (std::size_t i = 1; i < node.arguments_.size(); ++i)
+        {
+            ValueType type = checkNode(*node.arguments_[i]);
+            if (type != ValueType::DOUBLE_VECTOR && type != ValueType::SEQUENCE)
+            {
+                throwError("argument " + std::to_string(i + 1) + " of '" + name +
+                           "' must be DoubleVector or Sequence, got " + ValueTypeToString(type));
+            }
+        }
+        return ValueType::SEQUENCE;
+    }
+
+    // The first argument of `node` names a script function taking `parameters` Floats and
+    // returning `result`, where Float also accepts Int. The function has to be pure, which is
+    // only known once every function has been checked.
+    void TypeChecker::checkFunctionArgument(const FunctionCallNode &node, std::size_t parameters, ValueType result)
+    {
+        const std::string &name = node.functionName_;
+        const std::string &functionName = static_cast<const SymbolNode &>(*node.arguments_[0]).name_;
+        const FunctionTypeInfo *callee = function(functionName);
+        if (callee == nullptr)
+        {
+            throwError("unknown function '" + functionName + "' passed to '" + name + "'");
+        }
+        types_[node.arguments_[0].get()] = ValueType::VOID; // names the function; not evaluated
+
+        bool takesFloats = callee->parameterTypes_.size() == parameters &&
+                           std::all_of(callee->parameterTypes_.begin(), callee->parameterTypes_.end(),
+                                       [](ValueType type)
+                                       { return type == ValueType::FLOAT; });
+        bool returns = result == ValueType::FLOAT ? isNumericType(callee->returnType_) : callee->returnType_ == result;
+        if (!takesFloats || !returns)
+        {
+            throwError("'" + name + "' needs a function of " +
+                       (parameters == 1 ? "one Float parameter" : "two Float parameters") + " returning " +
+                       (result == ValueType::FLOAT ? "Int or Float" : ValueTypeToString(result)) + ", got '" +
+                       functionName + "'");
+        }
+
+        if (currentFunction_ != nullptr)
+        {
+            callsNonScalarBuiltin_[currentFunction_->declaration_->functionName_] = true;
+            callees_[currentFunction_->declaration_->functionName_].push_back(functionName);
+        }
+        functionForms_.emplace_back(&node, currentFunction_);
+    }
+
+    ValueType TypeChecker::checkVariableAssignment(const VariableAssignmentNode &node)
+    {
+        const ValueType *declared = lookupVariable(node.variableName_);
+        if (declared == nullptr)
+        {
+            throwError("assignment to undefined variable '" + node.variableName_ + "'");
+        }
+        noteWrite(node.variableName_);
+        ValueType target = *declared;
+        ValueType valueType = checkNode(*node.valueNode_);
+        if (!isAssignable(valueType, target))
+        {
+            throwError("cannot assign " + ValueTypeToString(valueType) + " to '" + node.variableName_ + "' of type " +
+                       ValueTypeToString(target));
+        }
+        return ValueType::VOID;
+    }
+
+    ValueType TypeChecker::checkForIteration(const ForIterationNode &node)
+    {
+        std::string keyword = node.isParallel_ ? "pfor" : "for";
+        for (const ASTNode *bound : {node.start_.get(), node.end_.get(), node.step_.get()})
+        {
+            ValueType boundType = checkNode(*bound);
+            if (boundType != ValueType::INT)
+            {
+                throwError("'" + keyword + "' bounds and step must be Int, got " + ValueTypeToString(boundType));
+            }
+        }
+        if (node.grain_ != nullptr)
+        {
+            ValueType grainType = checkNode(*node.grain_);
+            if (grainType != ValueType::INT)
+            {
+                throwError("'pfor' grain must be Int, got " + ValueTypeToString(grainType));
+            }
+        }
+        declareVariable(node.index_, ValueType::INT);
+        checkBody(node.body_);
+        if (node.isParallel_)
+        {
+            functionForms_.emplace_back(&node, currentFunction_);
+        }
+        return ValueType::VOID;
+    }
+
+    ValueType TypeChecker::checkWhileIteration(const WhileIterationNode &node)
+    {
+        ValueType conditionType = checkNode(*node.condition_);
+        if (conditionType != ValueType::BOOLEAN)
+        {
+            throwError("'while' condition must be Boolean, got " + ValueTypeToString(conditionType));
+        }
+        checkBody(node.body_);
+        return ValueType::VOID;
+    }
+
+    ValueType TypeChecker::checkIf(const IfNode &node)
+    {
+        ValueType conditionType = checkNode(*node.condition_);
+        if (conditionType != ValueType::BOOLEAN)
+        {
+            throwError("'if' condition must be Boolean, got " + ValueTypeToString(conditionType));
+        }
+        ValueType thenType = checkNode(*node.thenBranch_);
+        ValueType elseType = checkNode(*node.elseBranch_);
+        if (thenType == elseType)
+        {
+            return thenType;
+        }
+        if (isNumericType(thenType) && isNumericType(elseType))
+        {
+            return ValueType::FLOAT;
+        }
+        return ValueType::VOID; // Usable as a statement only
+    }
+
+    ValueType TypeChecker::checkBody(const std::vector<std::unique_ptr<ASTNode>> &body)
+    {
+        ValueType last = ValueType::VOID;
+        for (const auto &statement : body)
+        {
+            last = checkNode(*statement);
+        }
+        return last;
+    }
+
+    void TypeChecker::declareVariable(const std::string &name, ValueType type)
+    {
+        auto &scope = currentFunction_ != nullptr ? currentFunction_->locals_ : globals_;
+        auto [it, inserted] = scope.emplace(name, type);
+        if (!inserted && it->second != type)
+        {
+            throwError("variable '" + name + "' redeclared as " + ValueTypeToString(type) + ", previously " +
+                       ValueTypeToString(it->second));
+        }
+    }
+
+    const ValueType *TypeChecker::lookupVariable(const std::string &name) const
+    {
+        if (currentFunction_ != nullptr)
+        {
+            auto local = currentFunction_->locals_.find(name);
+            if (local != currentFunction_->locals_.end())
+            {
+                return &local->second;
+            }
+        }
+        auto global = globals_.find(name);
+        return global == globals_.end() ? nullptr : &global->second;
+    }
+
+    // Writes to a variable that is not a local of the current function are side effects
+    void TypeChecker::noteWrite(const std::string &name)
+    {
+        if (currentFunction_ != nullptr && currentFunction_->locals_.count(name) == 0)
+        {
+            hasSideEffects_[currentFunction_->declaration_->functionName_] = true;
+        }
+    }
+
+    void TypeChecker::computeNumericFunctions()
+    {
+        // Start optimistic from each function's own types, then remove functions that call
+        // non-numeric functions until nothing changes
+        for (auto &[name, info] : functions_)
+        {
+            bool scalar = !callsNonScalarBuiltin_[name] && isScalarType(info.returnType_);
+            for (const auto &[local, type] : info.locals_)
+            {
+                scalar = scalar && isScalarType(type);
+            }
+            info.isNumeric_ = scalar;
+        }
+
+        bool changed = true;
+        while (changed)
+        {
+            changed = false;
+            for (auto &[name, info] : functions_)
+            {
+                if (!info.isNumeric_)
+                    continue;
+                for (const auto &callee : callees_[name])
+                {
+                    if (!functions_.at(callee).isNumeric_)
+                    {
+                        info.isNumeric_ = false;
+                        changed = true;
+                        break;
+                    }
+                }
+            }
+        }
+    }
+
+    void TypeChecker::computePureFunctions()
+    {
+        for (auto &[name, info] : functions_)
+        {
+            info.isPure_ = !hasSideEffects_[name];
+        }
+
+        bool changed = true;
+        while (changed)
+        {
+            changed = false;
+            for (auto &[name, info] : functions_)
+            {
+                if (!info.isPure_)
+                    continue;
+                for (const auto &callee : callees_[name])
+                {
+                    if (!functions_.at(callee).isPure_)
+                    {
+                        info.isPure_ = false;
+                        changed = true;
+                        break;
+                    }
+                }
+            }
+        }
+    }
+
+    void TypeChecker::checkFunctionForms()
+    {
+        for (const auto &[node, enclosing] : functionForms_)
+        {
+            currentFunction_ = enclosing; // for the error message
+            if (node->getType() == NodeType::FOR_ITERATION)
+            {
+                const auto &loop = static_cast<const ForIterationNode &>(*node);
+                std::shared_ptr<const ParallelLoopPlan> plan = planParallelLoop(loop, *this);
+                if (plan == nullptr)
+                {
+                    throwError("the body of 'pfor' over '" + loop.index_ +
+                               "' may only update accumulators with add or a min/max selection, append with "
+                               "vector-push and call pure functions");
+                }
+                parallelPlans_[node] = std::move(plan);
+                continue;
+            }
+
+            const auto &call = static_cast<const FunctionCallNode &>(*node);
+            const std::string &functionName = static_cast<const SymbolNode &>(*call.arguments_[0]).name_;
+            if (!function(functionName)->isPure_)
+            {
+                throwError("'" + call.functionName_ + "' needs a function without side effects, but '" + functionName +
+                           "' prints, runs 'using' or writes a global");
+            }
+        }
+        currentFunction_ = nullptr;
+    }
+
+    void TypeChecker::throwError(const std::string &message) const
+    {
+        std::ostringstream oss;
+        oss << "Type error: " << message;
+        if (currentFunction_ != nullptr)
+        {
+            oss << " in function '" << currentFunction_->declaration_->functionName_ << "'";
+        }
+        throw std::runtime_error(oss.str());
+    }
+
+} // namespace Shattang::MyLisp
@@ -0,0 +1,376 @@
+#include <Shattang/MyLisp/Value.h>
+#include <Shattang/MyLisp/DoubleMatrix.h>
+#include <Shattang/MyLisp/Sequence.h>
+#include <Shattang/MyLisp/Sketches.h>
+#include <Shattang/MyLisp/Sorting.h>
+#include <Shattang/MyLisp/VectorExpression.h>
+
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+
+namespace Shattang::MyLisp
+{
+    struct DeferredVector
+    {
+        std::shared_ptr<const VectorExpression> expression_; // null until pending_ is resolved
+        std::future<DoubleVector> pending_;
+        bool isPending_ = false; // set once, when the Value is created
+        std::once_flag resolved_;
+        std::once_flag materialized_;
+        std::shared_ptr<DoubleVector> storage_;
+    };
+
+    namespace
+    {
+        [[noreturn]] void throwTypeMismatch(ValueType expected, ValueType actual)
+        {
+            throw std::runtime_error("Runtime error: expected " + ValueTypeToString(expected) + " value, got " +
+                                     ValueTypeToString(actual));
+        }
+
+        // Waits for a pending import, which then becomes an expression over its storage.
+        // Errors from the import are rethrown here, at the first use of the vector.
+        const VectorExpression &expressionOf(DeferredVector &vector)
+        {
+            if (vector.isPending_)
+            {
+                std::call_once(vector.resolved_, [&vector]()
+                               {
+                    vector.storage_ = std::make_shared<DoubleVector>(vector.pending_.get());
+                    vector.expression_ = VectorExpression::vector(vector.storage_); });
+            }
+            return *vector.expression_;
+        }
+    }
+
+    Value::Value(std::shared_ptr<const VectorExpression> expression)
+    {
+        auto deferred = std::make_shared<DeferredVector>();
+        deferred->expression_ = std::move(expression);
+        data_ = std::move(deferred);
+    }
+
+    Value::Value(std::future<DoubleVector> pending)
+    {
+        auto deferred = std::make_shared<DeferredVector>();
+        deferred->pending_ = std::move(pending);
+        deferred->isPending_ = true;
+        data_ = std::move(deferred);
+    }
+
+    Value::Value(std::shared_ptr<const DoubleMatrix> matrix) : data_(std::move(matrix)) {}
+
+    Value::Value(std::shared_ptr<const Sequence> sequence) : data_(std::move(sequence)) {}
+
+    Value::Value(std::shared_ptr<const QuantileSketch> sketch) : data_(std::move(sketch)) {}
+
+    Value::Value(std::shared_ptr<const DistinctSketch> sketch) : data_(std::move(sketch)) {}
+
+    Value::Value(std::shared_ptr<const Groups> groups) : data_(std::move(groups)) {}
+
+    ValueType Value::type() const
+    {
+        switch (data_.index())
+        {
+        case 1:
+            return ValueType::INT;
+        case 2:
+            return ValueType::FLOAT;
+        case 3:
+            return ValueType::BOOLEAN;
+        case 4:
+            return ValueType::STRING;
+        case 5:
+        case 6:
+            return ValueType::DOUBLE_VECTOR;
+        case 7:
+            return ValueType::SEQUENCE;
+        case 8:
+            return ValueType::QUANTILE_SKETCH;
+        case 9:
+            return ValueType::DISTINCT_SKETCH;
+        case 10:
+            return ValueType::GROUPS;
+        case 11:
+            return ValueType::DOUBLE_MATRIX;
+        default:
+            return ValueType::VOID;
+        }
+    }
+
+    long Value::asInt() const
+    {
+        if (const long *value = std::get_if<long>(&data_))
+        {
+            return *value;
+        }
+        throwTypeMismatch(ValueType::INT, type());
+    }
+
+    double Value::asFloat() const
+    {
+        if (const double *value = std::get_if<double>(&data_))
+        {
+            return *value;
+        }
+        if (const long *value = std::get_if<long>(&data_))
+        {
+            return static_cast<double>(*value);
+        }
+        throwTypeMismatch(ValueType::FLOAT, type());
+    }
+
+    bool Value::asBool() const
+    {
+        if (const bool *value = std::get_if<bool>(&data_))
+        {
+            return *value;
+        }
+        throwTypeMismatch(ValueType::BOOLEAN, type());
+    }
+
+    const String &Value::asString() const
+    {
+        if (const String *value = std::get_if<String>(&data_))
+        {
+            return *value;
+        }
+        throwTypeMismatch(ValueType::STRING, type());
+    }
+
+    const DoubleVector &Value::asVector() const
+    {
+        if (const auto *value = std::get_if<std::shared_ptr<DoubleVector>>(&data_))
+        {
+            return **value;
+        }
+        if (const auto *deferred = std::get_if<std::shared_ptr<DeferredVector>>(&data_))
+        {
+            DeferredVector &vector = **deferred;
+            const VectorExpression &expression = expressionOf(vector);
+            std::call_once(vector.materialized_, [&vector, &expression]()
+                           {
+                if (vector.storage_ == nullptr)
+                {
+                    vector.storage_ = std::make_shared<DoubleVector>(expression.materialize());
+                } });
+            return *vector.storage_;
+        }
+        throwTypeMismatch(ValueType::DOUBLE_VECTOR, type());
+    }
+
+    DoubleVector &Value::asMutableVector()
+    {
+        if (auto *deferred = std::get_if<std::shared_ptr<DeferredVector>>(&data_))
+        {
+            // Other Values may share the deferred vector, so this one gets its own storage
+            DeferredVector &vector = **deferred;
+            const VectorExpression &expression = expressionOf(vector);
+            data_ = std::make_shared<DoubleVector>(vector.storage_ != nullptr ? DoubleVector(*vector.storage_)
+                                                                              : expression.materialize());
+        }
+        if (auto *value = std::get_if<std::shared_ptr<DoubleVector>>(&data_))
+        {
+            // Copy on write: the other Values sharing the vector keep its current contents
+            if (value->use_count() > 1)
+            {
+                *value = std::make_shared<DoubleVector>(**value);
+            }
+            return **value;
+        }
+        throwTypeMismatch(ValueType::DOUBLE_VECTOR, type());
+    }
+
+    std::shared_ptr<const Sequence> Value::asSequence() const
+    {
+        if (const auto *sequence = std::get_if<std::shared_ptr<const Sequence>>(&data_))
+        {
+            return *sequence;
+        }
+        if (type() == ValueType::DOUBLE_VECTOR)
+        {
+            return Sequence::vector(asExpression());
+        }
+        throwTypeMismatch(ValueType::SEQUENCE, type());
+    }
+
+    const DoubleMatrix &Value::asMatrix() const
+    {
+        if (const auto *matrix = std::get_if<std::shared_ptr<const DoubleMatrix>>(&data_))
+        {
+            return **matrix;
+        }
+        throwTypeMismatch(ValueType::DOUBLE_MATRIX, type());
+    }
+
+    const QuantileSketch &Value::asQuantileSketch() const
+    {
+        if (const auto *sketch = std::get_if<std::shared_ptr<const QuantileSketch>>(&data_))
+        {
+            return **sketch;
+        }
+        throwTypeMismatch(ValueType::QUANTILE_SKETCH, type());
+    }
+
+    const DistinctSketch &Value::asDistinctSketch() const
+    {
+        if (const auto *sketch = std::get_if<std::shared_ptr<const DistinctSketch>>(&data_))
+        {
+            return **sketch;
+        }
+        throwTypeMismatch(ValueType::DISTINCT_SKETCH, type());
+    }
+
+    const Groups &Value::asGroups() const
+    {
+        if (const auto *groups = std::get_if<std::shared_ptr<const Groups>>(&data_))
+        {
+            return **groups;
+        }
+        throwTypeMismatch(ValueType::GROUPS, type());
+    }
+
+    std::shared_ptr<const VectorExpression> Value::asExpression() const
+    {
+        if (const auto *value = std::get_if<std::shared_ptr<DoubleVector>>(&data_))
+        {
+            return VectorExpression::vector(*value);
+        }
+        if (const auto *deferred = std::get_if<std::shared_ptr<DeferredVector>>(&data_))
+        {
+            expressionOf(**deferred);
+            return (*deferred)->expression_;
+        }
+        throwTypeMismatch(ValueType::DOUBLE_VECTOR, type());
+    }
+
+    std::size_t Value::vectorSize() const
+    {
+        if (const auto *deferred = std::get_if<std::shared_ptr<DeferredVector>>(&data_))
+        {
+            return expressionOf(**deferred).size();
+        }
+        return asVector().size();
+    }
+
+    double Value::vectorElement(long index) const
+    {
+        if (const auto *deferred = std::get_if<std::shared_ptr<DeferredVector>>(&data_))
+        {
+            // Random access computes the element instead of materializing the whole vector
+            const VectorExpression &expression = expressionOf(**deferred);
+            if (index < 0 || static_cast<std::size_t>(index) >= expression.size())
+            {
+                throw std::runtime_error("Runtime error: vector-ref index " + std::to_string(index) +
+                                         " out of range for length " + std::to_string(expression.size()));
+            }
+            return expression.at(static_cast<std::size_t>(index));
+        }
+        return asVector().at(index);
+    }
+
+    double Value::vectorElementUnchecked(std::size_t index) const
+    {
+        if (const auto *value = std::get_if<std::shared_ptr<DoubleVector>>(&data_))
+        {
+            return (**value)[index];
+        }
+        if (const auto *deferred = std::get_if<std::shared_ptr<DeferredVector>>(&data_))
+        {
+            return expressionOf(**deferred).at(index);
+        }
+        throwTypeMismatch(ValueType::DOUBLE_VECTOR, type());
+    }
+
+    std::string Value::toString() const
+    {
+        switch (type())
+        {
+        case ValueType::INT:
+            return std::to_string(asInt());
+        case ValueType::FLOAT:
+        {
+            std::ostringstream oss;
+            oss << std::get<double>(data_);
+            return oss.str();
+        }
+        case ValueType::BOOLEAN:
+            return asBool() ? "true" : "false";
+        case ValueType::STRING:
+            return asString().str();
+        case ValueType::DOUBLE_VECTOR:
+        case ValueType::SEQUENCE:
+        {
+            // A sequence prints the elements it produces
+            DoubleVector elements = type() == ValueType::SEQUENCE ? asSequence()->collect() : DoubleVector();
+            const DoubleVector &vector = type() == ValueType::SEQUENCE ? elements : asVector();
+            std::ostringstream oss;
+            oss << "[";
+            for (std::size_t i = 0; i < vector.size(); ++i)
+            {
+                oss << (i > 0 ? " " : "") << vector[i];
+            }
+            oss << "]";
+            return oss.str();
+        }
+        case ValueType::DOUBLE_MATRIX:
+        {
+            // One bracketed row per row of the matrix
+            const DoubleMatrix &matrix = asMatrix();
+            std::ostringstream oss;
+            oss << "[";
+            for (std::size_t row = 0; row < matrix.rows(); ++row)
+            {
+                oss << (row > 0 ? " [" : "[");
+                for (std::size_t column = 0; column < matrix.columns(); ++column)
+                {
+                    oss << (column > 0 ? " " : "") << matrix(row, column);
+                }
+                oss << "]";
+            }
+            oss << "]";
+            return oss.str();
+        }
+        case ValueType::QUANTILE_SKETCH:
+            return "<QuantileSketch of " + std::to_string(asQuantileSketch().count()) + " values>";
+        case ValueType::DISTINCT_SKETCH:
+            return "<DistinctSketch of " + std::to_string(asDistinctSketch().count()) + " values>";
+        case ValueType::GROUPS:
+            return "<Groups of " + std::to_string(asGroups().size()) + " keys>";
+        default:
+            return "";
+        }
+    }
+
+    bool Value::operator==(const Value &other) const
+    {
+        if (isNumericType(type()) && isNumericType(other.type()) && type() != other.type())
+        {
+            return asFloat() == other.asFloat();
+        }
+        if (type() == ValueType::DOUBLE_VECTOR && other.type() == ValueType::DOUBLE_VECTOR)
+        {
+            return asVector() == other.asVector();
+        }
+        if (type() == ValueType::DOUBLE_MATRIX && other.type() == ValueType::DOUBLE_MATRIX)
+        {
+            return asMatrix() == other.asMatrix();
+        }
+        if (type() == ValueType::SEQUENCE && other.type() == ValueType::SEQUENCE)
+        {
+            return asSequence()->collect() == other.asSequence()->collect();
+        }
+        return data_ == other.data_;
+    }
+
+    Value convertValue(Value value, ValueType type)
+    {
+        if (type == ValueType::FLOAT && value.type() == ValueType::INT)
+        {
+            return Value(static_cast<double>(value.asInt()));
+        }
+        return value;
+    }
+
+} // namespace Shattang::MyLisp
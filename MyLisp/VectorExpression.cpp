@@ -0,0 +1,390 @@
+#include <Shattang/MyLisp/VectorExpression.h>
+#include <Shattang/MyLisp/ThreadPool.h>
+#include <Shattang/MyLisp/VectorKernels.h>
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace Shattang::MyLisp
+{
+    std::shared_ptr<const VectorExpression> VectorExpression::vector(std::shared_ptr<const DoubleVector> data)
+    {
+        auto expression = std::make_shared<VectorExpression>();
+        expression->kind_ = Kind::VECTOR;
+        expression->size_ = data->size();
+        expression->data_ = std::move(data);
+        return expression;
+    }
+
+    std::shared_ptr<const VectorExpression> VectorExpression::constant(double value, std::size_t size)
+    {
+        auto expression = std::make_shared<VectorExpression>();
+        expression->kind_ = Kind::CONSTANT;
+        expression->size_ = size;
+        expression->value_ = value;
+        expression->scratchBlocks_ = 1;
+        return expression;
+    }
+
+    std::shared_ptr<const VectorExpression> VectorExpression::stream(std::shared_ptr<VectorStream> stream)
+    {
+        auto expression = std::make_shared<VectorExpression>();
+        expression->kind_ = Kind::STREAM;
+        expression->size_ = stream->size();
+        expression->scratchBlocks_ = 1;
+        expression->stream_ = std::move(stream);
+        return expression;
+    }
+
+    std::shared_ptr<const VectorExpression> VectorExpression::binary(Kind kind, std::shared_ptr<const VectorExpression> lhs,
+                                                                     std::shared_ptr<const VectorExpression> rhs,
+                                                                     const char *builtin)
+    {
+        if (lhs->size() != rhs->size())
+        {
+            throw std::runtime_error(std::string("Runtime error: '") + builtin + "' needs vectors of equal length, got " +
+                                     std::to_string(lhs->size()) + " and " + std::to_string(rhs->size()));
+        }
+        auto expression = std::make_shared<VectorExpression>();
+        expression->kind_ = kind;
+        expression->size_ = lhs->size();
+        expression->scratchBlocks_ = 1 + lhs->scratchBlocks() + rhs->scratchBlocks();
+        expression->lhs_ = std::move(lhs);
+        expression->rhs_ = std::move(rhs);
+        return expression;
+    }
+
+    std::shared_ptr<const VectorExpression> VectorExpression::concat(std::shared_ptr<const VectorExpression> lhs,
+                                                                     std::shared_ptr<const VectorExpression> rhs)
+    {
+        if (lhs->size() == 0)
+        {
+            return rhs;
+        }
+        if (rhs->size() == 0)
+        {
+            return lhs;
+        }
+        auto expression = std::make_shared<VectorExpression>();
+        expression->kind_ = Kind::CONCAT;
+        expression->size_ = lhs->size() + rhs->size();
+        expression->scratchBlocks_ = 1 + lhs->scratchBlocks() + rhs->scratchBlocks();
+        expression->lhs_ = std::move(lhs);
+        expression->rhs_ = std::move(rhs);
+        return expression;
+    }
+
+    std::shared_ptr<const VectorExpression> VectorExpression::slice(const std::shared_ptr<const VectorExpression> &expression,
+                                                                    std::size_t first, std::size_t size)
+    {
+        if (first == 0 && size == expression->size())
+        {
+            return expression;
+        }
+        switch (expression->kind())
+        {
+        case Kind::VECTOR:
+        case Kind::STREAM:
+        {
+            auto result = std::make_shared<VectorExpression>(*expression);
+            result->first_ += first;
+            result->size_ = size;
+            return result;
+        }
+        case Kind::CONSTANT:
+            return constant(expression->value_, size);
+        case Kind::CONCAT:
+        {
+            const auto &lhs = expression->lhs_;
+            const auto &rhs = expression->rhs_;
+            if (first + size <= lhs->size())
+            {
+                return slice(lhs, first, size);
+            }
+            if (first >= lhs->size())
+            {
+                return slice(rhs, first - lhs->size(), size);
+            }
+            std::size_t lhsCount = lhs->size() - first;
+            return concat(slice(lhs, first, lhsCount), slice(rhs, 0, size - lhsCount));
+        }
+        default:
+            return binary(expression->kind(), slice(expression->lhs_, first, size), slice(expression->rhs_, first, size),
+                          "slice");
+        }
+    }
+
+    const double *VectorExpression::evaluate(std::size_t offset, std::size_t count, double *scratch) const
+    {
+        switch (kind_)
+        {
+        case Kind::VECTOR:
+            return data_->data() + first_ + offset;
+        case Kind::CONSTANT:
+            std::fill(scratch, scratch + count, value_);
+            return scratch;
+        case Kind::STREAM:
+            stream_->read(first_ + offset, count, scratch);
+            return scratch;
+        default:
+            break;
+        }
+
+        double *lhsScratch = scratch + BlockSize;
+        double *rhsScratch = lhsScratch + lhs_->scratchBlocks() * BlockSize;
+        if (kind_ == Kind::CONCAT)
+        {
+            std::size_t split = lhs_->size();
+            if (offset + count <= split)
+            {
+                return lhs_->evaluate(offset, count, lhsScratch);
+            }
+            if (offset >= split)
+            {
+                return rhs_->evaluate(offset - split, count, rhsScratch);
+            }
+            // The block straddles both parts
+            std::size_t lhsCount = split - offset;
+            const double *lhs = lhs_->evaluate(offset, lhsCount, lhsScratch);
+            const double *rhs = rhs_->evaluate(0, count - lhsCount, rhsScratch);
+            std::copy(lhs, lhs + lhsCount, scratch);
+            std::copy(rhs, rhs + (count - lhsCount), scratch + lhsCount);
+            return scratch;
+        }
+
+        if (kind_ == Kind::MULTIPLY && lhs_->kind() == Kind::CONSTANT)
+        {
+            Kernels::scale(rhs_->evaluate(offset, count, rhsScratch), lhs_->value_, scratch, count);
+            return scratch;
+        }
+        if (kind_ == Kind::MULTIPLY && rhs_->kind() == Kind::CONSTANT)
+        {
+            Kernels::scale(lhs_->evaluate(offset, count, lhsScratch), rhs_->value_, scratch, count);
+            return scratch;
+        }
+
+        const double *lhs = lhs_->evaluate(offset, count, lhsScratch);
+        const double *rhs = rhs_->evaluate(offset, count, rhsScratch);
+        switch (kind_)
+        {
+        case Kind::ADD:
+            Kernels::add(lhs, rhs, scratch, count);
+            break;
+        case Kind::SUBTRACT:
+            Kernels::subtract(lhs, rhs, scratch, count);
+            break;
+        case Kind::MULTIPLY:
+            Kernels::multiply(lhs, rhs, scratch, count);
+            break;
+        default:
+            Kernels::divide(lhs, rhs, scratch, count);
+            break;
+        }
+        return scratch;
+    }
+
+    double VectorExpression::at(std::size_t index) const
+    {
+        switch (kind_)
+        {
+        case Kind::VECTOR:
+            return (*data_)[first_ + index];
+        case Kind::CONSTANT:
+            return value_;
+        case Kind::ADD:
+            return lhs_->at(index) + rhs_->at(index);
+        case Kind::SUBTRACT:
+            return lhs_->at(index) - rhs_->at(index);
+        case Kind::MULTIPLY:
+            return lhs_->at(index) * rhs_->at(index);
+        case Kind::DIVIDE:
+            return lhs_->at(index) / rhs_->at(index);
+        case Kind::STREAM:
+            return stream_->at(first_ + index);
+        default:
+            return index < lhs_->size() ? lhs_->at(index) : rhs_->at(index - lhs_->size());
+        }
+    }
+
+    template <typename Reduce>
+    void VectorExpression::forEachBlock(std::size_t first, std::size_t last, Reduce reduce) const
+    {
+        std::vector<double> scratch(scratchBlocks_ * BlockSize);
+        for (std::size_t offset = first; offset < last; offset += BlockSize)
+        {
+            std::size_t count = std::min(BlockSize, last - offset);
+            reduce(evaluate(offset, count, scratch.data()), count);
+        }
+    }
+
+    template <typename Reduce>
+    auto VectorExpression::reducePartitions(Reduce reduce, bool inOrder) const
+    {
+        std::vector<decltype(reduce(std::size_t(), std::size_t()))> partials((size_ + PartitionSize - 1) / PartitionSize);
+        auto run = [this, &partials, &reduce](std::size_t partition)
+        {
+            std::size_t first = partition * PartitionSize;
+            partials[partition] = reduce(first, std::min(size_, first + PartitionSize));
+        };
+        if (partials.size() > 1 && !inOrder && findStream() == nullptr)
+        {
+            computePool().parallelFor(partials.size(), run);
+        }
+        else
+        {
+            for (std::size_t partition = 0; partition < partials.size(); ++partition)
+            {
+                run(partition);
+            }
+        }
+        return partials;
+    }
+
+    const VectorStream *VectorExpression::findStream() const
+    {
+        if (kind_ == Kind::STREAM)
+        {
+            return stream_.get();
+        }
+        if (lhs_ == nullptr)
+        {
+            return nullptr;
+        }
+        const VectorStream *stream = lhs_->findStream();
+        return stream != nullptr ? stream : rhs_->findStream();
+    }
+
+    DoubleVector VectorExpression::materialize() const
+    {
+        if (const VectorStream *stream = findStream())
+        {
+            throw std::runtime_error("Runtime error: streamed vector '" + stream->name() + "' of " +
+                                     std::to_string(stream->size()) +
+                                     " values cannot be loaded into memory; only scans, reductions and element-wise "
+                                     "operations can read it");
+        }
+        if (kind_ == Kind::VECTOR)
+        {
+            return DoubleVector(data_->data() + first_, data_->data() + first_ + size_);
+        }
+        DoubleVector result;
+        result.reserve(size_);
+        forEachBlock(0, size_, [&result](const double *values, std::size_t count)
+                     { result.append(values, count); });
+        return result;
+    }
+
+    double VectorExpression::sum() const
+    {
+        // A product of two stored vectors needs no scratch at all
+        bool isDot = kind_ == Kind::MULTIPLY && lhs_->kind() == Kind::VECTOR && rhs_->kind() == Kind::VECTOR;
+        std::vector<double> partials = reducePartitions([this, isDot](std::size_t first, std::size_t last)
+                                                        {
+            if (isDot)
+            {
+                return Kernels::dot(lhs_->data_->data() + lhs_->first_ + first,
+                                    rhs_->data_->data() + rhs_->first_ + first, last - first);
+            }
+            double result = 0.0;
+            forEachBlock(first, last, [&result](const double *values, std::size_t count)
+                         { result += Kernels::sum(values, count); });
+            return result; });
+        double result = 0.0;
+        for (double partial : partials)
+        {
+            result += partial;
+        }
+        return result;
+    }
+
+    double VectorExpression::min() const
+    {
+        std::vector<double> partials = reducePartitions([this](std::size_t first, std::size_t last)
+                                                        {
+            double result = 0.0;
+            bool isFirst = true;
+            forEachBlock(first, last, [&result, &isFirst](const double *values, std::size_t count)
+                         {
+                double blockMin = Kernels::min(values, count);
+                result = isFirst || blockMin < result ? blockMin : result;
+                isFirst = false; });
+            return result; });
+        double result = partials.empty() ? 0.0 : partials[0];
+        for (double partial : partials)
+        {
+            result = partial < result ? partial : result;
+        }
+        return result;
+    }
+
+    double VectorExpression::max() const
+    {
+        std::vector<double> partials = reducePartitions([this](std::size_t first, std::size_t last)
+                                                        {
+            double result = 0.0;
+            bool isFirst = true;
+            forEachBlock(first, last, [&result, &isFirst](const double *values, std::size_t count)
+                         {
+                double blockMax = Kernels::max(values, count);
+                result = isFirst || blockMax > result ? blockMax : result;
+                isFirst = false; });
+            return result; });
+        double result = partials.empty() ? 0.0 : partials[0];
+        for (double partial : partials)
+        {
+            result = partial > result ? partial : result;
+        }
+        return result;
+    }
+
+    Moments VectorExpression::moments() const
+    {
+        std::vector<Moments> partials = reducePartitions([this](std::size_t first, std::size_t last)
+                                                         {
+            Moments result;
+            forEachBlock(first, last, [&result](const double *values, std::size_t count)
+                         { result.merge(Moments::of(values, count)); });
+            return result; });
+        Moments result;
+        for (const Moments &partial : partials)
+        {
+            result.merge(partial);
+        }
+        return result;
+    }
+
+    void VectorExpression::forEachPartitionBlock(
+        const std::function<void(std::size_t, const double *, std::size_t)> &visit) const
+    {
+        reducePartitions([this, &visit](std::size_t first, std::size_t last)
+                         {
+            forEachBlock(first, last, [&visit, first](const double *values, std::size_t count)
+                         { visit(first / PartitionSize, values, count); });
+            return 0; });
+    }
+
+    CoMoments VectorExpression::coMoments(const VectorExpression &lhs, const VectorExpression &rhs)
+    {
+        std::vector<CoMoments> partials = lhs.reducePartitions([&lhs, &rhs](std::size_t first, std::size_t last)
+                                                               {
+            std::vector<double> lhsScratch(lhs.scratchBlocks_ * BlockSize);
+            std::vector<double> rhsScratch(rhs.scratchBlocks_ * BlockSize);
+            CoMoments result;
+            for (std::size_t offset = first; offset < last; offset += BlockSize)
+            {
+                std::size_t count = std::min(BlockSize, last - offset);
+                result.merge(CoMoments::of(lhs.evaluate(offset, count, lhsScratch.data()),
+                                           rhs.evaluate(offset, count, rhsScratch.data()), count));
+            }
+            return result; }, rhs.readsStream());
+        CoMoments result;
+        for (const CoMoments &partial : partials)
+        {
+            result.merge(partial);
+        }
+        return result;
+    }
+
+} // namespace Shattang::MyLisp
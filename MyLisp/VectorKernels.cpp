@@ -0,0 +1,606 @@
+#include <Shattang/MyLisp/VectorKernels.h>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__) && defined(__SSE2__)
+#define MYLISP_X86_KERNELS 1
+#include <immintrin.h>
+#define MYLISP_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define MYLISP_X86_KERNELS 0
+#endif
+
+namespace Shattang::MyLisp::Kernels
+{
+    namespace
+    {
+        enum class BinaryOp
+        {
+            ADD,
+            SUBTRACT,
+            MULTIPLY,
+            DIVIDE
+        };
+
+        template <BinaryOp Op>
+        double applyScalar(double lhs, double rhs)
+        {
+            if constexpr (Op == BinaryOp::ADD)
+                return lhs + rhs;
+            else if constexpr (Op == BinaryOp::SUBTRACT)
+                return lhs - rhs;
+            else if constexpr (Op == BinaryOp::MULTIPLY)
+                return lhs * rhs;
+            else
+                return lhs / rhs;
+        }
+
+        // Scalar versions; also used for the tails of the SIMD loops
+
+        template <BinaryOp Op>
+        void binaryScalar(const double *lhs, const double *rhs, double *out, std::size_t count)
+        {
+            for (std::size_t i = 0; i < count; ++i)
+            {
+                out[i] = applyScalar<Op>(lhs[i], rhs[i]);
+            }
+        }
+
+        void scaleScalar(const double *values, double factor, double *out, std::size_t count)
+        {
+            for (std::size_t i = 0; i < count; ++i)
+            {
+                out[i] = values[i] * factor;
+            }
+        }
+
+        double dotScalar(const double *lhs, const double *rhs, std::size_t count)
+        {
+            double result = 0.0;
+            for (std::size_t i = 0; i < count; ++i)
+            {
+                result += lhs[i] * rhs[i];
+            }
+            return result;
+        }
+
+        double sumScalar(const double *values, std::size_t count)
+        {
+            double result = 0.0;
+            for (std::size_t i = 0; i < count; ++i)
+            {
+                result += values[i];
+            }
+            return result;
+        }
+
+        double squaredDeviationsScalar(const double *values, double center, std::size_t count)
+        {
+            double result = 0.0;
+            for (std::size_t i = 0; i < count; ++i)
+            {
+                double deviation = values[i] - center;
+                result += deviation * deviation;
+            }
+            return result;
+        }
+
+        double crossDeviationsScalar(const double *lhs, double lhsCenter, const double *rhs, double rhsCenter,
+                                     std::size_t count)
+        {
+            double result = 0.0;
+            for (std::size_t i = 0; i < count; ++i)
+            {
+                result += (lhs[i] - lhsCenter) * (rhs[i] - rhsCenter);
+            }
+            return result;
+        }
+
+        double minScalar(const double *values, std::size_t count)
+        {
+            double result = values[0];
+            for (std::size_t i = 1; i < count; ++i)
+            {
+                result = values[i] < result ? values[i] : result;
+            }
+            return result;
+        }
+
+        double maxScalar(const double *values, std::size_t count)
+        {
+            double result = values[0];
+            for (std::size_t i = 1; i < count; ++i)
+            {
+                result = values[i] > result ? values[i] : result;
+            }
+            return result;
+        }
+
+#if MYLISP_X86_KERNELS
+        // SSE2 is part of the x86-64 baseline, so these need no target attribute
+
+        template <BinaryOp Op>
+        __m128d applySse2(__m128d lhs, __m128d rhs)
+        {
+            if constexpr (Op == BinaryOp::ADD)
+                return _mm_add_pd(lhs, rhs);
+            else if constexpr (Op == BinaryOp::SUBTRACT)
+                return _mm_sub_pd(lhs, rhs);
+            else if constexpr (Op == BinaryOp::MULTIPLY)
+                return _mm_mul_pd(lhs, rhs);
+            else
+                return _mm_div_pd(lhs, rhs);
+        }
+
+        template <BinaryOp Op>
+        void binarySse2(const double *lhs, const double *rhs, double *out, std::size_t count)
+        {
+            std::size_t i = 0;
+            for (; i + 2 <= count; i += 2)
+            {
+                _mm_storeu_pd(out + i, applySse2<Op>(_mm_loadu_pd(lhs + i), _mm_loadu_pd(rhs + i)));
+            }
+            binaryScalar<Op>(lhs + i, rhs + i, out + i, count - i);
+        }
+
+        void scaleSse2(const double *values, double factor, double *out, std::size_t count)
+        {
+            __m128d broadcast = _mm_set1_pd(factor);
+            std::size_t i = 0;
+            for (; i + 2 <= count; i += 2)
+            {
+                _mm_storeu_pd(out + i, _mm_mul_pd(_mm_loadu_pd(values + i), broadcast));
+            }
+            scaleScalar(values + i, factor, out + i, count - i);
+        }
+
+        double horizontalSum(__m128d values)
+        {
+            return _mm_cvtsd_f64(_mm_add_sd(values, _mm_unpackhi_pd(values, values)));
+        }
+
+        double dotSse2(const double *lhs, const double *rhs, std::size_t count)
+        {
+            __m128d acc0 = _mm_setzero_pd();
+            __m128d acc1 = _mm_setzero_pd();
+            std::size_t i = 0;
+            for (; i + 4 <= count; i += 4)
+            {
+                acc0 = _mm_add_pd(acc0, _mm_mul_pd(_mm_loadu_pd(lhs + i), _mm_loadu_pd(rhs + i)));
+                acc1 = _mm_add_pd(acc1, _mm_mul_pd(_mm_loadu_pd(lhs + i + 2), _mm_loadu_pd(rhs + i + 2)));
+            }
+            return horizontalSum(_mm_add_pd(acc0, acc1)) + dotScalar(lhs + i, rhs + i, count - i);
+        }
+
+        double sumSse2(const double *values, std::size_t count)
+        {
+            __m128d acc0 = _mm_setzero_pd();
+            __m128d acc1 = _mm_setzero_pd();
+            std::size_t i = 0;
+            for (; i + 4 <= count; i += 4)
+            {
+                acc0 = _mm_add_pd(acc0, _mm_loadu_pd(values + i));
+                acc1 = _mm_add_pd(acc1, _mm_loadu_pd(values + i + 2));
+            }
+            return horizontalSum(_mm_add_pd(acc0, acc1)) + sumScalar(values + i, count - i);
+        }
+
+        double squaredDeviationsSse2(const double *values, double center, std::size_t count)
+        {
+            __m128d broadcast = _mm_set1_pd(center);
+            __m128d acc0 = _mm_setzero_pd();
+            __m128d acc1 = _mm_setzero_pd();
+            std::size_t i = 0;
+            for (; i + 4 <= count; i += 4)
+            {
+                __m128d deviation0 = _mm_sub_pd(_mm_loadu_pd(values + i), broadcast);
+                __m128d deviation1 = _mm_sub_pd(_mm_loadu_pd(values + i + 2), broadcast);
+                acc0 = _mm_add_pd(acc0, _mm_mul_pd(deviation0, deviation0));
+                acc1 = _mm_add_pd(acc1, _mm_mul_pd(deviation1, deviation1));
+            }
+            return horizontalSum(_mm_add_pd(acc0, acc1)) + squaredDeviationsScalar(values + i, center, count - i);
+        }
+
+        double crossDeviationsSse2(const double *lhs, double lhsCenter, const double *rhs, double rhsCenter,
+                                   std::size_t count)
+        {
+            __m128d lhsBroadcast = _mm_set1_pd(lhsCenter);
+            __m128d rhsBroadcast = _mm_set1_pd(rhsCenter);
+            __m128d acc0 = _mm_setzero_pd();
+            __m128d acc1 = _mm_setzero_pd();
+            std::size_t i = 0;
+            for (; i + 4 <= count; i += 4)
+            {
+                acc0 = _mm_add_pd(acc0, _mm_mul_pd(_mm_sub_pd(_mm_loadu_pd(lhs + i), lhsBroadcast),
+                                                   _mm_sub_pd(_mm_loadu_pd(rhs + i), rhsBroadcast)));
+                acc1 = _mm_add_pd(acc1, _mm_mul_pd(_mm_sub_pd(_mm_loadu_pd(lhs + i + 2), lhsBroadcast),
+                                                   _mm_sub_pd(_mm_loadu_pd(rhs + i + 2), rhsBroadcast)));
+            }
+            return horizontalSum(_mm_add_pd(acc0, acc1)) +
+                   crossDeviationsScalar(lhs + i, lhsCenter, rhs + i, rhsCenter, count - i);
+        }
+
+        double minSse2(const double *values, std::size_t count)
+        {
+            if (count < 2)
+            {
+                return minScalar(values, count);
+            }
+            __m128d acc = _mm_loadu_pd(values);
+            std::size_t i = 2;
+            for (; i + 2 <= count; i += 2)
+            {
+                acc = _mm_min_pd(acc, _mm_loadu_pd(values + i));
+            }
+            double lanes[2];
+            _mm_storeu_pd(lanes, acc);
+            double result = lanes[0] < lanes[1] ? lanes[0] : lanes[1];
+            return i < count && values[i] < result ? values[i] : result;
+        }
+
+        double maxSse2(const double *values, std::size_t count)
+        {
+            if (count < 2)
+            {
+                return maxScalar(values, count);
+            }
+            __m128d acc = _mm_loadu_pd(values);
+            std::size_t i = 2;
+            for (; i + 2 <= count; i += 2)
+            {
+                acc = _mm_max_pd(acc, _mm_loadu_pd(values + i));
+            }
+            double lanes[2];
+            _mm_storeu_pd(lanes, acc);
+            double result = lanes[0] > lanes[1] ? lanes[0] : lanes[1];
+            return i < count && values[i] > result ? values[i] : result;
+        }
+
+        // The tile is held in 16 registers, two columns each, for the whole depth
+        void multiplyTileSse2(const double *lhs, const double *rhs, std::size_t depth, double *out, std::size_t outStride)
+        {
+            __m128d acc[TileRows][TileColumns / 2];
+            for (std::size_t r = 0; r < TileRows; ++r)
+            {
+                for (std::size_t c = 0; c < TileColumns / 2; ++c)
+                {
+                    acc[r][c] = _mm_setzero_pd();
+                }
+            }
+            for (std::size_t p = 0; p < depth; ++p)
+            {
+                const double *row = rhs + p * TileColumns;
+                for (std::size_t r = 0; r < TileRows; ++r)
+                {
+                    __m128d broadcast = _mm_set1_pd(lhs[p * TileRows + r]);
+                    for (std::size_t c = 0; c < TileColumns / 2; ++c)
+                    {
+                        acc[r][c] = _mm_add_pd(acc[r][c], _mm_mul_pd(broadcast, _mm_loadu_pd(row + 2 * c)));
+                    }
+                }
+            }
+            for (std::size_t r = 0; r < TileRows; ++r)
+            {
+                for (std::size_t c = 0; c < TileColumns / 2; ++c)
+                {
+                    double *target = out + r * outStride + 2 * c;
+                    _mm_storeu_pd(target, _mm_add_pd(_mm_loadu_pd(target), acc[r][c]));
+                }
+            }
+        }
+
+        // AVX2 versions, compiled for AVX2 regardless of the build flags and only
+        // called after checking the CPU
+
+        template <BinaryOp Op>
+        MYLISP_TARGET_AVX2 __m256d applyAvx2(__m256d lhs, __m256d rhs)
+        {
+            if constexpr (Op == BinaryOp::ADD)
+                return _mm256_add_pd(lhs, rhs);
+            else if constexpr (Op == BinaryOp::SUBTRACT)
+                return _mm256_sub_pd(lhs, rhs);
+            else if constexpr (Op == BinaryOp::MULTIPLY)
+                return _mm256_mul_pd(lhs, rhs);
+            else
+                return _mm256_div_pd(lhs, rhs);
+        }
+
+        template <BinaryOp Op>
+        MYLISP_TARGET_AVX2 void binaryAvx2(const double *lhs, const double *rhs, double *out, std::size_t count)
+        {
+            std::size_t i = 0;
+            for (; i + 8 <= count; i += 8)
+            {
+                __m256d result0 = applyAvx2<Op>(_mm256_loadu_pd(lhs + i), _mm256_loadu_pd(rhs + i));
+                __m256d result1 = applyAvx2<Op>(_mm256_loadu_pd(lhs + i + 4), _mm256_loadu_pd(rhs + i + 4));
+                _mm256_storeu_pd(out + i, result0);
+                _mm256_storeu_pd(out + i + 4, result1);
+            }
+            binaryScalar<Op>(lhs + i, rhs + i, out + i, count - i);
+        }
+
+        MYLISP_TARGET_AVX2 void scaleAvx2(const double *values, double factor, double *out, std::size_t count)
+        {
+            __m256d broadcast = _mm256_set1_pd(factor);
+            std::size_t i = 0;
+            for (; i + 4 <= count; i += 4)
+            {
+                _mm256_storeu_pd(out + i, _mm256_mul_pd(_mm256_loadu_pd(values + i), broadcast));
+            }
+            scaleScalar(values + i, factor, out + i, count - i);
+        }
+
+        MYLISP_TARGET_AVX2 double horizontalSum(__m256d values)
+        {
+            __m128d low = _mm256_castpd256_pd128(values);
+            __m128d high = _mm256_extractf128_pd(values, 1);
+            return horizontalSum(_mm_add_pd(low, high));
+        }
+
+        MYLISP_TARGET_AVX2 double dotAvx2(const double *lhs, const double *rhs, std::size_t count)
+        {
+            __m256d acc0 = _mm256_setzero_pd();
+            __m256d acc1 = _mm256_setzero_pd();
+            std::size_t i = 0;
+            for (; i + 8 <= count; i += 8)
+            {
+                acc0 = _mm256_add_pd(acc0, _mm256_mul_pd(_mm256_loadu_pd(lhs + i), _mm256_loadu_pd(rhs + i)));
+                acc1 = _mm256_add_pd(acc1, _mm256_mul_pd(_mm256_loadu_pd(lhs + i + 4), _mm256_loadu_pd(rhs + i + 4)));
+            }
+            return horizontalSum(_mm256_add_pd(acc0, acc1)) + dotScalar(lhs + i, rhs + i, count - i);
+        }
+
+        MYLISP_TARGET_AVX2 double sumAvx2(const double *values, std::size_t count)
+        {
+            __m256d acc0 = _mm256_setzero_pd();
+            __m256d acc1 = _mm256_setzero_pd();
+            std::size_t i = 0;
+            for (; i + 8 <= count; i += 8)
+            {
+                acc0 = _mm256_add_pd(acc0, _mm256_loadu_pd(values + i));
+                acc1 = _mm256_add_pd(acc1, _mm256_loadu_pd(values + i + 4));
+            }
+            return horizontalSum(_mm256_add_pd(acc0, acc1)) + sumScalar(values + i, count - i);
+        }
+
+        MYLISP_TARGET_AVX2 double squaredDeviationsAvx2(const double *values, double center, std::size_t count)
+        {
+            __m256d broadcast = _mm256_set1_pd(center);
+            __m256d acc0 = _mm256_setzero_pd();
+            __m256d acc1 = _mm256_setzero_pd();
+            std::size_t i = 0;
+            for (; i + 8 <= count; i += 8)
+            {
+                __m256d deviation0 = _mm256_sub_pd(_mm256_loadu_pd(values + i), broadcast);
+                __m256d deviation1 = _mm256_sub_pd(_mm256_loadu_pd(values + i + 4), broadcast);
+                acc0 = _mm256_add_pd(acc0, _mm256_mul_pd(deviation0, deviation0));
+                acc1 = _mm256_add_pd(acc1, _mm256_mul_pd(deviation1, deviation1));
+            }
+            return horizontalSum(_mm256_add_pd(acc0, acc1)) + squaredDeviationsScalar(values + i, center, count - i);
+        }
+
+        MYLISP_TARGET_AVX2 double crossDeviationsAvx2(const double *lhs, double lhsCenter, const double *rhs,
+                                                      double rhsCenter, std::size_t count)
+        {
+            __m256d lhsBroadcast = _mm256_set1_pd(lhsCenter);
+            __m256d rhsBroadcast = _mm256_set1_pd(rhsCenter);
+            __m256d acc0 = _mm256_setzero_pd();
+            __m256d acc1 = _mm256_setzero_pd();
+            std::size_t i = 0;
+            for (; i + 8 <= count; i += 8)
+            {
+                acc0 = _mm256_add_pd(acc0, _mm256_mul_pd(_mm256_sub_pd(_mm256_loadu_pd(lhs + i), lhsBroadcast),
+                                                         _mm256_sub_pd(_mm256_loadu_pd(rhs + i), rhsBroadcast)));
+                acc1 = _mm256_add_pd(acc1, _mm256_mul_pd(_mm256_sub_pd(_mm256_loadu_pd(lhs + i + 4), lhsBroadcast),
+                                                         _mm256_sub_pd(_mm256_loadu_pd(rhs + i + 4), rhsBroadcast)));
+            }
+            return horizontalSum(_mm256_add_pd(acc0, acc1)) +
+                   crossDeviationsScalar(lhs + i, lhsCenter, rhs + i, rhsCenter, count - i);
+        }
+
+        MYLISP_TARGET_AVX2 double minAvx2(const double *values, std::size_t count)
+        {
+            if (count < 4)
+            {
+                return minScalar(values, count);
+            }
+            __m256d acc = _mm256_loadu_pd(values);
+            std::size_t i = 4;
+            for (; i + 4 <= count; i += 4)
+            {
+                acc = _mm256_min_pd(acc, _mm256_loadu_pd(values + i));
+            }
+            double lanes[4];
+            _mm256_storeu_pd(lanes, acc);
+            double result = minScalar(lanes, 4);
+            if (i < count)
+            {
+                double tail = minScalar(values + i, count - i);
+                result = tail < result ? tail : result;
+            }
+            return result;
+        }
+
+        MYLISP_TARGET_AVX2 double maxAvx2(const double *values, std::size_t count)
+        {
+            if (count < 4)
+            {
+                return maxScalar(values, count);
+            }
+            __m256d acc = _mm256_loadu_pd(values);
+            std::size_t i = 4;
+            for (; i + 4 <= count; i += 4)
+            {
+                acc = _mm256_max_pd(acc, _mm256_loadu_pd(values + i));
+            }
+            double lanes[4];
+            _mm256_storeu_pd(lanes, acc);
+            double result = maxScalar(lanes, 4);
+            if (i < count)
+            {
+                double tail = maxScalar(values + i, count - i);
+                result = tail > result ? tail : result;
+            }
+            return result;
+        }
+
+        // Each row of the tile is two registers; a broadcast element of `lhs` scales a row of `rhs`
+        MYLISP_TARGET_AVX2 void multiplyTileAvx2(const double *lhs, const double *rhs, std::size_t depth, double *out,
+                                                 std::size_t outStride)
+        {
+            __m256d acc[TileRows][2];
+            for (std::size_t r = 0; r < TileRows; ++r)
+            {
+                acc[r][0] = _mm256_setzero_pd();
+                acc[r][1] = _mm256_setzero_pd();
+            }
+            for (std::size_t p = 0; p < depth; ++p)
+            {
+                __m256d low = _mm256_loadu_pd(rhs + p * TileColumns);
+                __m256d high = _mm256_loadu_pd(rhs + p * TileColumns + 4);
+                for (std::size_t r = 0; r < TileRows; ++r)
+                {
+                    __m256d broadcast = _mm256_broadcast_sd(lhs + p * TileRows + r);
+                    acc[r][0] = _mm256_add_pd(acc[r][0], _mm256_mul_pd(broadcast, low));
+                    acc[r][1] = _mm256_add_pd(acc[r][1], _mm256_mul_pd(broadcast, high));
+                }
+            }
+            for (std::size_t r = 0; r < TileRows; ++r)
+            {
+                double *target = out + r * outStride;
+                _mm256_storeu_pd(target, _mm256_add_pd(_mm256_loadu_pd(target), acc[r][0]));
+                _mm256_storeu_pd(target + 4, _mm256_add_pd(_mm256_loadu_pd(target + 4), acc[r][1]));
+            }
+        }
+#else
+        void multiplyTileScalar(const double *lhs, const double *rhs, std::size_t depth, double *out,
+                                std::size_t outStride)
+        {
+            double acc[TileRows][TileColumns] = {};
+            for (std::size_t p = 0; p < depth; ++p)
+            {
+                for (std::size_t r = 0; r < TileRows; ++r)
+                {
+                    for (std::size_t c = 0; c < TileColumns; ++c)
+                    {
+                        acc[r][c] += lhs[p * TileRows + r] * rhs[p * TileColumns + c];
+                    }
+                }
+            }
+            for (std::size_t r = 0; r < TileRows; ++r)
+            {
+                for (std::size_t c = 0; c < TileColumns; ++c)
+                {
+                    out[r * outStride + c] += acc[r][c];
+                }
+            }
+        }
+#endif
+
+        struct KernelTable
+        {
+            void (*add_)(const double *, const double *, double *, std::size_t);
+            void (*subtract_)(const double *, const double *, double *, std::size_t);
+            void (*multiply_)(const double *, const double *, double *, std::size_t);
+            void (*divide_)(const double *, const double *, double *, std::size_t);
+            void (*scale_)(const double *, double, double *, std::size_t);
+            double (*dot_)(const double *, const double *, std::size_t);
+            double (*sum_)(const double *, std::size_t);
+            double (*squaredDeviations_)(const double *, double, std::size_t);
+            double (*crossDeviations_)(const double *, double, const double *, double, std::size_t);
+            double (*min_)(const double *, std::size_t);
+            double (*max_)(const double *, std::size_t);
+            void (*multiplyTile_)(const double *, const double *, std::size_t, double *, std::size_t);
+            const char *name_;
+        };
+
+        KernelTable selectKernels()
+        {
+#if MYLISP_X86_KERNELS
+            if (__builtin_cpu_supports("avx2"))
+            {
+                return {binaryAvx2<BinaryOp::ADD>, binaryAvx2<BinaryOp::SUBTRACT>, binaryAvx2<BinaryOp::MULTIPLY>,
+                        binaryAvx2<BinaryOp::DIVIDE>, scaleAvx2, dotAvx2, sumAvx2, squaredDeviationsAvx2,
+                        crossDeviationsAvx2, minAvx2, maxAvx2, multiplyTileAvx2, "avx2"};
+            }
+            return {binarySse2<BinaryOp::ADD>, binarySse2<BinaryOp::SUBTRACT>, binarySse2<BinaryOp::MULTIPLY>,
+                    binarySse2<BinaryOp::DIVIDE>, scaleSse2, dotSse2, sumSse2, squaredDeviationsSse2,
+                    crossDeviationsSse2, minSse2, maxSse2, multiplyTileSse2, "sse2"};
+#else
+            return {binaryScalar<BinaryOp::ADD>, binaryScalar<BinaryOp::SUBTRACT>, binaryScalar<BinaryOp::MULTIPLY>,
+                    binaryScalar<BinaryOp::DIVIDE>, scaleScalar, dotScalar, sumScalar, squaredDeviationsScalar,
+                    crossDeviationsScalar, minScalar, maxScalar, multiplyTileScalar, "scalar"};
+#endif
+        }
+
+        const KernelTable &kernels()
+        {
+            static const KernelTable table = selectKernels();
+            return table;
+        }
+    }
+
+    void add(const double *lhs, const double *rhs, double *out, std::size_t count)
+    {
+        kernels().add_(lhs, rhs, out, count);
+    }
+
+    void subtract(const double *lhs, const double *rhs, double *out, std::size_t count)
+    {
+        kernels().subtract_(lhs, rhs, out, count);
+    }
+
+    void multiply(const double *lhs, const double *rhs, double *out, std::size_t count)
+    {
+        kernels().multiply_(lhs, rhs, out, count);
+    }
+
+    void divide(const double *lhs, const double *rhs, double *out, std::size_t count)
+    {
+        kernels().divide_(lhs, rhs, out, count);
+    }
+
+    void scale(const double *values, double factor, double *out, std::size_t count)
+    {
+        kernels().scale_(values, factor, out, count);
+    }
+
+    double dot(const double *lhs, const double *rhs, std::size_t count)
+    {
+        return kernels().dot_(lhs, rhs, count);
+    }
+
+    double sum(const double *values, std::size_t count)
+    {
+        return kernels().sum_(values, count);
+    }
+
+    double squaredDeviations(const double *values, double center, std::size_t count)
+    {
+        return kernels().squaredDeviations_(values, center, count);
+    }
+
+    double crossDeviations(const double *lhs, double lhsCenter, const double *rhs, double rhsCenter, std::size_t count)
+    {
+        return kernels().crossDeviations_(lhs, lhsCenter, rhs, rhsCenter, count);
+    }
+
+    double min(const double *values, std::size_t count)
+    {
+        return kernels().min_(values, count);
+    }
+
+    double max(const double *values, std::size_t count)
+    {
+        return kernels().max_(values, count);
+    }
+
+    void multiplyTile(const double *lhs, const double *rhs, std::size_t depth, double *out, std::size_t outStride)
+    {
+        kernels().multiplyTile_(lhs, rhs, depth, out, outStride);
+    }
+
+    const char *instructionSet()
+    {
+        return kernels().name_;
+    }
+
+} // namespace Shattang::MyLisp::Kernels
@@ -0,0 +1,126 @@
+#include <Shattang/MyLisp/VectorStream.h>
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace Shattang::MyLisp
+{
+    StreamBufferPool::StreamBufferPool(std::size_t budgetBytes, std::size_t chunkSize)
+        : chunkSize_(chunkSize)
+    {
+        std::size_t count = chunkSize == 0 ? 0 : budgetBytes / (chunkSize * sizeof(double));
+        if (count < 2)
+        {
+            throw std::runtime_error("Runtime error: a stream budget of " + std::to_string(budgetBytes) +
+                                     " bytes does not hold two chunks of " + std::to_string(chunkSize) + " values");
+        }
+        buffers_.resize(count);
+    }
+
+    StreamBufferPool::Buffer &StreamBufferPool::acquire(const VectorStream &owner, std::size_t chunk, bool &loaded)
+    {
+        Buffer *victim = &buffers_.front();
+        for (Buffer &buffer : buffers_)
+        {
+            if (buffer.owner_ == &owner && buffer.chunk_ == chunk)
+            {
+                buffer.lastUse_ = ++clock_;
+                loaded = true;
+                return buffer;
+            }
+            // Unused buffers come first, then the least recently used
+            if (victim->owner_ != nullptr && (buffer.owner_ == nullptr || buffer.lastUse_ < victim->lastUse_))
+            {
+                victim = &buffer;
+            }
+        }
+        if (victim->data_ == nullptr)
+        {
+            victim->data_ = std::make_unique<double[]>(chunkSize_);
+        }
+        victim->owner_ = &owner;
+        victim->chunk_ = chunk;
+        victim->lastUse_ = ++clock_;
+        loaded = false;
+        return *victim;
+    }
+
+    void StreamBufferPool::release(const VectorStream &owner)
+    {
+        for (Buffer &buffer : buffers_)
+        {
+            if (buffer.owner_ == &owner)
+            {
+                buffer.owner_ = nullptr;
+            }
+        }
+    }
+
+    VectorStream::VectorStream(std::string name, std::size_t size, ChunkReader reader,
+                               std::shared_ptr<StreamBufferPool> pool)
+        : name_(std::move(name)), size_(size), reader_(std::move(reader)), pool_(std::move(pool)),
+          chunkSize_(pool_->chunkSize())
+    {
+    }
+
+    VectorStream::~VectorStream()
+    {
+        pool_->release(*this);
+    }
+
+    void VectorStream::read(std::size_t first, std::size_t count, double *out)
+    {
+        while (count > 0)
+        {
+            StreamBufferPool::Buffer *buffer = load(first);
+            std::size_t offset = first - currentFirst_;
+            std::size_t n = std::min(count, currentCount_ - offset);
+            std::memcpy(out, buffer->data_.get() + offset, n * sizeof(double));
+            first += n;
+            out += n;
+            count -= n;
+        }
+    }
+
+    StreamBufferPool::Buffer *VectorStream::load(std::size_t index)
+    {
+        std::size_t chunk = index / chunkSize_;
+        if (chunk == 0)
+        {
+            furthestChunk_ = 0; // a new pass
+            furthestIndex_ = 0;
+        }
+        else if (chunk + 1 < furthestChunk_)
+        {
+            throw std::runtime_error("Runtime error: streamed vector '" + name_ + "' read at index " +
+                                     std::to_string(index) + " after index " + std::to_string(furthestIndex_) +
+                                     "; streamed vectors can only be read front to back");
+        }
+        furthestChunk_ = std::max(furthestChunk_, chunk);
+        furthestIndex_ = std::max(furthestIndex_, index);
+
+        bool loaded = false;
+        StreamBufferPool::Buffer &buffer = pool_->acquire(*this, chunk, loaded);
+        currentChunk_ = chunk;
+        currentFirst_ = chunk * chunkSize_;
+        currentCount_ = std::min(chunkSize_, size_ - currentFirst_);
+        current_ = &buffer;
+        if (!loaded)
+        {
+            try
+            {
+                reader_(currentFirst_, currentCount_, buffer.data_.get());
+            }
+            catch (...)
+            {
+                pool_->release(*this);
+                current_ = nullptr;
+                currentCount_ = 0;
+                throw;
+            }
+        }
+        return current_;
+    }
+
+} // namespace Shattang::MyLisp
@@ -0,0 +1,58 @@
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <Shattang/MyLisp/Lexer.h>
+#include <Shattang/MyLisp/Parser.h>
+#include <Shattang/MyLisp/TypeChecker.h>
+#include <Shattang/MyLisp/CppTranspiler.h>
+
+using namespace Shattang::MyLisp;
+
+// Usage: MyLispCompiler <script.lisp> <output.h> <output.cpp> <module-name>
+int main(int argc, char *argv[])
+{
+    if (argc != 5)
+    {
+        std::cerr << "Usage: " << argv[0] << " <script.lisp> <output.h> <output.cpp> <module-name>\n";
+        return 2;
+    }
+
+    std::ifstream input(argv[1]);
+    if (!input)
+    {
+        std::cerr << "Cannot open " << argv[1] << "\n";
+        return 1;
+    }
+    std::ostringstream contents;
+    contents << input.rdbuf();
+    std::string script = contents.str();
+
+    try
+    {
+        auto lexer = Lexer(script);
+        auto parser = Parser(lexer);
+        auto ast = parser.parse();
+        const auto &scriptNode = static_cast<const ScriptNode &>(*ast);
+
+        TypeChecker checker;
+        checker.check(scriptNode);
+
+        // Generate both files before writing so a failure leaves no partial output behind
+        CppTranspiler transpiler(scriptNode, checker, argv[4]);
+        std::ostringstream header;
+        std::ostringstream source;
+        std::string headerPath = argv[2];
+        transpiler.emitHeader(header);
+        transpiler.emitSource(source, headerPath.substr(headerPath.find_last_of("/\\") + 1));
+
+        std::ofstream(argv[2]) << header.str();
+        std::ofstream(argv[3]) << source.str();
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << argv[1] << ": " << e.what() << "\n";
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,224 @@
+#include "Batch.h"
+#include "Results.h"
+
+#include <Shattang/MyLisp/DataSources.h>
+#include <Shattang/MyLisp/Interpreter.h>
+#include <Shattang/MyLisp/Program.h>
+#include <Shattang/MyLisp/ThreadPool.h>
+
+#include <algorithm>
+#include <condition_variable>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace Shattang::MyLisp
+{
+    namespace
+    {
+        struct BatchInput
+        {
+            std::string id_;
+            std::vector<std::pair<std::string, std::string>> bindings_; // import name, spec
+            std::size_t bytes_ = 0; // estimated memory for the inputs of one run
+        };
+
+        struct BatchState
+        {
+            std::mutex mutex_;
+            std::condition_variable changed_;
+            std::size_t running_ = 0;
+            std::size_t bytesInFlight_ = 0;
+            std::vector<std::optional<std::string>> lines_; // finished runs not yet written
+            std::size_t written_ = 0;
+            bool failed_ = false;
+        };
+
+        bool isBinarySpec(const std::string &path)
+        {
+            std::string extension = std::filesystem::path(path).extension().string();
+            return extension == ".f64" || extension == ".bin" || extension == ".mlc";
+        }
+
+        // File sizes stand in for the memory a run needs; a streamed binary input needs none
+        // beyond its run's stream pool
+        std::size_t estimateBytes(const BatchInput &input, const BatchOptions &options)
+        {
+            std::size_t bytes = options.streamBudget_;
+            for (const auto &[name, spec] : input.bindings_)
+            {
+                std::string path = spec.substr(0, spec.find('#'));
+                if (options.streamBudget_ != 0 && isBinarySpec(path))
+                {
+                    continue;
+                }
+                std::error_code error;
+                std::uintmax_t size = std::filesystem::file_size(path, error);
+                bytes += error ? 0 : static_cast<std::size_t>(size);
+            }
+            return bytes;
+        }
+
+        std::vector<BatchInput> readManifest(const std::string &path, const BatchOptions &options)
+        {
+            std::ifstream file(path);
+            if (!file)
+            {
+                throw std::runtime_error("cannot open manifest " + path);
+            }
+            std::vector<BatchInput> inputs;
+            std::string line;
+            for (int number = 1; std::getline(file, line); ++number)
+            {
+                std::istringstream fields(line);
+                BatchInput input;
+                if (!(fields >> input.id_) || input.id_.front() == ';')
+                {
+                    continue;
+                }
+                std::string binding;
+                while (fields >> binding)
+                {
+                    std::size_t equals = binding.find('=');
+                    if (equals == std::string::npos || equals == 0)
+                    {
+                        throw std::runtime_error(path + ":" + std::to_string(number) + ": expected name=spec, got '" +
+                                                 binding + "'");
+                    }
+                    input.bindings_.emplace_back(binding.substr(0, equals), binding.substr(equals + 1));
+                }
+                input.bytes_ = estimateBytes(input, options);
+                inputs.push_back(std::move(input));
+            }
+            return inputs;
+        }
+
+        // DataSources would otherwise open an unbound name as a file of that name
+        void requireBinding(const BatchInput &input, const std::string &name)
+        {
+            for (const auto &binding : input.bindings_)
+            {
+                if (binding.first == name)
+                {
+                    return;
+                }
+            }
+            throw std::runtime_error("Runtime error: manifest line '" + input.id_ + "' has no binding for import '" +
+                                     name + "'");
+        }
+
+        // Never throws; a failed run gives an error line
+        std::pair<bool, std::string> runInput(const Program &program, const BatchInput &input, const BatchOptions &options)
+        {
+            std::string line = "{\"input\":" + jsonString(input.id_);
+            try
+            {
+                DataSources sources;
+                for (const auto &[name, spec] : input.bindings_)
+                {
+                    sources.add(name, spec);
+                }
+                // Inputs are already spread across the pool, so statements of one run stay in order
+                TierOptions tiers;
+                tiers.parallelStatements_ = false;
+                Environment globals;
+                std::ostringstream output;
+                {
+                    Interpreter interpreter(globals, output, tiers);
+                    // Loaded on this thread; prefetching would start I/O threads for every run
+                    interpreter.setImportHandler([&sources, &input](const std::string &name)
+                                                 {
+                                                     requireBinding(input, name);
+                                                     return sources.open(name);
+                                                 },
+                                                 false);
+                    std::shared_ptr<StreamBufferPool> streamPool;
+                    if (options.streamBudget_ != 0)
+                    {
+                        streamPool = std::make_shared<StreamBufferPool>(options.streamBudget_);
+                        interpreter.setStreamHandler([&sources, &input, streamPool](const std::string &name)
+                                                     {
+                                                         requireBinding(input, name);
+                                                         return sources.openStream(name, streamPool);
+                                                     });
+                    }
+                    interpreter.run(program);
+                }
+
+                line += "," + successFields(program, globals, output.str()) + "}";
+                return {true, line};
+            }
+            catch (const std::exception &e)
+            {
+                return {false, line + "," + errorFields(e.what()) + "}"};
+            }
+        }
+    }
+
+    int runBatch(const BatchOptions &options, std::ostream &out, std::ostream &errors)
+    {
+        std::shared_ptr<const Program> program;
+        std::vector<BatchInput> inputs;
+        try
+        {
+            std::ifstream file(options.script_);
+            if (!file)
+            {
+                throw std::runtime_error("cannot open script " + options.script_);
+            }
+            std::ostringstream source;
+            source << file.rdbuf();
+            program = compile(source.str());
+            inputs = readManifest(options.manifest_, options);
+        }
+        catch (const std::exception &e)
+        {
+            errors << e.what() << "\n";
+            return 2;
+        }
+
+        unsigned jobs = options.jobs_ != 0 ? options.jobs_ : std::max(1u, std::thread::hardware_concurrency());
+        BatchState state;
+        state.lines_.resize(inputs.size());
+        {
+            ThreadPool pool(jobs);
+            for (std::size_t i = 0; i < inputs.size(); ++i)
+            {
+                std::unique_lock<std::mutex> lock(state.mutex_);
+                state.changed_.wait(lock, [&]
+                                    { return state.running_ < jobs &&
+                                             (state.running_ == 0 || options.memoryBudget_ == 0 ||
+                                              state.bytesInFlight_ + inputs[i].bytes_ <= options.memoryBudget_); });
+                ++state.running_;
+                state.bytesInFlight_ += inputs[i].bytes_;
+                lock.unlock();
+
+                pool.post([&, i]
+                          {
+                    auto [ok, line] = runInput(*program, inputs[i], options);
+                    std::lock_guard<std::mutex> lock(state.mutex_);
+                    --state.running_;
+                    state.bytesInFlight_ -= inputs[i].bytes_;
+                    state.failed_ = state.failed_ || !ok;
+                    state.lines_[i] = std::move(line);
+                    // Lines go out in manifest order as soon as every earlier run has finished
+                    while (state.written_ < inputs.size() && state.lines_[state.written_])
+                    {
+                        out << *state.lines_[state.written_] << "\n";
+                        state.lines_[state.written_].reset();
+                        ++state.written_;
+                    }
+                    out.flush();
+                    state.changed_.notify_all(); });
+            }
+        }
+        return state.failed_ ? 1 : 0;
+    }
+
+} // namespace Shattang::MyLisp
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstddef>
+#include <iosfwd>
+#include <string>
+
+namespace Shattang::MyLisp
+{
+    // Batch mode runs one script once per line of a manifest. Each line names an input and binds
+    // the names the script passes to `import-double-vector` for that run:
+    //   <id> <name>=<spec> [<name>=<spec>]...
+    // with specs as for DataSources. Blank lines and lines starting with ';' are skipped. A run
+    // fails if the script imports a name its line does not bind.
+    struct BatchOptions
+    {
+        std::string script_;
+        std::string manifest_;
+        unsigned jobs_ = 0;            // runs at once; 0 uses every hardware thread
+        std::size_t memoryBudget_ = 0; // bytes of input the runs in flight may hold; 0 for no limit
+        std::size_t streamBudget_ = 0; // if nonzero, binary inputs are streamed with a pool of this size per run
+    };
+
+    // Compiles the script once and runs it for every input on a thread pool. A run only starts
+    // while the estimated input size of the runs in flight, including its own, fits the memory
+    // budget, or when nothing else is running. Writes one JSON object per input to `out`, in
+    // manifest order: {"input": id, "ok": true, "globals": {...}, "output": printed text} with
+    // the script's Int, Float, Boolean and String globals, or {"input": id, "ok": false,
+    // "error": message}. Returns 0 if every run succeeded, 1 if any failed and 2 if the script
+    // or manifest could not be read.
+    int runBatch(const BatchOptions &options, std::ostream &out, std::ostream &errors);
+
+} // namespace Shattang::MyLisp
@@ -0,0 +1,109 @@
+#include "Results.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <optional>
+#include <vector>
+
+namespace Shattang::MyLisp
+{
+    namespace
+    {
+        // A global as a JSON value, or nothing for types without one
+        std::optional<std::string> jsonValue(const Value &value)
+        {
+            switch (value.type())
+            {
+            case ValueType::INT:
+                return std::to_string(value.asInt());
+            case ValueType::FLOAT:
+            {
+                double number = value.asFloat();
+                if (!std::isfinite(number))
+                {
+                    return "null";
+                }
+                // The shortest text that reads back as the same double
+                char buffer[32];
+                auto [end, error] = std::to_chars(buffer, buffer + sizeof buffer, number);
+                return std::string(buffer, end);
+            }
+            case ValueType::BOOLEAN:
+                return value.asBool() ? "true" : "false";
+            case ValueType::STRING:
+                return jsonString(value.asString().str());
+            default:
+                return std::nullopt;
+            }
+        }
+    }
+
+    std::string jsonString(std::string_view text)
+    {
+        std::string result = "\"";
+        for (char c : text)
+        {
+            switch (c)
+            {
+            case '"':
+                result += "\\\"";
+                break;
+            case '\\':
+                result += "\\\\";
+                break;
+            case '\n':
+                result += "\\n";
+                break;
+            case '\t':
+                result += "\\t";
+                break;
+            case '\r':
+                result += "\\r";
+                break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20)
+                {
+                    static constexpr char hex[] = "0123456789abcdef";
+                    result += "\\u00";
+                    result += hex[(c >> 4) & 0xF];
+                    result += hex[c & 0xF];
+                }
+                else
+                {
+                    result += c;
+                }
+            }
+        }
+        return result + "\"";
+    }
+
+    std::string successFields(const Program &program, Environment &globals, std::string_view output)
+    {
+        std::vector<std::string> names;
+        for (const auto &[name, type] : program.checker().globals())
+        {
+            names.push_back(name);
+        }
+        std::sort(names.begin(), names.end());
+        std::string fields = "\"ok\":true,\"globals\":{";
+        bool first = true;
+        for (const auto &name : names)
+        {
+            const Value *value = globals.findLocal(name);
+            std::optional<std::string> json = value != nullptr ? jsonValue(*value) : std::nullopt;
+            if (json)
+            {
+                fields += (first ? "" : ",") + jsonString(name) + ":" + *json;
+                first = false;
+            }
+        }
+        return fields + "},\"output\":" + jsonString(output);
+    }
+
+    std::string errorFields(std::string_view message)
+    {
+        return "\"ok\":false,\"error\":" + jsonString(message);
+    }
+
+} // namespace Shattang::MyLisp
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <Shattang/MyLisp/Environment.h>
+#include <Shattang/MyLisp/Program.h>
+
+#include <string>
+#include <string_view>
+
+namespace Shattang::MyLisp
+{
+    // Results of batch and server runs as JSON object members, for the caller to wrap in braces
+    // after any fields of its own
+
+    // `text` as a quoted JSON string
+    std::string jsonString(std::string_view text);
+
+    // "ok":true,"globals":{...},"output":"..." for a run of `program` that finished with
+    // `globals`; the globals are its Int, Float, Boolean and String ones, sorted by name
+    std::string successFields(const Program &program, Environment &globals, std::string_view output);
+
+    // "ok":false,"error":"..."
+    std::string errorFields(std::string_view message);
+
+} // namespace Shattang::MyLisp
@@ -0,0 +1,442 @@
+#include "Server.h"
+#include "Results.h"
+
+#include <Shattang/MyLisp/DataSources.h>
+#include <Shattang/MyLisp/Interpreter.h>
+#include <Shattang/MyLisp/Program.h>
+#include <Shattang/MyLisp/ThreadPool.h>
+
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <ostream>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+
+namespace Shattang::MyLisp
+{
+    namespace
+    {
+        constexpr std::size_t MaxRequestBytes = std::size_t(64) << 20;
+        constexpr int ReceiveTimeoutSeconds = 30; // a client that stops sending gives up its worker
+        constexpr long MaxCallDepth = 2000;       // runaway recursion fails its request, not the server
+
+        // Entries are dropped least recently used first once their total cost exceeds the capacity
+        template <typename Value>
+        class LruCache
+        {
+        public:
+            explicit LruCache(std::size_t capacity) : capacity_(capacity) {}
+
+            std::shared_ptr<const Value> find(const std::string &key)
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                auto it = entries_.find(key);
+                if (it == entries_.end())
+                {
+                    return nullptr;
+                }
+                order_.splice(order_.begin(), order_, it->second.position_);
+                return it->second.value_;
+            }
+
+            // Keeps the existing entry if another request inserted `key` first
+            void insert(const std::string &key, std::shared_ptr<const Value> value, std::size_t cost)
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (cost > capacity_ || entries_.count(key) != 0)
+                {
+                    return;
+                }
+                order_.push_front(key);
+                entries_.emplace(key, Entry{std::move(value), cost, order_.begin()});
+                total_ += cost;
+                while (total_ > capacity_)
+                {
+                    auto last = entries_.find(order_.back());
+                    total_ -= last->second.cost_;
+                    entries_.erase(last);
+                    order_.pop_back();
+                }
+            }
+
+        private:
+            struct Entry
+            {
+                std::shared_ptr<const Value> value_;
+                std::size_t cost_;
+                std::list<std::string>::iterator position_;
+            };
+
+            std::mutex mutex_;
+            std::size_t capacity_;
+            std::size_t total_ = 0;
+            std::list<std::string> order_; // most recently used first
+            std::unordered_map<std::string, Entry> entries_;
+        };
+
+        // Cancels runs that are still going at their deadline
+        class Watchdog
+        {
+        public:
+            using Clock = std::chrono::steady_clock;
+
+            Watchdog() : thread_([this]
+                                 { loop(); }) {}
+
+            ~Watchdog()
+            {
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    stopping_ = true;
+                }
+                changed_.notify_all();
+                thread_.join();
+            }
+
+            std::uint64_t watch(Interpreter &interpreter, Clock::time_point deadline)
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                runs_.emplace(nextId_, std::make_pair(deadline, &interpreter));
+                changed_.notify_all();
+                return nextId_++;
+            }
+
+            // Must be called before the Interpreter is destroyed
+            void release(std::uint64_t id)
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                runs_.erase(id);
+            }
+
+        private:
+            std::mutex mutex_;
+            std::condition_variable changed_;
+            bool stopping_ = false;
+            std::uint64_t nextId_ = 0;
+            std::map<std::uint64_t, std::pair<Clock::time_point, Interpreter *>> runs_;
+            std::thread thread_; // last, so that it starts once the rest is constructed
+
+            void loop()
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                while (!stopping_)
+                {
+                    Clock::time_point now = Clock::now();
+                    Clock::time_point next = Clock::time_point::max();
+                    for (const auto &[id, run] : runs_)
+                    {
+                        if (run.first <= now)
+                        {
+                            run.second->cancel();
+                        }
+                        else
+                        {
+                            next = std::min(next, run.first);
+                        }
+                    }
+                    if (next == Clock::time_point::max())
+                    {
+                        changed_.wait(lock);
+                    }
+                    else
+                    {
+                        changed_.wait_until(lock, next);
+                    }
+                }
+            }
+        };
+
+        class Server
+        {
+        public:
+            explicit Server(const ServerOptions &options)
+                : options_(options), programs_(options.programCacheSize_), data_(options.dataCacheBytes_)
+            {
+                if (options.timeLimit_.count() > 0)
+                {
+                    watchdog_.emplace();
+                }
+            }
+
+            // The response line for one request; never throws
+            std::string handle(const std::string &request)
+            {
+                try
+                {
+                    std::size_t newline = request.find('\n');
+                    std::unordered_map<std::string, std::string> bindings = options_.bindings_;
+                    std::istringstream fields(request.substr(0, newline));
+                    std::string binding;
+                    while (fields >> binding)
+                    {
+                        std::size_t equals = binding.find('=');
+                        if (equals == std::string::npos || equals == 0)
+                        {
+                            throw std::runtime_error("expected name=spec, got '" + binding + "'");
+                        }
+                        bindings[binding.substr(0, equals)] = binding.substr(equals + 1);
+                    }
+                    std::string source = newline == std::string::npos ? std::string() : request.substr(newline + 1);
+                    return "{" + run(*program(source), bindings) + "}";
+                }
+                catch (const std::exception &e)
+                {
+                    return "{" + errorFields(e.what()) + "}";
+                }
+            }
+
+        private:
+            const ServerOptions &options_;
+            LruCache<Program> programs_;
+            LruCache<DoubleVector> data_;
+            std::optional<Watchdog> watchdog_;
+
+            std::shared_ptr<const Program> program(const std::string &source)
+            {
+                std::shared_ptr<const Program> program = programs_.find(source);
+                if (program == nullptr)
+                {
+                    program = compile(source);
+                    programs_.insert(source, program, 1);
+                }
+                return program;
+            }
+
+            std::string run(const Program &program, const std::unordered_map<std::string, std::string> &bindings)
+            {
+                // Requests are already spread across the pool, so statements of one run stay in order
+                TierOptions tiers;
+                tiers.parallelStatements_ = false;
+                tiers.maxCallDepth_ = MaxCallDepth;
+                Environment globals;
+                std::ostringstream output;
+                std::atomic<std::size_t> imported{0};
+                Watchdog::Clock::time_point deadline = Watchdog::Clock::now() + options_.timeLimit_;
+                try
+                {
+                    Interpreter interpreter(globals, output, tiers);
+                    interpreter.setImportHandler([this, &bindings, &imported](const std::string &name)
+                                                 {
+                        // An unbound name would otherwise be opened as a path on the server
+                        auto it = bindings.find(name);
+                        if (it == bindings.end())
+                        {
+                            throw std::runtime_error("Runtime error: request has no binding for import '" + name + "'");
+                        }
+                        return load(it->second, imported); },
+                                                 false);
+                    std::optional<std::uint64_t> watch;
+                    if (watchdog_)
+                    {
+                        watch = watchdog_->watch(interpreter, deadline);
+                    }
+                    try
+                    {
+                        interpreter.run(program);
+                    }
+                    catch (...)
+                    {
+                        if (watch)
+                        {
+                            watchdog_->release(*watch);
+                        }
+                        throw;
+                    }
+                    if (watch)
+                    {
+                        watchdog_->release(*watch);
+                    }
+                }
+                catch (const std::exception &e)
+                {
+                    if (watchdog_ && Watchdog::Clock::now() >= deadline)
+                    {
+                        return errorFields("Runtime error: time limit of " + std::to_string(options_.timeLimit_.count()) +
+                                           " ms exceeded");
+                    }
+                    return errorFields(e.what());
+                }
+                return successFields(program, globals, output.str());
+            }
+
+            // A view of the cached data for `spec`; the key includes the file's size and
+            // modification time, so a rewritten file is loaded again
+            DoubleVector load(const std::string &spec, std::atomic<std::size_t> &imported)
+            {
+                std::filesystem::path path = spec.substr(0, spec.find('#'));
+                std::error_code error;
+                std::uintmax_t size = std::filesystem::file_size(path, error);
+                auto modified = std::filesystem::last_write_time(path, error);
+                std::shared_ptr<const DoubleVector> vector;
+                std::string key;
+                if (!error)
+                {
+                    key = spec + "\n" + std::to_string(size) + "\n" + std::to_string(modified.time_since_epoch().count());
+                    vector = data_.find(key);
+                }
+                if (vector == nullptr)
+                {
+                    vector = std::make_shared<const DoubleVector>(DataSources().open(spec));
+                    if (!error)
+                    {
+                        data_.insert(key, vector, vector->size() * sizeof(double));
+                    }
+                }
+                std::size_t bytes = imported += vector->size() * sizeof(double);
+                if (options_.memoryLimit_ != 0 && bytes > options_.memoryLimit_)
+                {
+                    throw std::runtime_error("Runtime error: imports exceed the request memory limit of " +
+                                             std::to_string(options_.memoryLimit_ >> 20) + " MB");
+                }
+                return DoubleVector::view(vector->data(), vector->size(), vector);
+            }
+        };
+
+        // Reads until the client shuts down its side of the connection
+        std::string readRequest(int client)
+        {
+            std::string request;
+            char buffer[1 << 16];
+            while (true)
+            {
+                ssize_t count = ::recv(client, buffer, sizeof buffer, 0);
+                if (count == 0)
+                {
+                    return request;
+                }
+                if (count < 0)
+                {
+                    if (errno == EINTR)
+                    {
+                        continue;
+                    }
+                    throw std::runtime_error(std::string("cannot read request: ") + std::strerror(errno));
+                }
+                request.append(buffer, static_cast<std::size_t>(count));
+                if (request.size() > MaxRequestBytes)
+                {
+                    throw std::runtime_error("request exceeds " + std::to_string(MaxRequestBytes >> 20) + " MB");
+                }
+            }
+        }
+
+        // A client that has gone away is not an error for the server
+        void writeResponse(int client, const std::string &response)
+        {
+            std::size_t written = 0;
+            while (written < response.size())
+            {
+                ssize_t count = ::send(client, response.data() + written, response.size() - written, MSG_NOSIGNAL);
+                if (count < 0 && errno == EINTR)
+                {
+                    continue;
+                }
+                if (count <= 0)
+                {
+                    return;
+                }
+                written += static_cast<std::size_t>(count);
+            }
+        }
+    }
+
+    int runServer(const ServerOptions &options, std::ostream &errors)
+    {
+        sockaddr_un address{};
+        address.sun_family = AF_UNIX;
+        if (options.socketPath_.empty() || options.socketPath_.size() >= sizeof address.sun_path)
+        {
+            errors << "invalid socket path '" << options.socketPath_ << "'\n";
+            return 2;
+        }
+        std::memcpy(address.sun_path, options.socketPath_.c_str(), options.socketPath_.size() + 1);
+
+        // A socket left behind by an earlier server is replaced; any other file is kept
+        std::error_code error;
+        if (std::filesystem::is_socket(options.socketPath_, error))
+        {
+            std::filesystem::remove(options.socketPath_, error);
+        }
+        int listener = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        if (listener < 0 || ::bind(listener, reinterpret_cast<const sockaddr *>(&address), sizeof address) != 0 ||
+            ::listen(listener, SOMAXCONN) != 0)
+        {
+            errors << options.socketPath_ << ": " << std::strerror(errno) << "\n";
+            if (listener >= 0)
+            {
+                ::close(listener);
+            }
+            return 2;
+        }
+
+        Server server(options);
+        unsigned jobs = options.jobs_ != 0 ? options.jobs_ : std::max(1u, std::thread::hardware_concurrency());
+        std::mutex mutex;
+        std::condition_variable changed;
+        unsigned running = 0;
+        ThreadPool pool(jobs);
+        while (true)
+        {
+            // Connections beyond the running requests wait in the listen backlog
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                changed.wait(lock, [&]
+                             { return running < jobs; });
+            }
+            int client = ::accept(listener, nullptr, nullptr);
+            if (client < 0)
+            {
+                if (errno == EINTR || errno == ECONNABORTED)
+                {
+                    continue;
+                }
+                errors << "accept: " << std::strerror(errno) << "\n";
+                break;
+            }
+            timeval timeout{ReceiveTimeoutSeconds, 0};
+            ::setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof timeout);
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                ++running;
+            }
+            pool.post([&, client]
+                      {
+                std::string response;
+                try
+                {
+                    response = server.handle(readRequest(client));
+                }
+                catch (const std::exception &e)
+                {
+                    response = "{" + errorFields(e.what()) + "}";
+                }
+                writeResponse(client, response + "\n");
+                ::close(client);
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    --running;
+                }
+                changed.notify_one(); });
+        }
+        ::close(listener);
+        return 2;
+    }
+
+} // namespace Shattang::MyLisp
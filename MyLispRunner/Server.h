@@ -0,0 +1,39 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <iosfwd>
+#include <string>
+#include <unordered_map>
+
+namespace Shattang::MyLisp
+{
+    // Server mode keeps a process running on a Unix domain socket, so a request costs only the
+    // script's execution. A client connects, writes a first line of `name=spec` bindings for
+    // `import-double-vector` (possibly empty) followed by the script, and shuts down its side
+    // for writing. The server answers with one JSON line as batch mode does, without "input",
+    // and closes the connection. An import bound neither by the request nor by the server's
+    // default bindings fails the request.
+    //
+    // Compiled programs are cached by script text, and loaded data by spec together with the
+    // file's size and modification time, so a changed file is loaded again. Cached data is
+    // handed to runs as views, without copying.
+    //
+    // A run past its time limit is cancelled at its next loop iteration or function call, and
+    // one whose imports exceed the memory limit fails at that import. Recursion is bounded so
+    // that it fails the request rather than the server.
+    struct ServerOptions
+    {
+        std::string socketPath_;
+        unsigned jobs_ = 0;                         // requests run at once; 0 uses every hardware thread
+        std::chrono::milliseconds timeLimit_{0};    // per request; 0 for none
+        std::size_t memoryLimit_ = 0;               // bytes of data one request may import; 0 for none
+        std::size_t programCacheSize_ = 256;        // compiled programs kept
+        std::size_t dataCacheBytes_ = std::size_t(1) << 30; // loaded data kept
+        std::unordered_map<std::string, std::string> bindings_; // used when a request does not bind a name
+    };
+
+    // Serves requests until the process is stopped. Returns 2 if the socket cannot be set up.
+    int runServer(const ServerOptions &options, std::ostream &errors);
+
+} // namespace Shattang::MyLisp
@@ -1,50 +1,135 @@
 #include <iostream>
+#include <string>
 #include <vector>
+#include "Batch.h"
+#include "Server.h"
+#include <Shattang/MyLisp/DataSources.h>
+#include <Shattang/MyLisp/Interpreter.h>
 #include <Shattang/MyLisp/Lexer.h>
 #include <Shattang/MyLisp/Parser.h>
+#include <Shattang/MyLisp/FlatParser.h>
 #include <Shattang/MyLisp/ASTPrettyPrinter.h>
+#include <Shattang/MyLisp/TypeChecker.h>
 
 using namespace Shattang::MyLisp;
 
-int main()
+int main(int argc, char *argv[])
 {
+    // Data sources for import-double-vector as name=spec, e.g. data_source=prices.f64.
+    // --stream=MB reads binary sources in chunks within that memory budget instead of mapping them.
+    // --batch=script.lisp --manifest=inputs.txt runs a script once per manifest line instead of
+    // the example below (see Batch.h), with --jobs=N runs at once and at most --memory=MB of input
+    // in flight.
+    // --serve=path answers scripts on a Unix domain socket (see Server.h), with --jobs=N requests
+    // at once, --timeout=ms and --memory=MB of imported data per request, --cache=MB of loaded
+    // data kept, and name=spec as the default bindings.
+    DataSources sources;
+    std::shared_ptr<StreamBufferPool> streamPool;
+    bool hasSources = false;
+    BatchOptions batch;
+    ServerOptions server;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        std::size_t equals = arg.find('=');
+        if (equals == std::string::npos)
+        {
+            std::cerr << "usage: MyLispRunner [--stream=MB] [name=spec]...\n"
+                      << "       MyLispRunner --batch=script --manifest=file [--jobs=N] [--memory=MB] [--stream=MB]\n"
+                      << "       MyLispRunner --serve=socket [--jobs=N] [--timeout=ms] [--memory=MB] [--cache=MB] [name=spec]...\n";
+            return 1;
+        }
+        std::string option = arg.substr(0, equals);
+        std::string value = arg.substr(equals + 1);
+        if (option == "--batch" || option == "--manifest")
+        {
+            (option == "--batch" ? batch.script_ : batch.manifest_) = value;
+            continue;
+        }
+        if (option == "--serve")
+        {
+            server.socketPath_ = value;
+            continue;
+        }
+        if (option == "--stream" || option == "--jobs" || option == "--memory" || option == "--timeout" ||
+            option == "--cache")
+        {
+            try
+            {
+                unsigned long number = std::stoul(value);
+                if (option == "--stream")
+                {
+                    streamPool = std::make_shared<StreamBufferPool>(number << 20);
+                    batch.streamBudget_ = number << 20;
+                }
+                else if (option == "--jobs")
+                {
+                    batch.jobs_ = static_cast<unsigned>(number);
+                    server.jobs_ = batch.jobs_;
+                }
+                else if (option == "--timeout")
+                {
+                    server.timeLimit_ = std::chrono::milliseconds(number);
+                }
+                else if (option == "--cache")
+                {
+                    server.dataCacheBytes_ = number << 20;
+                }
+                else
+                {
+                    batch.memoryBudget_ = number << 20;
+                    server.memoryLimit_ = number << 20;
+                }
+            }
+            catch (const std::exception &e)
+            {
+                std::cerr << option << ": " << e.what() << "\n";
+                return 1;
+            }
+            continue;
+        }
+        sources.add(option, value);
+        server.bindings_[option] = value;
+        hasSources = true;
+    }
+    if (!server.socketPath_.empty())
+    {
+        return runServer(server, std::cerr);
+    }
+    if (!batch.script_.empty() || !batch.manifest_.empty())
+    {
+        if (batch.script_.empty() || batch.manifest_.empty())
+        {
+            std::cerr << "--batch and --manifest must be given together\n";
+            return 1;
+        }
+        return runBatch(batch, std::cout, std::cerr);
+    }
+
     // Example MyLisp script with a function definition, variable assignment,
     // conditional, and function call
-    std::string myLispScript = R"(
+    static constexpr std::string_view myLispScript = R"(
 
         (using "math")
 
         (let (numbers DoubleVector) (import-double-vector "data_source"))
 
-        (define mean ((nums DoubleVector)) Float
-            (let (sum Float) 0)
-            (let (i Int) 0)
-            (while (less-than i (length nums))
-                (set sum (add sum (vector-ref nums i)))
-                (set i (add i 1))
-            )
-            (divide sum (length nums))
+        (define zScore ((x Float) (avg Float) (sd Float)) Float
+            (divide (subtract x avg) sd)
         )
 
-        (define variance ((nums DoubleVector) (avg Float)) Float
-            (let (squaredNums DoubleVector) (make-double-vector))
-            (for i 0 (subtract (length nums) 1) 1
-                (vector-push squaredNums (multiply (vector-ref nums i) (vector-ref nums i)))
-            )
-            (let (meanOfSquaresValue Float) (mean squaredNums))
-            (subtract meanOfSquaresValue (multiply avg avg))
-        )
-
-        (let (avg Float) (mean ((numbers))))
-
-        (let (varianceSum Float) (variance numbers avg))
+        (let (avg Float) (vector-mean numbers))
 
-        (let (stdDev Float) (sqrt varianceSum))
+        (let (stdDev Float) (vector-stddev numbers))
 
-        (let (overOne String) (if (greater-than stDev 1) "yes" "no"))
+        (let (overOne String) (if (greater-than stdDev 1) "yes" "no"))
 
         (print "Standard Deviation:" stdDev)
         (print "OverOne?" overOne)
+        (print "First z-score:" (zScore (vector-ref numbers 0) avg stdDev))
+
+        (let (order DoubleVector) (argsort numbers))
+        (print "Smallest:" (vector-ref numbers (to-int (vector-ref order 0))))
 
         )";
 
@@ -57,13 +142,46 @@ int main()
         std::cout << token.ToString() << "\n";
     }
 
-    auto lexer = Shattang::MyLisp::Lexer(myLispScript);
-    auto parser = Shattang::MyLisp::Parser(lexer);
-
-    auto ast = parser.parse();
+    // Parsed while compiling this file; a syntax error in the script fails the build
+    constexpr auto flatScript = ParseStatic<FlatNodeCount(myLispScript)>(myLispScript);
+    auto ast = BuildAST(flatScript.nodes());
 
     ASTPrettyPrinter printer(std::cout);
     printer.print(*ast);
-    
+
+    TypeChecker checker;
+    checker.check(static_cast<const ScriptNode &>(*ast));
+
+    std::cout << "Numeric functions:\n";
+    for (const auto &[name, info] : checker.functions())
+    {
+        if (info.isNumeric_)
+        {
+            std::cout << name << "\n";
+        }
+    }
+
+    // The script needs its data, so it only runs when sources were given
+    if (hasSources)
+    {
+        Interpreter interpreter;
+        interpreter.setImportHandler([&sources](const std::string &name)
+                                     { return sources.open(name); });
+        if (streamPool != nullptr)
+        {
+            interpreter.setStreamHandler([&sources, &streamPool](const std::string &name)
+                                         { return sources.openStream(name, streamPool); });
+        }
+        try
+        {
+            interpreter.run(static_cast<const ScriptNode &>(*ast));
+        }
+        catch (const std::exception &e)
+        {
+            std::cerr << e.what() << "\n";
+            return 1;
+        }
+    }
+
     return 0;
 }
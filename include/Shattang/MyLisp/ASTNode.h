@@ -99,7 +99,8 @@ namespace Shattang::MyLisp
     class StringNode : public LiteralNode
     {
     public:
-        std::string value_;
+        std::string value_; // as written, with the quotes
+        std::string text_;  // the text between the quotes; interned when the node is lowered
         StringNode(const std::string &value);
         NodeType getType() const override;
         std::string toString() const override;
@@ -166,6 +167,7 @@ namespace Shattang::MyLisp
         std::string toString() const override;
     };
 
+    // A `for` loop, or with isParallel_ a `pfor`, whose iterations may run concurrently
     class ForIterationNode : public ASTNode
     {
     public:
@@ -173,7 +175,9 @@ namespace Shattang::MyLisp
                          std::unique_ptr<ASTNode> start,
                          std::unique_ptr<ASTNode> end,
                          std::unique_ptr<ASTNode> step,
-                         std::vector<std::unique_ptr<ASTNode>> body);
+                         std::vector<std::unique_ptr<ASTNode>> body,
+                         bool isParallel = false,
+                         std::unique_ptr<ASTNode> grain = nullptr);
 
         NodeType getType() const override;
         std::string toString() const override;
@@ -183,6 +187,8 @@ namespace Shattang::MyLisp
         std::unique_ptr<ASTNode> end_;
         std::unique_ptr<ASTNode> step_;
         std::vector<std::unique_ptr<ASTNode>> body_;
+        bool isParallel_;
+        std::unique_ptr<ASTNode> grain_; // iterations per partition of a `pfor`; nullptr to choose automatically
     };
 
     class WhileIterationNode : public ASTNode
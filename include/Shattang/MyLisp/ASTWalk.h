@@ -0,0 +1,17 @@
+#pragma once
+
+#include "ASTNode.h"
+
+#include <functional>
+#include <string>
+#include <unordered_set>
+
+namespace Shattang::MyLisp
+{
+    // Calls `fn` for `node` and every node below it, parents before children
+    void forEachNode(const ASTNode &node, const std::function<void(const ASTNode &)> &fn);
+
+    // Adds the variables `node` may change: assignment and `let` targets, loop indices and pushed vectors
+    void collectWrittenVariables(const ASTNode &node, std::unordered_set<std::string> &written);
+
+} // namespace Shattang::MyLisp
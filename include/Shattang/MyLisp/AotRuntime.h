@@ -0,0 +1,651 @@
+#pragma once
+
+// Support code for C++ generated by CppTranspiler. Generated libraries link against MyLisp
+// for DoubleVector, DoubleMatrix and their SIMD kernels, for sequences, statistics, sketches and sorting and
+// for the compute pool; everything else is header only.
+
+#include "DoubleMatrix.h"
+#include "DoubleVector.h"
+#include "Sequence.h"
+#include "Sketches.h"
+#include "Sorting.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace Shattang::MyLisp::Aot
+{
+    using Shattang::MyLisp::DoubleVector;
+    using Shattang::MyLisp::forIndicesInRange;
+    using Shattang::MyLisp::vectorAdd;
+    using Shattang::MyLisp::vectorDivide;
+    using Shattang::MyLisp::vectorDot;
+    using Shattang::MyLisp::vectorMax;
+    using Shattang::MyLisp::vectorMin;
+    using Shattang::MyLisp::vectorMultiply;
+    using Shattang::MyLisp::vectorScale;
+    using Shattang::MyLisp::vectorSubtract;
+    using Shattang::MyLisp::vectorSum;
+
+    using DoubleMatrix = std::shared_ptr<const Shattang::MyLisp::DoubleMatrix>;
+    using Sequence = std::shared_ptr<const Shattang::MyLisp::Sequence>;
+    using QuantileSketch = std::shared_ptr<const Shattang::MyLisp::QuantileSketch>;
+    using DistinctSketch = std::shared_ptr<const Shattang::MyLisp::DistinctSketch>;
+    using Groups = std::shared_ptr<const Shattang::MyLisp::Groups>;
+
+    // Resolves `(import-double-vector "name")`; set by the embedding application before run()
+    using ImportHandler = std::function<DoubleVector(const std::string &name)>;
+
+    inline ImportHandler &importHandler()
+    {
+        static ImportHandler handler;
+        return handler;
+    }
+
+    inline void setImportHandler(ImportHandler handler)
+    {
+        importHandler() = std::move(handler);
+    }
+
+    inline DoubleVector importDoubleVector(const std::string &name)
+    {
+        if (!importHandler())
+        {
+            throw std::runtime_error("Runtime error: no import handler set for data source '" + name + "'");
+        }
+        return importHandler()(name);
+    }
+
+    inline void useModule(const std::string &)
+    {
+        // Builtins are linked statically; nothing to load
+    }
+
+    inline double vectorRef(const DoubleVector &vector, long index)
+    {
+        return vector.at(index);
+    }
+
+    // For `vector-ref`s that a loop entry check has already proven in range
+    inline double vectorRefUnchecked(const DoubleVector &vector, long index)
+    {
+        return vector[static_cast<std::size_t>(index)];
+    }
+
+    inline long length(const DoubleVector &vector)
+    {
+        return static_cast<long>(vector.size());
+    }
+
+    // Matrices are immutable and shared, as in the interpreter
+    inline DoubleMatrix matrixValue(Shattang::MyLisp::DoubleMatrix matrix)
+    {
+        return std::make_shared<const Shattang::MyLisp::DoubleMatrix>(std::move(matrix));
+    }
+
+    inline bool matrixEqual(const DoubleMatrix &lhs, const DoubleMatrix &rhs)
+    {
+        return *lhs == *rhs;
+    }
+
+    inline double matrixRef(const DoubleMatrix &matrix, long row, long column)
+    {
+        return matrix->at(row, column);
+    }
+
+    inline long matrixRows(const DoubleMatrix &matrix)
+    {
+        return static_cast<long>(matrix->rows());
+    }
+
+    inline long matrixColumns(const DoubleMatrix &matrix)
+    {
+        return static_cast<long>(matrix->columns());
+    }
+
+    inline DoubleVector matrixElements(const DoubleMatrix &matrix)
+    {
+        return matrix->elements();
+    }
+
+    inline DoubleMatrix matrixTranspose(const DoubleMatrix &matrix)
+    {
+        return matrixValue(Shattang::MyLisp::matrixTranspose(*matrix));
+    }
+
+    inline DoubleVector matrixVectorMultiply(const DoubleMatrix &matrix, const DoubleVector &vector)
+    {
+        return Shattang::MyLisp::matrixVectorMultiply(*matrix, vector);
+    }
+
+    inline DoubleMatrix matrixMultiply(const DoubleMatrix &lhs, const DoubleMatrix &rhs)
+    {
+        return matrixValue(Shattang::MyLisp::matrixMultiply(*lhs, *rhs));
+    }
+
+    // Lazy sequences. A DoubleVector source is copied, since generated code passes vectors by value.
+    inline Sequence toSequence(const Sequence &sequence)
+    {
+        return sequence;
+    }
+
+    inline Sequence toSequence(const DoubleVector &vector)
+    {
+        return Shattang::MyLisp::Sequence::vector(VectorExpression::vector(std::make_shared<const DoubleVector>(vector)));
+    }
+
+    inline Sequence range(long start, long end, long step = 1)
+    {
+        return Shattang::MyLisp::Sequence::range(start, end, step);
+    }
+
+    template <typename Source>
+    Sequence take(long count, const Source &source)
+    {
+        return Shattang::MyLisp::Sequence::take(count, toSequence(source));
+    }
+
+    template <typename Function, typename Source>
+    Sequence map(Function function, const Source &source)
+    {
+        return Shattang::MyLisp::Sequence::map([function](double element)
+                                               { return static_cast<double>(function(element)); }, toSequence(source));
+    }
+
+    template <typename Function, typename Source>
+    Sequence filter(Function function, const Source &source)
+    {
+        return Shattang::MyLisp::Sequence::filter([function](double element)
+                                                  { return static_cast<bool>(function(element)); }, toSequence(source));
+    }
+
+    template <typename Function, typename Lhs, typename Rhs>
+    Sequence zip(Function function, const Lhs &lhs, const Rhs &rhs)
+    {
+        return Shattang::MyLisp::Sequence::zip([function](double x, double y)
+                                               { return static_cast<double>(function(x, y)); },
+                                               toSequence(lhs), toSequence(rhs));
+    }
+
+    inline DoubleVector collect(const Sequence &sequence)
+    {
+        return sequence->collect();
+    }
+
+    inline DoubleMatrix makeDoubleMatrix(long rows, long columns, const DoubleVector &elements)
+    {
+        return matrixValue(Shattang::MyLisp::makeDoubleMatrix(rows, columns, elements));
+    }
+
+    inline DoubleMatrix makeDoubleMatrix(long rows, long columns, const Sequence &elements)
+    {
+        return matrixValue(Shattang::MyLisp::makeDoubleMatrix(rows, columns, elements->collect()));
+    }
+
+    inline long length(const Sequence &sequence)
+    {
+        return static_cast<long>(sequence->count());
+    }
+
+    inline double vectorSum(const Sequence &sequence)
+    {
+        return sequence->sum();
+    }
+
+    // Sequences are reduced in one pass, so emptiness is only known at the end
+    inline double nonEmpty(const char *name, std::optional<double> result)
+    {
+        if (!result)
+        {
+            throw std::runtime_error(std::string("Runtime error: '") + name + "' of an empty sequence");
+        }
+        return *result;
+    }
+
+    inline double vectorMin(const Sequence &sequence)
+    {
+        return nonEmpty("vector-min", sequence->min());
+    }
+
+    inline double vectorMax(const Sequence &sequence)
+    {
+        return nonEmpty("vector-max", sequence->max());
+    }
+
+    // The "math" module. Vectors are reduced through a VectorExpression that borrows them, so the
+    // results match the interpreter's.
+    inline std::shared_ptr<const VectorExpression> borrow(const DoubleVector &vector)
+    {
+        return VectorExpression::vector(std::shared_ptr<const DoubleVector>(std::shared_ptr<const void>(), &vector));
+    }
+
+    inline Moments momentsOf(const char *name, const DoubleVector &vector)
+    {
+        if (vector.empty())
+        {
+            throw std::runtime_error(std::string("Runtime error: '") + name + "' of an empty vector");
+        }
+        return borrow(vector)->moments();
+    }
+
+    inline Moments momentsOf(const char *name, const Sequence &sequence)
+    {
+        Moments moments = sequence->moments();
+        if (moments.count_ == 0.0)
+        {
+            throw std::runtime_error(std::string("Runtime error: '") + name + "' of an empty sequence");
+        }
+        return moments;
+    }
+
+    inline CoMoments coMomentsOf(const char *name, const DoubleVector &lhs, const DoubleVector &rhs)
+    {
+        if (lhs.size() != rhs.size())
+        {
+            throw std::runtime_error(std::string("Runtime error: '") + name + "' needs vectors of equal length, got " +
+                                     std::to_string(lhs.size()) + " and " + std::to_string(rhs.size()));
+        }
+        if (lhs.empty())
+        {
+            throw std::runtime_error(std::string("Runtime error: '") + name + "' of an empty vector");
+        }
+        return VectorExpression::coMoments(*borrow(lhs), *borrow(rhs));
+    }
+
+    template <typename Elements>
+    double vectorMean(const Elements &elements)
+    {
+        return momentsOf("vector-mean", elements).mean_;
+    }
+
+    template <typename Elements>
+    double vectorVariance(const Elements &elements)
+    {
+        return momentsOf("vector-variance", elements).variance();
+    }
+
+    template <typename Elements>
+    double vectorStddev(const Elements &elements)
+    {
+        return std::sqrt(momentsOf("vector-stddev", elements).variance());
+    }
+
+    inline double vectorCovariance(const DoubleVector &lhs, const DoubleVector &rhs)
+    {
+        return coMomentsOf("vector-covariance", lhs, rhs).covariance();
+    }
+
+    inline double vectorCorrelation(const DoubleVector &lhs, const DoubleVector &rhs)
+    {
+        return coMomentsOf("vector-correlation", lhs, rhs).correlation();
+    }
+
+    template <typename Sketch>
+    Sketch sketchOf(const DoubleVector &vector)
+    {
+        return sketchElements<Sketch>(*borrow(vector));
+    }
+
+    template <typename Sketch>
+    Sketch sketchOf(const Sequence &sequence)
+    {
+        return sketchElements<Sketch>(*sequence);
+    }
+
+    template <typename Elements>
+    QuantileSketch quantileSketch(const Elements &elements)
+    {
+        return std::make_shared<const Shattang::MyLisp::QuantileSketch>(
+            sketchOf<Shattang::MyLisp::QuantileSketch>(elements));
+    }
+
+    template <typename Elements>
+    DistinctSketch distinctSketch(const Elements &elements)
+    {
+        return std::make_shared<const Shattang::MyLisp::DistinctSketch>(
+            sketchOf<Shattang::MyLisp::DistinctSketch>(elements));
+    }
+
+    template <typename Sketch, typename Elements>
+    std::shared_ptr<const Sketch> sketchUpdate(const std::shared_ptr<const Sketch> &sketch, const Elements &elements)
+    {
+        Sketch result = *sketch;
+        result.merge(sketchOf<Sketch>(elements));
+        return std::make_shared<const Sketch>(std::move(result));
+    }
+
+    template <typename Sketch>
+    std::shared_ptr<const Sketch> sketchMerge(const std::shared_ptr<const Sketch> &lhs,
+                                              const std::shared_ptr<const Sketch> &rhs)
+    {
+        Sketch result = *lhs;
+        result.merge(*rhs);
+        return std::make_shared<const Sketch>(std::move(result));
+    }
+
+    template <typename Sketch>
+    long sketchCount(const std::shared_ptr<const Sketch> &sketch)
+    {
+        return static_cast<long>(sketch->count());
+    }
+
+    template <typename Sketch>
+    std::string sketchSerialize(const std::shared_ptr<const Sketch> &sketch)
+    {
+        return sketch->serialize();
+    }
+
+    inline double sketchQuantile(const QuantileSketch &sketch, double fraction)
+    {
+        if (!(fraction >= 0.0 && fraction <= 1.0))
+        {
+            std::ostringstream text;
+            text << fraction;
+            throw std::runtime_error("Runtime error: 'sketch-quantile' fraction must be between 0 and 1, got " +
+                                     text.str());
+        }
+        if (sketch->count() == 0)
+        {
+            throw std::runtime_error("Runtime error: 'sketch-quantile' of an empty sketch");
+        }
+        return sketch->quantile(fraction);
+    }
+
+    inline long sketchDistinct(const DistinctSketch &sketch)
+    {
+        return static_cast<long>(std::llround(sketch->estimate()));
+    }
+
+    inline QuantileSketch parseQuantileSketch(const std::string &text)
+    {
+        return std::make_shared<const Shattang::MyLisp::QuantileSketch>(Shattang::MyLisp::QuantileSketch::parse(text));
+    }
+
+    inline DistinctSketch parseDistinctSketch(const std::string &text)
+    {
+        return std::make_shared<const Shattang::MyLisp::DistinctSketch>(Shattang::MyLisp::DistinctSketch::parse(text));
+    }
+
+    // Sorting and grouping; a sequence is collected first where every element is needed at once
+    inline std::shared_ptr<const VectorExpression> collectedElements(const DoubleVector &vector)
+    {
+        return borrow(vector);
+    }
+
+    inline std::shared_ptr<const VectorExpression> collectedElements(const Sequence &sequence)
+    {
+        return VectorExpression::vector(std::make_shared<const DoubleVector>(sequence->collect()));
+    }
+
+    template <typename Elements>
+    DoubleVector sort(const Elements &elements)
+    {
+        return sortElements(*collectedElements(elements));
+    }
+
+    template <typename Elements>
+    DoubleVector argsort(const Elements &elements)
+    {
+        return argsortElements(*collectedElements(elements));
+    }
+
+    inline DoubleVector topK(long count, const DoubleVector &vector)
+    {
+        return topElements(*borrow(vector), count);
+    }
+
+    inline DoubleVector topK(long count, const Sequence &sequence)
+    {
+        return topElements(*sequence, count);
+    }
+
+    inline DoubleVector histogram(const DoubleVector &vector, double low, double high, long bins)
+    {
+        return histogramElements(*borrow(vector), low, high, bins);
+    }
+
+    inline DoubleVector histogram(const Sequence &sequence, double low, double high, long bins)
+    {
+        return histogramElements(*sequence, low, high, bins);
+    }
+
+    inline Groups groupByKey(const DoubleVector &keys, const DoubleVector &values)
+    {
+        return std::make_shared<const Shattang::MyLisp::Groups>(Shattang::MyLisp::Groups::of(*borrow(keys), *borrow(values)));
+    }
+
+    inline DoubleVector groupKeys(const Groups &groups)
+    {
+        return groups->keys_;
+    }
+
+    inline DoubleVector groupCounts(const Groups &groups)
+    {
+        return groups->counts_;
+    }
+
+    inline DoubleVector groupSums(const Groups &groups)
+    {
+        return groups->sums_;
+    }
+
+    inline DoubleVector groupMeans(const Groups &groups)
+    {
+        return groups->means();
+    }
+
+    template <typename T, typename U>
+    auto divide(T lhs, U rhs)
+    {
+        if constexpr (std::is_integral_v<T> && std::is_integral_v<U>)
+        {
+            if (rhs == 0)
+            {
+                throw std::runtime_error("Runtime error: integer division by zero");
+            }
+            // The smallest Int divided by -1 traps in hardware; negate with wrapping as the interpreter does
+            if (rhs == -1)
+            {
+                return static_cast<decltype(lhs / rhs)>(0UL - static_cast<unsigned long>(lhs));
+            }
+        }
+        return lhs / rhs;
+    }
+
+    inline long modulo(long lhs, long rhs)
+    {
+        if (rhs == 0)
+        {
+            throw std::runtime_error("Runtime error: integer modulo by zero");
+        }
+        if (rhs == -1)
+        {
+            return 0; // the smallest Int modulo -1 traps in hardware
+        }
+        return lhs % rhs;
+    }
+
+    inline long toInt(long value)
+    {
+        return value;
+    }
+
+    inline long toInt(double value)
+    {
+        if (!(value >= -0x1p63 && value < 0x1p63))
+        {
+            throw std::runtime_error("Runtime error: 'to-int' of " + std::to_string(value) + " is out of range");
+        }
+        return static_cast<long>(value);
+    }
+
+    inline void checkStep(long step)
+    {
+        if (step == 0)
+        {
+            throw std::runtime_error("Runtime error: 'for' step must not be zero");
+        }
+    }
+
+    inline long checkGrain(const char *form, long grain)
+    {
+        if (grain <= 0)
+        {
+            throw std::runtime_error(std::string("Runtime error: '") + form + "' grain must be positive, got " +
+                                     std::to_string(grain));
+        }
+        return grain;
+    }
+
+    // Runs task(0) .. task(partitions - 1) on the compute pool; if one fails, runs them again in
+    // order so the error is the one the first failing partition reports, as the interpreter does
+    template <typename Task>
+    void runPartitions(std::size_t partitions, const Task &task)
+    {
+        try
+        {
+            computePool().parallelFor(partitions, task);
+        }
+        catch (const std::exception &)
+        {
+            for (std::size_t partition = 0; partition < partitions; ++partition)
+            {
+                task(partition);
+            }
+        }
+    }
+
+    // `pmap` and `preduce`, partitioned like Interpreter::parallelMap and parallelReduce so both
+    // produce the same results
+    template <typename Function>
+    DoubleVector pmap(Function function, const DoubleVector &input, long grain = 0)
+    {
+        std::size_t size = partitionSize(input.size(), grain);
+        DoubleVector result(input.size());
+        runPartitions((input.size() + size - 1) / size, [&](std::size_t partition)
+                      {
+            std::size_t last = std::min(input.size(), (partition + 1) * size);
+            for (std::size_t i = partition * size; i < last; ++i)
+            {
+                result[i] = static_cast<double>(function(input[i]));
+            } });
+        return result;
+    }
+
+    template <typename Function, typename T>
+    double preduce(Function function, T init, const DoubleVector &input, long grain = 0)
+    {
+        std::size_t size = partitionSize(input.size(), grain);
+        std::vector<double> partials((input.size() + size - 1) / size);
+        runPartitions(partials.size(), [&](std::size_t partition)
+                      {
+            std::size_t first = partition * size;
+            std::size_t last = std::min(input.size(), first + size);
+            double accumulator = input[first];
+            for (std::size_t i = first + 1; i < last; ++i)
+            {
+                accumulator = static_cast<double>(function(accumulator, input[i]));
+            }
+            partials[partition] = accumulator; });
+        double total = static_cast<double>(init);
+        for (double partial : partials)
+        {
+            total = static_cast<double>(function(total, partial));
+        }
+        return total;
+    }
+
+    template <typename T>
+    void printValue(std::ostream &out, const T &value)
+    {
+        if constexpr (std::is_same_v<T, bool>)
+        {
+            out << (value ? "true" : "false");
+        }
+        else if constexpr (std::is_same_v<T, Sequence>)
+        {
+            printValue(out, value->collect());
+        }
+        else if constexpr (std::is_same_v<T, QuantileSketch>)
+        {
+            out << "<QuantileSketch of " << value->count() << " values>";
+        }
+        else if constexpr (std::is_same_v<T, DistinctSketch>)
+        {
+            out << "<DistinctSketch of " << value->count() << " values>";
+        }
+        else if constexpr (std::is_same_v<T, DoubleMatrix>)
+        {
+            out << "[";
+            for (std::size_t row = 0; row < value->rows(); ++row)
+            {
+                out << (row > 0 ? " [" : "[");
+                for (std::size_t column = 0; column < value->columns(); ++column)
+                {
+                    out << (column > 0 ? " " : "") << (*value)(row, column);
+                }
+                out << "]";
+            }
+            out << "]";
+        }
+        else if constexpr (std::is_same_v<T, Groups>)
+        {
+            out << "<Groups of " << value->size() << " keys>";
+        }
+        else if constexpr (std::is_same_v<T, DoubleVector>)
+        {
+            out << "[";
+            for (std::size_t i = 0; i < value.size(); ++i)
+            {
+                out << (i > 0 ? " " : "") << value[i];
+            }
+            out << "]";
+        }
+        else
+        {
+            out << value;
+        }
+    }
+
+    // Generated code keeps Strings as std::string, so `string-append` copies rather than building a rope
+    template <typename... Args>
+    std::string stringAppend(const std::string &first, const Args &...rest)
+    {
+        std::string result = first;
+        (result.append(rest), ...);
+        return result;
+    }
+
+    inline long stringLength(const std::string &text)
+    {
+        return static_cast<long>(text.size());
+    }
+
+    // Formats like `print`, with the stream's default precision as Value::toString has
+    template <typename T>
+    std::string toString(const T &value)
+    {
+        std::ostringstream out;
+        printValue(out, value);
+        return out.str();
+    }
+
+    template <typename... Args>
+    void print(const Args &...args)
+    {
+        bool first = true;
+        ((std::cout << (first ? "" : " "), printValue(std::cout, args), first = false), ...);
+        std::cout << "\n";
+    }
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include "ASTNode.h"
+#include "TypeChecker.h"
+
+#include <memory>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+namespace Shattang::MyLisp
+{
+    // The elements a `for` loop reads from one vector, as offsets from the loop index
+    struct IndexedVector
+    {
+        std::string vector_;
+        long minOffset_ = 0;
+        long maxOffset_ = 0;
+    };
+
+    // The `vector-ref`s in a `for` loop body that read (vector-ref v i), (vector-ref v (add i c))
+    // or (vector-ref v (subtract i c)), with c an integer literal, where the body writes neither
+    // i nor v. If every index the loop visits is in range for each vector at loop entry, none of
+    // these accesses can fail, so they may skip their own bounds checks; see forIndicesInRange.
+    struct BoundsCheckPlan
+    {
+        std::vector<IndexedVector> vectors_;
+        std::unordered_set<const ASTNode *> accesses_; // the `vector-ref` calls covered by the entry check
+    };
+
+    // `function` is the enclosing function, or nullptr for top-level code. Returns nullptr if
+    // no access qualifies.
+    std::unique_ptr<BoundsCheckPlan> planBoundsChecks(const ForIterationNode &loop, const FunctionTypeInfo *function);
+
+} // namespace Shattang::MyLisp
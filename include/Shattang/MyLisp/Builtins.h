@@ -0,0 +1,45 @@
+#pragma once
+
+#include "Value.h"
+#include "ValueType.h"
+
+#include <span>
+#include <string>
+#include <vector>
+
+namespace Shattang::MyLisp
+{
+    class Interpreter;
+
+    // Computes the result type of a call from its argument types. Throws std::runtime_error with a
+    // message (without the "Type error" prefix) if the arguments are not acceptable.
+    using TypeRule = ValueType (*)(const std::string &name, const std::vector<ValueType> &args);
+
+    // Runs a builtin on already evaluated arguments that passed the type rule
+    using BuiltinFunction = Value (*)(Interpreter &interpreter, std::span<Value> args);
+
+    struct Builtin
+    {
+        TypeRule typeRule_;
+        BuiltinFunction function_; // nullptr if the runtime does not implement it yet
+        bool isScalar_;            // operates on Int/Float/Boolean only and has no side effects
+        const char *module_ = nullptr; // the module a script has to import with `using`, if any
+    };
+
+    // Returns nullptr if `name` is not a builtin
+    const Builtin *findBuiltin(const std::string &name);
+
+    // True if `(using "name")` names a module builtins can belong to
+    bool isModule(const std::string &name);
+
+    // `pmap` and `preduce` take the name of a script function as their first argument, so they are
+    // forms the type checker and both tiers handle themselves rather than builtins
+    bool isParallelCall(const std::string &name);
+
+    // `map`, `filter` and `zip` also take a script function first; they build a Sequence
+    bool isSequenceCall(const std::string &name);
+
+    // Every form whose first argument names a script function
+    bool takesFunctionName(const std::string &name);
+
+} // namespace Shattang::MyLisp
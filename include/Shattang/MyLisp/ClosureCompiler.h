@@ -0,0 +1,144 @@
+#pragma once
+
+#include "ASTNode.h"
+#include "Environment.h"
+#include "TypeChecker.h"
+#include "Value.h"
+
+#include <functional>
+#include <memory>
+#include <memory_resource>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+namespace Shattang::MyLisp
+{
+    class Interpreter;
+
+    // The variables referenced by a piece of compiled code. Each slot is either a local held in
+    // the Frame itself or a name resolved through the Environment the first time it is used.
+    struct SlotLayout
+    {
+        std::vector<std::string> names_;
+        std::vector<int> localIndex_; // index into Frame locals, or -1 to resolve through the Environment
+        int localCount_ = 0;
+    };
+
+    // Storage for one activation of compiled code. Its slots come from the runtime pool, which
+    // recycles them from one call to the next.
+    class Frame
+    {
+    public:
+        Frame(Interpreter &interpreter, const SlotLayout &layout, Environment &env);
+
+        // A view of `parent` for one partition of a parallel loop. The variables in `privateSlots`
+        // get fresh storage in this Frame; every other slot refers to the parent's variable.
+        Frame(const Frame &parent, const std::vector<int> &privateSlots);
+
+        // The variable in `slot`; throws if it is neither a local nor defined in the Environment
+        Value &get(int slot)
+        {
+            Value *value = bound_[slot];
+            return value != nullptr ? *value : bind(slot, false);
+        }
+
+        // Like get(), but defines the variable in the Environment's own scope if needed (`let`, `for`)
+        Value &declare(int slot)
+        {
+            Value *value = bound_[slot];
+            return value != nullptr ? *value : bind(slot, true);
+        }
+
+        Interpreter &interpreter() { return interpreter_; }
+
+    private:
+        Interpreter &interpreter_;
+        const SlotLayout &layout_;
+        Environment &env_;
+        std::pmr::vector<Value> locals_;
+        std::pmr::vector<Value *> bound_;
+
+        Value &bind(int slot, bool declare);
+    };
+
+    using Code = std::function<Value(Frame &)>;
+
+    // Tier 1 code for a `define`. Parameters and locals live in the Frame; globals are
+    // resolved through the interpreter's global Environment.
+    struct CompiledFunction
+    {
+        SlotLayout layout_;
+        std::vector<int> parameterSlots_;
+        std::vector<ValueType> parameterTypes_;
+        ValueType returnType_ = ValueType::VOID;
+        std::vector<Code> body_;
+
+        Value invoke(Interpreter &interpreter, std::vector<Value> &args) const;
+    };
+
+    // Runs the iterations of a `for` loop from `index` on; `end` and `step` were evaluated on loop entry
+    using ForRange = std::function<void(Frame &, long index, long end, long step)>;
+
+    // Tier 1 code for a `for` or `while` loop that the AST walker is executing. Every variable
+    // is resolved through the walker's Environment, so the loop can take over mid-execution.
+    struct CompiledLoop
+    {
+        SlotLayout layout_;
+        ForRange forRange_; // `for` only
+        Code whileLoop_;    // `while` only; the whole loop, starting with its condition
+
+        void runFor(Interpreter &interpreter, Environment &env, long index, long end, long step) const;
+        void runWhile(Interpreter &interpreter, Environment &env) const;
+    };
+
+    class VectorLoop;
+    struct VectorLoopPlan;
+    class ParallelLoop;
+    struct ParallelLoopPlan;
+
+    // Compiles type-checked AST into trees of closures: variables become slots, builtins and
+    // functions are resolved once, and arithmetic is specialized on the static operand types.
+    // Loops matched by planVectorLoop run through VectorKernels instead of element by element,
+    // and `for` loops matched by planParallelLoop are split across computePool(), as `pfor` always is.
+    // Safe to run on a background thread while the interpreter executes the same AST.
+    class ClosureCompiler
+    {
+    public:
+        ClosureCompiler(Interpreter &interpreter, const TypeChecker &checker);
+
+        std::unique_ptr<CompiledFunction> compileFunction(const FunctionDeclarationNode &node);
+
+        // `function` is the enclosing function, or nullptr for a top-level loop
+        std::unique_ptr<CompiledLoop> compileLoop(const ASTNode &loop, const FunctionTypeInfo *function);
+
+    private:
+        Interpreter &interpreter_;
+        const TypeChecker &checker_;
+        const FunctionTypeInfo *function_ = nullptr;
+        SlotLayout *layout_ = nullptr;
+        bool localsInFrame_ = false;
+        std::unordered_set<const ASTNode *> uncheckedAccesses_; // `vector-ref`s proven in range by an enclosing loop
+
+        Code compile(const ASTNode &node);
+        std::vector<Code> compileAll(const std::vector<std::unique_ptr<ASTNode>> &nodes);
+        Code compileVariableDeclaration(const VariableDeclarationNode &node);
+        Code compileVariableAssignment(const VariableAssignmentNode &node);
+        Code compileFunctionCall(const FunctionCallNode &node);
+        Code compileBuiltinCall(const FunctionCallNode &node);
+        Code compileForIteration(const ForIterationNode &node);
+        ForRange compileForRange(const ForIterationNode &node);
+        Code compileWhileIteration(const WhileIterationNode &node);
+        std::shared_ptr<const VectorLoop> compileVectorLoop(const VectorLoopPlan &plan);
+        Code compileParallelFor(const ForIterationNode &node);
+        Code compileCallWithFunction(const FunctionCallNode &node);
+        std::shared_ptr<const ParallelLoop> compileParallelLoop(const ParallelLoopPlan &plan, const std::string &index,
+                                                                bool isExplicit = false);
+        Code compileIf(const IfNode &node);
+
+        int slotFor(const std::string &name);
+        ValueType variableType(const std::string &name) const;
+        [[noreturn]] void throwError(const std::string &message) const;
+    };
+
+} // namespace Shattang::MyLisp
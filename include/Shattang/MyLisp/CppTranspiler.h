@@ -0,0 +1,51 @@
+#pragma once
+
+#include "ASTNode.h"
+#include "TypeChecker.h"
+
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace Shattang::MyLisp
+{
+    // Translates a type-checked script into standalone C++20. Each `define` becomes a
+    // native function and the top-level statements become `void run()`, all inside
+    // `namespace <moduleName>`. Generated code only depends on AotRuntime.h.
+    class CppTranspiler
+    {
+    public:
+        CppTranspiler(const ScriptNode &script, const TypeChecker &checker, const std::string &moduleName);
+
+        void emitHeader(std::ostream &out);
+        void emitSource(std::ostream &out, const std::string &headerName);
+
+    private:
+        const ScriptNode &script_;
+        const TypeChecker &checker_;
+        std::string moduleName_;
+        std::unordered_map<std::string, std::string> mangledNames_; // C++ name -> MyLisp name
+        int indentLevel_ = 0;
+        int loopCounter_ = 0; // numbers the temporaries of each `for`
+        const FunctionTypeInfo *function_ = nullptr; // function being emitted, nullptr for run()
+        std::unordered_set<const ASTNode *> uncheckedAccesses_; // `vector-ref`s proven in range by an enclosing loop
+
+        std::string mangle(const std::string &name);
+        std::string cppType(ValueType type) const;
+        std::string signature(const FunctionDeclarationNode &node);
+        bool isMutatedParameter(const FunctionDeclarationNode &node, const std::string &name) const;
+
+        void emitFunction(std::ostream &out, const FunctionDeclarationNode &node);
+        void emitBody(std::ostream &out, const std::vector<std::unique_ptr<ASTNode>> &body, bool returnsLast);
+        void emitStatement(std::ostream &out, const ASTNode &node);
+        void emitForLoop(std::ostream &out, const ForIterationNode &node, const std::string &start, const std::string &end,
+                         const std::string &step);
+        std::string emitExpression(const ASTNode &node);
+        std::string emitCall(const FunctionCallNode &node);
+        std::string emitStringLiteral(const std::string &quoted) const;
+        void indent(std::ostream &out) const;
+        [[noreturn]] void throwError(const std::string &message) const;
+    };
+
+} // namespace Shattang::MyLisp
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "DoubleVector.h"
+#include "VectorStream.h"
+
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace Shattang::MyLisp
+{
+    // Loaders behind `import-double-vector`. Binary formats are memory mapped and returned as
+    // read-only DoubleVector views, so loading costs page faults rather than a copy. All
+    // loaders throw std::runtime_error naming the file on failure.
+
+    // A raw file of little-endian float64 values
+    DoubleVector mapDoubleFile(const std::string &path);
+
+    // Columnar files hold named float64 columns. Layout, all integers little-endian uint64:
+    //   "MYLCOL01", column count, then per column a 64-byte entry of
+    //   name (48 bytes, NUL padded), data offset, value count,
+    // followed by the column data, each column starting on a 64-byte boundary.
+    constexpr std::size_t ColumnNameSize = 47; // longest column name
+
+    DoubleVector mapColumn(const std::string &path, const std::string &column);
+    std::vector<std::string> columnNames(const std::string &path);
+    void writeColumnFile(const std::string &path, const std::vector<std::pair<std::string, const DoubleVector *>> &columns);
+
+    // The same binary formats read a chunk at a time with pread, for inputs larger than memory.
+    // Only the file header is read up front.
+    std::shared_ptr<VectorStream> streamDoubleFile(const std::string &path, std::shared_ptr<StreamBufferPool> pool);
+    std::shared_ptr<VectorStream> streamColumn(const std::string &path, const std::string &column,
+                                               std::shared_ptr<StreamBufferPool> pool);
+
+    // Reads every page of a view in on the calling thread, so that a later scan does not wait
+    // for the disk. Does nothing for vectors that own their storage.
+    void prefetchPages(const DoubleVector &vector);
+
+    // Numbers in CSV or whitespace separated text, such as legacy exports
+    struct TextOptions
+    {
+        char delimiter_ = ',';  // spaces, tabs and newlines always separate values too
+        long column_ = -1;      // zero-based field of each line to read, or -1 for every field
+        unsigned threads_ = 0;  // 0 uses every hardware thread
+    };
+
+    // Large inputs are split at line boundaries and parsed in parallel. A first line that does
+    // not parse as numbers is taken to be a header and skipped.
+    DoubleVector parseNumberText(std::string_view text, const TextOptions &options = TextOptions());
+    DoubleVector loadNumberText(const std::string &path, const TextOptions &options = TextOptions());
+
+    // Maps the names scripts pass to `import-double-vector` onto files. A spec is a path whose
+    // extension selects the loader:
+    //   data.f64, data.bin     raw float64
+    //   data.mlc#price         column "price" of a columnar file
+    //   data.csv, data.txt     text, every field; data.csv#2 reads only the third field
+    // Names that were not added are treated as specs themselves.
+    class DataSources
+    {
+    public:
+        void add(const std::string &name, const std::string &spec);
+        DoubleVector open(const std::string &name) const;
+        // Streams a binary source through `pool`; text sources are not streamable and give nullptr
+        std::shared_ptr<VectorStream> openStream(const std::string &name, std::shared_ptr<StreamBufferPool> pool) const;
+
+    private:
+        std::unordered_map<std::string, std::string> specs_;
+    };
+
+} // namespace Shattang::MyLisp
@@ -0,0 +1,51 @@
+#pragma once
+
+#include "DoubleVector.h"
+
+#include <cstddef>
+
+namespace Shattang::MyLisp
+{
+    // Dense row-major float64 storage for the DoubleMatrix type: element (row, column) is
+    // elements()[row * columns() + column]. Matrices are immutable once built.
+    class DoubleMatrix
+    {
+    public:
+        DoubleMatrix() = default;
+        DoubleMatrix(std::size_t rows, std::size_t columns, double value = 0.0);
+        // Takes `elements` in row-major order; throws std::runtime_error unless it holds rows * columns values
+        DoubleMatrix(std::size_t rows, std::size_t columns, DoubleVector elements);
+
+        std::size_t rows() const { return rows_; }
+        std::size_t columns() const { return columns_; }
+        const DoubleVector &elements() const { return elements_; }
+        const double *row(std::size_t index) const { return elements_.data() + index * columns_; }
+
+        double operator()(std::size_t row, std::size_t column) const { return elements_[row * columns_ + column]; }
+
+        // Checked access used by `matrix-ref`; throws std::runtime_error when out of range
+        double at(long row, long column) const;
+
+        bool operator==(const DoubleMatrix &other) const;
+
+    private:
+        std::size_t rows_ = 0;
+        std::size_t columns_ = 0;
+        DoubleVector elements_;
+    };
+
+    // Behind `make-double-matrix`; throws std::runtime_error for a negative dimension or the
+    // wrong number of elements
+    DoubleMatrix makeDoubleMatrix(long rows, long columns, DoubleVector elements);
+
+    // Whole-matrix operations behind the other matrix-* builtins. Products throw
+    // std::runtime_error unless the inner dimensions agree. Large operands are split across the
+    // compute pool by rows of the result, and every element is added up in the same order on
+    // any number of threads.
+    DoubleMatrix matrixTranspose(const DoubleMatrix &matrix);
+    DoubleVector matrixVectorMultiply(const DoubleMatrix &matrix, const DoubleVector &vector);
+    // Blocked as in BLIS: panels of `rhs` sized for the L3 cache and of `lhs` for L2 are packed
+    // into tile order, and Kernels::multiplyTile accumulates each tile of the result in registers
+    DoubleMatrix matrixMultiply(const DoubleMatrix &lhs, const DoubleMatrix &rhs);
+
+} // namespace Shattang::MyLisp
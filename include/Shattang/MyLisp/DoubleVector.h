@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cstddef>
+#include <initializer_list>
+#include <memory>
+
+namespace Shattang::MyLisp
+{
+    // Contiguous float64 storage for the DoubleVector type. The buffer is aligned for SIMD
+    // loads and grows geometrically, so push is amortized O(1).
+    // A vector may instead be a read-only view of memory it does not own, such as a mapped
+    // file. Views are shared rather than copied, and growing one copies it into owned storage.
+    class DoubleVector
+    {
+    public:
+        static constexpr std::size_t Alignment = 64;
+
+        DoubleVector() = default;
+        explicit DoubleVector(std::size_t size, double value = 0.0);
+        DoubleVector(std::initializer_list<double> values);
+        DoubleVector(const double *first, const double *last);
+
+        // A view of [data, data + size), which `owner` keeps alive
+        static DoubleVector view(const double *data, std::size_t size, std::shared_ptr<const void> owner);
+
+        DoubleVector(const DoubleVector &other);
+        DoubleVector(DoubleVector &&other) noexcept;
+        DoubleVector &operator=(const DoubleVector &other);
+        DoubleVector &operator=(DoubleVector &&other) noexcept;
+        ~DoubleVector();
+
+        std::size_t size() const { return size_; }
+        std::size_t capacity() const { return capacity_; }
+        bool empty() const { return size_ == 0; }
+        bool isView() const { return owner_ != nullptr; }
+
+        // Writable access is for owned storage only; a view must be grown (or copied) first
+        double *data() { return data_; }
+        const double *data() const { return data_; }
+        double *begin() { return data_; }
+        double *end() { return data_ + size_; }
+        const double *begin() const { return data_; }
+        const double *end() const { return data_ + size_; }
+
+        double &operator[](std::size_t index) { return data_[index]; }
+        double operator[](std::size_t index) const { return data_[index]; }
+
+        // Checked access used by `vector-ref`; throws std::runtime_error when out of range
+        double at(long index) const;
+
+        void push(double value)
+        {
+            if (size_ >= capacity_) // always true for a view
+            {
+                grow(size_ + 1);
+            }
+            data_[size_++] = value;
+        }
+
+        void append(const double *values, std::size_t count); // `values` must not point into this vector
+        void reserve(std::size_t capacity);
+        void resize(std::size_t size, double value = 0.0);
+        void clear() { size_ = 0; }
+
+        bool operator==(const DoubleVector &other) const;
+
+    private:
+        double *data_ = nullptr;
+        std::size_t size_ = 0;
+        std::size_t capacity_ = 0;             // 0 for a view, so that any growth reallocates
+        std::shared_ptr<const void> owner_;    // set for a view
+
+        void grow(std::size_t minimumCapacity);
+    };
+
+    // Whole-vector operations behind the vector-* builtins. Element-wise operations require
+    // equal lengths; min and max require a non-empty vector. All throw std::runtime_error.
+    DoubleVector vectorAdd(const DoubleVector &lhs, const DoubleVector &rhs);
+    DoubleVector vectorSubtract(const DoubleVector &lhs, const DoubleVector &rhs);
+    DoubleVector vectorMultiply(const DoubleVector &lhs, const DoubleVector &rhs);
+    DoubleVector vectorDivide(const DoubleVector &lhs, const DoubleVector &rhs);
+    DoubleVector vectorScale(const DoubleVector &vector, double factor);
+    double vectorDot(const DoubleVector &lhs, const DoubleVector &rhs);
+    double vectorSum(const DoubleVector &vector);
+    double vectorMin(const DoubleVector &vector);
+    double vectorMax(const DoubleVector &vector);
+
+    // The entry check for bounds-check elimination: true if every index visited by
+    // (for i start end step ...), plus any offset in [minOffset, maxOffset], is within
+    // [0, size). `step` must not be zero; a loop with no iterations always passes.
+    bool forIndicesInRange(long start, long end, long step, long minOffset, long maxOffset, std::size_t size);
+
+} // namespace Shattang::MyLisp
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "Memory.h"
+#include "Value.h"
+
+#include <memory_resource>
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace Shattang::MyLisp
+{
+    // Variables of one scope: the globals, or the locals of one function call.
+    // Pointers returned by find()/define() stay valid for the lifetime of the Environment,
+    // which lets compiled code resolve a variable once and reuse the pointer.
+    // The table and the names in it live in a TableArena owned by the Environment, so declaring
+    // a function call's variables costs no trips to the allocator beyond the first chunk. The
+    // values are not arena-allocated: what the variables hold is allocated and released as usual.
+    class Environment
+    {
+    public:
+        explicit Environment(Environment *parent = nullptr);
+
+        Environment(const Environment &) = delete;
+        Environment &operator=(const Environment &) = delete;
+
+        // Declares `name` in this scope, or overwrites it if this scope already has it
+        Value &define(const std::string &name, Value value);
+
+        // Looks in this scope, then in the parents; returns nullptr if undefined
+        Value *find(const std::string &name);
+
+        // Looks in this scope only
+        Value *findLocal(const std::string &name);
+
+        // Like find() but throws std::runtime_error if undefined
+        Value &get(const std::string &name);
+
+        Environment *parent() const { return parent_; }
+
+    private:
+        // Lets lookups by std::string_view find std::pmr::string keys without a temporary key
+        struct NameHash
+        {
+            using is_transparent = void;
+            std::size_t operator()(std::string_view name) const { return std::hash<std::string_view>()(name); }
+        };
+
+        TableArena arena_;
+        std::pmr::unordered_map<std::pmr::string, Value, NameHash, std::equal_to<>> variables_;
+        Environment *parent_;
+    };
+
+} // namespace Shattang::MyLisp
@@ -0,0 +1,568 @@
+#pragma once
+
+#include "Lexer.h"
+#include "ASTNode.h"
+
+#include <array>
+#include <cstddef>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+namespace Shattang::MyLisp
+{
+    // One node of a flat AST. Nodes are stored in preorder, root (SCRIPT) first, and refer
+    // to each other by index, so a whole script can be built in a constant expression.
+    //
+    // Children per node type:
+    //   SCRIPT                statements
+    //   VARIABLE_DECLARATION  value                  (text_ = name, typeName_ = type)
+    //   FUNCTION_DECLARATION  parameters, then body  (text_ = name, typeName_ = return type)
+    //   FUNCTION_CALL         arguments              (text_ = function name)
+    //   VARIABLE_ASSIGNMENT   value                  (text_ = name)
+    //   FOR_ITERATION         start, end, step, body (text_ = index name; intValue_ = 1 for `pfor`,
+    //                                                2 for `pfor` with a grain child before start)
+    //   WHILE_ITERATION       condition, body
+    //   IF                    condition, then, else
+    // Parameters are SYMBOL nodes with typeName_ set. Literals keep their source text in text_.
+    struct FlatNode
+    {
+        NodeType type_ = NodeType::SCRIPT;
+        std::string_view text_;
+        std::string_view typeName_;
+        long intValue_ = 0;      // INTEGER value, or 1/0 for BOOLEAN
+        int parameterCount_ = 0; // FUNCTION_DECLARATION only
+        int childCount_ = 0;
+        int firstChild_ = -1;
+        int nextSibling_ = -1;
+        int line_ = 0;
+        int column_ = 0;
+    };
+
+    struct FlatParseError
+    {
+        std::string_view message_;
+        std::string_view token_;
+        TokenType found_ = TokenType::END_OF_FILE;
+        std::optional<TokenType> expected_; // set when a specific token was required here
+        int line_ = 0;
+        int column_ = 0;
+    };
+
+    // Converts the text of a FLOAT token. Returns the parse error message, or an empty view if
+    // `value` was set. Not constexpr, as std::from_chars for double is not.
+    std::string_view ParseFloatLiteral(std::string_view text, double &value);
+
+    // The MyLisp grammar, and the only implementation of it: Parser runs it and converts the
+    // result with BuildAST, ParseStatic runs it during compilation. Reports the first error
+    // through error() instead of throwing, and produces FlatNodes instead of ASTNodes.
+    class FlatParser
+    {
+    public:
+        // Deeper expressions are a parse error, so that untrusted text cannot overflow the stack
+        // of the parser or of the passes that walk the AST after it
+        static constexpr int MaxNestingDepth = 1000;
+
+        constexpr explicit FlatParser(std::string_view source) : FlatParser(Lexer(source)) {}
+        constexpr explicit FlatParser(Lexer lexer)
+            : lexer_(lexer), currentToken_(lexer_.GetNextToken()) {}
+
+        // Returns false if the script has a syntax error
+        constexpr bool parse();
+
+        constexpr const std::vector<FlatNode> &nodes() const { return nodes_; }
+        constexpr const FlatParseError &error() const { return error_; }
+
+    private:
+        Lexer lexer_;
+        Token currentToken_;
+        std::vector<FlatNode> nodes_;
+        FlatParseError error_;
+        bool failed_ = false;
+        bool isParsingDefine_ = false;
+        int depth_ = 0; // parseExpression calls in progress
+
+        constexpr int parseExpression();
+        constexpr int parseAtom();
+        constexpr int parseLet();
+        constexpr int parseDefine();
+        constexpr int parseFunctionCall();
+        constexpr int parseSet();
+        constexpr int parseForIteration();
+        constexpr int parseWhileIteration();
+        constexpr int parseCallWithFunction();
+        constexpr int parseIf();
+        constexpr void parseBody(int parent, int &lastChild);
+        constexpr int addNode(NodeType type, std::string_view text);
+        constexpr void addChild(int parent, int &lastChild, int child);
+        constexpr bool consume(TokenType expectedType);
+        constexpr int fail(std::string_view message, std::optional<TokenType> expected = std::nullopt);
+    };
+
+    constexpr bool FlatParser::parse()
+    {
+        int root = addNode(NodeType::SCRIPT, std::string_view());
+        int lastChild = -1;
+        while (!failed_ && currentToken_.type_ != TokenType::END_OF_FILE)
+        {
+            addChild(root, lastChild, parseExpression());
+        }
+        return !failed_;
+    }
+
+    constexpr int FlatParser::parseExpression()
+    {
+        if (depth_ >= MaxNestingDepth)
+        {
+            return fail("Expressions are nested too deeply");
+        }
+        ++depth_;
+        int openParenCount = 0;
+
+        // Unwrap nested parentheses
+        while (currentToken_.type_ == TokenType::OPEN_PAREN)
+        {
+            consume(TokenType::OPEN_PAREN);
+            openParenCount++;
+        }
+
+        int expr = -1;
+        if (currentToken_.type_ == TokenType::SYMBOL)
+        {
+            if (currentToken_.value_ == "let")
+                expr = parseLet();
+            else if (currentToken_.value_ == "define")
+                expr = parseDefine();
+            else if (currentToken_.value_ == "set")
+                expr = parseSet();
+            else if (currentToken_.value_ == "for" || currentToken_.value_ == "pfor")
+                expr = parseForIteration();
+            else if (currentToken_.value_ == "pmap" || currentToken_.value_ == "preduce" ||
+                     currentToken_.value_ == "map" || currentToken_.value_ == "filter" || currentToken_.value_ == "zip")
+                expr = parseCallWithFunction();
+            else if (currentToken_.value_ == "while")
+                expr = parseWhileIteration();
+            else if (currentToken_.value_ == "if")
+                expr = parseIf();
+            else if (openParenCount > 0)
+                expr = parseFunctionCall();
+            else
+                expr = parseAtom();
+        }
+        else
+        {
+            expr = parseAtom();
+        }
+        --depth_;
+        if (failed_)
+            return -1;
+
+        // Consume the matching number of closing parentheses
+        while (openParenCount > 0 && currentToken_.type_ == TokenType::CLOSE_PAREN)
+        {
+            consume(TokenType::CLOSE_PAREN);
+            openParenCount--;
+        }
+
+        if (openParenCount != 0)
+        {
+            return fail("Mismatched parentheses: more opening than closing parentheses.");
+        }
+        return expr;
+    }
+
+    constexpr int FlatParser::parseIf()
+    {
+        int node = addNode(NodeType::IF, currentToken_.value_);
+        consume(TokenType::SYMBOL); // Consume `if`
+
+        int lastChild = -1;
+        for (int i = 0; i < 3 && !failed_; ++i)
+        {
+            addChild(node, lastChild, parseExpression()); // condition, then-branch, else-branch
+        }
+        return node;
+    }
+
+    constexpr int FlatParser::parseForIteration()
+    {
+        bool isParallel = currentToken_.value_ == "pfor";
+        consume(TokenType::SYMBOL); // Consume `for` or `pfor`
+
+        // `pfor` may give its grain with the index: (pfor (i grain) start end step body...)
+        bool hasGrain = isParallel && currentToken_.type_ == TokenType::OPEN_PAREN;
+        if (hasGrain)
+        {
+            consume(TokenType::OPEN_PAREN);
+        }
+        if (currentToken_.type_ != TokenType::SYMBOL)
+        {
+            return fail(isParallel ? "Expected an index variable name after 'pfor'"
+                                   : "Expected an index variable name after 'for'");
+        }
+        int node = addNode(NodeType::FOR_ITERATION, currentToken_.value_);
+        nodes_[node].intValue_ = hasGrain ? 2 : isParallel ? 1 : 0;
+        consume(TokenType::SYMBOL);
+
+        int lastChild = -1;
+        if (hasGrain)
+        {
+            addChild(node, lastChild, parseExpression()); // grain
+            consume(TokenType::CLOSE_PAREN);
+        }
+        for (int i = 0; i < 3 && !failed_; ++i)
+        {
+            addChild(node, lastChild, parseExpression()); // start, end, step
+        }
+        parseBody(node, lastChild);
+        return node;
+    }
+
+    constexpr int FlatParser::parseWhileIteration()
+    {
+        int node = addNode(NodeType::WHILE_ITERATION, currentToken_.value_);
+        consume(TokenType::SYMBOL); // Consume `while`
+
+        int lastChild = -1;
+        addChild(node, lastChild, parseExpression()); // condition
+        parseBody(node, lastChild);
+        return node;
+    }
+
+    constexpr int FlatParser::parseSet()
+    {
+        consume(TokenType::SYMBOL); // Consume `set`
+
+        if (currentToken_.type_ != TokenType::SYMBOL)
+        {
+            return fail("Expected a variable name after 'set'");
+        }
+        int node = addNode(NodeType::VARIABLE_ASSIGNMENT, currentToken_.value_);
+        consume(TokenType::SYMBOL);
+
+        int lastChild = -1;
+        addChild(node, lastChild, parseExpression());
+        return node;
+    }
+
+    constexpr int FlatParser::parseAtom()
+    {
+        int node = -1;
+        switch (currentToken_.type_)
+        {
+        case TokenType::SYMBOL:
+            node = addNode(NodeType::SYMBOL, currentToken_.value_);
+            break;
+        case TokenType::INTEGER:
+        {
+            // Same range and syntax as std::stol in Parser
+            std::string_view text = currentToken_.value_;
+            bool negative = !text.empty() && text[0] == '-';
+            std::size_t i = (!text.empty() && (text[0] == '-' || text[0] == '+')) ? 1 : 0;
+            if (i == text.size())
+            {
+                return fail("Invalid integer literal");
+            }
+            unsigned long magnitude = 0;
+            unsigned long limit = negative ? static_cast<unsigned long>(std::numeric_limits<long>::max()) + 1
+                                           : static_cast<unsigned long>(std::numeric_limits<long>::max());
+            for (; i < text.size(); ++i)
+            {
+                unsigned long digit = static_cast<unsigned long>(text[i] - '0');
+                if (magnitude > (limit - digit) / 10)
+                {
+                    return fail("Integer literal out of range");
+                }
+                magnitude = magnitude * 10 + digit;
+            }
+            node = addNode(NodeType::INTEGER, text);
+            nodes_[node].intValue_ = negative ? static_cast<long>(0 - magnitude) : static_cast<long>(magnitude);
+            break;
+        }
+        case TokenType::FLOAT:
+        {
+            std::string_view text = currentToken_.value_;
+            std::size_t digits = 0;
+            for (std::size_t i = 0; i < text.size() && text[i] != 'e' && text[i] != 'E'; ++i)
+            {
+                digits += isDigitChar(text[i]) ? 1 : 0;
+            }
+            if (digits == 0)
+            {
+                return fail("Invalid floating point literal");
+            }
+            // During constant evaluation the range is checked once BuildAST converts the node
+            if (!std::is_constant_evaluated())
+            {
+                double value = 0;
+                std::string_view error = ParseFloatLiteral(text, value);
+                if (!error.empty())
+                {
+                    return fail(error);
+                }
+            }
+            node = addNode(NodeType::FLOAT, text);
+            break;
+        }
+        case TokenType::BOOL_TRUE:
+        case TokenType::BOOL_FALSE:
+            node = addNode(NodeType::BOOLEAN, currentToken_.value_);
+            nodes_[node].intValue_ = currentToken_.type_ == TokenType::BOOL_TRUE ? 1 : 0;
+            break;
+        case TokenType::STRING:
+            node = addNode(NodeType::STRING, currentToken_.value_);
+            break;
+        case TokenType::ERROR:
+            return fail(currentToken_.error_);
+        default:
+            return fail("Unexpected token");
+        }
+        consume(currentToken_.type_);
+        return node;
+    }
+
+    constexpr int FlatParser::parseLet()
+    {
+        consume(TokenType::SYMBOL);     // Consume `let`
+        consume(TokenType::OPEN_PAREN); // Consume opening parenthesis for variable declaration
+        if (failed_)
+            return -1;
+        if (currentToken_.type_ != TokenType::SYMBOL)
+        {
+            return fail("Expected a variable name after 'let'");
+        }
+        int node = addNode(NodeType::VARIABLE_DECLARATION, currentToken_.value_);
+        consume(TokenType::SYMBOL);
+
+        if (currentToken_.type_ != TokenType::SYMBOL)
+        {
+            return fail("Expected a type after variable name");
+        }
+        nodes_[node].typeName_ = currentToken_.value_;
+        consume(TokenType::SYMBOL);
+        consume(TokenType::CLOSE_PAREN); // Consume closing parenthesis for variable declaration
+
+        int lastChild = -1;
+        if (!failed_)
+        {
+            addChild(node, lastChild, parseExpression());
+        }
+        return node;
+    }
+
+    constexpr int FlatParser::parseDefine()
+    {
+        if (isParsingDefine_)
+            return fail("Nested function definition not supported");
+
+        isParsingDefine_ = true;
+
+        consume(TokenType::SYMBOL); // Consume `define`
+
+        if (currentToken_.type_ != TokenType::SYMBOL)
+        {
+            return fail("Expected a function name after 'define'");
+        }
+        int node = addNode(NodeType::FUNCTION_DECLARATION, currentToken_.value_);
+        consume(TokenType::SYMBOL);
+
+        int lastChild = -1;
+        consume(TokenType::OPEN_PAREN); // Consume the opening parenthesis for parameter list
+        while (!failed_ && currentToken_.type_ != TokenType::CLOSE_PAREN)
+        {
+            consume(TokenType::OPEN_PAREN); // Consume the opening parenthesis for each parameter
+            if (failed_)
+                return -1;
+            if (currentToken_.type_ != TokenType::SYMBOL)
+            {
+                return fail("Expected a parameter name");
+            }
+            int param = addNode(NodeType::SYMBOL, currentToken_.value_);
+            consume(TokenType::SYMBOL);
+
+            if (currentToken_.type_ != TokenType::SYMBOL)
+            {
+                return fail("Expected a parameter type");
+            }
+            nodes_[param].typeName_ = currentToken_.value_;
+            consume(TokenType::SYMBOL);
+            consume(TokenType::CLOSE_PAREN); // Consume the closing parenthesis for each parameter
+
+            addChild(node, lastChild, param);
+            nodes_[node].parameterCount_++;
+        }
+        consume(TokenType::CLOSE_PAREN); // Consume the closing parenthesis for the parameter list
+        if (failed_)
+            return -1;
+
+        if (currentToken_.type_ != TokenType::SYMBOL)
+        {
+            return fail("Expected a return type for the function");
+        }
+        nodes_[node].typeName_ = currentToken_.value_;
+        consume(TokenType::SYMBOL);
+
+        parseBody(node, lastChild);
+
+        isParsingDefine_ = false;
+        return node;
+    }
+
+    constexpr int FlatParser::parseFunctionCall()
+    {
+        int node = addNode(NodeType::FUNCTION_CALL, currentToken_.value_);
+        consume(TokenType::SYMBOL);
+
+        int lastChild = -1;
+        parseBody(node, lastChild);
+        return node;
+    }
+
+    constexpr int FlatParser::parseCallWithFunction()
+    {
+        int node = addNode(NodeType::FUNCTION_CALL, currentToken_.value_);
+        consume(TokenType::SYMBOL); // Consume `pmap`, `preduce`, `map`, `filter` or `zip`
+
+        if (currentToken_.type_ != TokenType::SYMBOL)
+        {
+            return fail("Expected a function name as the first argument");
+        }
+        int lastChild = -1;
+        addChild(node, lastChild, addNode(NodeType::SYMBOL, currentToken_.value_));
+        consume(TokenType::SYMBOL);
+        parseBody(node, lastChild);
+        return node;
+    }
+
+    constexpr void FlatParser::parseBody(int parent, int &lastChild)
+    {
+        while (!failed_ && currentToken_.type_ != TokenType::CLOSE_PAREN)
+        {
+            addChild(parent, lastChild, parseExpression());
+        }
+    }
+
+    constexpr int FlatParser::addNode(NodeType type, std::string_view text)
+    {
+        FlatNode node;
+        node.type_ = type;
+        node.text_ = text;
+        node.line_ = currentToken_.line_;
+        node.column_ = currentToken_.column_;
+        nodes_.push_back(node);
+        return static_cast<int>(nodes_.size()) - 1;
+    }
+
+    constexpr void FlatParser::addChild(int parent, int &lastChild, int child)
+    {
+        if (failed_ || child < 0)
+            return;
+        if (lastChild < 0)
+            nodes_[parent].firstChild_ = child;
+        else
+            nodes_[lastChild].nextSibling_ = child;
+        nodes_[parent].childCount_++;
+        lastChild = child;
+    }
+
+    constexpr bool FlatParser::consume(TokenType expectedType)
+    {
+        if (failed_)
+            return false;
+        if (currentToken_.type_ != expectedType)
+        {
+            if (currentToken_.type_ == TokenType::ERROR)
+                fail(currentToken_.error_);
+            else
+                fail("Unexpected token", expectedType);
+            return false;
+        }
+        currentToken_ = lexer_.GetNextToken();
+        return true;
+    }
+
+    constexpr int FlatParser::fail(std::string_view message, std::optional<TokenType> expected)
+    {
+        if (!failed_)
+        {
+            failed_ = true;
+            error_ = FlatParseError{message, currentToken_.value_, currentToken_.type_, expected,
+                                    currentToken_.line_, currentToken_.column_};
+        }
+        return -1;
+    }
+
+    // A parsed script in fixed storage, so it can be the value of a constexpr variable
+    template <std::size_t N>
+    struct FlatScript
+    {
+        std::array<FlatNode, N> nodes_{};
+        std::size_t size_ = 0;
+        FlatParseError error_{};
+        bool ok_ = false;
+
+        constexpr bool ok() const { return ok_; }
+        constexpr std::span<const FlatNode> nodes() const { return std::span<const FlatNode>(nodes_.data(), size_); }
+    };
+
+    // Number of FlatNodes needed for `source`; use as the capacity of ParseFlat / ParseStatic
+    constexpr std::size_t FlatNodeCount(std::string_view source)
+    {
+        FlatParser parser(source);
+        parser.parse();
+        return parser.nodes().empty() ? 1 : parser.nodes().size();
+    }
+
+    template <std::size_t N>
+    constexpr FlatScript<N> ParseFlat(std::string_view source)
+    {
+        FlatParser parser(source);
+        FlatScript<N> script;
+        script.ok_ = parser.parse();
+        script.error_ = parser.error();
+        if (script.ok_ && parser.nodes().size() > N)
+        {
+            script.ok_ = false;
+            script.error_ = FlatParseError{"Script has more nodes than the FlatScript capacity", std::string_view(),
+                                           TokenType::END_OF_FILE, std::nullopt, 0, 0};
+        }
+        if (script.ok_)
+        {
+            for (std::size_t i = 0; i < parser.nodes().size(); ++i)
+            {
+                script.nodes_[i] = parser.nodes()[i];
+            }
+            script.size_ = parser.nodes().size();
+        }
+        return script;
+    }
+
+    // "Parse error: ..." with the position and the offending token, as Parser throws it
+    std::string FormatParseError(const FlatParseError &error);
+
+    // Intentionally not constexpr: reaching it while evaluating ParseStatic turns a
+    // MyLisp syntax error into a C++ compile error that names this function
+    void syntaxErrorInEmbeddedMyLispScript(const FlatParseError &error);
+
+    // Parses `source` during compilation; a syntax error fails the build.
+    //   static constexpr std::string_view source = R"((print "hi"))";
+    //   constexpr auto script = ParseStatic<FlatNodeCount(source)>(source);
+    template <std::size_t N>
+    consteval FlatScript<N> ParseStatic(std::string_view source)
+    {
+        FlatScript<N> script = ParseFlat<N>(source);
+        if (!script.ok())
+        {
+            syntaxErrorInEmbeddedMyLispScript(script.error_);
+        }
+        return script;
+    }
+
+    // Converts flat nodes produced by a successful parse into the regular AST
+    std::unique_ptr<ASTNode> BuildAST(std::span<const FlatNode> nodes);
+
+} // namespace Shattang::MyLisp
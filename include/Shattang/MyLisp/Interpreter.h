@@ -0,0 +1,237 @@
+#pragma once
+
+#include "ASTNode.h"
+#include "ClosureCompiler.h"
+#include "Environment.h"
+#include "NativeCompiler.h"
+#include "ThreadPool.h"
+#include "TypeChecker.h"
+#include "Value.h"
+#include "VectorStream.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace Shattang::MyLisp
+{
+    class Program;
+    struct StatementGraph;
+
+    // Controls promotion from the AST walker (tier 0) to closure compiled code (tier 1) and of
+    // numeric functions on to machine code (tier 2), how tier 1 runs loops that planParallelLoop
+    // accepts, and how run() orders top-level statements
+    struct TierOptions
+    {
+        bool enableTiering_ = true;
+        bool backgroundCompilation_ = true; // false compiles synchronously when a threshold is crossed
+        long callThreshold_ = 50;           // calls before a function is compiled
+        long backEdgeThreshold_ = 1000;     // iterations before a loop is compiled
+        bool enableNative_ = true;          // compile numeric, pure functions to machine code where supported
+        long nativeThreshold_ = 1000;       // calls before a numeric function gets machine code; a compiled loop in it also promotes it
+        bool parallelLoops_ = true;         // split independent `for` iterations across computePool()
+        long parallelThreshold_ = 10000;    // iterations a loop needs before it is split
+        bool orderedFloatSums_ = false;     // add to Float accumulators in iteration order, as tier 0 does
+        bool parallelStatements_ = true;    // run top-level statements StatementGraph finds independent concurrently
+        long maxCallDepth_ = 0;             // nested calls on one thread before the run fails; 0 for no limit
+    };
+
+    struct TierStatistics
+    {
+        int compiledFunctions_ = 0;
+        int compiledLoops_ = 0;
+        int failedCompilations_ = 0;
+        int nativeFunctions_ = 0;
+        int deoptimizations_ = 0;
+    };
+
+    // Resolves `(import-double-vector "name")`, typically through DataSources
+    using ImportHandler = std::function<DoubleVector(const std::string &name)>;
+
+    // Returns a stream for imports that should be read a chunk at a time instead of loaded, or
+    // nullptr to load the import through the ImportHandler
+    using StreamHandler = std::function<std::shared_ptr<VectorStream>(const std::string &name)>;
+
+    // A script function with its hotness counters. The counters are atomic since independent
+    // top-level statements may call the function from several threads; compiled_ and native_ are
+    // published by the compiler thread once code_ and nativeCode_ are ready. native_ is cleared
+    // again once the function deoptimizes too often, but nativeCode_ stays for calls in flight.
+    struct FunctionEntry
+    {
+        const FunctionDeclarationNode *declaration_ = nullptr;
+        const FunctionTypeInfo *typeInfo_ = nullptr;
+        const TypeChecker *checker_ = nullptr;
+        std::atomic<long> calls_{0};
+        std::atomic<bool> queued_{false};
+        std::unique_ptr<CompiledFunction> code_;
+        std::atomic<const CompiledFunction *> compiled_{nullptr};
+        std::atomic<long> nativeCalls_{0};
+        std::atomic<bool> nativeQueued_{false};
+        std::atomic<long> deoptimizations_{0};
+        std::unique_ptr<NativeFunction> nativeCode_;
+        std::atomic<const NativeFunction *> native_{nullptr};
+    };
+
+    // A loop with its back-edge counter, promoted with on-stack replacement at the next iteration
+    struct LoopEntry
+    {
+        std::atomic<long> backEdges_{0};
+        std::atomic<bool> queued_{false};
+        std::unique_ptr<CompiledLoop> code_;
+        std::atomic<const CompiledLoop *> compiled_{nullptr};
+    };
+
+    // Executes scripts. Cold code runs in a cheap AST walker with no compile step; functions and
+    // loops whose counters cross TierOptions thresholds are compiled to closures on a background
+    // thread and swapped in at the next call or iteration without blocking execution. Functions
+    // TypeChecker finds numeric and pure are compiled further to machine code once they are
+    // hotter still; a call whose arguments or values break that code's assumptions deoptimizes
+    // to the closure or walker tier.
+    // Top-level statements run on computePool() as soon as the statements they depend on have
+    // finished (see StatementGraph). Scripts and Programs passed to run() must outlive the
+    // Interpreter.
+    class Interpreter
+    {
+    public:
+        explicit Interpreter(std::ostream &out = std::cout, TierOptions options = TierOptions());
+        // Runs scripts with `globals` as their global variables instead of an Environment of its own
+        explicit Interpreter(Environment &globals, std::ostream &out = std::cout, TierOptions options = TierOptions());
+        ~Interpreter();
+
+        Interpreter(const Interpreter &) = delete;
+        Interpreter &operator=(const Interpreter &) = delete;
+
+        // Type checks and executes a script; its functions stay callable through call(). If
+        // statements fail, the error of the first one is rethrown. Statements after it that
+        // StatementGraph found independent of it may have run, but no barrier has.
+        void run(const ScriptNode &script);
+        // Runs a compiled Program without checking it again. Its inputs must be defined in
+        // globals() with assignable types; an Int input declared Float is widened in place.
+        void run(const Program &program);
+
+        // Calls a function defined by a script that has been run
+        Value call(const std::string &name, std::vector<Value> args);
+
+        // With `prefetch`, imports load on I/O threads and return pending vectors, so a script only
+        // waits for data at its first use; run() starts every import named by a string literal
+        // in top-level code or a function it calls before executing anything. The handler must
+        // then be thread safe.
+        void setImportHandler(ImportHandler handler, bool prefetch = true);
+        void setStreamHandler(StreamHandler handler) { streamHandler_ = std::move(handler); }
+        Value importDoubleVector(const std::string &name);
+
+        // Blocks until queued background compilations have finished
+        void waitForCompilation();
+
+        // Makes the running script fail at its next loop iteration or function call; may be called
+        // from any thread, such as a watchdog enforcing a time limit. Builtins already running finish.
+        void cancel() { cancelled_.store(true, std::memory_order_relaxed); }
+
+        // Used by compiled code at each loop iteration; throws once cancel() has been called
+        void checkCancelled() const
+        {
+            if (cancelled_.load(std::memory_order_relaxed))
+            {
+                throwCancelled();
+            }
+        }
+
+        std::ostream &out() { return out_; }
+        const TierOptions &options() const { return options_; }
+        Environment &globals() { return globals_; }
+        TierStatistics statistics() const;
+
+        // Used by compiled code; returns nullptr if `name` is not a script function
+        FunctionEntry *findFunction(const std::string &name);
+        Value callFunction(FunctionEntry &entry, std::vector<Value> &args);
+
+        // A form that takes a script function (see takesFunctionName) with the evaluated arguments
+        // after the function name. `map`, `filter` and `zip` return a Sequence that calls the
+        // function when it is consumed, which must happen while this Interpreter exists.
+        Value callWithFunction(const std::string &form, FunctionEntry &function, std::vector<Value> &args);
+
+        // `pmap` and `preduce` with the evaluated arguments after the function name. The vector is
+        // split by partitionSize(), so results do not depend on the number of threads: `preduce`
+        // folds each partition from its first element, then folds the partial results into the
+        // initial value in order. If an element fails, the partitions are run again in order on
+        // this thread so the error is the one the first failing partition reports.
+        Value parallelMap(FunctionEntry &function, std::vector<Value> &args);
+        Value parallelReduce(FunctionEntry &function, std::vector<Value> &args);
+
+    private:
+        // What the walker needs besides the AST node: where variables live and how they were typed
+        struct Scope
+        {
+            Environment &env_;
+            const TypeChecker &checker_;
+            const FunctionTypeInfo *function_;
+        };
+
+        std::ostream &out_;
+        TierOptions options_;
+        ImportHandler importHandler_;
+        bool prefetchImports_ = true;
+        std::mutex importsMutex_; // imports from concurrent statements
+        std::unordered_map<std::string, std::future<DoubleVector>> prefetched_;
+        StreamHandler streamHandler_;
+        std::unordered_map<std::string, std::shared_ptr<VectorStream>> openedStreams_; // by prefetchImports()
+        std::unique_ptr<ThreadPool> ioPool_; // started by the first import
+        Environment ownGlobals_; // unless the caller supplied the globals
+        Environment &globals_;
+        std::vector<std::unique_ptr<TypeChecker>> checkers_;
+        std::unordered_map<const ASTNode *, String> literals_; // interned by execute() before statements run
+
+        std::mutex functionsMutex_; // registration vs. lookups from the compiler thread
+        std::unordered_map<std::string, FunctionEntry *> functions_;
+        std::vector<std::unique_ptr<FunctionEntry>> entries_; // redefined functions stay alive for compiled callers
+        std::mutex loopsMutex_;
+        std::unordered_map<const ASTNode *, std::unique_ptr<LoopEntry>> loops_;
+
+        std::atomic<bool> cancelled_{false};
+        std::atomic<int> compiledFunctions_{0};
+        std::atomic<int> compiledLoops_{0};
+        std::atomic<int> failedCompilations_{0};
+        std::atomic<int> nativeFunctions_{0};
+        std::atomic<int> deoptimizations_{0};
+
+        std::mutex queueMutex_;
+        std::condition_variable queueChanged_;
+        std::deque<std::function<void()>> jobs_;
+        bool compiling_ = false;
+        bool stopping_ = false;
+        std::thread compilerThread_; // started on the first promotion
+
+        [[noreturn]] static void throwCancelled();
+        Value evaluate(const ASTNode &node, Scope &scope);
+        Value evaluateFunctionCall(const FunctionCallNode &node, Scope &scope);
+        Value evaluateForIteration(const ForIterationNode &node, Scope &scope);
+        Value evaluateParallelFor(const ForIterationNode &node, Scope &scope);
+        bool runParallelFor(const ForIterationNode &node, Scope &scope, long index, long end, long step, long grain);
+        Value evaluateWhileIteration(const WhileIterationNode &node, Scope &scope);
+        Value interpretFunction(FunctionEntry &entry, std::vector<Value> &args);
+        void execute(const ScriptNode &script, const TypeChecker &checker, const StatementGraph *graph);
+        void runStatements(const ScriptNode &script, Scope &scope, const StatementGraph &graph);
+
+        void prefetchImports(const ScriptNode &script);
+        std::future<DoubleVector> startImport(const std::string &name);
+
+        LoopEntry *loopEntry(const ASTNode &loop);
+        void countBackEdge(LoopEntry &entry, const ASTNode &loop, const Scope &scope);
+        void promoteFunction(FunctionEntry &entry);
+        bool isNativeCandidate(const FunctionEntry &entry) const;
+        void promoteNative(FunctionEntry &entry);
+        bool invokeNative(FunctionEntry &entry, const NativeFunction &code, std::vector<Value> &args, Value &result);
+        void schedule(std::function<void()> job);
+        void compilerLoop();
+    };
+
+} // namespace Shattang::MyLisp
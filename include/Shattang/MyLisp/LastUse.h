@@ -0,0 +1,17 @@
+#pragma once
+
+#include "ASTNode.h"
+#include "TypeChecker.h"
+
+#include <unordered_set>
+
+namespace Shattang::MyLisp
+{
+    // The reads of DoubleVector parameters and top-level `let`s of `function` after which the
+    // variable is never read again, so its value may be moved out instead of shared. Reads inside
+    // loops and the vector of a `vector-push` are left out, as is any read of a variable that
+    // another argument of the same call also reads, since generated C++ evaluates arguments in
+    // no fixed order.
+    std::unordered_set<const ASTNode *> findLastUses(const FunctionDeclarationNode &function, const FunctionTypeInfo &info);
+
+} // namespace Shattang::MyLisp
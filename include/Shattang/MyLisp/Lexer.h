@@ -2,6 +2,7 @@
 
 #include <vector>
 #include <string>
+#include <string_view>
 
 namespace Shattang::MyLisp
 {
@@ -25,39 +26,273 @@ namespace Shattang::MyLisp
         std::string_view value_;
         int line_;
         int column_;
-        std::string error_;
+        std::string_view error_; // Always a string literal, so tokens stay usable in constant expressions
 
         std::string ToString() const;
     };
 
     std::string TokenTypeToString(TokenType type);
 
+    // ASCII character classes; unlike <cctype> these are constexpr and locale independent
+    constexpr bool isSpaceChar(char c)
+    {
+        return c == ' ' || c == '\t' || c == '\n' || c == '\v' || c == '\f' || c == '\r';
+    }
+
+    constexpr bool isDigitChar(char c)
+    {
+        return c >= '0' && c <= '9';
+    }
+
+    constexpr bool isAlphaChar(char c)
+    {
+        return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+    }
+
+    constexpr bool isAlnumChar(char c)
+    {
+        return isAlphaChar(c) || isDigitChar(c);
+    }
+
+    // The Lexer is constexpr so that embedded scripts can be tokenized at compile time (see FlatParser.h)
     class Lexer
     {
     public:
-        Lexer(const std::string &input)
+        constexpr Lexer(std::string_view input)
             : input_(input), index_(0), line_(1), column_(1) {}
 
-        Token GetNextToken();
+        constexpr Token GetNextToken();
 
     private:
-        const std::string &input_; // Class holds a reference, so caller must hold the input
+        std::string_view input_;   // Class holds a view, so caller must hold the input
         std::size_t index_;        // The index where next token parsing will begin
         int line_;                 // Tracks the current line number
         int column_;               // Tracks the current column number
 
-        void handleWhitespace();
-        void handleComment();
-        Token makeToken(TokenType type);
-        Token makeErrorToken(const std::string &errorMessage);
-        Token makeEOFToken();
-        Token handleNumber();
-        Token handleAlpha();
-        Token tokenizeFloat(size_t start);
-        Token tokenizeInteger(size_t start);
-        Token tokenizeString();
+        constexpr void advance();
+        constexpr void handleWhitespace();
+        constexpr void handleComment();
+        constexpr Token makeToken(TokenType type);
+        constexpr Token makeErrorToken(std::string_view errorMessage);
+        constexpr Token makeEOFToken();
+        constexpr Token handleNumber();
+        constexpr Token handleAlpha();
+        constexpr Token tokenizeFloat(size_t start);
+        constexpr Token tokenizeInteger(size_t start);
+        constexpr Token tokenizeString();
     };
 
-    std::vector<Token> Tokenize(const std::string &input);
+    std::vector<Token> Tokenize(std::string_view input);
+
+    constexpr void Lexer::advance()
+    {
+        ++index_;
+        ++column_;
+    }
+
+    constexpr Token Lexer::GetNextToken()
+    {
+        while (index_ < input_.length())
+        {
+            char currentChar = input_[index_];
+
+            if (isSpaceChar(currentChar))
+            {
+                handleWhitespace();
+                continue;
+            }
+
+            if (currentChar == ';')
+            { // Assuming comments start with a semicolon
+                handleComment();
+                continue;
+            }
+
+            if (currentChar == '(')
+                return makeToken(TokenType::OPEN_PAREN);
+            if (currentChar == ')')
+                return makeToken(TokenType::CLOSE_PAREN);
+            if (isDigitChar(currentChar) || currentChar == '+' || currentChar == '-')
+            {
+                return handleNumber();
+            }
+            if (isAlphaChar(currentChar) || currentChar == '_')
+            {
+                return handleAlpha();
+            }
+            if (currentChar == '"')
+                return tokenizeString();
+
+            return makeErrorToken("Unknown character");
+        }
+
+        return makeEOFToken();
+    }
+
+    constexpr void Lexer::handleComment()
+    {
+        while (index_ < input_.length() && input_[index_] != '\n')
+        {
+            advance();
+        }
+        if (index_ < input_.length() && input_[index_] == '\n')
+        {
+            handleWhitespace(); // Handle newline to update line number
+        }
+    }
+
+    constexpr void Lexer::handleWhitespace()
+    {
+        if (input_[index_] == '\n')
+        {
+            line_++;
+            column_ = 1;
+        }
+        else
+        {
+            column_++;
+        }
+        index_++;
+    }
+
+    constexpr Token Lexer::makeToken(TokenType type)
+    {
+        Token token{type, input_.substr(index_, 1), line_, column_, ""};
+        advance();
+        return token;
+    }
+
+    constexpr Token Lexer::makeErrorToken(std::string_view errorMessage)
+    {
+        std::string_view errorValue = input_.substr(index_ < input_.length() ? index_ : input_.length(), 1);
+        Token errorToken{TokenType::ERROR, errorValue, line_, column_, errorMessage};
+        advance();
+        return errorToken;
+    }
+
+    constexpr Token Lexer::makeEOFToken()
+    {
+        return Token{TokenType::END_OF_FILE, std::string_view(), line_, column_, ""};
+    }
+
+    constexpr Token Lexer::handleNumber()
+    {
+        size_t start = index_;
+        bool hasDecimal = false;
+        bool hasExponent = false;
+
+        if (input_[index_] == '+' || input_[index_] == '-')
+        {
+            advance();
+        }
+
+        while (index_ < input_.length())
+        {
+            char c = input_[index_];
+            if (c == '.' && !hasDecimal)
+            {
+                hasDecimal = true;
+                advance();
+            }
+            else if ((c == 'e' || c == 'E') && !hasExponent)
+            {
+                hasExponent = true;
+                advance();
+
+                if (index_ < input_.length() && (input_[index_] == '+' || input_[index_] == '-'))
+                {
+                    advance();
+                }
+                if (index_ >= input_.length() || !isDigitChar(input_[index_]))
+                {
+                    return makeErrorToken("Invalid scientific notation");
+                }
+            }
+            else if (!isDigitChar(c))
+            {
+                break;
+            }
+            else
+            {
+                advance();
+            }
+        }
+
+        if (hasDecimal || hasExponent)
+        {
+            return tokenizeFloat(start);
+        }
+        else
+        {
+            return tokenizeInteger(start);
+        }
+    }
+
+    constexpr Token Lexer::handleAlpha()
+    {
+        size_t start = index_;
+        while (index_ < input_.length() && (isAlnumChar(input_[index_]) || input_[index_] == '_' || input_[index_] == '-' || input_[index_] == '?'))
+        {
+            advance();
+        }
+
+        std::string_view value = input_.substr(start, index_ - start);
+
+        if (value == "true")
+        {
+            return Token{TokenType::BOOL_TRUE, value, line_, column_, ""};
+        }
+        else if (value == "false")
+        {
+            return Token{TokenType::BOOL_FALSE, value, line_, column_, ""};
+        }
+        else
+        {
+            return Token{TokenType::SYMBOL, value, line_, column_, ""};
+        }
+    }
+
+    constexpr Token Lexer::tokenizeFloat(size_t start)
+    {
+        std::string_view value = input_.substr(start, index_ - start);
+        return Token{TokenType::FLOAT, value, line_, column_, ""};
+    }
+
+    constexpr Token Lexer::tokenizeInteger(size_t start)
+    {
+        std::string_view value = input_.substr(start, index_ - start);
+        return Token{TokenType::INTEGER, value, line_, column_, ""};
+    }
+
+    constexpr Token Lexer::tokenizeString()
+    {
+        size_t start = index_;
+        advance(); // Skip the opening quote
+
+        while (index_ < input_.length() && input_[index_] != '"')
+        {
+            if (input_[index_] == '\n')
+            {
+                line_++;
+                column_ = 1;
+                index_++;
+            }
+            else
+            {
+                advance();
+            }
+        }
+
+        if (index_ < input_.length())
+        {
+            advance(); // Include closing quote
+            std::string_view value = input_.substr(start, index_ - start);
+            return Token{TokenType::STRING, value, line_, column_, ""};
+        }
+        else
+        {
+            return Token{TokenType::ERROR, "", line_, column_, "Unterminated string"};
+        }
+    }
 
 }
\ No newline at end of file
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "ASTNode.h"
+#include "TypeChecker.h"
+#include "Value.h"
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace Shattang::MyLisp
+{
+    enum class ReductionKind
+    {
+        SUM, // (set acc (add acc E)) or (set acc (add E acc)); Int or Float
+        MIN, // the selections planVectorLoop accepts; Float only
+        MAX
+    };
+
+    // An accumulator a parallel loop computes per partition and then combines
+    struct Reduction
+    {
+        std::string variable_;
+        ReductionKind kind_ = ReductionKind::SUM;
+        ValueType type_ = ValueType::FLOAT;
+        bool isInclusive_ = false; // MIN and MAX: ties replace the accumulator (less-equal, greater-equal)
+    };
+
+    // A `for` loop whose iterations only depend on each other through reductions and appends.
+    // Its body may update accumulators as above, append with (vector-push out E) to vectors it
+    // does not otherwise read, and wrap either in `if`. Everything else must be a builtin without
+    // side effects that does not read an accumulator, an output or a variable the body writes.
+    // The iterations can then run in any order, as long as the partial results are combined
+    // and the appends concatenated in iteration order. The body of a `pfor` may also call script
+    // functions that FunctionTypeInfo::isPure_ marks as free of side effects.
+    struct ParallelLoopPlan
+    {
+        std::vector<Reduction> reductions_;
+        std::vector<std::string> outputs_; // appended to in iteration order
+        std::vector<std::string> inputs_;  // every vector the body reads
+    };
+
+    // Returns nullptr unless every statement of `loop`'s body fits the plan above
+    std::unique_ptr<ParallelLoopPlan> planParallelLoop(const ForIterationNode &loop, const TypeChecker &checker);
+
+    // Number of iterations of a `for` from `index` to the inclusive `end`; `step` is not zero
+    std::size_t iterationCount(long index, long end, long step);
+
+    // The private variables one partition of the loop starts with: each accumulator's identity,
+    // then an empty vector for each output
+    std::vector<Value> partitionStart(const ParallelLoopPlan &plan);
+
+    // Folds the private variables every partition ended with into `targets`, the loop's own
+    // accumulators and then outputs. Partitions are taken in iteration order.
+    void combinePartitions(const ParallelLoopPlan &plan, const std::vector<std::vector<Value>> &partitions,
+                           const std::vector<Value *> &targets);
+
+} // namespace Shattang::MyLisp
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "ASTNode.h"
+#include "TypeChecker.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace Shattang::MyLisp
+{
+    // The per-index value computed by a vectorizable loop
+    struct ElementExpression
+    {
+        enum class Kind
+        {
+            ELEMENT,   // (vector-ref vector_ <index>)
+            INVARIANT, // numeric expression the loop does not change, evaluated once
+            ADD,
+            SUBTRACT,
+            MULTIPLY,
+            DIVIDE
+        };
+
+        Kind kind_ = Kind::INVARIANT;
+        std::string vector_;
+        const ASTNode *invariant_ = nullptr;
+        std::unique_ptr<ElementExpression> lhs_;
+        std::unique_ptr<ElementExpression> rhs_;
+    };
+
+    enum class VectorLoopKind
+    {
+        SUM, // (set acc (add acc E))
+        MIN, // (set acc (if (less-than E acc) E acc))
+        MAX, // (set acc (if (greater-than E acc) E acc))
+        MAP  // (vector-push out E)
+    };
+
+    // A loop over consecutive indices whose body is one of the statements above. `for` loops
+    // need step 1; `while` loops need the shape
+    //   (while (less-than i bound) <statement> (set i (add i 1)))
+    // with `less-equal` also accepted. E may only read vectors at the loop index.
+    struct VectorLoopPlan
+    {
+        VectorLoopKind kind_ = VectorLoopKind::SUM;
+        std::string index_;
+        const ASTNode *bound_ = nullptr; // `while` only; `for` loops evaluate their own range
+        bool inclusiveBound_ = false;
+        std::string target_; // accumulator, or output vector for MAP
+        std::unique_ptr<ElementExpression> element_;
+        std::vector<std::string> inputs_; // vectors read by element_
+    };
+
+    // Returns nullptr unless `loop` is a `for` or `while` loop with one of the shapes above
+    std::unique_ptr<VectorLoopPlan> planVectorLoop(const ASTNode &loop, const TypeChecker &checker);
+
+    // If `value` is (if (less-than E acc) E acc), or its mirrored, less-equal or greater-than forms,
+    // returns E and sets `isMin`, and `isInclusive` for the -equal forms; otherwise nullptr
+    const ASTNode *matchSelection(const ASTNode &value, const std::string &acc, bool &isMin, bool &isInclusive);
+
+} // namespace Shattang::MyLisp
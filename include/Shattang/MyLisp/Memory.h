@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstddef>
+#include <memory_resource>
+
+namespace Shattang::MyLisp
+{
+    // Size-classed storage for runtime data that outlives the call that made it, such as the
+    // buffers of vectors. Requests are rounded up to a power of two from 16 bytes to 64 KB;
+    // each thread keeps its own free list per class and trades blocks in batches with a list
+    // shared by all threads, so most allocations take no lock and a block freed on another
+    // thread is simply reused there. Blocks are aligned to their size, up to 64 bytes. Larger
+    // or more strictly aligned requests go to ::operator new. Memory taken for small blocks is
+    // kept for the life of the process and bounded by the peak in use.
+    class BlockPool : public std::pmr::memory_resource
+    {
+    public:
+        static constexpr std::size_t SmallestBlock = 16;
+        static constexpr std::size_t LargestBlock = 64 * 1024;
+        static constexpr std::size_t MaxAlignment = 64;
+
+    private:
+        void *do_allocate(std::size_t bytes, std::size_t alignment) override;
+        void do_deallocate(void *pointer, std::size_t bytes, std::size_t alignment) override;
+        bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override { return this == &other; }
+    };
+
+    // The process-wide pool. It is never destroyed, so values freed during static destruction
+    // are still safe.
+    BlockPool &runtimePool();
+
+    // The storage of one Environment's variable table: the table's buckets and nodes bump a
+    // pointer through chunks taken from the runtime pool, deallocate() does nothing, and the
+    // chunks go back to the pool together when the Environment is destroyed. Only the table
+    // lives here. The vectors and strings its variables hold keep their own storage, since
+    // they may outlive the scope.
+    class TableArena : public std::pmr::monotonic_buffer_resource
+    {
+    public:
+        explicit TableArena(std::size_t initialSize = 1024) : monotonic_buffer_resource(initialSize, &runtimePool()) {}
+    };
+
+} // namespace Shattang::MyLisp
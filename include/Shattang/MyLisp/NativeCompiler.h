@@ -0,0 +1,67 @@
+#pragma once
+
+#include "ASTNode.h"
+#include "TypeChecker.h"
+#include "Value.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace Shattang::MyLisp
+{
+    // What a call into native code needs from the interpreter; the generated code reads it
+    struct NativeContext
+    {
+        const std::atomic<bool> *cancelled_ = nullptr; // checked at every call and loop iteration
+        long depthBudget_ = 0;                         // native activations allowed before deoptimizing
+    };
+
+    // Tier 2 code for a `define` that TypeChecker found numeric and pure, together with every
+    // function it calls: x86-64 machine code in executable memory of its own. Parameters, locals
+    // and intermediate results live in the machine stack frame as 64-bit integers and doubles.
+    //
+    // The code assumes that the arguments have their declared types, that integer divisors and
+    // `for` steps are not zero, that the run is not cancelled and that recursion stays within
+    // the depth budget. A call that breaks an assumption deoptimizes: invoke() returns false
+    // without any effect, and the caller runs the function in a lower tier, which then reports
+    // whatever error the assumption was guarding against.
+    class NativeFunction
+    {
+    public:
+        // Returns 0 with the result stored, or nonzero to deoptimize
+        using Entry = int (*)(NativeContext *context, const std::int64_t *args, std::int64_t *result);
+
+        NativeFunction(const std::vector<unsigned char> &code, std::vector<ValueType> parameterTypes,
+                       ValueType returnType);
+        ~NativeFunction();
+
+        NativeFunction(const NativeFunction &) = delete;
+        NativeFunction &operator=(const NativeFunction &) = delete;
+
+        // Guards the argument types and runs the machine code; `args` are left unchanged
+        bool invoke(NativeContext &context, const std::vector<Value> &args, Value &result) const;
+
+        std::size_t codeSize() const { return codeSize_; }
+
+    private:
+        void *memory_ = nullptr;
+        std::size_t mappedSize_ = 0;
+        std::size_t codeSize_ = 0;
+        Entry entry_ = nullptr;
+        std::vector<ValueType> parameterTypes_;
+        ValueType returnType_;
+    };
+
+    // True where compileNativeFunction can generate code: x86-64 with POSIX memory mapping
+    bool nativeCodeSupported();
+
+    // Compiles `function` and the functions it calls to machine code. Throws std::runtime_error
+    // for what the native tier does not handle, such as a function that reads a global or a
+    // local outside the block that declares it; such functions stay in tier 1.
+    std::unique_ptr<NativeFunction> compileNativeFunction(const FunctionDeclarationNode &function,
+                                                          const TypeChecker &checker);
+
+} // namespace Shattang::MyLisp
@@ -5,25 +5,13 @@
 
 namespace Shattang::MyLisp
 {
-    // Parser processes tokens from the Lexer to create an AST.
+    // Parser turns the tokens from the Lexer into an AST. The grammar itself is FlatParser's;
+    // Parser runs it and builds ASTNodes from the result, throwing std::runtime_error with
+    // the first syntax error.
     class Parser
     {
     private:
         Lexer &lexer_;
-        Token currentToken_;
-        bool isParsingDefine_ = false;
-
-        std::unique_ptr<ASTNode> parseExpression();
-        std::unique_ptr<ASTNode> parseAtom();
-        std::unique_ptr<ASTNode> parseLet();
-        std::unique_ptr<ASTNode> parseDefine();
-        std::unique_ptr<ASTNode> parseFunctionCall();
-        std::unique_ptr<ASTNode> parseSet();
-        std::unique_ptr<ASTNode> parseForIteration();
-        std::unique_ptr<ASTNode> parseWhileIteration();
-        std::unique_ptr<ASTNode> parseIf();
-        void consume(TokenType expectedType);
-        void throwError(const std::string &message);
 
     public:
         explicit Parser(Lexer &lexer);
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "ASTNode.h"
+#include "Environment.h"
+#include "Interpreter.h"
+#include "StatementGraph.h"
+#include "TypeChecker.h"
+#include "ValueType.h"
+
+#include <iostream>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace Shattang::MyLisp
+{
+    // Globals a Program reads from the Environment it runs in, by name, with their types
+    using ProgramInputs = std::unordered_map<std::string, ValueType>;
+
+    // A parsed and type checked script with the statement order it has to keep, built once by
+    // compile() and never changed afterwards. Runs only read it, so any number of threads may
+    // run the same Program at once, each with its own Environment; they share no locks beyond
+    // those of the process-wide pools.
+    class Program
+    {
+    public:
+        // Runs the script in a new Interpreter with `globals` as its global variables: inputs are
+        // read from it and top-level `let`s are defined in it. Tiered code and imports belong to
+        // that Interpreter, so they are not shared between runs. To set import or stream handlers,
+        // construct an Interpreter over `globals` and pass this Program to its run().
+        void run(Environment &globals, std::ostream &out = std::cout, TierOptions options = TierOptions()) const;
+
+        const ScriptNode &script() const { return *script_; }
+        const TypeChecker &checker() const { return checker_; }
+        const StatementGraph &statementGraph() const { return graph_; }
+        const ProgramInputs &inputs() const { return inputs_; }
+
+    private:
+        std::unique_ptr<const ScriptNode> script_;
+        TypeChecker checker_;
+        StatementGraph graph_;
+        ProgramInputs inputs_;
+
+        Program(std::unique_ptr<const ScriptNode> script, ProgramInputs inputs);
+
+        friend std::shared_ptr<const Program> compile(std::unique_ptr<ASTNode> script, ProgramInputs inputs);
+    };
+
+    // Parses and type checks `source`. Throws std::runtime_error with the first parse or type error.
+    std::shared_ptr<const Program> compile(std::string_view source, ProgramInputs inputs = {});
+
+    // The same for a script that is already parsed, such as one built by BuildAST
+    std::shared_ptr<const Program> compile(std::unique_ptr<ASTNode> script, ProgramInputs inputs = {});
+
+} // namespace Shattang::MyLisp
@@ -0,0 +1,89 @@
+#pragma once
+
+#include "DoubleVector.h"
+#include "VectorExpression.h"
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <optional>
+
+namespace Shattang::MyLisp
+{
+    // A lazy sequence of doubles built by `range`, `map`, `filter`, `take` and `zip`. It only
+    // describes a pipeline: every consumer opens a Cursor and pulls the elements through all
+    // stages a block at a time, so (vector-sum (map f (filter g v))) runs in one pass with a
+    // block of scratch per stage and never stores an intermediate sequence. Sequences are
+    // immutable; consuming one twice runs its pipeline twice.
+    class Sequence
+    {
+    public:
+        enum class Kind
+        {
+            VECTOR, // the elements of a VectorExpression, which may read a stream
+            RANGE,  // start, start + step, .. up to the inclusive end, like `for`
+            MAP,
+            FILTER,
+            TAKE,
+            ZIP // a function of the elements of two sequences, as long as the shorter one
+        };
+
+        using UnaryFunction = std::function<double(double)>;
+        using Predicate = std::function<bool(double)>;
+        using BinaryFunction = std::function<double(double, double)>;
+
+        static constexpr std::size_t BlockSize = VectorExpression::BlockSize;
+
+        // Reads a sequence front to back
+        class Cursor
+        {
+        public:
+            virtual ~Cursor() = default;
+
+            // Writes up to `capacity` elements to `out`; fewer only once the sequence is exhausted
+            virtual std::size_t read(double *out, std::size_t capacity) = 0;
+        };
+
+        static std::shared_ptr<const Sequence> vector(std::shared_ptr<const VectorExpression> elements);
+        // Throws std::runtime_error if `step` is zero
+        static std::shared_ptr<const Sequence> range(long start, long end, long step);
+        static std::shared_ptr<const Sequence> map(UnaryFunction function, std::shared_ptr<const Sequence> source);
+        static std::shared_ptr<const Sequence> filter(Predicate predicate, std::shared_ptr<const Sequence> source);
+        // Throws std::runtime_error if `count` is negative
+        static std::shared_ptr<const Sequence> take(long count, std::shared_ptr<const Sequence> source);
+        static std::shared_ptr<const Sequence> zip(BinaryFunction function, std::shared_ptr<const Sequence> lhs,
+                                                   std::shared_ptr<const Sequence> rhs);
+
+        Kind kind() const { return kind_; }
+
+        std::unique_ptr<Cursor> open() const;
+
+        DoubleVector collect() const;
+        std::size_t count() const;
+
+        // Adds up blocks and partitions like VectorExpression::sum, so summing a sequence gives
+        // the same result as summing the vector it collects into
+        double sum() const;
+        std::optional<double> min() const; // empty if the sequence is
+        std::optional<double> max() const;
+        Moments moments() const; // combined in the same order as VectorExpression::moments
+
+    private:
+        Kind kind_ = Kind::RANGE;
+        std::shared_ptr<const VectorExpression> elements_; // VECTOR
+        long start_ = 0;                                   // RANGE
+        long end_ = 0;                                     // RANGE
+        long step_ = 1;                                    // RANGE
+        long count_ = 0;                                   // TAKE
+        UnaryFunction function_;                           // MAP
+        Predicate predicate_;                              // FILTER
+        BinaryFunction binaryFunction_;                    // ZIP
+        std::shared_ptr<const Sequence> lhs_;              // the source of MAP, FILTER and TAKE
+        std::shared_ptr<const Sequence> rhs_;              // ZIP
+
+        // reduce(values, count) for each block, in order
+        template <typename Reduce>
+        void forEachBlock(Reduce reduce) const;
+    };
+
+} // namespace Shattang::MyLisp
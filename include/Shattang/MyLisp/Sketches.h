@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace Shattang::MyLisp
+{
+    class Sequence;
+    class VectorExpression;
+
+    // Quantiles of a stream in bounded memory: the KLL sketch of Karnin, Lang and Liberty.
+    // Values enter level 0. When a level fills up it is sorted and every other element moves
+    // to the next level, where it stands for twice as many values. Lower levels get
+    // geometrically smaller capacities, so about 3k values are kept, and the rank error of a
+    // query shrinks in proportion to 1/k (about 1.7% for the default). The coin that picks
+    // which half moves up is seeded the same way for every sketch, so the same updates and
+    // merges in the same order always give the same sketch. NaN values are ignored.
+    class QuantileSketch
+    {
+    public:
+        static constexpr std::size_t DefaultK = 200;
+
+        explicit QuantileSketch(std::size_t k = DefaultK);
+
+        void update(const double *values, std::size_t count);
+        void merge(const QuantileSketch &other);
+
+        std::uint64_t count() const { return count_; }
+        // The value at `fraction` of the way through the sorted input: the minimum for 0 and
+        // the maximum for 1. count() must be at least 1 and `fraction` within [0, 1].
+        double quantile(double fraction) const;
+
+        // Exact text form, with doubles as hex floats; parse() throws std::runtime_error if
+        // `text` is not one
+        std::string serialize() const;
+        static QuantileSketch parse(const std::string &text);
+
+    private:
+        std::size_t k_;
+        std::uint64_t count_ = 0;
+        double min_ = 0.0;
+        double max_ = 0.0;
+        std::uint64_t coin_; // state of the generator that picks which half of a level moves up
+        std::vector<std::vector<double>> levels_;
+        std::size_t retained_ = 0;
+        std::size_t capacity_ = 0; // of all levels together; compress() runs when it is reached
+
+        std::size_t levelCapacity(std::size_t level) const;
+        void addLevel();
+        void compress();
+    };
+
+    // Number of distinct values in a stream: HyperLogLog (Flajolet et al.) with 2^14 one-byte
+    // registers, for a standard error of about 0.8% in 16 KB. Each value is hashed; the first
+    // bits pick a register, which keeps the longest run of leading zeros seen in the rest.
+    // Merging takes the maximum of each register, so merges in any order agree.
+    // 0.0 and -0.0 count as one value, as do all NaNs.
+    class DistinctSketch
+    {
+    public:
+        static constexpr int Precision = 14;
+
+        DistinctSketch();
+
+        void update(const double *values, std::size_t count);
+        void merge(const DistinctSketch &other);
+
+        std::uint64_t count() const { return count_; } // values added, not distinct ones
+        double estimate() const;
+
+        std::string serialize() const;
+        static DistinctSketch parse(const std::string &text); // throws std::runtime_error
+
+    private:
+        std::uint64_t count_ = 0;
+        std::vector<std::uint8_t> registers_;
+    };
+
+    // A QuantileSketch or DistinctSketch of some elements. Each partition of the elements, as
+    // VectorExpression defines them, is sketched separately and the results merged in order, on
+    // the compute pool for a vector. So the result depends neither on the number of threads nor
+    // on whether the elements come from a vector or from a sequence.
+    template <typename Sketch>
+    Sketch sketchElements(const VectorExpression &elements);
+    template <typename Sketch>
+    Sketch sketchElements(const Sequence &elements);
+
+} // namespace Shattang::MyLisp
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "DoubleVector.h"
+
+#include <cstddef>
+
+namespace Shattang::MyLisp
+{
+    class Sequence;
+    class VectorExpression;
+
+    // Ordering and bucketing of float64 values. Values are ordered as by `<`, except that -0.0
+    // comes before 0.0 and all NaNs come last, so every input has one sorted order and the
+    // results do not depend on the number of threads. Functions that need every element at
+    // once throw std::runtime_error for an expression that reads a stream, like materialize().
+
+    // Each partition is sorted with a least significant digit radix sort on the bits of its
+    // values, then sorted runs are merged pairwise. Every merge is cut along its merge path into
+    // pieces of one partition, so the last rounds still keep all cores busy.
+    DoubleVector sortElements(const VectorExpression &elements);
+    // The indices, as Floats, that put `elements` in sorted order; equal values keep their order
+    DoubleVector argsortElements(const VectorExpression &elements);
+
+    // The `count` largest values, largest first, or all of them if there are fewer. NaNs are
+    // skipped. Each partition keeps its own candidates, so memory grows with `count`, not with
+    // the input. Throws std::runtime_error if `count` is negative.
+    DoubleVector topElements(const VectorExpression &elements, long count);
+    DoubleVector topElements(const Sequence &elements, long count);
+
+    // Counts of the values in `bins` equal bins over [low, high], as Floats. The last bin also
+    // holds `high`; values outside the range and NaNs are not counted. Throws std::runtime_error
+    // unless low < high and `bins` is positive.
+    DoubleVector histogramElements(const VectorExpression &elements, double low, double high, long bins);
+    DoubleVector histogramElements(const Sequence &elements, double low, double high, long bins);
+
+    // The values of a vector aggregated by the matching elements of a vector of keys, one group
+    // per distinct key in sorted order. 0.0 and -0.0 are one key, as are all NaNs.
+    // Pairs are first scattered by a hash of their key into buckets small enough for cache,
+    // every input partition writing its share of each bucket in order, and then each bucket is
+    // aggregated on its own in an open addressing table. The values of a group are added in
+    // input order, as a loop over the vectors would.
+    struct Groups
+    {
+        DoubleVector keys_;
+        DoubleVector counts_;
+        DoubleVector sums_;
+
+        // Throws std::runtime_error if `keys` and `values` differ in length
+        static Groups of(const VectorExpression &keys, const VectorExpression &values);
+
+        std::size_t size() const { return keys_.size(); }
+        DoubleVector means() const;
+    };
+
+} // namespace Shattang::MyLisp
@@ -0,0 +1,27 @@
+#pragma once
+
+#include "ASTNode.h"
+
+#include <cstddef>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+namespace Shattang::MyLisp
+{
+    // The order the top-level statements of a script have to keep. A statement waits for every
+    // earlier statement that writes a global it reads or writes, or that reads a global it
+    // writes; calls count with everything the called script functions read and write. Barriers
+    // call `print` or another builtin with side effects, directly or through a function, or a
+    // function the script does not define; they wait for every earlier statement, so their
+    // effects happen in program order and only once everything before them has succeeded.
+    struct StatementGraph
+    {
+        std::vector<std::vector<std::size_t>> dependencies_; // per statement, the earlier statements it waits for
+        std::vector<bool> isBarrier_;
+        std::unordered_set<std::string> globals_; // every global a statement may define
+    };
+
+    StatementGraph buildStatementGraph(const ScriptNode &script);
+
+} // namespace Shattang::MyLisp
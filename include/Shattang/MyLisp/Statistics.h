@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+
+namespace Shattang::MyLisp
+{
+    // Count, mean and M2, the sum of squared deviations from the mean, of a set of values.
+    // A block is summarized exactly with two SIMD passes while it is in cache, and summaries
+    // are combined with the pairwise update of Chan, Golub and LeVeque. Unlike the mean of
+    // squares minus the squared mean, this does not cancel when the variance is small
+    // relative to the mean.
+    struct Moments
+    {
+        double count_ = 0.0;
+        double mean_ = 0.0;
+        double m2_ = 0.0;
+
+        static Moments of(const double *values, std::size_t count);
+        void merge(const Moments &other);
+
+        double variance() const { return m2_ / count_; } // of the population; NaN if empty
+    };
+
+    // Moments of two paired sets of values and their co-moment, the sum of products of the
+    // deviations from the two means
+    struct CoMoments
+    {
+        Moments lhs_;
+        Moments rhs_;
+        double comoment_ = 0.0;
+
+        static CoMoments of(const double *lhs, const double *rhs, std::size_t count);
+        void merge(const CoMoments &other);
+
+        double covariance() const { return comoment_ / lhs_.count_; } // of the population
+        double correlation() const; // Pearson's; NaN if either side is constant
+    };
+
+} // namespace Shattang::MyLisp
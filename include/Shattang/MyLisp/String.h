@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <iosfwd>
+#include <string>
+#include <string_view>
+
+namespace Shattang::MyLisp
+{
+    // Immutable text for String values, copied in constant time. Up to SmallCapacity bytes are
+    // stored inline; longer text lives in a reference counted node from the runtime pool.
+    // Interned text has one node per distinct value for the whole process, so two interned
+    // Strings are equal exactly when they share it; string literals are interned by the parser.
+    // concat() of long text makes a rope node over both sides instead of copying them. Short
+    // pieces appended to a rope are merged into its last leaf, and a rope that grows too deep is
+    // rebalanced, so appending in a loop stays linear.
+    class String
+    {
+    public:
+        static constexpr std::size_t SmallCapacity = 15;
+
+        String() noexcept;
+        String(std::string_view text);
+        String(const std::string &text) : String(std::string_view(text)) {}
+        String(const char *text) : String(std::string_view(text)) {}
+
+        String(const String &other) noexcept;
+        String(String &&other) noexcept;
+        String &operator=(const String &other) noexcept;
+        String &operator=(String &&other) noexcept;
+        ~String();
+
+        // The shared copy of `text`; it is forgotten when the last String using it goes away
+        static String intern(std::string_view text);
+        static String concat(const String &lhs, const String &rhs);
+
+        std::size_t size() const;
+        bool empty() const { return size() == 0; }
+
+        // The whole text in one buffer
+        std::string str() const;
+        // Calls `visit` on each piece of the text in order, without gathering them
+        void forEachPiece(const std::function<void(std::string_view)> &visit) const;
+
+        bool operator==(const String &other) const;
+
+    private:
+        struct Node;
+        struct InternTable;
+
+        // Inline text with its length in the last byte, or a Node pointer in the first bytes and
+        // HeapTag in the last
+        static constexpr unsigned char HeapTag = 0xFF;
+        alignas(void *) unsigned char bytes_[SmallCapacity + 1];
+
+        explicit String(Node *node) noexcept;
+
+        bool isHeap() const { return bytes_[SmallCapacity] == HeapTag; }
+        Node *node() const;
+        bool isRope() const { return depth() != 0; }
+        std::size_t depth() const; // 0 unless this is a rope
+        std::string_view flat() const; // the text of a String that is not a rope
+
+        static Node *makeFlat(std::string_view text);
+        static String makeConcat(String lhs, String rhs);
+        static String rebalance(const String &rope);
+        static void release(Node *node);
+        static InternTable &internTable();
+    };
+
+    std::ostream &operator<<(std::ostream &out, const String &text);
+
+} // namespace Shattang::MyLisp
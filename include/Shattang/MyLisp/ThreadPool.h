@@ -0,0 +1,68 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace Shattang::MyLisp
+{
+    // A fixed set of worker threads running queued jobs in order. The destructor finishes
+    // every queued job before joining, so futures returned by submit() are always satisfied.
+    // parallelFor() splits one computation across the workers with work stealing.
+    class ThreadPool
+    {
+    public:
+        explicit ThreadPool(unsigned threads);
+        ~ThreadPool();
+
+        ThreadPool(const ThreadPool &) = delete;
+        ThreadPool &operator=(const ThreadPool &) = delete;
+
+        void post(std::function<void()> job);
+
+        // Runs `function` on a worker; its result or exception is delivered through the future
+        template <typename Function>
+        std::future<std::invoke_result_t<Function>> submit(Function function)
+        {
+            using Result = std::invoke_result_t<Function>;
+            auto task = std::make_shared<std::packaged_task<Result()>>(std::move(function));
+            std::future<Result> result = task->get_future();
+            post([task]()
+                 { (*task)(); });
+            return result;
+        }
+
+        // Runs task(0) .. task(count - 1) on the calling thread and idle workers, returning once all
+        // have run. Each participant starts on its own contiguous run of tasks and, when that is
+        // done, steals from the end of another's. After a task throws, tasks not yet started are
+        // skipped and the first exception is rethrown here. `count` must be below 2^32.
+        void parallelFor(std::size_t count, const std::function<void(std::size_t)> &task);
+
+        std::size_t size() const { return workers_.size(); }
+
+    private:
+        std::mutex mutex_;
+        std::condition_variable changed_;
+        std::deque<std::function<void()>> jobs_;
+        bool stopping_ = false;
+        std::vector<std::thread> workers_;
+
+        void workerLoop();
+    };
+
+    // Shared by everything that splits a computation across cores. It has one worker less than
+    // the hardware has threads, since the thread calling parallelFor() takes part.
+    ThreadPool &computePool();
+
+    // Items per task when `count` items are split for parallelFor(): `grain` if positive, else a
+    // size that depends only on `count`. Either way, results combined task by task do not depend
+    // on the number of threads.
+    std::size_t partitionSize(std::size_t count, long grain = 0);
+
+} // namespace Shattang::MyLisp
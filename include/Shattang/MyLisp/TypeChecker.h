@@ -0,0 +1,104 @@
+#pragma once
+
+#include "ASTNode.h"
+#include "ValueType.h"
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+namespace Shattang::MyLisp
+{
+    // Type information gathered for a single `define`
+    struct FunctionTypeInfo
+    {
+        const FunctionDeclarationNode *declaration_ = nullptr;
+        std::vector<ValueType> parameterTypes_;
+        ValueType returnType_ = ValueType::VOID;
+        std::unordered_map<std::string, ValueType> locals_; // parameters, `let`s and loop indices
+
+        // True when every parameter, local and the return value is Int, Float or Boolean
+        // and the body only calls scalar builtins or other numeric functions. Such functions
+        // need no heap values at runtime; compileNativeFunction turns them into machine code.
+        bool isNumeric_ = false;
+
+        // True when neither the body nor any function it calls prints, runs `using`, assigns a
+        // global or pushes to a global vector. Such functions may be called from several threads
+        // at once by `pmap`, `preduce` and `pfor`, and whenever a lazy `map`, `filter` or `zip`
+        // happens to be consumed.
+        bool isPure_ = false;
+
+        // Reads of a DoubleVector variable that are its last, which may move the value out; see findLastUses
+        std::unordered_set<const ASTNode *> lastUses_;
+    };
+
+    struct ParallelLoopPlan;
+
+    // Checks a parsed script against its type annotations and records the type of every expression.
+    // Throws std::runtime_error describing the first type error found.
+    class TypeChecker
+    {
+    public:
+        void check(const ScriptNode &script);
+        // Also lets the script read and assign `inputs`, globals that are defined before it runs
+        void check(const ScriptNode &script, const std::unordered_map<std::string, ValueType> &inputs);
+
+        // Type of an expression node visited by check(); throws if the node was not checked
+        ValueType typeOf(const ASTNode &node) const;
+
+        // Returns nullptr if no such function was declared
+        const FunctionTypeInfo *function(const std::string &name) const;
+
+        const std::unordered_map<std::string, FunctionTypeInfo> &functions() const { return functions_; }
+        const std::unordered_map<std::string, ValueType> &globals() const { return globals_; }
+
+        // How a `pfor` combines its iterations; every `pfor` visited by check() has one
+        const ParallelLoopPlan *parallelPlan(const ForIterationNode &node) const;
+
+    private:
+        std::unordered_map<std::string, FunctionTypeInfo> functions_;
+        std::unordered_map<std::string, ValueType> globals_;
+        std::unordered_map<const ASTNode *, ValueType> types_;
+
+        FunctionTypeInfo *currentFunction_ = nullptr;
+        std::unordered_map<std::string, std::vector<std::string>> callees_; // user functions called by each function
+        std::unordered_map<std::string, bool> callsNonScalarBuiltin_;
+        std::unordered_map<std::string, bool> hasSideEffects_; // directly, not through callees
+        std::unordered_map<const ASTNode *, std::shared_ptr<const ParallelLoopPlan>> parallelPlans_;
+        // Imported by a top-level (using "name") in this or an earlier script, which makes the
+        // builtins of the module available anywhere in the script
+        std::unordered_set<std::string> modules_;
+
+        // `pfor` loops and calls that take a function, with their enclosing function; they can
+        // only be validated once isPure_ is known for every function
+        std::vector<std::pair<const ASTNode *, FunctionTypeInfo *>> functionForms_;
+
+        ValueType checkNode(const ASTNode &node);
+        ValueType checkSymbol(const SymbolNode &node);
+        ValueType checkVariableDeclaration(const VariableDeclarationNode &node);
+        ValueType checkFunctionDeclaration(const FunctionDeclarationNode &node);
+        ValueType checkFunctionCall(const FunctionCallNode &node);
+        void importModule(const FunctionCallNode &node);
+        ValueType checkParallelCall(const FunctionCallNode &node);
+        ValueType checkSequenceCall(const FunctionCallNode &node);
+        void checkFunctionArgument(const FunctionCallNode &node, std::size_t parameters, ValueType result);
+        ValueType checkVariableAssignment(const VariableAssignmentNode &node);
+        ValueType checkForIteration(const ForIterationNode &node);
+        ValueType checkWhileIteration(const WhileIterationNode &node);
+        ValueType checkIf(const IfNode &node);
+        ValueType checkBody(const std::vector<std::unique_ptr<ASTNode>> &body);
+
+        void declareVariable(const std::string &name, ValueType type);
+        const ValueType *lookupVariable(const std::string &name) const;
+        void noteWrite(const std::string &name);
+        void computeNumericFunctions();
+        void computePureFunctions();
+        void checkFunctionForms();
+        [[noreturn]] void throwError(const std::string &message) const;
+    };
+
+} // namespace Shattang::MyLisp
@@ -0,0 +1,91 @@
+#pragma once
+
+#include "DoubleVector.h"
+#include "String.h"
+#include "ValueType.h"
+
+#include <future>
+#include <memory>
+#include <string>
+#include <utility>
+#include <variant>
+
+namespace Shattang::MyLisp
+{
+    class DoubleMatrix;
+    class VectorExpression;
+    class Sequence;
+    class QuantileSketch;
+    class DistinctSketch;
+    struct Groups;
+    struct DeferredVector;
+
+    // A runtime value. A default constructed Value is Void. Copying a Value shares its
+    // DoubleVector, which is copied on write: asMutableVector() updates it in place only while
+    // no other Value refers to it. A DoubleVector value may also be a deferred VectorExpression,
+    // which is only materialized when storage is needed, or a pending import, which is waited
+    // for when the vector is first used. Matrices, sequences, sketches and groups are immutable
+    // and shared.
+    class Value
+    {
+    public:
+        Value() = default;
+        Value(long value) : data_(value) {}
+        Value(int value) : data_(static_cast<long>(value)) {}
+        Value(double value) : data_(value) {}
+        Value(bool value) : data_(value) {}
+        Value(String value) : data_(std::move(value)) {}
+        Value(const std::string &value) : data_(String(value)) {}
+        Value(const char *value) : data_(String(value)) {}
+        Value(DoubleVector value) : data_(std::make_shared<DoubleVector>(std::move(value))) {}
+        Value(std::shared_ptr<const VectorExpression> expression);
+        Value(std::shared_ptr<const DoubleMatrix> matrix);
+        Value(std::future<DoubleVector> pending);
+        Value(std::shared_ptr<const Sequence> sequence);
+        Value(std::shared_ptr<const QuantileSketch> sketch);
+        Value(std::shared_ptr<const DistinctSketch> sketch);
+        Value(std::shared_ptr<const Groups> groups);
+
+        ValueType type() const;
+
+        long asInt() const;
+        double asFloat() const; // Int values are widened
+        bool asBool() const;
+        const String &asString() const;
+        const DoubleVector &asVector() const; // materializes a deferred vector
+        DoubleVector &asMutableVector();      // copies a vector that is still shared first
+        const DoubleMatrix &asMatrix() const;
+
+        // A Sequence, or the elements of a DoubleVector as one, without materializing either
+        std::shared_ptr<const Sequence> asSequence() const;
+
+        const QuantileSketch &asQuantileSketch() const;
+        const DistinctSketch &asDistinctSketch() const;
+        const Groups &asGroups() const;
+
+        // A DoubleVector value as an expression, without materializing it
+        std::shared_ptr<const VectorExpression> asExpression() const;
+        std::size_t vectorSize() const;
+        double vectorElement(long index) const; // checked, as used by vector-ref
+        double vectorElementUnchecked(std::size_t index) const; // `index` must be less than vectorSize()
+
+        bool isVoid() const { return std::holds_alternative<std::monostate>(data_); }
+
+        // Text written by `print`; matches what AotRuntime prints for the same value
+        std::string toString() const;
+
+        bool operator==(const Value &other) const;
+
+    private:
+        std::variant<std::monostate, long, double, bool, String, std::shared_ptr<DoubleVector>,
+                     std::shared_ptr<DeferredVector>, std::shared_ptr<const Sequence>,
+                     std::shared_ptr<const QuantileSketch>, std::shared_ptr<const DistinctSketch>,
+                     std::shared_ptr<const Groups>, std::shared_ptr<const DoubleMatrix>>
+            data_;
+    };
+
+    // Converts `value` for storage in a slot declared as `type`; only widens Int to Float. A vector
+    // stays shared until one of its holders changes it, so storing one never copies it.
+    Value convertValue(Value value, ValueType type);
+
+} // namespace Shattang::MyLisp
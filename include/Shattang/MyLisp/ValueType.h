@@ -0,0 +1,34 @@
+#pragma once
+
+#include <string>
+
+namespace Shattang::MyLisp
+{
+    // Static types named by `let`, parameter and return type annotations
+    enum class ValueType
+    {
+        VOID,
+        INT,
+        FLOAT,
+        BOOLEAN,
+        STRING,
+        DOUBLE_VECTOR,
+        DOUBLE_MATRIX,
+        SEQUENCE, // lazy, see Sequence
+        QUANTILE_SKETCH,
+        DISTINCT_SKETCH,
+        GROUPS // see Groups
+    };
+
+    // Converts a ValueType to the name used in MyLisp source, e.g. "DoubleVector"
+    std::string ValueTypeToString(ValueType type);
+
+    // Resolves a type annotation such as "Float"; throws std::runtime_error for unknown names
+    ValueType ValueTypeFromName(const std::string &name);
+
+    // True for Int and Float
+    bool isNumericType(ValueType type);
+
+    // True if a value of type `from` may be stored where `to` is expected (Int widens to Float)
+    bool isAssignable(ValueType from, ValueType to);
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include "DoubleVector.h"
+#include "Statistics.h"
+#include "VectorStream.h"
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace Shattang::MyLisp
+{
+    // An immutable element-wise computation over stored vectors. Consumers evaluate it a block
+    // at a time, so chains like (vector-sum (vector-multiply a b)) or a push loop feeding a
+    // reduction run in one pass without allocating the intermediate vectors.
+    // Stored vectors are shared, not copied; this relies on DoubleVector values only ever
+    // growing at the end, which leaves the referenced range unchanged. Expressions over a
+    // VectorStream are read front to back and can never be materialized.
+    class VectorExpression
+    {
+    public:
+        enum class Kind
+        {
+            VECTOR,   // a range of a stored vector
+            CONSTANT, // the same value at every index
+            ADD,
+            SUBTRACT,
+            MULTIPLY,
+            DIVIDE,
+            CONCAT, // lhs followed by rhs
+            STREAM  // a range of a VectorStream
+        };
+
+        static constexpr std::size_t BlockSize = 1024;
+        // Reductions split the expression into partitions of this many elements, run them on the
+        // compute pool and combine their results in order. The size is fixed so that float
+        // results are the same on any number of threads.
+        static constexpr std::size_t PartitionSize = 64 * BlockSize;
+
+        static std::shared_ptr<const VectorExpression> vector(std::shared_ptr<const DoubleVector> data);
+        static std::shared_ptr<const VectorExpression> constant(double value, std::size_t size);
+        static std::shared_ptr<const VectorExpression> stream(std::shared_ptr<VectorStream> stream);
+        // Throws std::runtime_error, naming `builtin`, if the operands differ in length
+        static std::shared_ptr<const VectorExpression> binary(Kind kind, std::shared_ptr<const VectorExpression> lhs,
+                                                              std::shared_ptr<const VectorExpression> rhs,
+                                                              const char *builtin);
+
+        static std::shared_ptr<const VectorExpression> concat(std::shared_ptr<const VectorExpression> lhs,
+                                                              std::shared_ptr<const VectorExpression> rhs);
+
+        // Elements [first, first + size) of `expression`; the range must be within it
+        static std::shared_ptr<const VectorExpression> slice(const std::shared_ptr<const VectorExpression> &expression,
+                                                             std::size_t first, std::size_t size);
+
+        Kind kind() const { return kind_; }
+        std::size_t size() const { return size_; }
+        bool readsStream() const { return findStream() != nullptr; }
+
+        // Number of BlockSize buffers evaluate() needs as scratch space
+        std::size_t scratchBlocks() const { return scratchBlocks_; }
+
+        // Elements [offset, offset + count) with count <= BlockSize. The result points into a
+        // stored vector or into `scratch`, which must hold scratchBlocks() * BlockSize doubles.
+        const double *evaluate(std::size_t offset, std::size_t count, double *scratch) const;
+
+        // One element, computed without scratch space; `index` must be less than size()
+        double at(std::size_t index) const;
+
+        // Throws std::runtime_error if the expression reads a stream
+        DoubleVector materialize() const;
+
+        double sum() const;
+        double min() const; // size() must be at least 1
+        double max() const; // size() must be at least 1
+        Moments moments() const;
+
+        // For reductions kept outside this class: visit(partition, values, count) for the blocks
+        // of each partition, in order within a partition. Partitions run like those of sum().
+        std::size_t partitionCount() const { return (size_ + PartitionSize - 1) / PartitionSize; }
+        void forEachPartitionBlock(const std::function<void(std::size_t, const double *, std::size_t)> &visit) const;
+        // `lhs` and `rhs` must have the same size
+        static CoMoments coMoments(const VectorExpression &lhs, const VectorExpression &rhs);
+
+    private:
+        Kind kind_ = Kind::CONSTANT;
+        std::size_t size_ = 0;
+        std::size_t scratchBlocks_ = 0;
+        std::shared_ptr<const DoubleVector> data_; // VECTOR
+        std::shared_ptr<VectorStream> stream_;     // STREAM
+        std::size_t first_ = 0;                    // VECTOR and STREAM
+        double value_ = 0.0;                       // CONSTANT
+        std::shared_ptr<const VectorExpression> lhs_;
+        std::shared_ptr<const VectorExpression> rhs_;
+
+        const VectorStream *findStream() const;
+
+        // reduce(values, count) for the blocks of elements [first, last), in order
+        template <typename Reduce>
+        void forEachBlock(std::size_t first, std::size_t last, Reduce reduce) const;
+
+        // Computes one result per partition with reduce(first, last), in parallel unless a stream
+        // is read or `inOrder` is set
+        template <typename Reduce>
+        auto reducePartitions(Reduce reduce, bool inOrder = false) const;
+    };
+
+} // namespace Shattang::MyLisp
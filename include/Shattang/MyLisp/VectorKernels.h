@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+
+// SIMD loops over raw float64 arrays. The widest instruction set supported by the running
+// CPU (AVX2, then SSE2) is picked on first use; other targets use scalar loops. Pointers
+// need no particular alignment and `out` may alias an input.
+namespace Shattang::MyLisp::Kernels
+{
+    void add(const double *lhs, const double *rhs, double *out, std::size_t count);
+    void subtract(const double *lhs, const double *rhs, double *out, std::size_t count);
+    void multiply(const double *lhs, const double *rhs, double *out, std::size_t count);
+    void divide(const double *lhs, const double *rhs, double *out, std::size_t count);
+    void scale(const double *values, double factor, double *out, std::size_t count);
+
+    double dot(const double *lhs, const double *rhs, std::size_t count);
+    double sum(const double *values, std::size_t count);
+
+    // Sum of (values[i] - center)^2, and of (lhs[i] - lhsCenter) * (rhs[i] - rhsCenter)
+    double squaredDeviations(const double *values, double center, std::size_t count);
+    double crossDeviations(const double *lhs, double lhsCenter, const double *rhs, double rhsCenter, std::size_t count);
+
+    // `count` must be at least 1
+    double min(const double *values, std::size_t count);
+    double max(const double *values, std::size_t count);
+
+    // Adds the product of two packed panels to a TileRows x TileColumns tile of `out`, whose rows
+    // are `outStride` apart: out[r][c] += sum of lhs[p * TileRows + r] * rhs[p * TileColumns + c]
+    // for p below `depth`. `out` must not alias the panels.
+    constexpr std::size_t TileRows = 4;
+    constexpr std::size_t TileColumns = 8;
+    void multiplyTile(const double *lhs, const double *rhs, std::size_t depth, double *out, std::size_t outStride);
+
+    // "avx2", "sse2" or "scalar"
+    const char *instructionSet();
+
+} // namespace Shattang::MyLisp::Kernels
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace Shattang::MyLisp
+{
+    class VectorStream;
+
+    // A fixed budget of chunk buffers shared by every stream reading from it. Buffers are
+    // allocated on first use and then recycled least recently used first, so memory use stays
+    // within the budget however large the streamed inputs are. Streams sharing a pool must be
+    // read from one thread.
+    class StreamBufferPool
+    {
+    public:
+        static constexpr std::size_t DefaultChunkSize = std::size_t(1) << 17; // values, 1 MB
+
+        // Throws std::runtime_error if the budget holds fewer than two chunks
+        explicit StreamBufferPool(std::size_t budgetBytes, std::size_t chunkSize = DefaultChunkSize);
+
+        std::size_t chunkSize() const { return chunkSize_; }
+        std::size_t bufferCount() const { return buffers_.size(); }
+
+    private:
+        friend class VectorStream;
+
+        struct Buffer
+        {
+            std::unique_ptr<double[]> data_;
+            const VectorStream *owner_ = nullptr;
+            std::size_t chunk_ = 0;
+            std::uint64_t lastUse_ = 0;
+        };
+
+        std::size_t chunkSize_;
+        std::vector<Buffer> buffers_;
+        std::uint64_t clock_ = 0;
+
+        // The buffer holding `chunk` of `owner`; `loaded` is false if it must be read first
+        Buffer &acquire(const VectorStream &owner, std::size_t chunk, bool &loaded);
+        void release(const VectorStream &owner);
+    };
+
+    // A vector too large for memory, read a chunk at a time through a StreamBufferPool. Reads
+    // must go front to back: each pass may look back one chunk, for stencils like
+    // (vector-ref v (subtract i 1)), and may start over from index 0, but any other backward
+    // access throws, naming the stream. A stream has one reader at a time.
+    class VectorStream
+    {
+    public:
+        // Reads values [first, first + count) of the source into `out`
+        using ChunkReader = std::function<void(std::size_t first, std::size_t count, double *out)>;
+
+        VectorStream(std::string name, std::size_t size, ChunkReader reader, std::shared_ptr<StreamBufferPool> pool);
+        ~VectorStream();
+
+        VectorStream(const VectorStream &) = delete;
+        VectorStream &operator=(const VectorStream &) = delete;
+
+        const std::string &name() const { return name_; }
+        std::size_t size() const { return size_; }
+
+        // `index` and the range must be within size()
+        double at(std::size_t index)
+        {
+            std::size_t offset = index - currentFirst_;
+            if (offset < currentCount_ && current_->owner_ == this && current_->chunk_ == currentChunk_)
+            {
+                return current_->data_[offset];
+            }
+            return load(index)->data_[index - currentFirst_];
+        }
+        void read(std::size_t first, std::size_t count, double *out);
+
+    private:
+        std::string name_;
+        std::size_t size_;
+        ChunkReader reader_;
+        std::shared_ptr<StreamBufferPool> pool_;
+        std::size_t chunkSize_;
+        std::size_t furthestChunk_ = 0; // in the current pass
+        std::size_t furthestIndex_ = 0;
+
+        // The chunk last read; another stream may since have taken its buffer
+        StreamBufferPool::Buffer *current_ = nullptr;
+        std::size_t currentChunk_ = 0;
+        std::size_t currentFirst_ = 0;
+        std::size_t currentCount_ = 0;
+
+        // Makes the chunk holding `index` current
+        StreamBufferPool::Buffer *load(std::size_t index);
+    };
+
+} // namespace Shattang::MyLisp
@@ -0,0 +1,81 @@
+#include "TestSupport.h"
+
+#include <Shattang/MyLisp/CppTranspiler.h>
+
+#include <aot_sample.h>
+
+#include <fstream>
+#include <iostream>
+#include <limits>
+
+using namespace Shattang::MyLisp;
+using namespace Shattang::MyLisp::Testing;
+
+namespace
+{
+    std::string readFile(const std::string &path)
+    {
+        std::ifstream in(path);
+        std::ostringstream text;
+        text << in.rdbuf();
+        return text.str();
+    }
+
+    // What run() of a compiled module prints to std::cout
+    template <typename Function>
+    std::string captureOutput(Function function)
+    {
+        std::ostringstream out;
+        std::streambuf *previous = std::cout.rdbuf(out.rdbuf());
+        try
+        {
+            function();
+        }
+        catch (...)
+        {
+            std::cout.rdbuf(previous);
+            throw;
+        }
+        std::cout.rdbuf(previous);
+        return out.str();
+    }
+
+    std::string transpile(const std::string &source)
+    {
+        CheckedScript script(source);
+        CppTranspiler transpiler(script.script(), script.checker_, "module");
+        std::ostringstream header, implementation;
+        transpiler.emitHeader(header);
+        transpiler.emitSource(implementation, "module.h");
+        return header.str() + implementation.str();
+    }
+}
+
+TEST(CompiledModulePrintsWhatTheInterpreterPrints)
+{
+    std::string interpreted = runAllTiers(readFile(MYLISP_AOT_SAMPLE));
+    CHECK_EQUAL(captureOutput(aot_sample::run), interpreted);
+    CHECK_EQUAL(interpreted.substr(0, interpreted.find('\n')), "-9223372036854775808 0 -3 -1");
+}
+
+TEST(CompiledFunctionsAreCallableFromCpp)
+{
+    constexpr long Smallest = std::numeric_limits<long>::min();
+    CHECK_EQUAL(aot_sample::quotient(Smallest, -1), Smallest);
+    CHECK_EQUAL(aot_sample::remainder(Smallest, -1), 0L);
+    CHECK_EQUAL(aot_sample::quotient(9, 2), 4L);
+    CHECK_THROWS(aot_sample::quotient(1, 0), "Runtime error: integer division by zero");
+    CHECK_THROWS(aot_sample::remainder(1, 0), "Runtime error: integer modulo by zero");
+    CHECK_EQUAL(aot_sample::mean(Aot::DoubleVector{1.0, 2.0, 6.0}), 3.0);
+    CHECK_EQUAL(aot_sample::label(7), "n=7");
+}
+
+TEST(UnsupportedScriptsAreCompileErrors)
+{
+    std::string generated = transpile("(define twice ((x Int)) Int (multiply x 2)) (print (twice 4))");
+    CHECK_CONTAINS(generated, "long twice(long x)");
+    CHECK_CONTAINS(generated, "void run()");
+
+    CHECK_THROWS(transpile("(define my-f ((x Int)) Int x) (define my_f ((x Int)) Int x)"), "Compile error:");
+    CHECK_THROWS(transpile("(define f ((x Int)) Int x) (let (f Int) 2)"), "has the same name as a function");
+}
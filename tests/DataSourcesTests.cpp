@@ -0,0 +1,174 @@
+#include "TestSupport.h"
+
+#include <Shattang/MyLisp/DataSources.h>
+#include <Shattang/MyLisp/Lexer.h>
+#include <Shattang/MyLisp/Parser.h>
+#include <Shattang/MyLisp/VectorStream.h>
+
+#include <fstream>
+#include <mutex>
+#include <set>
+
+using namespace Shattang::MyLisp;
+using namespace Shattang::MyLisp::Testing;
+
+namespace
+{
+    DoubleVector ramp(std::size_t size)
+    {
+        DoubleVector values(size);
+        for (std::size_t i = 0; i < size; ++i)
+        {
+            values[i] = static_cast<double>(i) * 0.5;
+        }
+        return values;
+    }
+
+    std::string writeDoubles(const std::string &file, const DoubleVector &values)
+    {
+        std::string path = scratchPath(file);
+        std::ofstream out(path, std::ios::binary);
+        out.write(reinterpret_cast<const char *>(values.data()), static_cast<std::streamsize>(values.size() * sizeof(double)));
+        return path;
+    }
+
+    std::string writeText(const std::string &file, const std::string &text)
+    {
+        std::string path = scratchPath(file);
+        std::ofstream(path) << text;
+        return path;
+    }
+}
+
+TEST(BinaryFilesAreMappedWithoutCopying)
+{
+    DoubleVector values = ramp(10000);
+    std::string path = writeDoubles("ramp.f64", values);
+    DoubleVector mapped = mapDoubleFile(path);
+    CHECK(mapped.isView());
+    CHECK(mapped == values);
+
+    // Writing to a view gives it storage of its own
+    DoubleVector copy = mapped;
+    copy.push(1.0);
+    CHECK(!copy.isView());
+    CHECK_EQUAL(copy.size(), 10001u);
+    CHECK(mapped == values);
+
+    CHECK_THROWS(mapDoubleFile(scratchPath("missing.f64")), "missing.f64");
+    CHECK_EQUAL(mapDoubleFile(writeDoubles("empty.f64", DoubleVector())).size(), 0u);
+}
+
+TEST(ColumnarFilesHoldNamedColumns)
+{
+    DoubleVector price = ramp(1000);
+    DoubleVector volume = ramp(3);
+    std::string path = scratchPath("table.mlc");
+    writeColumnFile(path, {{"price", &price}, {"volume", &volume}});
+    CHECK(columnNames(path) == (std::vector<std::string>{"price", "volume"}));
+    CHECK(mapColumn(path, "price") == price);
+    CHECK(mapColumn(path, "volume") == volume);
+    CHECK_THROWS(mapColumn(path, "missing"), "missing");
+    CHECK_THROWS(columnNames(writeText("bad.mlc", "not a column file")), "bad.mlc");
+}
+
+TEST(TextFilesAreParsedWithAHeader)
+{
+    CHECK(parseNumberText("1 2\t3\n4,5") == (DoubleVector{1, 2, 3, 4, 5}));
+    TextOptions secondField;
+    secondField.column_ = 1;
+    CHECK(parseNumberText("day,price\n1,10.5\n2,11\n3,-2e1\n", secondField) == (DoubleVector{10.5, 11, -20}));
+    CHECK_THROWS(parseNumberText("1,2\n3,x\n"), "");
+
+    DataSources sources;
+    sources.add("prices", writeText("prices.csv", "day,price\n1,10.5\n2,11\n") + "#1");
+    sources.add("ramp", writeDoubles("named.f64", ramp(4)));
+    CHECK(sources.open("prices") == (DoubleVector{10.5, 11}));
+    CHECK(sources.open("ramp") == ramp(4));
+    // Unknown names are specs themselves
+    CHECK(sources.open(scratchPath("named.f64")) == ramp(4));
+}
+
+TEST(ScriptsImportDataSources)
+{
+    DataSources sources;
+    sources.add("values", writeDoubles("values.f64", ramp(101)));
+    ImportHandler imports = [&sources](const std::string &name)
+    { return sources.open(name); };
+    CHECK_EQUAL(runAllTiers(R"(
+        (let (v DoubleVector) (import-double-vector "values"))
+        (let (total Float) 0.0)
+        (for i 0 100 1 (set total (add total (vector-ref v i))))
+        (print (length v) total (vector-sum v))
+    )",
+                            imports),
+                "101 2525 2525\n");
+    CHECK_CONTAINS(run(R"((print (length (import-double-vector "no-such-source.f64"))))", TierOptions(), imports),
+                   "ERR");
+}
+
+TEST(ReachableImportsArePrefetched)
+{
+    std::mutex mutex;
+    std::set<std::string> loaded;
+    std::ostringstream out;
+    Interpreter interpreter(out);
+    interpreter.setImportHandler([&](const std::string &name)
+                                 {
+                                     std::lock_guard<std::mutex> lock(mutex);
+                                     loaded.insert(name);
+                                     return ramp(4); });
+    Lexer lexer(R"(
+        (define unused () Float (vector-sum (import-double-vector "unused")))
+        (define used () Float (vector-sum (import-double-vector "used")))
+        (let (a DoubleVector) (import-double-vector "a"))
+        (print (vector-sum a) (used))
+    )");
+    Parser parser(lexer);
+    std::unique_ptr<ASTNode> script = parser.parse();
+    interpreter.run(static_cast<const ScriptNode &>(*script));
+    CHECK_EQUAL(out.str(), "3 3\n");
+    CHECK(loaded == (std::set<std::string>{"a", "used"}));
+
+    // A failed prefetch fails the script where the data is used
+    std::string output = run(R"(
+        (print "before")
+        (print (vector-sum (import-double-vector "broken")))
+    )",
+                             TierOptions(), [](const std::string &name) -> DoubleVector
+                             { throw std::runtime_error("Runtime error: cannot open " + name); });
+    CHECK_CONTAINS(output, "ERR Runtime error: cannot open broken");
+}
+
+TEST(LargeInputsStreamThroughABoundedPool)
+{
+    DoubleVector values = ramp(50000);
+    std::string path = writeDoubles("stream.f64", values);
+    auto pool = std::make_shared<StreamBufferPool>(4 * 1024 * sizeof(double), 1024);
+    std::shared_ptr<VectorStream> stream = streamDoubleFile(path, pool);
+    CHECK_EQUAL(stream->size(), 50000u);
+    for (std::size_t i : {0u, 1023u, 1024u, 49999u, 7u})
+    {
+        CHECK_EQUAL(stream->at(i), values[i]);
+    }
+    double chunk[10];
+    stream->read(30000, 10, chunk);
+    CHECK_EQUAL(chunk[9], values[30009]);
+    CHECK(pool->bufferCount() <= 4);
+
+    std::ostringstream out;
+    Interpreter interpreter(out);
+    DataSources sources;
+    sources.add("big", path);
+    interpreter.setStreamHandler([&](const std::string &name)
+                                 { return sources.openStream(name, pool); });
+    Lexer lexer(R"(
+        (let (v DoubleVector) (import-double-vector "big"))
+        (print (vector-sum v) (vector-max (vector-scale v 2.0)) (length v))
+    )");
+    Parser parser(lexer);
+    std::unique_ptr<ASTNode> script = parser.parse();
+    interpreter.run(static_cast<const ScriptNode &>(*script));
+    CHECK_EQUAL(out.str(), "6.24988e+08 49999 50000\n");
+    CHECK(pool->bufferCount() <= 4);
+}
@@ -0,0 +1,96 @@
+#include "TestSupport.h"
+
+#include <Shattang/MyLisp/DoubleMatrix.h>
+#include <Shattang/MyLisp/VectorKernels.h>
+
+#include <cmath>
+
+using namespace Shattang::MyLisp;
+using namespace Shattang::MyLisp::Testing;
+
+namespace
+{
+    DoubleMatrix sample(std::size_t rows, std::size_t columns, double seed)
+    {
+        DoubleVector elements(rows * columns);
+        for (std::size_t i = 0; i < elements.size(); ++i)
+        {
+            elements[i] = std::cos(static_cast<double>(i) * 0.37 + seed);
+        }
+        return DoubleMatrix(rows, columns, std::move(elements));
+    }
+
+    DoubleMatrix naiveMultiply(const DoubleMatrix &lhs, const DoubleMatrix &rhs)
+    {
+        DoubleVector elements(lhs.rows() * rhs.columns());
+        for (std::size_t i = 0; i < lhs.rows(); ++i)
+            for (std::size_t j = 0; j < rhs.columns(); ++j)
+            {
+                double sum = 0.0;
+                for (std::size_t k = 0; k < lhs.columns(); ++k)
+                    sum += lhs(i, k) * rhs(k, j);
+                elements[i * rhs.columns() + j] = sum;
+            }
+        return DoubleMatrix(lhs.rows(), rhs.columns(), std::move(elements));
+    }
+
+    bool near(const DoubleMatrix &actual, const DoubleMatrix &expected)
+    {
+        if (actual.rows() != expected.rows() || actual.columns() != expected.columns())
+            return false;
+        for (std::size_t i = 0; i < actual.elements().size(); ++i)
+            if (std::fabs(actual.elements()[i] - expected.elements()[i]) > 1e-9)
+                return false;
+        return true;
+    }
+}
+
+TEST(BlockedMultiplyMatchesTheNaiveProduct)
+{
+    // Shapes that are and are not multiples of the register tile and the cache blocks
+    const std::size_t shapes[][3] = {{1, 1, 1}, {4, 8, 8}, {5, 3, 9}, {17, 33, 65}, {130, 70, 260}};
+    for (const auto &shape : shapes)
+    {
+        DoubleMatrix lhs = sample(shape[0], shape[1], 0.5);
+        DoubleMatrix rhs = sample(shape[1], shape[2], 1.5);
+        CHECK(near(matrixMultiply(lhs, rhs), naiveMultiply(lhs, rhs)));
+    }
+    CHECK_THROWS(matrixMultiply(sample(2, 3, 0.0), sample(2, 3, 0.0)), "Runtime error:");
+}
+
+TEST(TileKernelAccumulatesIntoItsOutput)
+{
+    DoubleVector lhs(Kernels::TileRows * 3, 1.0);     // packed: TileRows values per step
+    DoubleVector rhs(Kernels::TileColumns * 3, 2.0);  // packed: TileColumns values per step
+    DoubleVector out(Kernels::TileRows * Kernels::TileColumns, 1.0);
+    Kernels::multiplyTile(lhs.data(), rhs.data(), 3, out.data(), Kernels::TileColumns);
+    for (double value : out)
+    {
+        CHECK_EQUAL(value, 7.0);
+    }
+}
+
+TEST(TransposeAndMatrixVectorProducts)
+{
+    DoubleMatrix matrix = sample(37, 11, 0.25);
+    DoubleMatrix transposed = matrixTranspose(matrix);
+    CHECK_EQUAL(transposed.rows(), 11u);
+    CHECK_EQUAL(transposed(3, 30), matrix(30, 3));
+    CHECK(matrixTranspose(transposed) == matrix);
+
+    DoubleVector vector(11, 2.0);
+    DoubleVector product = matrixVectorMultiply(matrix, vector);
+    DoubleMatrix expected = naiveMultiply(matrix, DoubleMatrix(11, 1, DoubleVector(11, 2.0)));
+    CHECK(near(DoubleMatrix(37, 1, product), expected));
+    CHECK_THROWS(matrixVectorMultiply(matrix, DoubleVector(3)), "Runtime error:");
+    CHECK_THROWS(makeDoubleMatrix(2, 2, DoubleVector(3)), "Runtime error:");
+    CHECK_THROWS(matrix.at(37, 0), "Runtime error:");
+
+    CHECK_EQUAL(runAllTiers(R"(
+        (let (m DoubleMatrix) (make-double-matrix 2 3 (collect (range 1 6))))
+        (let (t DoubleMatrix) (matrix-transpose m))
+        (print (matrix-rows t) (matrix-columns t) (matrix-ref t 2 1) (matrix-elements (matrix-multiply m t)))
+        (print (matrix-vector-multiply m (collect (range 1 3))))
+    )"),
+                "3 2 6 [14 32 32 77]\n[14 32]\n");
+}
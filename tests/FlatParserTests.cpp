@@ -0,0 +1,106 @@
+#include "TestSupport.h"
+
+#include <Shattang/MyLisp/ASTNode.h>
+#include <Shattang/MyLisp/FlatParser.h>
+#include <Shattang/MyLisp/Lexer.h>
+#include <Shattang/MyLisp/Parser.h>
+
+#include <string_view>
+
+using namespace Shattang::MyLisp;
+using namespace Shattang::MyLisp::Testing;
+
+namespace
+{
+    // Parsed while this file compiles; a syntax error here would fail the build
+    constexpr std::string_view EmbeddedSource = R"(
+        (define square ((x Float)) Float (multiply x x))
+        (print (square 1.5) -42 true "text")
+    )";
+    constexpr auto EmbeddedScript = ParseStatic<FlatNodeCount(EmbeddedSource)>(EmbeddedSource);
+
+    static_assert(EmbeddedScript.ok());
+    static_assert(EmbeddedScript.nodes()[0].type_ == NodeType::SCRIPT);
+    static_assert(EmbeddedScript.nodes()[0].childCount_ == 2);
+    static_assert(EmbeddedScript.nodes()[1].type_ == NodeType::FUNCTION_DECLARATION);
+    static_assert(EmbeddedScript.nodes()[1].text_ == "square");
+    static_assert(EmbeddedScript.nodes()[1].parameterCount_ == 1);
+
+    constexpr bool Parses(std::string_view source)
+    {
+        FlatParser parser(source);
+        return parser.parse();
+    }
+    static_assert(Parses("(let (x Int) 1)"));
+    static_assert(!Parses("(let (x Int) 1"));
+
+    std::string parseError(const std::string &source)
+    {
+        try
+        {
+            Lexer lexer(source);
+            Parser parser(lexer);
+            parser.parse();
+        }
+        catch (const std::exception &error)
+        {
+            return error.what();
+        }
+        return "";
+    }
+
+    std::string nested(int depth)
+    {
+        std::string source = "(print ";
+        for (int i = 0; i < depth; ++i)
+        {
+            source += "(add 1 ";
+        }
+        return source + "0" + std::string(depth, ')') + ")";
+    }
+}
+
+TEST(EmbeddedScriptBuildsTheSameAstAsParser)
+{
+    std::unique_ptr<ASTNode> ast = BuildAST(EmbeddedScript.nodes());
+    std::ostringstream out;
+    Interpreter embedded(out);
+    embedded.run(static_cast<const ScriptNode &>(*ast));
+    CHECK_EQUAL(out.str(), run(std::string(EmbeddedSource)));
+    CHECK_EQUAL(out.str(), "2.25 -42 true text\n");
+}
+
+TEST(SyntaxErrorsArePositioned)
+{
+    std::string error = parseError("(let (x Int) 1)\n(print (add 1 2)");
+    CHECK_CONTAINS(error, "Parse error:");
+    CHECK_CONTAINS(error, "line 2");
+}
+
+TEST(IntegerLiteralsCoverTheIntRange)
+{
+    CHECK_EQUAL(run("(print -9223372036854775808 9223372036854775807)"), "-9223372036854775808 9223372036854775807\n");
+    CHECK_CONTAINS(parseError("(print 9223372036854775808)"), "Parse error:");
+}
+
+TEST(OutOfRangeFloatLiteralsAreParseErrors)
+{
+    CHECK_EQUAL(run("(print 1e308 +2.5 1e-5)"), "1e+308 2.5 1e-05\n");
+
+    std::string error = parseError("(print 1.0)\n(print 1e999)");
+    CHECK_CONTAINS(error, "Parse error: Floating point literal out of range");
+    CHECK_CONTAINS(error, "line 2");
+
+    double value = 0.0;
+    CHECK_EQUAL(ParseFloatLiteral("1e999", value), std::string_view("Floating point literal out of range"));
+    CHECK(ParseFloatLiteral("+0.5", value).empty());
+    CHECK_EQUAL(value, 0.5);
+}
+
+TEST(DeepNestingIsAParseErrorNotACrash)
+{
+    CHECK_EQUAL(run(nested(FlatParser::MaxNestingDepth - 10)), std::to_string(FlatParser::MaxNestingDepth - 10) + "\n");
+
+    std::string error = parseError(nested(200000));
+    CHECK_CONTAINS(error, "Parse error: Expressions are nested too deeply");
+}
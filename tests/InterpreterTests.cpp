@@ -0,0 +1,114 @@
+#include "TestSupport.h"
+
+#include <Shattang/MyLisp/Lexer.h>
+#include <Shattang/MyLisp/Parser.h>
+#include <Shattang/MyLisp/StatementGraph.h>
+
+using namespace Shattang::MyLisp;
+using namespace Shattang::MyLisp::Testing;
+
+namespace
+{
+    StatementGraph graphOf(const std::string &source, std::unique_ptr<ASTNode> &ast)
+    {
+        Lexer lexer(source);
+        Parser parser(lexer);
+        ast = parser.parse();
+        return buildStatementGraph(static_cast<const ScriptNode &>(*ast));
+    }
+}
+
+TEST(HotFunctionsAndLoopsAreCompiled)
+{
+    const std::string source = R"(
+        (define describe ((n Int)) String
+            (if (equal (modulo n 2) 0) "even" "odd"))
+        (let (total Int) 0)
+        (let (i Int) 0)
+        (while (less-than i 100)
+            (set total (add total (string-length (describe i))))
+            (set i (add i 1)))
+        (print total (describe 3))
+    )";
+    CHECK_EQUAL(runAllTiers(source), "350 odd\n");
+
+    TierStatistics statistics;
+    run(source, walkerOnly(), nullptr, &statistics);
+    CHECK_EQUAL(statistics.compiledFunctions_, 0);
+    CHECK_EQUAL(statistics.compiledLoops_, 0);
+
+    run(source, eagerTier1(), nullptr, &statistics);
+    CHECK(statistics.compiledFunctions_ > 0);
+    CHECK(statistics.compiledLoops_ > 0);
+    CHECK_EQUAL(statistics.failedCompilations_, 0);
+}
+
+TEST(SmallestIntDividedByMinusOneWraps)
+{
+    CHECK_EQUAL(runAllTiers(R"(
+        (let (smallest Int) (subtract -9223372036854775807 1))
+        (for i 1 3 1
+            (print (divide smallest -1) (modulo smallest -1) (divide 9 -1) (modulo -9 4)))
+    )"),
+                "-9223372036854775808 0 -9 -1\n-9223372036854775808 0 -9 -1\n-9223372036854775808 0 -9 -1\n");
+}
+
+TEST(ErrorsComeFromTheLeftmostOperandInEveryTier)
+{
+    std::string output = runAllTiers(R"(
+        (define f ((a Int) (b Int)) Int (add (divide a b) (modulo a b)))
+        (print (f 7 2))
+        (print (f 7 0))
+    )");
+    CHECK_CONTAINS(output, "4\nERR Runtime error:");
+    CHECK_CONTAINS(output, "integer division by zero");
+}
+
+TEST(RuntimeErrorsStopTheScript)
+{
+    CHECK_CONTAINS(runAllTiers("(print (vector-ref (collect (range 1 3)) 5))"), "ERR Runtime error:");
+    CHECK_CONTAINS(run("(print (add 1 \"a\"))"), "ERR Type error:");
+}
+
+TEST(IndependentStatementsDoNotWaitForEachOther)
+{
+    std::unique_ptr<ASTNode> ast;
+    StatementGraph graph = graphOf(R"(
+        (let (a Int) 1)
+        (let (b Int) 2)
+        (let (c Int) (add a 1))
+        (print a b c)
+    )",
+                                   ast);
+    CHECK_EQUAL(graph.dependencies_.size(), 4u);
+    CHECK(graph.dependencies_[1].empty());
+    CHECK(graph.dependencies_[2] == std::vector<std::size_t>{0});
+    CHECK_EQUAL(graph.dependencies_[3].size(), 3u);
+
+    CHECK_EQUAL(runAllTiers(R"(
+        (define sumTo ((n Int)) Int
+            (let (total Int) 0)
+            (for i 1 n 1 (set total (add total i)))
+            total)
+        (let (a Int) (sumTo 1000))
+        (let (b Int) (sumTo 2000))
+        (let (c Int) (sumTo 3000))
+        (print a b c)
+    )"),
+                "500500 2001000 4501500\n");
+}
+
+TEST(VectorArgumentsAreCopiedOnWrite)
+{
+    CHECK_EQUAL(runAllTiers(R"(
+        (define extend ((v DoubleVector)) DoubleVector
+            (vector-push v 9.0)
+            v)
+        (let (original DoubleVector) (collect (range 1 3)))
+        (let (extended DoubleVector) (extend original))
+        (let (alias DoubleVector) original)
+        (vector-push alias 4.0)
+        (print original extended alias)
+    )"),
+                "[1 2 3] [1 2 3 9] [1 2 3 4]\n");
+}
@@ -0,0 +1,97 @@
+#include "TestSupport.h"
+
+#include <Shattang/MyLisp/Environment.h>
+#include <Shattang/MyLisp/Memory.h>
+
+#include <cstdint>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+using namespace Shattang::MyLisp;
+using namespace Shattang::MyLisp::Testing;
+
+namespace
+{
+    bool aligned(const void *pointer, std::size_t alignment)
+    {
+        return reinterpret_cast<std::uintptr_t>(pointer) % alignment == 0;
+    }
+}
+
+TEST(BlockPoolAlignsAndReusesBlocks)
+{
+    BlockPool &pool = runtimePool();
+    for (std::size_t bytes : {1u, 16u, 24u, 64u, 100u, 4096u, 65536u, 65537u, 1u << 20})
+    {
+        void *block = pool.allocate(bytes, alignof(std::max_align_t));
+        CHECK(aligned(block, alignof(std::max_align_t)));
+        if (bytes >= BlockPool::MaxAlignment && bytes <= BlockPool::LargestBlock)
+        {
+            CHECK(aligned(block, BlockPool::MaxAlignment));
+        }
+        std::memset(block, 0xAB, bytes);
+        pool.deallocate(block, bytes, alignof(std::max_align_t));
+        // A freed block is the next one handed out for its size class on this thread
+        void *again = pool.allocate(bytes, alignof(std::max_align_t));
+        if (bytes <= BlockPool::LargestBlock)
+        {
+            CHECK_EQUAL(again, block);
+        }
+        pool.deallocate(again, bytes, alignof(std::max_align_t));
+    }
+
+    // Blocks may be freed on another thread than the one that took them
+    std::vector<void *> blocks;
+    for (int i = 0; i < 10000; ++i)
+    {
+        blocks.push_back(pool.allocate(48, 16));
+    }
+    std::thread([&]()
+                {
+                    for (void *block : blocks)
+                    {
+                        pool.deallocate(block, 48, 16);
+                    } })
+        .join();
+}
+
+TEST(EnvironmentPointersSurviveGrowth)
+{
+    Environment globals;
+    Value *first = &globals.define("first", Value(1L));
+    for (int i = 0; i < 5000; ++i)
+    {
+        globals.define("v" + std::to_string(i), Value(static_cast<long>(i)));
+    }
+    CHECK_EQUAL(first, globals.find("first"));
+    CHECK_EQUAL(first->asInt(), 1L);
+
+    Environment local(&globals);
+    local.define("first", Value(2L));
+    CHECK_EQUAL(local.get("first").asInt(), 2L);
+    CHECK_EQUAL(local.get("v4999").asInt(), 4999L);
+    CHECK(local.findLocal("v1") == nullptr);
+    CHECK(local.find("missing") == nullptr);
+    CHECK_THROWS(local.get("missing"), "missing");
+
+    // A redefinition overwrites the value in place
+    Value *redefined = &globals.define("first", Value(3L));
+    CHECK_EQUAL(redefined, first);
+    CHECK_EQUAL(first->asInt(), 3L);
+}
+
+TEST(ScopesReleaseTheirTablesAfterEachCall)
+{
+    CHECK_EQUAL(runAllTiers(R"(
+        (define depth ((n Int)) Int
+            (let (a Int) n)
+            (let (b Int) (add a 1))
+            (let (label String) (to-string b))
+            (if (less-than n 1) (string-length label) (add 1 (depth (subtract n 1)))))
+        (let (total Int) 0)
+        (for i 1 200 1 (set total (add total (depth 100))))
+        (print total)
+    )"),
+                "20200\n");
+}
@@ -0,0 +1,87 @@
+#include "TestSupport.h"
+
+#include <Shattang/MyLisp/NativeCompiler.h>
+
+#include <atomic>
+
+using namespace Shattang::MyLisp;
+using namespace Shattang::MyLisp::Testing;
+
+TEST(NumericFunctionsGetMachineCode)
+{
+    const std::string source = R"(
+        (define fib ((n Int)) Int
+            (if (less-than n 2) n (add (fib (subtract n 1)) (fib (subtract n 2)))))
+        (define harmonic ((n Int)) Float
+            (let (total Float) 0.0)
+            (for i 1 n 1 (set total (add total (divide 1.0 i))))
+            total)
+        (print (fib 20) (harmonic 10))
+    )";
+    CHECK_EQUAL(runAllTiers(source), "6765 2.92897\n");
+
+    TierStatistics statistics;
+    run(source, eagerNative(), nullptr, &statistics);
+    CHECK_EQUAL(statistics.nativeFunctions_ > 0, nativeCodeSupported());
+    CHECK_EQUAL(statistics.deoptimizations_, 0);
+}
+
+TEST(TypeCheckerMarksNumericAndPureFunctions)
+{
+    CheckedScript script(R"(
+        (let (scale Float) 2.0)
+        (define square ((x Float)) Float (multiply x x))
+        (define loud ((x Float)) Float (print x) x)
+        (define scaled ((x Float)) Float (multiply x scale))
+        (define size ((v DoubleVector)) Int (length v))
+    )");
+    CHECK(script.checker_.function("square")->isNumeric_);
+    CHECK(script.checker_.function("square")->isPure_);
+    CHECK(!script.checker_.function("loud")->isPure_);
+    CHECK(!script.checker_.function("size")->isNumeric_);
+
+    if (nativeCodeSupported())
+    {
+        std::unique_ptr<NativeFunction> square = compileNativeFunction(script.function("square"), script.checker_);
+        std::atomic<bool> cancelled{false};
+        NativeContext context;
+        context.cancelled_ = &cancelled;
+        context.depthBudget_ = 100;
+        Value result;
+        CHECK(square->invoke(context, {Value(1.5)}, result));
+        CHECK_EQUAL(result.asFloat(), 2.25);
+        // A guard failure deoptimizes without running anything
+        CHECK(!square->invoke(context, {Value(std::string("x"))}, result));
+
+        // Globals stay in tier 1
+        CHECK_THROWS(compileNativeFunction(script.function("scaled"), script.checker_), "");
+    }
+}
+
+TEST(IntDivisionByMinusOneDeoptimizes)
+{
+    const std::string source = R"(
+        (define quotient ((a Int) (b Int)) Int (divide a b))
+        (define remainder ((a Int) (b Int)) Int (modulo a b))
+        (let (smallest Int) (subtract -9223372036854775807 1))
+        (print (quotient smallest -1) (remainder smallest -1) (quotient 7 -1) (remainder 7 -1) (quotient -7 2))
+    )";
+    CHECK_EQUAL(runAllTiers(source), "-9223372036854775808 0 -7 0 -3\n");
+
+    TierStatistics statistics;
+    run(source, eagerNative(), nullptr, &statistics);
+    if (nativeCodeSupported())
+    {
+        CHECK(statistics.deoptimizations_ > 0);
+    }
+}
+
+TEST(IntDivisionByZeroFailsInEveryTier)
+{
+    std::string output = runAllTiers(R"(
+        (define quotient ((a Int) (b Int)) Int (divide a b))
+        (print (quotient 1 1))
+        (print (quotient 1 0))
+    )");
+    CHECK_CONTAINS(output, "1\nERR Runtime error:");
+}
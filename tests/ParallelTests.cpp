@@ -0,0 +1,107 @@
+#include "TestSupport.h"
+
+#include <Shattang/MyLisp/LoopParallelizer.h>
+#include <Shattang/MyLisp/ThreadPool.h>
+
+#include <atomic>
+#include <vector>
+
+using namespace Shattang::MyLisp;
+using namespace Shattang::MyLisp::Testing;
+
+namespace
+{
+    // Splits every loop that qualifies, however short
+    TierOptions splitEveryLoop(TierOptions options)
+    {
+        options.parallelThreshold_ = 1;
+        return options;
+    }
+}
+
+TEST(ThreadPoolRunsEveryTask)
+{
+    std::vector<std::atomic<int>> visits(1000);
+    computePool().parallelFor(visits.size(), [&](std::size_t i)
+                              { visits[i]++; });
+    for (const std::atomic<int> &count : visits)
+    {
+        CHECK_EQUAL(count.load(), 1);
+    }
+
+    ThreadPool pool(3);
+    CHECK_EQUAL(pool.size(), 3u);
+    CHECK_EQUAL(pool.submit([]()
+                            { return 42; })
+                    .get(),
+                42);
+    std::future<int> failed = pool.submit([]() -> int
+                                          { throw std::runtime_error("task failed"); });
+    CHECK_THROWS(failed.get(), "task failed");
+    CHECK(partitionSize(1000000) > 0);
+}
+
+TEST(ReductionLoopsArePlannedForParallelRuns)
+{
+    CheckedScript script(R"(
+        (let (v DoubleVector) (collect (range 1 100)))
+        (let (total Float) 0.0)
+        (let (count Int) 0)
+        (let (evens DoubleVector) (make-double-vector))
+        (for i 0 99 1
+            (set total (add total (vector-ref v i)))
+            (if (equal (modulo i 2) 0) (vector-push evens (vector-ref v i)) (set count (add count 1))))
+        (for i 1 99 1 (set total (add total (vector-ref v (subtract i 1)))) (vector-push v 1.0))
+    )");
+    std::unique_ptr<ParallelLoopPlan> plan =
+        planParallelLoop(static_cast<const ForIterationNode &>(script.statement(4)), script.checker_);
+    CHECK(plan != nullptr);
+    CHECK_EQUAL(plan->reductions_.size(), 2u);
+    CHECK(plan->outputs_ == std::vector<std::string>{"evens"});
+    // The second loop appends to a vector it reads
+    CHECK(planParallelLoop(static_cast<const ForIterationNode &>(script.statement(5)), script.checker_) == nullptr);
+    CHECK_EQUAL(iterationCount(0, 99, 1), 100u);
+    CHECK_EQUAL(iterationCount(10, 0, -3), 4u);
+}
+
+TEST(ParallelLoopsMatchSerialOnes)
+{
+    const std::string source = R"(
+        (let (v DoubleVector) (collect (range 1 100000)))
+        (let (total Float) 0.0)
+        (let (count Int) 0)
+        (let (smallest Float) 1000000.0)
+        (let (evens DoubleVector) (make-double-vector))
+        (for i 0 99999 1
+            (set total (add total (vector-ref v i)))
+            (set smallest (if (less-than (vector-ref v i) smallest) (vector-ref v i) smallest))
+            (if (equal (modulo i 2) 0) (vector-push evens (vector-ref v i)) (set count (add count 1))))
+        (print total count smallest (length evens) (vector-ref evens 0) (vector-ref evens 49999))
+    )";
+    const std::string expected = "5.00005e+09 50000 1 50000 1 99999\n";
+    CHECK_EQUAL(run(source, walkerOnly()), expected);
+    CHECK_EQUAL(run(source, splitEveryLoop(eagerTier1())), expected);
+    CHECK_EQUAL(run(source, splitEveryLoop(TierOptions())), expected);
+}
+
+TEST(ParallelFormsCallPureFunctions)
+{
+    const std::string source = R"(
+        (define square ((x Float)) Float (multiply x x))
+        (define plus ((a Float) (b Float)) Float (add a b))
+        (let (v DoubleVector) (collect (range 1 1000)))
+        (let (squares DoubleVector) (pmap square v))
+        (let (total Float) 0.0)
+        (pfor i 0 999 1 (set total (add total (square (vector-ref v i)))))
+        (print (vector-ref squares 999) (subtract (preduce plus 0.0 squares) 333833000.0)
+               (subtract total 333833000.0) (preduce plus 0.0 (make-double-vector)))
+    )";
+    CHECK_EQUAL(runAllTiers(source), "1e+06 500 500 0\n");
+    CHECK_EQUAL(run(source, splitEveryLoop(eagerTier1())), run(source, walkerOnly()));
+
+    std::string impure = run(R"(
+        (define loud ((x Float)) Float (print x) x)
+        (print (pmap loud (collect (range 1 3))))
+    )");
+    CHECK_CONTAINS(impure, "ERR Type error:");
+}
@@ -0,0 +1,87 @@
+#include "TestSupport.h"
+
+#include <Shattang/MyLisp/Environment.h>
+#include <Shattang/MyLisp/Program.h>
+
+#include <thread>
+#include <vector>
+
+using namespace Shattang::MyLisp;
+using namespace Shattang::MyLisp::Testing;
+
+TEST(OneProgramRunsOnManyThreadsAtOnce)
+{
+    std::shared_ptr<const Program> program = compile(R"(
+        (define sumTo ((n Int)) Int
+            (let (total Int) 0)
+            (for i 1 n 1 (set total (add total i)))
+            total)
+        (let (result Int) (add (sumTo limit) offset))
+        (let (scaled DoubleVector) (vector-scale values factor))
+        (print result)
+    )",
+                                                     {{"limit", ValueType::INT},
+                                                      {"offset", ValueType::INT},
+                                                      {"factor", ValueType::FLOAT},
+                                                      {"values", ValueType::DOUBLE_VECTOR}});
+    CHECK_EQUAL(program->inputs().size(), 4u);
+
+    constexpr int Runs = 16;
+    std::vector<std::string> outputs(Runs);
+    std::vector<long> results(Runs);
+    std::vector<double> lastScaled(Runs);
+    std::vector<std::thread> threads;
+    for (int run = 0; run < Runs; ++run)
+    {
+        threads.emplace_back([&, run]()
+                             {
+                                 Environment globals;
+                                 globals.define("limit", Value(static_cast<long>(1000 * (run + 1))));
+                                 globals.define("offset", Value(static_cast<long>(run)));
+                                 globals.define("factor", Value(2L)); // an Int for a Float input is widened
+                                 globals.define("values", Value(DoubleVector{1.0, 2.0, static_cast<double>(run)}));
+                                 std::ostringstream out;
+                                 TierOptions options;
+                                 options.callThreshold_ = 1;
+                                 options.backEdgeThreshold_ = 10;
+                                 program->run(globals, out, options);
+                                 outputs[run] = out.str();
+                                 results[run] = globals.get("result").asInt();
+                                 lastScaled[run] = globals.get("scaled").asVector()[2]; });
+    }
+    for (std::thread &thread : threads)
+    {
+        thread.join();
+    }
+    for (int run = 0; run < Runs; ++run)
+    {
+        long n = 1000L * (run + 1);
+        long expected = n * (n + 1) / 2 + run;
+        CHECK_EQUAL(results[run], expected);
+        CHECK_EQUAL(outputs[run], std::to_string(expected) + "\n");
+        CHECK_EQUAL(lastScaled[run], 2.0 * run);
+    }
+}
+
+TEST(CompileAndRunErrorsAreReported)
+{
+    CHECK_THROWS(compile("(print (add 1 2)"), "Parse error:");
+    CHECK_THROWS(compile("(print (add 1 \"a\"))"), "Type error:");
+    CHECK_THROWS(compile("(print missing)"), "missing");
+
+    std::shared_ptr<const Program> program = compile("(print (add count 1))", {{"count", ValueType::INT}});
+    Environment empty;
+    std::ostringstream out;
+    CHECK_THROWS(program->run(empty, out), "count");
+
+    Environment wrongType;
+    wrongType.define("count", Value("three"));
+    CHECK_THROWS(program->run(wrongType, out), "count");
+
+    Environment divisor;
+    divisor.define("count", Value(-1L));
+    std::shared_ptr<const Program> divide = compile("(print (divide 5 count) (divide (subtract -9223372036854775807 1) count))",
+                                                    {{"count", ValueType::INT}});
+    divide->run(divisor, out);
+    CHECK_EQUAL(out.str(), "-5 -9223372036854775808\n");
+}
@@ -0,0 +1,198 @@
+#include "TestSupport.h"
+
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <fstream>
+#include <thread>
+#include <vector>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace Shattang::MyLisp;
+using namespace Shattang::MyLisp::Testing;
+
+namespace
+{
+    std::string writeFile(const std::string &file, const std::string &contents)
+    {
+        std::string path = scratchPath(file);
+        std::ofstream(path, std::ios::binary) << contents;
+        return path;
+    }
+
+    std::string writeDoubles(const std::string &file, const std::vector<double> &values)
+    {
+        return writeFile(file, std::string(reinterpret_cast<const char *>(values.data()), values.size() * sizeof(double)));
+    }
+
+    // Runs MyLispRunner with `arguments` and returns what it wrote to stdout
+    std::string runRunner(const std::string &arguments, int &status)
+    {
+        std::string command = std::string(MYLISP_RUNNER) + " " + arguments + " 2>/dev/null";
+        FILE *pipe = ::popen(command.c_str(), "r");
+        std::string output;
+        char buffer[4096];
+        while (std::size_t count = std::fread(buffer, 1, sizeof(buffer), pipe))
+        {
+            output.append(buffer, count);
+        }
+        status = WEXITSTATUS(::pclose(pipe));
+        return output;
+    }
+
+    std::vector<std::string> lines(const std::string &text)
+    {
+        std::vector<std::string> result;
+        std::istringstream in(text);
+        for (std::string line; std::getline(in, line);)
+        {
+            result.push_back(line);
+        }
+        return result;
+    }
+
+    // A MyLispRunner --serve process for the duration of a test
+    class Server
+    {
+    public:
+        explicit Server(const std::vector<std::string> &arguments) : socketPath_(scratchPath("server.sock"))
+        {
+            std::vector<std::string> all{MYLISP_RUNNER, "--serve=" + socketPath_};
+            all.insert(all.end(), arguments.begin(), arguments.end());
+            pid_ = ::fork();
+            if (pid_ == 0)
+            {
+                std::vector<char *> argv;
+                for (std::string &argument : all)
+                {
+                    argv.push_back(argument.data());
+                }
+                argv.push_back(nullptr);
+                ::execv(argv[0], argv.data());
+                ::_exit(127);
+            }
+        }
+
+        ~Server()
+        {
+            ::kill(pid_, SIGTERM);
+            ::waitpid(pid_, nullptr, 0);
+            ::unlink(socketPath_.c_str());
+        }
+
+        // Sends one request and returns the reply line; retries the connection while the
+        // server is still starting
+        std::string request(const std::string &text) const
+        {
+            sockaddr_un address{};
+            address.sun_family = AF_UNIX;
+            socketPath_.copy(address.sun_path, sizeof(address.sun_path) - 1);
+            int fd = -1;
+            for (int attempt = 0; attempt < 200; ++attempt)
+            {
+                fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+                if (::connect(fd, reinterpret_cast<const sockaddr *>(&address), sizeof(address)) == 0)
+                {
+                    break;
+                }
+                ::close(fd);
+                fd = -1;
+                std::this_thread::sleep_for(std::chrono::milliseconds(25));
+            }
+            if (fd < 0)
+            {
+                throw TestFailure("cannot connect to " + socketPath_);
+            }
+            for (std::size_t sent = 0; sent < text.size();)
+            {
+                ssize_t count = ::send(fd, text.data() + sent, text.size() - sent, MSG_NOSIGNAL);
+                if (count <= 0)
+                {
+                    break;
+                }
+                sent += static_cast<std::size_t>(count);
+            }
+            ::shutdown(fd, SHUT_WR);
+            std::string reply;
+            char buffer[4096];
+            while (ssize_t count = ::recv(fd, buffer, sizeof(buffer), 0))
+            {
+                if (count < 0)
+                {
+                    break;
+                }
+                reply.append(buffer, static_cast<std::size_t>(count));
+            }
+            ::close(fd);
+            return reply;
+        }
+
+    private:
+        std::string socketPath_;
+        pid_t pid_ = -1;
+    };
+}
+
+TEST(BatchRunsTheScriptOncePerManifestLine)
+{
+    std::string script = writeFile("batch.lisp", R"(
+        (let (v DoubleVector) (import-double-vector "data"))
+        (let (total Float) (vector-sum v))
+        (let (q Int) (divide (subtract -9223372036854775807 1) (to-int (subtract 0.0 (vector-ref v 0)))))
+        (print "sum" total)
+    )");
+    std::string manifest = writeFile("manifest.txt", "first data=" + writeDoubles("a.f64", {1, 2, 3}) +
+                                                         "\n; skipped\n\nsecond data=" + writeDoubles("b.f64", {10, 20}) +
+                                                         "\nunbound other=" + scratchPath("a.f64") +
+                                                         "\nmissing data=" + scratchPath("missing.f64") + "\n");
+    int status = 0;
+    std::vector<std::string> results = lines(runRunner("--batch=" + script + " --manifest=" + manifest + " --jobs=2", status));
+    CHECK_EQUAL(status, 1);
+    CHECK_EQUAL(results.size(), 4u);
+    CHECK_EQUAL(results[0], R"({"input":"first","ok":true,"globals":{"q":-9223372036854775808,"total":6},"output":"sum 6\n"})");
+    CHECK_EQUAL(results[1], R"({"input":"second","ok":true,"globals":{"q":922337203685477580,"total":30},"output":"sum 30\n"})");
+    CHECK_CONTAINS(results[2], R"({"input":"unbound","ok":false,"error":"Runtime error: manifest line 'unbound' has no binding for import 'data'"})");
+    CHECK_CONTAINS(results[3], R"({"input":"missing","ok":false,"error":"Runtime error: data source)");
+
+    runRunner("--batch=" + script, status);
+    CHECK_EQUAL(status, 1);
+    runRunner("--batch=" + scratchPath("none.lisp") + " --manifest=" + manifest, status);
+    CHECK_EQUAL(status, 2);
+}
+
+TEST(ServerAnswersRequestsAndSurvivesBadOnes)
+{
+    std::string data = writeDoubles("served.f64", {1, 2, 3});
+    Server server({"--jobs=2", "--timeout=5000", "data=" + data});
+
+    CHECK_EQUAL(server.request("\n(print (vector-sum (import-double-vector \"data\")))"),
+                "{\"ok\":true,\"globals\":{},\"output\":\"6\\n\"}\n");
+    CHECK_EQUAL(server.request("data=" + writeDoubles("other.f64", {10, 20}) +
+                               "\n(print (vector-sum (import-double-vector \"data\")))"),
+                "{\"ok\":true,\"globals\":{},\"output\":\"30\\n\"}\n");
+
+    // The smallest Int divided by -1 traps in hardware unless the runtime handles it
+    CHECK_EQUAL(server.request("\n(let (x Int) (divide (subtract -9223372036854775807 1) -1)) (print x (modulo x -1))"),
+                "{\"ok\":true,\"globals\":{\"x\":-9223372036854775808},\"output\":\"-9223372036854775808 0\\n\"}\n");
+
+    // Names that are not bound are not opened as paths
+    CHECK_EQUAL(server.request("\n(print (vector-sum (import-double-vector \"/etc/passwd\")))"),
+                "{\"ok\":false,\"error\":\"Runtime error: request has no binding for import '/etc/passwd'\"}\n");
+
+    std::string deep = "\n(print ";
+    for (int i = 0; i < 200000; ++i)
+    {
+        deep += "(add 1 ";
+    }
+    deep += "0" + std::string(200000, ')') + ")";
+    CHECK_CONTAINS(server.request(deep), "{\"ok\":false,\"error\":\"Parse error: Expressions are nested too deeply");
+    CHECK_CONTAINS(server.request("\n(print (add 1 2)"), "{\"ok\":false,\"error\":\"Parse error:");
+    CHECK_CONTAINS(server.request("\n(print (divide 1 0))"), "{\"ok\":false,\"error\":\"Runtime error: integer division by zero");
+    CHECK_CONTAINS(server.request("\n(define f ((n Int)) Int (f n)) (print (f 1))"), "{\"ok\":false,\"error\":");
+
+    // Still serving after all of the above
+    CHECK_EQUAL(server.request("\n(print (add 1 2))"), "{\"ok\":true,\"globals\":{},\"output\":\"3\\n\"}\n");
+}
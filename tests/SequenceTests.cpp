@@ -0,0 +1,47 @@
+#include "TestSupport.h"
+
+#include <Shattang/MyLisp/Sequence.h>
+
+using namespace Shattang::MyLisp;
+using namespace Shattang::MyLisp::Testing;
+
+TEST(PipelinesPullElementsLazily)
+{
+    int mapped = 0;
+    auto squares = Sequence::map([&mapped](double x)
+                                 { ++mapped; return x * x; },
+                                 Sequence::range(1, 1000000000, 1));
+    auto odd = Sequence::filter([](double x)
+                                { return static_cast<long>(x) % 2 == 1; },
+                                squares);
+    DoubleVector firstFive = Sequence::take(5, odd)->collect();
+    CHECK(firstFive == (DoubleVector{1, 9, 25, 49, 81}));
+    // Only the blocks needed for five elements were computed, not a billion
+    CHECK(mapped <= static_cast<int>(Sequence::BlockSize));
+
+    auto pairs = Sequence::zip([](double a, double b)
+                               { return a - b; },
+                               Sequence::range(10, 1, -1), Sequence::range(1, 100, 1));
+    CHECK(pairs->collect() == (DoubleVector{9, 7, 5, 3, 1, -1, -3, -5, -7, -9}));
+    CHECK_EQUAL(Sequence::range(1, 10000, 1)->sum(), 50005000.0);
+    CHECK_EQUAL(Sequence::range(1, 10000, 3)->count(), 3334u);
+    CHECK(!Sequence::range(1, 0, 1)->min().has_value());
+
+    CHECK_THROWS(Sequence::range(1, 10, 0), "");
+    CHECK_THROWS(Sequence::take(-1, Sequence::range(1, 10, 1)), "");
+}
+
+TEST(SequenceFormsAgreeAcrossTiers)
+{
+    CHECK_EQUAL(runAllTiers(R"(
+        (define square ((x Float)) Float (multiply x x))
+        (define small ((x Float)) Boolean (less-than x 50.0))
+        (define minus ((a Float) (b Float)) Float (subtract a b))
+        (let (v DoubleVector) (collect (range 1 10)))
+        (print (collect (take 3 (filter small (map square (range 1 100))))))
+        (print (vector-sum (map square v)) (collect (zip minus (range 1 3) (range 10 20))))
+        (print (collect (range 10 1 -4)) (length (collect (range 1 0))))
+    )"),
+                "[1 4 9]\n385 [-9 -9 -9]\n[10 6 2] 0\n");
+    CHECK_CONTAINS(runAllTiers("(print (collect (range 1 10 0)))"), "ERR Runtime error:");
+}
@@ -0,0 +1,133 @@
+#include "TestSupport.h"
+
+#include <Shattang/MyLisp/Sketches.h>
+#include <Shattang/MyLisp/Sorting.h>
+#include <Shattang/MyLisp/VectorExpression.h>
+
+#include <algorithm>
+#include <cmath>
+
+using namespace Shattang::MyLisp;
+using namespace Shattang::MyLisp::Testing;
+
+namespace
+{
+    std::shared_ptr<const VectorExpression> expressionOf(DoubleVector values)
+    {
+        return VectorExpression::vector(std::make_shared<const DoubleVector>(std::move(values)));
+    }
+
+    DoubleVector shuffled(std::size_t size)
+    {
+        DoubleVector values(size);
+        for (std::size_t i = 0; i < size; ++i)
+        {
+            values[i] = static_cast<double>((i * 7919) % size); // a permutation, as 7919 is prime
+        }
+        return values;
+    }
+}
+
+TEST(MomentsAreNumericallyStable)
+{
+    // A large offset ruins the naive sum-of-squares variance
+    CHECK_EQUAL(runAllTiers(R"(
+        (using "math")
+        (let (v DoubleVector) (collect (range 1 5)))
+        (let (shifted DoubleVector) (make-double-vector))
+        (for i 0 4 1 (vector-push shifted (add (vector-ref v i) 1000000000.0)))
+        (print (vector-mean v) (vector-variance v) (vector-variance shifted) (vector-stddev v))
+        (print (vector-covariance v (vector-scale v 2.0)) (vector-correlation v (vector-scale v -1.0)))
+    )"),
+                "3 2 2 1.41421\n4 -1\n");
+    CHECK_CONTAINS(run("(print (vector-mean (collect (range 1 3))))"), "ERR");
+    CHECK_CONTAINS(runAllTiers(R"(
+        (using "math")
+        (print (vector-covariance (collect (range 1 3)) (collect (range 1 4))))
+    )"),
+                   "ERR Runtime error:");
+}
+
+TEST(QuantileSketchesStayWithinTheirErrorBound)
+{
+    DoubleVector values = shuffled(100000);
+    QuantileSketch whole;
+    whole.update(values.data(), values.size());
+    CHECK_EQUAL(whole.count(), 100000u);
+    for (double fraction : {0.01, 0.5, 0.99})
+    {
+        CHECK(std::fabs(whole.quantile(fraction) - fraction * 100000.0) < 2000.0);
+    }
+    CHECK_EQUAL(whole.quantile(0.0), 0.0);
+    CHECK_EQUAL(whole.quantile(1.0), 99999.0);
+
+    QuantileSketch lower, upper;
+    lower.update(values.data(), 50000);
+    upper.update(values.data() + 50000, 50000);
+    lower.merge(upper);
+    CHECK_EQUAL(lower.count(), 100000u);
+    CHECK(std::fabs(lower.quantile(0.5) - 50000.0) < 2000.0);
+
+    QuantileSketch parsed = QuantileSketch::parse(whole.serialize());
+    CHECK_EQUAL(parsed.quantile(0.5), whole.quantile(0.5));
+    CHECK_THROWS(QuantileSketch::parse("garbage"), "");
+}
+
+TEST(DistinctSketchesEstimateCardinality)
+{
+    DoubleVector values = shuffled(50000);
+    DistinctSketch sketch;
+    sketch.update(values.data(), values.size());
+    sketch.update(values.data(), values.size()); // duplicates do not count
+    CHECK_EQUAL(sketch.count(), 100000u);
+    CHECK(std::fabs(sketch.estimate() - 50000.0) < 2500.0);
+    CHECK_EQUAL(DistinctSketch::parse(sketch.serialize()).estimate(), sketch.estimate());
+    CHECK_THROWS(DistinctSketch::parse("garbage"), "");
+
+    CHECK_EQUAL(runAllTiers(R"(
+        (using "math")
+        (let (v DoubleVector) (collect (range 1 1000)))
+        (let (q QuantileSketch) (quantile-sketch v))
+        (let (d DistinctSketch) (distinct-sketch v))
+        (let (again DistinctSketch) (sketch-merge d (distinct-sketch v)))
+        (print (sketch-count q) (sketch-quantile q 0.0) (sketch-quantile q 1.0) (sketch-count again))
+        (print (equal (sketch-serialize (parse-quantile-sketch (sketch-serialize q))) (sketch-serialize q)))
+    )"),
+                "1000 1 1000 2000\ntrue\n");
+}
+
+TEST(SortingTopKAndGroupingMatchTheirDefinitions)
+{
+    DoubleVector values = shuffled(10007);
+    DoubleVector sorted = sortElements(*expressionOf(values));
+    CHECK(std::is_sorted(sorted.begin(), sorted.end()));
+    CHECK_EQUAL(sorted.size(), values.size());
+    DoubleVector order = argsortElements(*expressionOf(values));
+    for (std::size_t i = 0; i < order.size(); ++i)
+    {
+        CHECK_EQUAL(values[static_cast<std::size_t>(order[i])], sorted[i]);
+    }
+    CHECK(topElements(*expressionOf(values), 3) == (DoubleVector{10006, 10005, 10004}));
+    CHECK(histogramElements(*expressionOf(DoubleVector{0, 1, 2, 3, 9.5, 10, -1}), 0.0, 10.0, 2) ==
+          (DoubleVector{4, 2}));
+    CHECK_THROWS(histogramElements(*expressionOf(values), 1.0, 1.0, 2), "");
+
+    Groups groups = Groups::of(*expressionOf(DoubleVector{2, 1, 2, 1, 3}), *expressionOf(DoubleVector{10, 1, 20, 3, 5}));
+    CHECK(groups.keys_ == (DoubleVector{1, 2, 3}));
+    CHECK(groups.counts_ == (DoubleVector{2, 2, 1}));
+    CHECK(groups.sums_ == (DoubleVector{4, 30, 5}));
+    CHECK(groups.means() == (DoubleVector{2, 15, 5}));
+
+    CHECK_EQUAL(runAllTiers(R"(
+        (let (v DoubleVector) (make-double-vector))
+        (vector-push v 3.0)
+        (vector-push v 1.0)
+        (vector-push v 2.0)
+        (let (order DoubleVector) (argsort v))
+        (let (g Groups) (group-by-key (vector-scale v 0.0) v))
+        (print (sort v) order (vector-ref v (to-int (vector-ref order 0))) (top-k 2 v))
+        (print (histogram v 0.0 4.0 2) (group-keys g) (group-sums g) (group-counts g))
+    )"),
+                "[1 2 3] [1 2 0] 1 [3 2]\n[1 2] [0] [6] [3]\n");
+    CHECK_CONTAINS(runAllTiers("(print (top-k -1 (collect (range 1 3))))"), "ERR Runtime error:");
+}
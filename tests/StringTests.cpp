@@ -0,0 +1,65 @@
+#include "TestSupport.h"
+
+#include <Shattang/MyLisp/String.h>
+
+#include <string>
+
+using namespace Shattang::MyLisp;
+using namespace Shattang::MyLisp::Testing;
+
+TEST(SmallAndLargeStringsCompareByText)
+{
+    String empty;
+    CHECK(empty.empty());
+    String small("short");
+    String large(std::string(100, 'x'));
+    CHECK_EQUAL(small.size(), 5u);
+    CHECK_EQUAL(large.size(), 100u);
+    CHECK_EQUAL(small.str(), "short");
+    CHECK(large == String(std::string(100, 'x')));
+    CHECK(!(small == large));
+
+    String copy = large;
+    String moved = std::move(copy);
+    CHECK(moved == large);
+
+    std::ostringstream out;
+    out << small;
+    CHECK_EQUAL(out.str(), "short");
+}
+
+TEST(InternedStringsShareOneCopy)
+{
+    String a = String::intern("a name long enough to be stored on the heap");
+    String b = String::intern(std::string("a name long enough to be stored on the heap"));
+    CHECK(a == b);
+    CHECK_EQUAL(a.str(), "a name long enough to be stored on the heap");
+    CHECK(String::intern("x") == String("x"));
+}
+
+TEST(ConcatenationBuildsBalancedRopes)
+{
+    String text;
+    std::string expected;
+    for (int i = 0; i < 2000; ++i)
+    {
+        std::string piece = "piece" + std::to_string(i) + ";";
+        text = String::concat(text, String(piece));
+        expected += piece;
+    }
+    CHECK_EQUAL(text.size(), expected.size());
+    CHECK_EQUAL(text.str(), expected);
+    CHECK(text == String(expected));
+
+    std::string visited;
+    text.forEachPiece([&visited](std::string_view piece)
+                      { visited += piece; });
+    CHECK_EQUAL(visited, expected);
+
+    CHECK_EQUAL(runAllTiers(R"(
+        (let (s String) "")
+        (for i 1 500 1 (set s (string-append s (to-string (modulo i 10)))))
+        (print (string-length s) (equal s (string-append s "")) (string-append "ab" "cd" "ef"))
+    )"),
+                "500 true abcdef\n");
+}
@@ -0,0 +1,178 @@
+#include "TestSupport.h"
+
+#include <Shattang/MyLisp/Lexer.h>
+#include <Shattang/MyLisp/Parser.h>
+
+#include <exception>
+#include <filesystem>
+#include <iostream>
+#include <utility>
+#include <vector>
+#include <unistd.h>
+
+namespace Shattang::MyLisp::Testing
+{
+    namespace
+    {
+        struct Test
+        {
+            const char *name_;
+            void (*body_)();
+        };
+
+        std::vector<Test> &tests()
+        {
+            static std::vector<Test> registered;
+            return registered;
+        }
+
+        struct ScratchDirectory
+        {
+            std::filesystem::path path_ =
+                std::filesystem::temp_directory_path() / ("MyLispTests." + std::to_string(::getpid()));
+
+            ScratchDirectory() { std::filesystem::create_directories(path_); }
+            ~ScratchDirectory() { std::filesystem::remove_all(path_); }
+        };
+    }
+
+    TestRegistration::TestRegistration(const char *name, void (*body)())
+    {
+        tests().push_back(Test{name, body});
+    }
+
+    void fail(const char *file, int line, const std::string &message)
+    {
+        throw TestFailure(std::string(file) + ":" + std::to_string(line) + ": " + message);
+    }
+
+    void checkContains(const std::string &text, const std::string &part, const char *expression, const char *file, int line)
+    {
+        if (text.find(part) == std::string::npos)
+        {
+            fail(file, line, std::string(expression) + "\n  is:       " + text + "\n  lacks:    " + part);
+        }
+    }
+
+    std::string run(const std::string &source, TierOptions options, ImportHandler imports, TierStatistics *statistics)
+    {
+        std::ostringstream out;
+        try
+        {
+            Lexer lexer(source);
+            Parser parser(lexer);
+            std::unique_ptr<ASTNode> script = parser.parse();
+            Interpreter interpreter(out, options);
+            if (imports)
+            {
+                interpreter.setImportHandler(std::move(imports), false);
+            }
+            try
+            {
+                interpreter.run(static_cast<const ScriptNode &>(*script));
+            }
+            catch (...)
+            {
+                interpreter.waitForCompilation();
+                if (statistics)
+                {
+                    *statistics = interpreter.statistics();
+                }
+                throw;
+            }
+            interpreter.waitForCompilation();
+            if (statistics)
+            {
+                *statistics = interpreter.statistics();
+            }
+        }
+        catch (const std::exception &error)
+        {
+            out << "ERR " << error.what();
+        }
+        return out.str();
+    }
+
+    std::string runAllTiers(const std::string &source, ImportHandler imports)
+    {
+        std::string walker = run(source, walkerOnly(), imports);
+        std::pair<const char *, std::string> others[] = {{"tier 1", run(source, eagerTier1(), imports)},
+                                                         {"native", run(source, eagerNative(), imports)},
+                                                         {"default", run(source, TierOptions(), imports)}};
+        for (const auto &[tier, output] : others)
+        {
+            if (output != walker)
+            {
+                throw TestFailure(std::string(tier) + " output differs from the walker's\n  walker: " + walker + "\n  " +
+                                  tier + ": " + output);
+            }
+        }
+        return walker;
+    }
+
+    CheckedScript::CheckedScript(const std::string &source)
+    {
+        Lexer lexer(source);
+        Parser parser(lexer);
+        ast_ = parser.parse();
+        checker_.check(script());
+    }
+
+    const FunctionDeclarationNode &CheckedScript::function(const std::string &name) const
+    {
+        return *checker_.function(name)->declaration_;
+    }
+
+    std::string scratchPath(const std::string &file)
+    {
+        static const ScratchDirectory directory;
+        return (directory.path_ / file).string();
+    }
+
+    TierOptions walkerOnly()
+    {
+        TierOptions options;
+        options.enableTiering_ = false;
+        return options;
+    }
+
+    TierOptions eagerTier1()
+    {
+        TierOptions options;
+        options.enableNative_ = false;
+        options.backgroundCompilation_ = false;
+        options.callThreshold_ = 1;
+        options.backEdgeThreshold_ = 1;
+        return options;
+    }
+
+    TierOptions eagerNative()
+    {
+        TierOptions options = eagerTier1();
+        options.enableNative_ = true;
+        options.nativeThreshold_ = 1;
+        return options;
+    }
+
+} // namespace Shattang::MyLisp::Testing
+
+int main()
+{
+    using namespace Shattang::MyLisp::Testing;
+    int failed = 0;
+    for (const Test &test : tests())
+    {
+        try
+        {
+            test.body_();
+            std::cout << "PASS " << test.name_ << "\n";
+        }
+        catch (const std::exception &error)
+        {
+            ++failed;
+            std::cout << "FAIL " << test.name_ << "\n  " << error.what() << "\n";
+        }
+    }
+    std::cout << tests().size() - failed << " of " << tests().size() << " tests passed\n";
+    return failed == 0 ? 0 : 1;
+}
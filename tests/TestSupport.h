@@ -0,0 +1,109 @@
+#pragma once
+
+#include <Shattang/MyLisp/ASTNode.h>
+#include <Shattang/MyLisp/Interpreter.h>
+#include <Shattang/MyLisp/TypeChecker.h>
+
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+namespace Shattang::MyLisp::Testing
+{
+    // Thrown by the CHECK macros; the runner reports it and goes on with the next test
+    struct TestFailure : std::runtime_error
+    {
+        using std::runtime_error::runtime_error;
+    };
+
+    // Registers a test with the runner in TestSupport.cpp. Tests run in the order of their
+    // definitions; the program fails if any of them does.
+    struct TestRegistration
+    {
+        TestRegistration(const char *name, void (*body)());
+    };
+
+    [[noreturn]] void fail(const char *file, int line, const std::string &message);
+
+    template <typename Actual, typename Expected>
+    void checkEqual(const Actual &actual, const Expected &expected, const char *text, const char *file, int line)
+    {
+        if (!(actual == expected))
+        {
+            std::ostringstream message;
+            message << text << "\n  actual:   " << actual << "\n  expected: " << expected;
+            fail(file, line, message.str());
+        }
+    }
+
+    void checkContains(const std::string &text, const std::string &part, const char *expression, const char *file, int line);
+
+    // The printed output of `source`, or "ERR " and the message of the error that stopped it.
+    // `statistics`, if given, receives the interpreter's once compilations have finished.
+    std::string run(const std::string &source, TierOptions options = TierOptions(), ImportHandler imports = nullptr,
+                    TierStatistics *statistics = nullptr);
+
+    // Runs `source` in the walker, in tier 1 and in native code with every threshold at 1, and
+    // with the default options. Fails the test unless all four print the same; returns that.
+    std::string runAllTiers(const std::string &source, ImportHandler imports = nullptr);
+
+    // A parsed and type checked script, for tests of the passes that take one
+    struct CheckedScript
+    {
+        std::unique_ptr<ASTNode> ast_;
+        TypeChecker checker_;
+
+        explicit CheckedScript(const std::string &source);
+
+        const ScriptNode &script() const { return static_cast<const ScriptNode &>(*ast_); }
+        const ASTNode &statement(std::size_t index) const { return *script().statements_.at(index); }
+        const FunctionDeclarationNode &function(const std::string &name) const;
+    };
+
+    // `file` in a directory of this process under the system's temporary directory, which is
+    // removed again at exit
+    std::string scratchPath(const std::string &file);
+
+    TierOptions walkerOnly();
+    TierOptions eagerTier1();  // closures from the first call or iteration, no native code
+    TierOptions eagerNative(); // native code from the first call
+
+} // namespace Shattang::MyLisp::Testing
+
+#define TEST(name)                                                                          \
+    static void name();                                                                     \
+    static ::Shattang::MyLisp::Testing::TestRegistration name##Registration(#name, name); \
+    static void name()
+
+#define CHECK(condition)                                                         \
+    do                                                                           \
+    {                                                                            \
+        if (!(condition))                                                        \
+            ::Shattang::MyLisp::Testing::fail(__FILE__, __LINE__, #condition);   \
+    } while (false)
+
+#define CHECK_EQUAL(actual, expected) \
+    ::Shattang::MyLisp::Testing::checkEqual((actual), (expected), #actual " == " #expected, __FILE__, __LINE__)
+
+// Checks that `text` contains `part`, typically an error message from run()
+#define CHECK_CONTAINS(text, part) \
+    ::Shattang::MyLisp::Testing::checkContains((text), (part), #text, __FILE__, __LINE__)
+
+#define CHECK_THROWS(expression, part)                                                                   \
+    do                                                                                                   \
+    {                                                                                                    \
+        try                                                                                              \
+        {                                                                                                \
+            (void)(expression);                                                                          \
+        }                                                                                                \
+        catch (const ::Shattang::MyLisp::Testing::TestFailure &)                                         \
+        {                                                                                                \
+            throw;                                                                                       \
+        }                                                                                                \
+        catch (const std::exception &error)                                                              \
+        {                                                                                                \
+            ::Shattang::MyLisp::Testing::checkContains(error.what(), (part), #expression, __FILE__, __LINE__); \
+            break;                                                                                       \
+        }                                                                                                \
+        ::Shattang::MyLisp::Testing::fail(__FILE__, __LINE__, #expression " did not throw");            \
+    } while (false)
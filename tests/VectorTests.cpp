@@ -0,0 +1,211 @@
+#include "TestSupport.h"
+
+#include <Shattang/MyLisp/BoundsCheckElimination.h>
+#include <Shattang/MyLisp/DoubleVector.h>
+#include <Shattang/MyLisp/LoopVectorizer.h>
+#include <Shattang/MyLisp/VectorExpression.h>
+#include <Shattang/MyLisp/VectorKernels.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+using namespace Shattang::MyLisp;
+using namespace Shattang::MyLisp::Testing;
+
+namespace
+{
+    DoubleVector sample(std::size_t size, double offset)
+    {
+        DoubleVector values(size);
+        for (std::size_t i = 0; i < size; ++i)
+        {
+            values[i] = std::sin(static_cast<double>(i) + offset) * 10.0 + offset;
+        }
+        return values;
+    }
+
+    bool near(double actual, double expected)
+    {
+        return std::fabs(actual - expected) <= 1e-9 * std::fmax(1.0, std::fabs(expected));
+    }
+
+    std::shared_ptr<const VectorExpression> expressionOf(const DoubleVector &values)
+    {
+        return VectorExpression::vector(std::make_shared<const DoubleVector>(values));
+    }
+}
+
+TEST(KernelsMatchScalarLoopsOnEverySize)
+{
+    // Sizes around the vector width leave remainders for the scalar tails
+    for (std::size_t size : {0u, 1u, 3u, 4u, 7u, 8u, 9u, 31u, 1000u})
+    {
+        DoubleVector lhs = sample(size, 1.0);
+        DoubleVector rhs = sample(size, 20.0);
+        DoubleVector out(size);
+
+        Kernels::add(lhs.data(), rhs.data(), out.data(), size);
+        for (std::size_t i = 0; i < size; ++i)
+            CHECK_EQUAL(out[i], lhs[i] + rhs[i]);
+        Kernels::subtract(lhs.data(), rhs.data(), out.data(), size);
+        for (std::size_t i = 0; i < size; ++i)
+            CHECK_EQUAL(out[i], lhs[i] - rhs[i]);
+        Kernels::multiply(lhs.data(), rhs.data(), out.data(), size);
+        for (std::size_t i = 0; i < size; ++i)
+            CHECK_EQUAL(out[i], lhs[i] * rhs[i]);
+        Kernels::divide(lhs.data(), rhs.data(), out.data(), size);
+        for (std::size_t i = 0; i < size; ++i)
+            CHECK_EQUAL(out[i], lhs[i] / rhs[i]);
+        Kernels::scale(lhs.data(), 2.5, out.data(), size);
+        for (std::size_t i = 0; i < size; ++i)
+            CHECK_EQUAL(out[i], lhs[i] * 2.5);
+
+        double sum = 0.0, dot = 0.0;
+        for (std::size_t i = 0; i < size; ++i)
+        {
+            sum += lhs[i];
+            dot += lhs[i] * rhs[i];
+        }
+        CHECK(near(Kernels::sum(lhs.data(), size), sum));
+        CHECK(near(Kernels::dot(lhs.data(), rhs.data(), size), dot));
+        if (size > 0)
+        {
+            CHECK_EQUAL(Kernels::min(lhs.data(), size), *std::min_element(lhs.begin(), lhs.end()));
+            CHECK_EQUAL(Kernels::max(lhs.data(), size), *std::max_element(lhs.begin(), lhs.end()));
+        }
+    }
+    CHECK(Kernels::instructionSet() != nullptr);
+}
+
+TEST(DoubleVectorStorageIsAlignedAndChecked)
+{
+    DoubleVector values = sample(100, 0.0);
+    CHECK_EQUAL(reinterpret_cast<std::uintptr_t>(values.data()) % DoubleVector::Alignment, 0u);
+    values.push(1.0);
+    CHECK_EQUAL(values.size(), 101u);
+    CHECK_EQUAL(values.at(100), 1.0);
+    CHECK_THROWS(values.at(101), "Runtime error:");
+    CHECK_THROWS(values.at(-1), "Runtime error:");
+    CHECK_THROWS(vectorAdd(values, sample(3, 0.0)), "vector-add");
+}
+
+TEST(VectorBuiltinsAgreeAcrossTiers)
+{
+    CHECK_EQUAL(runAllTiers(R"(
+        (let (a DoubleVector) (collect (range 1 5)))
+        (let (b DoubleVector) (vector-scale a 2.0))
+        (print (vector-add a b) (vector-subtract b a) (vector-multiply a a) (vector-divide b a))
+        (print (vector-dot a b) (vector-sum a) (vector-min b) (vector-max b) (length a))
+    )"),
+                "[3 6 9 12 15] [1 2 3 4 5] [1 4 9 16 25] [2 2 2 2 2]\n110 15 2 10 5\n");
+    CHECK_CONTAINS(runAllTiers("(print (vector-add (collect (range 1 3)) (collect (range 1 4))))"), "ERR Runtime error:");
+}
+
+TEST(ElementWiseLoopsAreVectorized)
+{
+    CheckedScript script(R"(
+        (let (a DoubleVector) (collect (range 1 1000)))
+        (let (b DoubleVector) (vector-scale a 0.5))
+        (let (total Float) 0.0)
+        (for i 0 999 1 (set total (add total (multiply (vector-ref a i) (vector-ref b i)))))
+        (let (out DoubleVector) (make-double-vector))
+        (for i 0 999 1 (vector-push out (add (vector-ref a i) 1.0)))
+        (let (j Int) 0)
+        (let (largest Float) 0.0)
+        (while (less-than j 1000)
+            (set largest (if (greater-than (vector-ref b j) largest) (vector-ref b j) largest))
+            (set j (add j 1)))
+        (for i 0 999 2 (set total (add total (vector-ref a i))))
+    )");
+    std::unique_ptr<VectorLoopPlan> sum = planVectorLoop(script.statement(3), script.checker_);
+    CHECK(sum != nullptr);
+    CHECK(sum->kind_ == VectorLoopKind::SUM);
+    CHECK_EQUAL(sum->inputs_.size(), 2u);
+    std::unique_ptr<VectorLoopPlan> map = planVectorLoop(script.statement(5), script.checker_);
+    CHECK(map != nullptr);
+    CHECK(map->kind_ == VectorLoopKind::MAP);
+    std::unique_ptr<VectorLoopPlan> max = planVectorLoop(script.statement(8), script.checker_);
+    CHECK(max != nullptr);
+    CHECK(max->kind_ == VectorLoopKind::MAX);
+    // Strided loops are left alone
+    CHECK(planVectorLoop(script.statement(9), script.checker_) == nullptr);
+
+    CHECK_EQUAL(runAllTiers(R"(
+        (let (a DoubleVector) (collect (range 1 1000)))
+        (let (total Float) 0.0)
+        (for i 0 999 1 (set total (add total (multiply (vector-ref a i) 0.5))))
+        (let (out DoubleVector) (make-double-vector))
+        (for i 0 999 1 (vector-push out (subtract (vector-ref a i) 1.0)))
+        (let (smallest Float) 1000000.0)
+        (let (j Int) 0)
+        (while (less-equal j 999)
+            (set smallest (if (less-than (vector-ref a j) smallest) (vector-ref a j) smallest))
+            (set j (add j 1)))
+        (print total (vector-sum out) (length out) smallest)
+    )"),
+                "250250 499500 1000 1\n");
+}
+
+TEST(FusedExpressionsMatchMaterializedOnes)
+{
+    DoubleVector a = sample(5000, 1.0);
+    DoubleVector b = sample(5000, 2.0);
+    auto product = VectorExpression::binary(VectorExpression::Kind::MULTIPLY, expressionOf(a), expressionOf(b), "vector-multiply");
+    auto shifted = VectorExpression::binary(VectorExpression::Kind::ADD, product, VectorExpression::constant(1.0, 5000), "vector-add");
+    DoubleVector materialized = shifted->materialize();
+    CHECK_EQUAL(materialized.size(), 5000u);
+    for (std::size_t i : {0u, 1023u, 1024u, 4999u})
+    {
+        CHECK_EQUAL(materialized[i], a[i] * b[i] + 1.0);
+        CHECK_EQUAL(shifted->at(i), materialized[i]);
+    }
+    CHECK(near(shifted->sum(), vectorSum(materialized)));
+    CHECK_EQUAL(shifted->min(), vectorMin(materialized));
+    CHECK_EQUAL(shifted->max(), vectorMax(materialized));
+    CHECK_THROWS(VectorExpression::binary(VectorExpression::Kind::ADD, expressionOf(a), expressionOf(sample(3, 0.0)), "vector-add"),
+                 "vector-add");
+
+    CHECK_EQUAL(runAllTiers(R"(
+        (let (a DoubleVector) (collect (range 1 4)))
+        (let (b DoubleVector) (vector-add (vector-multiply a a) (vector-scale a 2.0)))
+        (print (vector-sum (vector-subtract b a)) b)
+    )"),
+                "40 [3 8 15 24]\n");
+}
+
+TEST(BoundsAreCheckedOnceAtLoopEntry)
+{
+    CheckedScript script(R"(
+        (let (v DoubleVector) (collect (range 1 10)))
+        (let (total Float) 0.0)
+        (for i 1 8 1 (set total (add total (subtract (vector-ref v (add i 1)) (vector-ref v (subtract i 1))))))
+    )");
+    std::unique_ptr<BoundsCheckPlan> plan =
+        planBoundsChecks(static_cast<const ForIterationNode &>(script.statement(2)), nullptr);
+    CHECK(plan != nullptr);
+    CHECK_EQUAL(plan->vectors_.size(), 1u);
+    CHECK_EQUAL(plan->vectors_[0].minOffset_, -1L);
+    CHECK_EQUAL(plan->vectors_[0].maxOffset_, 1L);
+    CHECK_EQUAL(plan->accesses_.size(), 2u);
+
+    CHECK(forIndicesInRange(1, 8, 1, -1, 1, 10));
+    CHECK(!forIndicesInRange(1, 9, 1, -1, 1, 10));
+    CHECK(!forIndicesInRange(0, 8, 1, -1, 1, 10));
+
+    // A loop that runs past the end still fails at the first bad access
+    CHECK_CONTAINS(runAllTiers(R"(
+        (let (v DoubleVector) (collect (range 1 10)))
+        (let (total Float) 0.0)
+        (for i 0 10 1 (set total (add total (vector-ref v i))))
+        (print total)
+    )"),
+                   "ERR Runtime error:");
+    CHECK_EQUAL(runAllTiers(R"(
+        (let (v DoubleVector) (collect (range 1 10)))
+        (let (total Float) 0.0)
+        (for i 1 8 1 (set total (add total (subtract (vector-ref v (add i 1)) (vector-ref v (subtract i 1))))))
+        (print total)
+    )"),
+                "16\n");
+}
@@ -0,0 +1,32 @@
+; Compiled ahead of time by the mylisp_add_library target in CMakeLists.txt;
+; CppTranspilerTests runs it and compares with the interpreter.
+
+(using "math")
+
+(define quotient ((a Int) (b Int)) Int
+    (divide a b)
+)
+
+(define remainder ((a Int) (b Int)) Int
+    (modulo a b)
+)
+
+(define mean ((values DoubleVector)) Float
+    (let (total Float) 0.0)
+    (for i 0 (subtract (length values) 1) 1
+        (set total (add total (vector-ref values i)))
+    )
+    (divide total (length values))
+)
+
+(define label ((n Int)) String
+    (if (less-than n 0) "negative" (string-append "n=" (to-string n)))
+)
+
+(let (smallest Int) -9223372036854775808)
+(let (values DoubleVector) (collect (range 1 10)))
+(let (squares DoubleVector) (vector-multiply values values))
+
+(print (quotient smallest -1) (remainder smallest -1) (quotient -7 2) (remainder -7 2))
+(print (mean values) (vector-sum squares) (vector-stddev values) (label -3) (label 42))
+(print (sort (vector-scale values -1.0)) (divide 7.0 2) 1e20)